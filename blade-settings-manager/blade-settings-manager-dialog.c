@@ -29,7 +29,12 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <sys/stat.h>
 
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
 
@@ -45,6 +50,10 @@
 #define TEXT_WIDTH (128)
 #define ICON_WIDTH (48)
 
+#define MENU_CACHE_FILE    "xfce4/settings-manager/menu.cache"
+#define MENU_CACHE_MAGIC   "XSMMENU"
+#define MENU_CACHE_VERSION (1)
+
 
 
 struct _XfceSettingsManagerDialogClass
@@ -52,12 +61,29 @@ struct _XfceSettingsManagerDialogClass
     XfceTitledDialogClass __parent__;
 };
 
+/* the fields of a store row needed to start a dialog */
+typedef struct
+{
+    gchar    *name;
+    gchar    *icon_name;
+    gchar    *comment;
+    gchar    *command;
+    gchar    *filename;
+    gboolean  snotify;
+}
+DialogItem;
+
 struct _XfceSettingsManagerDialog
 {
     XfceTitledDialog __parent__;
 
     BlconfChannel  *channel;
     PojkMenu     *menu;
+    gchar          *menu_file;
+
+    /* directories of the cache key, watched until the menu is loaded */
+    GSList         *cache_monitors;
+    guint           cache_reload_id;
 
     GtkListStore   *store;
 
@@ -72,7 +98,7 @@ struct _XfceSettingsManagerDialog
 
     GtkWidget      *socket_scroll;
     GtkWidget      *socket_viewport;
-    PojkMenuItem *socket_item;
+    DialogItem     *socket_item;
 
     GtkWidget      *button_back;
     GtkWidget      *button_help;
@@ -84,13 +110,48 @@ struct _XfceSettingsManagerDialog
 
 typedef struct
 {
-    PojkMenuDirectory       *directory;
+    gint                       index;
+    gchar                     *name;
     XfceSettingsManagerDialog *dialog;
     GtkWidget                 *iconview;
     GtkWidget                 *box;
 }
 DialogCategory;
 
+/* on-disk layout of the menu cache: header, the categories, the items
+ * of all categories in order and the string pool, strings are referenced
+ * by their offset in the pool */
+typedef struct
+{
+    gchar   magic[8];
+    guint32 version;
+    guint32 n_categories;
+    guint32 n_items;
+    guint32 strings_len;
+    guint32 key;
+}
+MenuCacheHeader;
+
+typedef struct
+{
+    guint32 name;
+    guint32 n_items;
+}
+MenuCacheCategory;
+
+typedef struct
+{
+    guint32 name;
+    guint32 icon_name;
+    guint32 comment;
+    guint32 command;
+    guint32 filename;
+    guint32 desktop_id;
+    guint32 filter_text;
+    guint32 snotify;
+}
+MenuCacheItem;
+
 
 
 enum
@@ -98,8 +159,11 @@ enum
     COLUMN_NAME,
     COLUMN_ICON_NAME,
     COLUMN_TOOLTIP,
-    COLUMN_MENU_ITEM,
-    COLUMN_MENU_DIRECTORY,
+    COLUMN_COMMAND,
+    COLUMN_FILENAME,
+    COLUMN_DESKTOP_ID,
+    COLUMN_SNOTIFY,
+    COLUMN_CATEGORY,
     COLUMN_FILTER_TEXT,
     N_COLUMNS
 };
@@ -119,6 +183,7 @@ static void     xfce_settings_manager_dialog_set_title       (XfceSettingsManage
                                                               const gchar               *icon_name,
                                                               const gchar               *subtitle);
 static void     xfce_settings_manager_dialog_go_back         (XfceSettingsManagerDialog *dialog);
+static void     xfce_settings_manager_dialog_item_free       (DialogItem                *item);
 static void     xfce_settings_manager_dialog_entry_changed   (GtkWidget                 *entry,
                                                               XfceSettingsManagerDialog *dialog);
 static gboolean xfce_settings_manager_dialog_entry_key_press (GtkWidget                 *entry,
@@ -128,6 +193,11 @@ static void     xfce_settings_manager_dialog_entry_clear     (GtkWidget
                                                               GtkEntryIconPosition       icon_pos,
                                                               GdkEvent                  *event);
 static void     xfce_settings_manager_dialog_menu_reload     (XfceSettingsManagerDialog *dialog);
+static gboolean xfce_settings_manager_dialog_cache_load      (XfceSettingsManagerDialog *dialog,
+                                                              GPtrArray                 *paths);
+static void     xfce_settings_manager_dialog_cache_watch     (XfceSettingsManagerDialog *dialog,
+                                                              GPtrArray                 *paths);
+static void     xfce_settings_manager_dialog_cache_unwatch   (XfceSettingsManagerDialog *dialog);
 static void     xfce_settings_manager_dialog_scroll_to_item  (GtkWidget                 *iconview,
                                                               XfceSettingsManagerDialog *dialog);
 
@@ -170,6 +240,7 @@ xfce_settings_manager_dialog_init (XfceSettingsManagerDialog *dialog)
     GtkWidget *viewport;
     GList     *children;
     gchar     *path;
+    GPtrArray *paths;
 
     dialog->channel = blconf_channel_get ("blade-settings-manager");
 
@@ -177,13 +248,16 @@ xfce_settings_manager_dialog_init (XfceSettingsManagerDialog *dialog)
                                         G_TYPE_STRING,
                                         G_TYPE_STRING,
                                         G_TYPE_STRING,
-                                        POJK_TYPE_MENU_ITEM,
-                                        POJK_TYPE_MENU_DIRECTORY,
+                                        G_TYPE_STRING,
+                                        G_TYPE_STRING,
+                                        G_TYPE_STRING,
+                                        G_TYPE_BOOLEAN,
+                                        G_TYPE_INT,
                                         G_TYPE_STRING);
 
     path = xfce_resource_lookup (XFCE_RESOURCE_CONFIG, "menus/blade-settings-manager.menu");
-    dialog->menu = pojk_menu_new_for_path (path != NULL ? path : MENUFILE);
-    g_free (path);
+    dialog->menu_file = path != NULL ? path : g_strdup (MENUFILE);
+    dialog->menu = pojk_menu_new_for_path (dialog->menu_file);
 
     gtk_window_set_default_size (GTK_WINDOW (dialog),
       blconf_channel_get_int (dialog->channel, "/last/window-width", 640),
@@ -276,7 +350,15 @@ xfce_settings_manager_dialog_init (XfceSettingsManagerDialog *dialog)
     gtk_viewport_set_shadow_type (GTK_VIEWPORT (viewport), GTK_SHADOW_NONE);
     gtk_widget_show (viewport);
 
-    xfce_settings_manager_dialog_menu_reload (dialog);
+    /* trust the cache key and only load the menu once one of the
+     * files it was computed from changes, pojk monitors the menu
+     * itself after the first load */
+    paths = g_ptr_array_new_with_free_func (g_free);
+    if (xfce_settings_manager_dialog_cache_load (dialog, paths))
+        xfce_settings_manager_dialog_cache_watch (dialog, paths);
+    else
+        xfce_settings_manager_dialog_menu_reload (dialog);
+    g_ptr_array_free (paths, TRUE);
 
     g_signal_connect_swapped (G_OBJECT (dialog->menu), "reload-required",
         G_CALLBACK (xfce_settings_manager_dialog_menu_reload), dialog);
@@ -295,9 +377,12 @@ xfce_settings_manager_dialog_finalize (GObject *object)
 
     g_free (dialog->filter_text);
 
+    xfce_settings_manager_dialog_cache_unwatch (dialog);
+
     if (dialog->socket_item != NULL)
-        g_object_unref (G_OBJECT (dialog->socket_item));
+        xfce_settings_manager_dialog_item_free (dialog->socket_item);
 
+    g_free (dialog->menu_file);
     g_object_unref (G_OBJECT (dialog->menu));
     g_object_unref (G_OBJECT (dialog->store));
 
@@ -519,7 +604,6 @@ xfce_settings_manager_dialog_query_tooltip (GtkWidget                 *iconview,
     GValue          value = { 0, };
     GtkTreeModel   *model;
     GtkTreeIter     iter;
-    PojkMenuItem *item;
     const gchar    *comment;
 
     if (keyboard_mode)
@@ -537,11 +621,9 @@ xfce_settings_manager_dialog_query_tooltip (GtkWidget                 *iconview,
     model = blxo_icon_view_get_model (BLXO_ICON_VIEW (iconview));
     if (gtk_tree_model_get_iter (model, &iter, path))
     {
-        gtk_tree_model_get_value (model, &iter, COLUMN_MENU_ITEM, &value);
-        item = g_value_get_object (&value);
-        g_assert (POJK_IS_MENU_ITEM (item));
+        gtk_tree_model_get_value (model, &iter, COLUMN_TOOLTIP, &value);
 
-        comment = pojk_menu_item_get_comment (item);
+        comment = g_value_get_string (&value);
         if (!blxo_str_is_empty (comment))
             gtk_tooltip_set_text (tooltip, comment);
 
@@ -619,7 +701,7 @@ xfce_settings_manager_dialog_go_back (XfceSettingsManagerDialog *dialog)
 
     if (dialog->socket_item != NULL)
     {
-        g_object_unref (G_OBJECT (dialog->socket_item));
+        xfce_settings_manager_dialog_item_free (dialog->socket_item);
         dialog->socket_item = NULL;
     }
 }
@@ -781,9 +863,9 @@ xfce_settings_manager_dialog_plug_added (GtkWidget                 *socket,
 {
     /* set dialog information from desktop file */
     xfce_settings_manager_dialog_set_title (dialog,
-        pojk_menu_item_get_name (dialog->socket_item),
-        pojk_menu_item_get_icon_name (dialog->socket_item),
-        pojk_menu_item_get_comment (dialog->socket_item));
+        dialog->socket_item->name,
+        dialog->socket_item->icon_name,
+        dialog->socket_item->comment);
 
     /* show socket and hide the categories view */
     gtk_widget_show (dialog->socket_scroll);
@@ -806,7 +888,7 @@ xfce_settings_manager_dialog_plug_removed (GtkWidget                 *socket,
 {
     /* this shouldn't happen */
     g_critical ("pluggable dialog \"%s\" crashed",
-                pojk_menu_item_get_command (dialog->socket_item));
+                dialog->socket_item->command);
 
     /* restore dialog */
     xfce_settings_manager_dialog_go_back (dialog);
@@ -814,35 +896,61 @@ xfce_settings_manager_dialog_plug_removed (GtkWidget                 *socket,
 
 
 
+static DialogItem *
+xfce_settings_manager_dialog_item_get (GtkTreeModel *model,
+                                       GtkTreeIter  *iter)
+{
+    DialogItem *item;
+
+    item = g_slice_new0 (DialogItem);
+    gtk_tree_model_get (model, iter,
+                        COLUMN_NAME, &item->name,
+                        COLUMN_ICON_NAME, &item->icon_name,
+                        COLUMN_TOOLTIP, &item->comment,
+                        COLUMN_COMMAND, &item->command,
+                        COLUMN_FILENAME, &item->filename,
+                        COLUMN_SNOTIFY, &item->snotify, -1);
+
+    return item;
+}
+
+
+
+static void
+xfce_settings_manager_dialog_item_free (DialogItem *item)
+{
+    g_free (item->name);
+    g_free (item->icon_name);
+    g_free (item->comment);
+    g_free (item->command);
+    g_free (item->filename);
+    g_slice_free (DialogItem, item);
+}
+
+
+
+/* takes ownership of item */
 static void
 xfce_settings_manager_dialog_spawn (XfceSettingsManagerDialog *dialog,
-                                    PojkMenuItem            *item)
+                                    DialogItem                *item)
 {
     const gchar    *command;
-    gboolean        snotify;
     GdkScreen      *screen;
     GError         *error = NULL;
-    GFile          *desktop_file;
-    gchar          *filename;
     XfceRc         *rc;
     gboolean        pluggable = FALSE;
     gchar          *cmd;
     GtkWidget      *socket;
     GdkCursor      *cursor;
 
-    g_return_if_fail (POJK_IS_MENU_ITEM (item));
+    g_return_if_fail (item != NULL && item->command != NULL);
 
     screen = gtk_window_get_screen (GTK_WINDOW (dialog));
-    command = pojk_menu_item_get_command (item);
+    command = item->command;
 
     /* we need to read some more info from the desktop
      *  file that is not supported by pojk */
-    desktop_file = pojk_menu_item_get_file (item);
-    filename = g_file_get_path (desktop_file);
-    g_object_unref (desktop_file);
-
-    rc = xfce_rc_simple_open (filename, TRUE);
-    g_free (filename);
+    rc = item->filename != NULL ? xfce_rc_simple_open (item->filename, TRUE) : NULL;
     if (G_LIKELY (rc != NULL))
     {
         pluggable = xfce_rc_read_bool_entry (rc, "X-XfcePluggable", FALSE);
@@ -873,7 +981,9 @@ xfce_settings_manager_dialog_spawn (XfceSettingsManagerDialog *dialog,
         gtk_widget_show (socket);
 
         /* for info when the plug is attached */
-        dialog->socket_item = g_object_ref (item);
+        if (dialog->socket_item != NULL)
+            xfce_settings_manager_dialog_item_free (dialog->socket_item);
+        dialog->socket_item = item;
 
         /* spawn dialog with socket argument */
         cmd = g_strdup_printf ("%s --socket-id=%d", command, gtk_socket_get_id (GTK_SOCKET (socket)));
@@ -889,13 +999,14 @@ xfce_settings_manager_dialog_spawn (XfceSettingsManagerDialog *dialog,
     }
     else
     {
-        snotify = pojk_menu_item_supports_startup_notification (item);
-        if (!xfce_spawn_command_line_on_screen (screen, command, FALSE, snotify, &error))
+        if (!xfce_spawn_command_line_on_screen (screen, command, FALSE, item->snotify, &error))
         {
             xfce_dialog_show_error (GTK_WINDOW (dialog), error,
                                     _("Unable to start \"%s\""), command);
             g_error_free (error);
         }
+
+        xfce_settings_manager_dialog_item_free (item);
     }
 }
 
@@ -908,17 +1019,12 @@ xfce_settings_manager_dialog_item_activated (BlxoIconView               *iconvie
 {
     GtkTreeModel   *model;
     GtkTreeIter     iter;
-    PojkMenuItem *item;
 
     model = blxo_icon_view_get_model (iconview);
     if (gtk_tree_model_get_iter (model, &iter, path))
     {
-        gtk_tree_model_get (model, &iter, COLUMN_MENU_ITEM, &item, -1);
-        g_assert (POJK_IS_MENU_ITEM (item));
-
-        xfce_settings_manager_dialog_spawn (dialog, item);
-
-        g_object_unref (G_OBJECT (item));
+        xfce_settings_manager_dialog_spawn (dialog,
+            xfce_settings_manager_dialog_item_get (model, &iter));
     }
 }
 
@@ -936,8 +1042,8 @@ xfce_settings_manager_dialog_filter_category (GtkTreeModel *model,
     const gchar    *filter_text;
 
     /* filter only the active category */
-    gtk_tree_model_get_value (model, iter, COLUMN_MENU_DIRECTORY, &cat_val);
-    visible = g_value_get_object (&cat_val) == G_OBJECT (category->directory);
+    gtk_tree_model_get_value (model, iter, COLUMN_CATEGORY, &cat_val);
+    visible = g_value_get_int (&cat_val) == category->index;
     g_value_unset (&cat_val);
 
     /* filter search string */
@@ -1025,7 +1131,7 @@ xfce_settings_manager_dialog_category_free (gpointer data)
 
     dialog->categories = g_list_remove (dialog->categories, category);
 
-    g_object_unref (G_OBJECT (category->directory));
+    g_free (category->name);
     g_slice_free (DialogCategory, category);
 }
 
@@ -1033,7 +1139,8 @@ xfce_settings_manager_dialog_category_free (gpointer data)
 
 static void
 xfce_settings_manager_dialog_add_category (XfceSettingsManagerDialog *dialog,
-                                           PojkMenuDirectory       *directory)
+                                           gint                       index,
+                                           const gchar               *name)
 {
     GtkTreeModel    *filter;
     GtkWidget       *alignment;
@@ -1046,7 +1153,8 @@ xfce_settings_manager_dialog_add_category (XfceSettingsManagerDialog *dialog,
     DialogCategory  *category;
 
     category = g_slice_new0 (DialogCategory);
-    category->directory = (PojkMenuDirectory *) g_object_ref (G_OBJECT (directory));
+    category->index = index;
+    category->name = g_strdup (name);
     category->dialog = dialog;
 
     /* filter category from main store */
@@ -1060,7 +1168,7 @@ xfce_settings_manager_dialog_add_category (XfceSettingsManagerDialog *dialog,
     gtk_widget_show (vbox);
 
     /* create a label for the category title */
-    label = gtk_label_new (pojk_menu_directory_get_name (directory));
+    label = gtk_label_new (name);
     attrs = pango_attr_list_new ();
     pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
     gtk_label_set_attributes (GTK_LABEL (label), attrs);
@@ -1172,6 +1280,514 @@ xfce_settings_manager_dialog_menu_sort (gconstpointer a,
 
 
 
+static void
+xfce_settings_manager_dialog_cache_key_add (GChecksum   *checksum,
+                                            GPtrArray   *paths,
+                                            const gchar *path,
+                                            gboolean     recursive)
+{
+    struct stat  st;
+    gchar       *str;
+    GDir        *dir;
+    const gchar *name;
+    gchar       *child;
+
+    if (paths != NULL)
+        g_ptr_array_add (paths, g_strdup (path));
+
+    /* a missing directory is part of the key too, so creating
+     * it later invalidates the cache */
+    if (g_stat (path, &st) != 0)
+    {
+        str = g_strdup_printf ("%s:-\n", path);
+        g_checksum_update (checksum, (const guchar *) str, -1);
+        g_free (str);
+        return;
+    }
+
+    str = g_strdup_printf ("%s:%ld\n", path, (glong) st.st_mtime);
+    g_checksum_update (checksum, (const guchar *) str, -1);
+    g_free (str);
+
+    if (!recursive || !S_ISDIR (st.st_mode))
+        return;
+
+    /* desktop files in subdirectories are part of the menu too,
+     * skip the desktop files themselves to avoid a stat for each */
+    dir = g_dir_open (path, 0, NULL);
+    if (dir == NULL)
+        return;
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        if (g_str_has_suffix (name, ".desktop")
+            || g_str_has_suffix (name, ".directory"))
+            continue;
+
+        child = g_build_filename (path, name, NULL);
+        if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            xfce_settings_manager_dialog_cache_key_add (checksum, paths, child, TRUE);
+        g_free (child);
+    }
+
+    g_dir_close (dir);
+}
+
+
+
+static void
+xfce_settings_manager_dialog_cache_key_add_dirs (GChecksum           *checksum,
+                                                 GPtrArray           *paths,
+                                                 const gchar         *user_dir,
+                                                 const gchar * const *system_dirs,
+                                                 const gchar         *relpath,
+                                                 gboolean             recursive)
+{
+    gchar *path;
+    guint  i;
+
+    path = g_build_filename (user_dir, relpath, NULL);
+    xfce_settings_manager_dialog_cache_key_add (checksum, paths, path, recursive);
+    g_free (path);
+
+    for (i = 0; system_dirs[i] != NULL; i++)
+    {
+        path = g_build_filename (system_dirs[i], relpath, NULL);
+        xfce_settings_manager_dialog_cache_key_add (checksum, paths, path, recursive);
+        g_free (path);
+    }
+}
+
+
+
+/**
+ * The key of the menu cache, a checksum of the menu file and the
+ * modification times of all directories the menu is merged from,
+ * the language and version, because names and comments are translated.
+ * If paths is not NULL, the files and directories are added to it.
+ **/
+static gchar *
+xfce_settings_manager_dialog_cache_key (XfceSettingsManagerDialog *dialog,
+                                        GPtrArray                 *paths)
+{
+    GChecksum           *checksum;
+    const gchar * const *languages;
+    gchar               *basename;
+    gchar               *merged;
+    gchar               *key;
+    guint                i;
+
+    checksum = g_checksum_new (G_CHECKSUM_MD5);
+
+    g_checksum_update (checksum, (const guchar *) PACKAGE_VERSION "\n", -1);
+
+    languages = g_get_language_names ();
+    for (i = 0; languages[i] != NULL; i++)
+    {
+        g_checksum_update (checksum, (const guchar *) languages[i], -1);
+        g_checksum_update (checksum, (const guchar *) "\n", -1);
+    }
+
+    xfce_settings_manager_dialog_cache_key_add (checksum, paths, dialog->menu_file, FALSE);
+
+    /* <DefaultAppDirs/> and <DefaultDirectoryDirs/> */
+    xfce_settings_manager_dialog_cache_key_add_dirs (checksum, paths,
+        g_get_user_data_dir (), g_get_system_data_dirs (), "applications", TRUE);
+    xfce_settings_manager_dialog_cache_key_add_dirs (checksum, paths,
+        g_get_user_data_dir (), g_get_system_data_dirs (), "desktop-directories", FALSE);
+
+    /* <DefaultMergeDirs/> */
+    basename = g_path_get_basename (dialog->menu_file);
+    if (g_str_has_suffix (basename, ".menu"))
+        basename[strlen (basename) - strlen (".menu")] = '\0';
+    merged = g_strdup_printf ("menus/%s-merged", basename);
+    xfce_settings_manager_dialog_cache_key_add_dirs (checksum, paths,
+        g_get_user_config_dir (), g_get_system_config_dirs (), merged, TRUE);
+    g_free (merged);
+    g_free (basename);
+
+    key = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+
+    return key;
+}
+
+
+
+static guint32
+xfce_settings_manager_dialog_cache_add_string (GString     *strings,
+                                               const gchar *str)
+{
+    guint32 offset;
+
+    /* the pool starts with an empty string */
+    if (str == NULL || *str == '\0')
+        return 0;
+
+    offset = strings->len;
+
+    /* include the nul terminator */
+    g_string_append_len (strings, str, strlen (str) + 1);
+
+    return offset;
+}
+
+
+
+/**
+ * Write the categories and items in the store to the menu cache,
+ * the next start can then show them without loading the menu.
+ **/
+static void
+xfce_settings_manager_dialog_cache_save (XfceSettingsManagerDialog *dialog)
+{
+    GtkTreeModel      *model = GTK_TREE_MODEL (dialog->store);
+    GtkTreeIter        iter;
+    MenuCacheHeader    header;
+    MenuCacheCategory  cache_category;
+    MenuCacheItem      cache_item;
+    GArray            *categories;
+    GArray            *items;
+    GString           *strings;
+    GList             *li;
+    DialogCategory    *category;
+    gchar             *name, *icon_name, *comment;
+    gchar             *command, *filename, *desktop_id;
+    gchar             *filter_text;
+    gboolean           snotify;
+    gint               index;
+    gchar             *key;
+    gchar             *cache_file;
+    gchar             *data, *p;
+    gsize              length;
+    GError            *error = NULL;
+
+    cache_file = xfce_resource_save_location (XFCE_RESOURCE_CACHE, MENU_CACHE_FILE, TRUE);
+    if (G_UNLIKELY (cache_file == NULL))
+        return;
+
+    categories = g_array_new (FALSE, FALSE, sizeof (MenuCacheCategory));
+    items = g_array_new (FALSE, FALSE, sizeof (MenuCacheItem));
+    strings = g_string_sized_new (16 * 1024);
+    g_string_append_c (strings, '\0');
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, MENU_CACHE_MAGIC, sizeof (header.magic));
+    header.version = MENU_CACHE_VERSION;
+
+    key = xfce_settings_manager_dialog_cache_key (dialog, NULL);
+    header.key = xfce_settings_manager_dialog_cache_add_string (strings, key);
+    g_free (key);
+
+    /* categories in order of the layout */
+    for (li = dialog->categories; li != NULL; li = li->next)
+    {
+        category = li->data;
+
+        cache_category.name = xfce_settings_manager_dialog_cache_add_string (strings, category->name);
+        cache_category.n_items = 0;
+        g_array_append_val (categories, cache_category);
+    }
+
+    /* the items in the store are sorted by category */
+    if (gtk_tree_model_get_iter_first (model, &iter))
+    {
+        do
+        {
+            gtk_tree_model_get (model, &iter,
+                                COLUMN_NAME, &name,
+                                COLUMN_ICON_NAME, &icon_name,
+                                COLUMN_TOOLTIP, &comment,
+                                COLUMN_COMMAND, &command,
+                                COLUMN_FILENAME, &filename,
+                                COLUMN_DESKTOP_ID, &desktop_id,
+                                COLUMN_SNOTIFY, &snotify,
+                                COLUMN_CATEGORY, &index,
+                                COLUMN_FILTER_TEXT, &filter_text, -1);
+
+            if (G_LIKELY (index >= 0 && (guint) index < categories->len))
+            {
+                g_array_index (categories, MenuCacheCategory, index).n_items++;
+
+                cache_item.name = xfce_settings_manager_dialog_cache_add_string (strings, name);
+                cache_item.icon_name = xfce_settings_manager_dialog_cache_add_string (strings, icon_name);
+                cache_item.comment = xfce_settings_manager_dialog_cache_add_string (strings, comment);
+                cache_item.command = xfce_settings_manager_dialog_cache_add_string (strings, command);
+                cache_item.filename = xfce_settings_manager_dialog_cache_add_string (strings, filename);
+                cache_item.desktop_id = xfce_settings_manager_dialog_cache_add_string (strings, desktop_id);
+                cache_item.filter_text = xfce_settings_manager_dialog_cache_add_string (strings, filter_text);
+                cache_item.snotify = snotify;
+                g_array_append_val (items, cache_item);
+            }
+
+            g_free (name);
+            g_free (icon_name);
+            g_free (comment);
+            g_free (command);
+            g_free (filename);
+            g_free (desktop_id);
+            g_free (filter_text);
+        }
+        while (gtk_tree_model_iter_next (model, &iter));
+    }
+
+    header.n_categories = categories->len;
+    header.n_items = items->len;
+    header.strings_len = strings->len;
+
+    length = sizeof (header)
+             + categories->len * sizeof (MenuCacheCategory)
+             + items->len * sizeof (MenuCacheItem)
+             + strings->len;
+
+    data = p = g_malloc (length);
+    memcpy (p, &header, sizeof (header));
+    p += sizeof (header);
+    memcpy (p, categories->data, categories->len * sizeof (MenuCacheCategory));
+    p += categories->len * sizeof (MenuCacheCategory);
+    memcpy (p, items->data, items->len * sizeof (MenuCacheItem));
+    p += items->len * sizeof (MenuCacheItem);
+    memcpy (p, strings->str, strings->len);
+
+    g_array_free (categories, TRUE);
+    g_array_free (items, TRUE);
+    g_string_free (strings, TRUE);
+
+    if (!g_file_set_contents (cache_file, data, length, &error))
+    {
+        g_warning ("Failed to save the menu cache: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+    g_free (cache_file);
+}
+
+
+
+static const gchar *
+xfce_settings_manager_dialog_cache_string (const gchar *strings,
+                                           guint32      offset)
+{
+    /* empty strings were stored for missing values */
+    return strings[offset] != '\0' ? strings + offset : NULL;
+}
+
+
+
+/**
+ * Fill the store from the menu cache, returns FALSE if there is no
+ * cache or it is outdated, so the menu has to be loaded.
+ **/
+static gboolean
+xfce_settings_manager_dialog_cache_load (XfceSettingsManagerDialog *dialog,
+                                         GPtrArray                 *paths)
+{
+    GMappedFile             *mapped;
+    const gchar             *data;
+    gsize                    length;
+    MenuCacheHeader          header;
+    const MenuCacheCategory *cache_categories;
+    const MenuCacheItem     *cache_items;
+    const MenuCacheItem     *cache_item;
+    const gchar             *strings;
+    gsize                    expected;
+    gchar                   *cache_file;
+    gchar                   *key;
+    guint                    i, n, n_items;
+    gint                     position = 0;
+    gboolean                 valid = FALSE;
+
+    cache_file = xfce_resource_lookup (XFCE_RESOURCE_CACHE, MENU_CACHE_FILE);
+    if (cache_file == NULL)
+        return FALSE;
+
+    mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+    g_free (cache_file);
+    if (mapped == NULL)
+        return FALSE;
+
+    data = g_mapped_file_get_contents (mapped);
+    length = g_mapped_file_get_length (mapped);
+
+    if (length < sizeof (header))
+        goto invalid;
+
+    memcpy (&header, data, sizeof (header));
+    if (memcmp (header.magic, MENU_CACHE_MAGIC, sizeof (header.magic)) != 0
+        || header.version != MENU_CACHE_VERSION)
+        goto invalid;
+
+    expected = sizeof (header)
+               + (gsize) header.n_categories * sizeof (MenuCacheCategory)
+               + (gsize) header.n_items * sizeof (MenuCacheItem)
+               + header.strings_len;
+    if (expected != length
+        || header.strings_len == 0
+        || header.key >= header.strings_len)
+        goto invalid;
+
+    strings = data + length - header.strings_len;
+    if (strings[header.strings_len - 1] != '\0')
+        goto invalid;
+
+    key = xfce_settings_manager_dialog_cache_key (dialog, paths);
+    valid = strcmp (strings + header.key, key) == 0;
+    g_free (key);
+    if (!valid)
+        goto invalid;
+
+    cache_categories = (const MenuCacheCategory *) (data + sizeof (header));
+    cache_items = (const MenuCacheItem *) (cache_categories + header.n_categories);
+
+    /* check all offsets before the store is touched */
+    for (i = 0, n_items = 0; i < header.n_categories; i++)
+    {
+        if (cache_categories[i].name >= header.strings_len
+            || cache_categories[i].n_items > header.n_items - n_items)
+            goto invalid;
+        n_items += cache_categories[i].n_items;
+    }
+
+    for (n = 0; n < header.n_items; n++)
+    {
+        cache_item = &cache_items[n];
+        if (cache_item->name >= header.strings_len
+            || cache_item->icon_name >= header.strings_len
+            || cache_item->comment >= header.strings_len
+            || cache_item->command >= header.strings_len
+            || cache_item->filename >= header.strings_len
+            || cache_item->desktop_id >= header.strings_len
+            || cache_item->filter_text >= header.strings_len)
+            goto invalid;
+    }
+
+    for (i = 0; i < header.n_categories; i++)
+    {
+        for (n = 0; n < cache_categories[i].n_items; n++, cache_items++)
+        {
+            gtk_list_store_insert_with_values (dialog->store, NULL, position++,
+                COLUMN_NAME, strings + cache_items->name,
+                COLUMN_ICON_NAME, xfce_settings_manager_dialog_cache_string (strings, cache_items->icon_name),
+                COLUMN_TOOLTIP, xfce_settings_manager_dialog_cache_string (strings, cache_items->comment),
+                COLUMN_COMMAND, strings + cache_items->command,
+                COLUMN_FILENAME, xfce_settings_manager_dialog_cache_string (strings, cache_items->filename),
+                COLUMN_DESKTOP_ID, xfce_settings_manager_dialog_cache_string (strings, cache_items->desktop_id),
+                COLUMN_SNOTIFY, cache_items->snotify != 0,
+                COLUMN_CATEGORY, (gint) i,
+                COLUMN_FILTER_TEXT, strings + cache_items->filter_text, -1);
+        }
+
+        /* only categories with items are stored */
+        xfce_settings_manager_dialog_add_category (dialog, i, strings + cache_categories[i].name);
+    }
+
+    g_mapped_file_unref (mapped);
+
+    return TRUE;
+
+invalid:
+    g_mapped_file_unref (mapped);
+
+    return FALSE;
+}
+
+
+
+static gboolean
+xfce_settings_manager_dialog_cache_reload (gpointer data)
+{
+    XfceSettingsManagerDialog *dialog = XFCE_SETTINGS_MANAGER_DIALOG (data);
+
+    dialog->cache_reload_id = 0;
+
+    /* the reload starts the pojk monitors and rewrites the cache */
+    xfce_settings_manager_dialog_cache_unwatch (dialog);
+    xfce_settings_manager_dialog_menu_reload (dialog);
+
+    return FALSE;
+}
+
+
+
+static void
+xfce_settings_manager_dialog_cache_changed (GFileMonitor              *monitor,
+                                            GFile                     *file,
+                                            GFile                     *other_file,
+                                            GFileMonitorEvent          event_type,
+                                            XfceSettingsManagerDialog *dialog)
+{
+    if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED
+        || event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT
+        || event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+        return;
+
+    /* wait for things to settle down, an install touches many files */
+    if (dialog->cache_reload_id == 0)
+        dialog->cache_reload_id = g_timeout_add (500, xfce_settings_manager_dialog_cache_reload, dialog);
+}
+
+
+
+/**
+ * Watch the menu file and the directories of the cache key, this also
+ * sees desktop files edited in place, which do not change the key.
+ **/
+static void
+xfce_settings_manager_dialog_cache_watch (XfceSettingsManagerDialog *dialog,
+                                          GPtrArray                 *paths)
+{
+    GFile        *file;
+    GFileMonitor *monitor;
+    const gchar  *path;
+    guint         i;
+
+    for (i = 0; i < paths->len; i++)
+    {
+        path = g_ptr_array_index (paths, i);
+        file = g_file_new_for_path (path);
+
+        /* missing paths are watched too, so creating them reloads */
+        if (g_file_test (path, G_FILE_TEST_IS_DIR))
+            monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+        else
+            monitor = g_file_monitor (file, G_FILE_MONITOR_NONE, NULL, NULL);
+        g_object_unref (G_OBJECT (file));
+
+        if (G_LIKELY (monitor != NULL))
+        {
+            g_signal_connect (G_OBJECT (monitor), "changed",
+                G_CALLBACK (xfce_settings_manager_dialog_cache_changed), dialog);
+            dialog->cache_monitors = g_slist_prepend (dialog->cache_monitors, monitor);
+        }
+    }
+}
+
+
+
+static void
+xfce_settings_manager_dialog_cache_unwatch (XfceSettingsManagerDialog *dialog)
+{
+    GSList *li;
+
+    if (dialog->cache_reload_id != 0)
+    {
+        g_source_remove (dialog->cache_reload_id);
+        dialog->cache_reload_id = 0;
+    }
+
+    for (li = dialog->cache_monitors; li != NULL; li = li->next)
+    {
+        g_file_monitor_cancel (G_FILE_MONITOR (li->data));
+        g_object_unref (G_OBJECT (li->data));
+    }
+
+    g_slist_free (dialog->cache_monitors);
+    dialog->cache_monitors = NULL;
+}
+
+
+
 static void
 xfce_settings_manager_dialog_menu_reload (XfceSettingsManagerDialog *dialog)
 {
@@ -1181,9 +1797,12 @@ xfce_settings_manager_dialog_menu_reload (XfceSettingsManagerDialog *dialog)
     PojkMenuDirectory *directory;
     GList               *items, *lp;
     gint                 i = 0;
+    gint                 n_categories = 0;
     gchar               *item_text;
     gchar               *normalized;
     gchar               *filter_text;
+    GFile               *desktop_file;
+    gchar               *filename;
     DialogCategory      *category;
 
     g_return_if_fail (XFCE_IS_SETTINGS_MANAGER_DIALOG (dialog));
@@ -1238,24 +1857,36 @@ xfce_settings_manager_dialog_menu_reload (XfceSettingsManagerDialog *dialog)
                     filter_text = g_utf8_casefold (normalized, -1);
                     g_free (normalized);
 
+                    desktop_file = pojk_menu_item_get_file (lp->data);
+                    filename = g_file_get_path (desktop_file);
+                    g_object_unref (desktop_file);
+
                     gtk_list_store_insert_with_values (dialog->store, NULL, i++,
                         COLUMN_NAME, pojk_menu_item_get_name (lp->data),
                         COLUMN_ICON_NAME, pojk_menu_item_get_icon_name (lp->data),
                         COLUMN_TOOLTIP, pojk_menu_item_get_comment (lp->data),
-                        COLUMN_MENU_ITEM, lp->data,
-                        COLUMN_MENU_DIRECTORY, directory,
+                        COLUMN_COMMAND, pojk_menu_item_get_command (lp->data),
+                        COLUMN_FILENAME, filename,
+                        COLUMN_DESKTOP_ID, pojk_menu_item_get_desktop_id (lp->data),
+                        COLUMN_SNOTIFY, pojk_menu_item_supports_startup_notification (lp->data),
+                        COLUMN_CATEGORY, n_categories,
                         COLUMN_FILTER_TEXT, filter_text, -1);
 
+                    g_free (filename);
                     g_free (filter_text);
                 }
                 g_list_free (items);
 
                 /* add the new category to the box */
-                xfce_settings_manager_dialog_add_category (dialog, directory);
+                xfce_settings_manager_dialog_add_category (dialog, n_categories++,
+                    pojk_menu_directory_get_name (directory));
             }
         }
 
         g_list_free (elements);
+
+        /* store the result for the next start */
+        xfce_settings_manager_dialog_cache_save (dialog);
     }
     else
     {
@@ -1265,6 +1896,7 @@ xfce_settings_manager_dialog_menu_reload (XfceSettingsManagerDialog *dialog)
 }
 
 
+
 GtkWidget *
 xfce_settings_manager_dialog_new (void)
 {
@@ -1279,8 +1911,7 @@ xfce_settings_manager_dialog_show_dialog (XfceSettingsManagerDialog *dialog,
 {
     GtkTreeModel   *model = GTK_TREE_MODEL (dialog->store);
     GtkTreeIter     iter;
-    PojkMenuItem *item;
-    const gchar    *desktop_id;
+    gchar          *desktop_id;
     gchar          *name;
     gboolean        found = FALSE;
 
@@ -1292,17 +1923,16 @@ xfce_settings_manager_dialog_show_dialog (XfceSettingsManagerDialog *dialog,
     {
         do
         {
-             gtk_tree_model_get (model, &iter, COLUMN_MENU_ITEM, &item, -1);
-             g_assert (POJK_IS_MENU_ITEM (item));
+             gtk_tree_model_get (model, &iter, COLUMN_DESKTOP_ID, &desktop_id, -1);
 
-             desktop_id = pojk_menu_item_get_desktop_id (item);
              if (g_strcmp0 (desktop_id, name) == 0)
              {
-                  xfce_settings_manager_dialog_spawn (dialog, item);
+                  xfce_settings_manager_dialog_spawn (dialog,
+                      xfce_settings_manager_dialog_item_get (model, &iter));
                   found = TRUE;
              }
 
-             g_object_unref (G_OBJECT (item));
+             g_free (desktop_id);
         }
         while (!found && gtk_tree_model_iter_next (model, &iter));
     }
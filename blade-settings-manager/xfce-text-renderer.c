@@ -34,6 +34,15 @@
 
 
 
+/* maximum number of cached layouts per renderer */
+#define LAYOUT_CACHE_MAX (256)
+
+
+
+typedef struct _XfceTextRendererLayout XfceTextRendererLayout;
+
+
+
 enum
 {
   PROP_0,
@@ -78,6 +87,7 @@ static void xfce_text_renderer_render       (GtkCellRenderer       *renderer,
 static void xfce_text_renderer_invalidate   (XfceTextRenderer      *text_renderer);
 static void xfce_text_renderer_set_widget   (XfceTextRenderer      *text_renderer,
                                              GtkWidget             *widget);
+static void xfce_text_renderer_layout_free  (gpointer               data);
 
 
 
@@ -103,6 +113,17 @@ struct _XfceTextRenderer
 
   /* underline prelited rows */
   gboolean      follow_prelit;
+
+  /* measured layouts of the texts, only valid for the
+   * current widget, font and wrapping */
+  GHashTable   *layouts;
+};
+
+struct _XfceTextRendererLayout
+{
+  PangoLayout *layout;
+  gint         width;
+  gint         height;
 };
 
 
@@ -207,6 +228,8 @@ static void
 xfce_text_renderer_init (XfceTextRenderer *text_renderer)
 {
   text_renderer->wrap_width = -1;
+  text_renderer->layouts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                  xfce_text_renderer_layout_free);
 }
 
 
@@ -223,6 +246,8 @@ xfce_text_renderer_finalize (GObject *object)
   /* drop the cached widget */
   xfce_text_renderer_set_widget (text_renderer, NULL);
 
+  g_hash_table_destroy (text_renderer->layouts);
+
   (*G_OBJECT_CLASS (xfce_text_renderer_parent_class)->finalize) (object);
 }
 
@@ -297,12 +322,21 @@ xfce_text_renderer_set_property (GObject      *object,
       break;
 
     case PROP_WRAP_MODE:
-      text_renderer->wrap_mode = g_value_get_enum (value);
+      if (text_renderer->wrap_mode != g_value_get_enum (value))
+        {
+          text_renderer->wrap_mode = g_value_get_enum (value);
+          g_hash_table_remove_all (text_renderer->layouts);
+        }
       break;
 
     case PROP_WRAP_WIDTH:
+      if (text_renderer->wrap_width != g_value_get_int (value))
+        {
+          text_renderer->wrap_width = g_value_get_int (value);
+          g_hash_table_remove_all (text_renderer->layouts);
+        }
+
       /* be sure to reset fixed height if wrapping is requested */
-      text_renderer->wrap_width = g_value_get_int (value);
       if (G_LIKELY (text_renderer->wrap_width >= 0))
         gtk_cell_renderer_set_fixed_size (GTK_CELL_RENDERER (text_renderer), -1, -1);
       break;
@@ -315,6 +349,62 @@ xfce_text_renderer_set_property (GObject      *object,
 
 
 
+static void
+xfce_text_renderer_layout_free (gpointer data)
+{
+  XfceTextRendererLayout *layout = data;
+
+  g_object_unref (G_OBJECT (layout->layout));
+  g_slice_free (XfceTextRendererLayout, layout);
+}
+
+
+
+static XfceTextRendererLayout*
+xfce_text_renderer_get_layout (XfceTextRenderer *text_renderer)
+{
+  XfceTextRendererLayout *layout;
+
+  g_return_val_if_fail (text_renderer->layout != NULL, NULL);
+
+  /* lookup the text, the icon view asks for the size of an item
+   * many times during a relayout, and renders it afterwards */
+  layout = g_hash_table_lookup (text_renderer->layouts, text_renderer->text);
+  if (G_LIKELY (layout != NULL))
+    return layout;
+
+  /* keep the table small, it is only a cache */
+  if (G_UNLIKELY (g_hash_table_size (text_renderer->layouts) >= LAYOUT_CACHE_MAX))
+    g_hash_table_remove_all (text_renderer->layouts);
+
+  /* start from the layout of the widget */
+  layout = g_slice_new (XfceTextRendererLayout);
+  layout->layout = pango_layout_copy (text_renderer->layout);
+
+  /* setup the wrapping */
+  if (text_renderer->wrap_width < 0)
+    {
+      pango_layout_set_width (layout->layout, -1);
+      pango_layout_set_wrap (layout->layout, PANGO_WRAP_CHAR);
+    }
+  else
+    {
+      pango_layout_set_width (layout->layout, text_renderer->wrap_width * PANGO_SCALE);
+      pango_layout_set_wrap (layout->layout, text_renderer->wrap_mode);
+    }
+
+  pango_layout_set_text (layout->layout, text_renderer->text, -1);
+
+  /* calculate the real text dimension */
+  pango_layout_get_pixel_size (layout->layout, &layout->width, &layout->height);
+
+  g_hash_table_insert (text_renderer->layouts, g_strdup (text_renderer->text), layout);
+
+  return layout;
+}
+
+
+
 static void
 xfce_text_renderer_get_size (GtkCellRenderer *renderer,
                              GtkWidget       *widget,
@@ -324,10 +414,11 @@ xfce_text_renderer_get_size (GtkCellRenderer *renderer,
                              gint            *width,
                              gint            *height)
 {
-  XfceTextRenderer *text_renderer = XFCE_TEXT_RENDERER (renderer);
-  gint              text_length;
-  gint              text_width;
-  gint              text_height;
+  XfceTextRenderer       *text_renderer = XFCE_TEXT_RENDERER (renderer);
+  XfceTextRendererLayout *layout;
+  gint                    text_length;
+  gint                    text_width;
+  gint                    text_height;
 
   /* setup the new widget */
   xfce_text_renderer_set_widget (text_renderer, widget);
@@ -347,11 +438,10 @@ xfce_text_renderer_get_size (GtkCellRenderer *renderer,
     }
   else
     {
-      /* calculate the real text dimension */
-      pango_layout_set_width (text_renderer->layout, text_renderer->wrap_width * PANGO_SCALE);
-      pango_layout_set_wrap (text_renderer->layout, text_renderer->wrap_mode);
-      pango_layout_set_text (text_renderer->layout, text_renderer->text, -1);
-      pango_layout_get_pixel_size (text_renderer->layout, &text_width, &text_height);
+      /* get the real text dimension */
+      layout = xfce_text_renderer_get_layout (text_renderer);
+      text_width = layout->width;
+      text_height = layout->height;
     }
 
   /* if we have to follow the state manually, we'll need
@@ -446,14 +536,16 @@ xfce_text_renderer_render (GtkCellRenderer     *renderer,
                            GdkRectangle        *expose_area,
                            GtkCellRendererState flags)
 {
-  XfceTextRenderer *text_renderer = XFCE_TEXT_RENDERER (renderer);
-  GtkStateType      state;
-  cairo_t          *cr;
-  gint              x0, x1, y0, y1;
-  gint              text_width;
-  gint              text_height;
-  gint              x_offset;
-  gint              y_offset;
+  XfceTextRenderer       *text_renderer = XFCE_TEXT_RENDERER (renderer);
+  XfceTextRendererLayout *layout;
+  PangoAttrList          *attr_list = NULL;
+  GtkStateType            state;
+  cairo_t                *cr;
+  gint                    x0, x1, y0, y1;
+  gint                    text_width;
+  gint                    text_height;
+  gint                    x_offset;
+  gint                    y_offset;
 
   /* setup the new widget */
   xfce_text_renderer_set_widget (text_renderer, widget);
@@ -478,28 +570,17 @@ xfce_text_renderer_render (GtkCellRenderer     *renderer,
         state = GTK_STATE_NORMAL;
     }
 
-  /* check if we should follow the prelit state (used for single click support) */
-  if (text_renderer->follow_prelit && (flags & GTK_CELL_RENDERER_PRELIT) != 0)
-    pango_layout_set_attributes (text_renderer->layout, xfce_pango_attr_list_underline_single ());
-  else
-    pango_layout_set_attributes (text_renderer->layout, NULL);
-
-  /* setup the wrapping */
-  if (text_renderer->wrap_width < 0)
-    {
-      pango_layout_set_width (text_renderer->layout, -1);
-      pango_layout_set_wrap (text_renderer->layout, PANGO_WRAP_CHAR);
-    }
-  else
-    {
-      pango_layout_set_width (text_renderer->layout, text_renderer->wrap_width * PANGO_SCALE);
-      pango_layout_set_wrap (text_renderer->layout, text_renderer->wrap_mode);
-    }
-
-  pango_layout_set_text (text_renderer->layout, text_renderer->text, -1);
+  /* get the measured layout of the text */
+  layout = xfce_text_renderer_get_layout (text_renderer);
+  text_width = layout->width;
+  text_height = layout->height;
 
-  /* calculate the real text dimension */
-  pango_layout_get_pixel_size (text_renderer->layout, &text_width, &text_height);
+  /* check if we should follow the prelit state (used for single click support),
+   * only touch the attributes if they change, so the layout stays valid */
+  if (text_renderer->follow_prelit && (flags & GTK_CELL_RENDERER_PRELIT) != 0)
+    attr_list = xfce_pango_attr_list_underline_single ();
+  if (pango_layout_get_attributes (layout->layout) != attr_list)
+    pango_layout_set_attributes (layout->layout, attr_list);
 
   /* take into account the state indicator (required for calculation) */
   if (text_renderer->follow_state)
@@ -565,7 +646,7 @@ xfce_text_renderer_render (GtkCellRenderer     *renderer,
                     expose_area, widget, "cellrenderertext",
                     cell_area->x + x_offset + renderer->xpad,
                     cell_area->y + y_offset + renderer->ypad,
-                    text_renderer->layout);
+                    layout->layout);
 }
 
 
@@ -590,6 +671,9 @@ xfce_text_renderer_set_widget (XfceTextRenderer *text_renderer,
   if (G_LIKELY (widget == text_renderer->widget))
     return;
 
+  /* the layouts depend on the font of the widget */
+  g_hash_table_remove_all (text_renderer->layouts);
+
   /* disconnect from the previously set widget */
   if (G_UNLIKELY (text_renderer->widget != NULL))
     {
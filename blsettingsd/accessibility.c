@@ -52,9 +52,21 @@
 #define UNSET_FLAG(mask,flag) G_STMT_START{ ((mask) &= ~(flag)); }G_STMT_END
 #define HAS_FLAG(mask,flag)   (((mask) & (flag)) != 0)
 
+/* the controls the helper manages */
+#define ACCESSX_CONTROLS (XkbStickyKeysMask | XkbSlowKeysMask | XkbBounceKeysMask \
+                          | XkbMouseKeysMask | XkbAccessXKeysMask)
+
+/* delay before applying changed properties, about one frame */
+#define APPLY_DELAY 16
+
+
+
+typedef struct _XfceAccessibilityControls XfceAccessibilityControls;
+
 
 
 static void            xfce_accessibility_helper_finalize                       (GObject                      *object);
+static void            xfce_accessibility_helper_value_free                     (gpointer                      data);
 static void            xfce_accessibility_helper_set_xkb                        (XfceAccessibilityHelper      *helper,
                                                                                  gulong                        mask);
 static void            xfce_accessibility_helper_channel_property_changed       (BlconfChannel                *channel,
@@ -86,6 +98,16 @@ struct _XfceAccessibilityHelper
     /* blconf channel */
     BlconfChannel      *channel;
 
+    /* copy of the channel properties */
+    GHashTable         *props;
+
+    /* controls changed since the last apply */
+    gulong              pending_mask;
+    guint               apply_timeout_id;
+
+    /* the controls last set on the server */
+    XfceAccessibilityControls *applied;
+
 #ifdef HAVE_LIBNOTIFY
     NotifyNotification *notification;
 #endif /* !HAVE_LIBNOTIFY */
@@ -93,6 +115,24 @@ struct _XfceAccessibilityHelper
 
 
 
+/* values of the controls, computed from the properties */
+struct _XfceAccessibilityControls
+{
+    gulong enabled_ctrls;
+    guint  ax_options;
+
+    gint   slow_keys_delay;
+    gint   debounce_delay;
+
+    gint   mk_delay;
+    gint   mk_interval;
+    gint   mk_time_to_max;
+    gint   mk_max_speed;
+    gint   mk_curve;
+};
+
+
+
 G_DEFINE_TYPE (XfceAccessibilityHelper, xfce_accessibility_helper, G_TYPE_OBJECT);
 
 
@@ -108,12 +148,30 @@ xfce_accessibility_helper_class_init (XfceAccessibilityHelperClass *klass)
 
 
 
+static gboolean
+xfce_accessibility_helper_prop_load (gpointer key,
+                                     gpointer value,
+                                     gpointer user_data)
+{
+    XfceAccessibilityHelper *helper = XFCE_ACCESSIBILITY_HELPER (user_data);
+
+    /* we've stolen the key and value */
+    g_hash_table_insert (helper->props, key, value);
+
+    return TRUE;
+}
+
+
+
 static void
 xfce_accessibility_helper_init (XfceAccessibilityHelper *helper)
 {
-    gint dummy;
+    GHashTable *props;
+    gint        dummy;
 
     helper->channel = NULL;
+    helper->props = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           xfce_accessibility_helper_value_free);
 #ifdef HAVE_LIBNOTIFY
     helper->notification = NULL;
 #endif /* !HAVE_LIBNOTIFY */
@@ -123,11 +181,19 @@ xfce_accessibility_helper_init (XfceAccessibilityHelper *helper)
         /* open the channel */
         helper->channel = blconf_channel_get ("accessibility");
 
+        /* load all the properties in one call */
+        props = blconf_channel_get_properties (helper->channel, NULL);
+        if (G_LIKELY (props != NULL))
+        {
+            g_hash_table_foreach_steal (props, xfce_accessibility_helper_prop_load, helper);
+            g_hash_table_destroy (props);
+        }
+
         /* monitor channel changes */
         g_signal_connect (G_OBJECT (helper->channel), "property-changed", G_CALLBACK (xfce_accessibility_helper_channel_property_changed), helper);
 
         /* restore the xbd configuration */
-        xfce_accessibility_helper_set_xkb (helper, XkbStickyKeysMask | XkbSlowKeysMask | XkbBounceKeysMask | XkbMouseKeysMask | XkbAccessXKeysMask);
+        xfce_accessibility_helper_set_xkb (helper, ACCESSX_CONTROLS);
 
 #ifdef HAVE_LIBNOTIFY
         /* setup a connection with the notification daemon */
@@ -153,9 +219,16 @@ xfce_accessibility_helper_init (XfceAccessibilityHelper *helper)
 static void
 xfce_accessibility_helper_finalize (GObject *object)
 {
-#ifdef HAVE_LIBNOTIFY
     XfceAccessibilityHelper *helper = XFCE_ACCESSIBILITY_HELPER (object);
 
+    /* stop a pending apply */
+    if (helper->apply_timeout_id != 0)
+        g_source_remove (helper->apply_timeout_id);
+
+    g_hash_table_destroy (helper->props);
+    g_slice_free (XfceAccessibilityControls, helper->applied);
+
+#ifdef HAVE_LIBNOTIFY
     /* close an opened notification */
     if (G_UNLIKELY (helper->notification))
         notify_notification_close (helper->notification, NULL);
@@ -166,14 +239,220 @@ xfce_accessibility_helper_finalize (GObject *object)
 
 
 
+static void
+xfce_accessibility_helper_value_free (gpointer data)
+{
+    GValue *value = data;
+
+    g_value_unset (value);
+    g_free (value);
+}
+
+
+
+static gboolean
+xfce_accessibility_helper_get_bool (XfceAccessibilityHelper *helper,
+                                    const gchar             *property,
+                                    gboolean                 default_value)
+{
+    const GValue *value;
+
+    value = g_hash_table_lookup (helper->props, property);
+    if (value != NULL && G_VALUE_HOLDS_BOOLEAN (value))
+        return g_value_get_boolean (value);
+
+    return default_value;
+}
+
+
+
+static gint
+xfce_accessibility_helper_get_int (XfceAccessibilityHelper *helper,
+                                   const gchar             *property,
+                                   gint                     default_value)
+{
+    const GValue *value;
+
+    value = g_hash_table_lookup (helper->props, property);
+    if (value != NULL && G_VALUE_HOLDS_INT (value))
+        return g_value_get_int (value);
+
+    return default_value;
+}
+
+
+
+static void
+xfce_accessibility_helper_load_controls (XfceAccessibilityHelper   *helper,
+                                         gulong                     mask,
+                                         XfceAccessibilityControls *controls)
+{
+    gint interval;
+    gint max_speed;
+    gint time_to_max;
+
+    /* AccessXKeys */
+    if (HAS_FLAG (mask, XkbAccessXKeysMask))
+    {
+        if (xfce_accessibility_helper_get_bool (helper, "/AccessXKeys", FALSE))
+            SET_FLAG (controls->enabled_ctrls, XkbAccessXKeysMask);
+        else
+            UNSET_FLAG (controls->enabled_ctrls, XkbAccessXKeysMask);
+    }
+
+    /* Sticky keys */
+    if (HAS_FLAG (mask, XkbStickyKeysMask))
+    {
+        if (xfce_accessibility_helper_get_bool (helper, "/StickyKeys", FALSE))
+            SET_FLAG (controls->enabled_ctrls, XkbStickyKeysMask);
+        else
+            UNSET_FLAG (controls->enabled_ctrls, XkbStickyKeysMask);
+
+        if (xfce_accessibility_helper_get_bool (helper, "/StickyKeys/LatchToLock", FALSE))
+            SET_FLAG (controls->ax_options, XkbAX_LatchToLockMask);
+        else
+            UNSET_FLAG (controls->ax_options, XkbAX_LatchToLockMask);
+
+        if (xfce_accessibility_helper_get_bool (helper, "/StickyKeys/TwoKeysDisable", FALSE))
+            SET_FLAG (controls->ax_options, XkbAX_TwoKeysMask);
+        else
+            UNSET_FLAG (controls->ax_options, XkbAX_TwoKeysMask);
+    }
+
+    /* Slow keys */
+    if (HAS_FLAG (mask, XkbSlowKeysMask))
+    {
+        if (xfce_accessibility_helper_get_bool (helper, "/SlowKeys", FALSE))
+            SET_FLAG (controls->enabled_ctrls, XkbSlowKeysMask);
+        else
+            UNSET_FLAG (controls->enabled_ctrls, XkbSlowKeysMask);
+
+        controls->slow_keys_delay = CLAMP (xfce_accessibility_helper_get_int (helper, "/SlowKeys/Delay", 100), 1, G_MAXUSHORT);
+    }
+
+    /* Bounce keys */
+    if (HAS_FLAG (mask, XkbBounceKeysMask))
+    {
+        if (xfce_accessibility_helper_get_bool (helper, "/BounceKeys", FALSE))
+            SET_FLAG (controls->enabled_ctrls, XkbBounceKeysMask);
+        else
+            UNSET_FLAG (controls->enabled_ctrls, XkbBounceKeysMask);
+
+        controls->debounce_delay = CLAMP (xfce_accessibility_helper_get_int (helper, "/BounceKeys/Delay", 100), 1, G_MAXUSHORT);
+    }
+
+    /* Mouse keys */
+    if (HAS_FLAG (mask, XkbMouseKeysMask))
+    {
+        if (xfce_accessibility_helper_get_bool (helper, "/MouseKeys", FALSE))
+            SET_FLAG (controls->enabled_ctrls, XkbMouseKeysMask);
+        else
+            UNSET_FLAG (controls->enabled_ctrls, XkbMouseKeysMask);
+
+        /* get values */
+        interval = xfce_accessibility_helper_get_int (helper, "/MouseKeys/Interval", 20);
+        time_to_max = xfce_accessibility_helper_get_int (helper, "/MouseKeys/TimeToMax", 3000);
+        max_speed = xfce_accessibility_helper_get_int (helper, "/MouseKeys/MaxSpeed", 1000);
+
+        /* calculate maximum speed and to to reach it */
+        interval = CLAMP (interval, 1, G_MAXUSHORT);
+        max_speed = (max_speed * interval) / 1000;
+        time_to_max = (time_to_max + interval / 2) / interval;
+
+        /* set new values, clamp to limits */
+        controls->mk_delay = CLAMP (xfce_accessibility_helper_get_int (helper, "/MouseKeys/Delay", 160), 1, G_MAXUSHORT);
+        controls->mk_interval = interval;
+        controls->mk_time_to_max = CLAMP (time_to_max, 1, G_MAXUSHORT);
+        controls->mk_max_speed = CLAMP (max_speed, 1, G_MAXUSHORT);
+        controls->mk_curve = CLAMP (xfce_accessibility_helper_get_int (helper, "/MouseKeys/Curve", 0), -1000, 1000);
+    }
+}
+
+
+
+static gulong
+xfce_accessibility_helper_diff_controls (const XfceAccessibilityControls *old,
+                                         const XfceAccessibilityControls *controls,
+                                         gulong                           mask)
+{
+    gulong changed = 0;
+    gulong enabled_changes;
+
+    enabled_changes = old->enabled_ctrls ^ controls->enabled_ctrls;
+
+    if (HAS_FLAG (enabled_changes, XkbAccessXKeysMask))
+        SET_FLAG (changed, XkbAccessXKeysMask);
+
+    if (HAS_FLAG (enabled_changes, XkbStickyKeysMask)
+        || old->ax_options != controls->ax_options)
+        SET_FLAG (changed, XkbStickyKeysMask);
+
+    if (HAS_FLAG (enabled_changes, XkbSlowKeysMask)
+        || old->slow_keys_delay != controls->slow_keys_delay)
+        SET_FLAG (changed, XkbSlowKeysMask);
+
+    if (HAS_FLAG (enabled_changes, XkbBounceKeysMask)
+        || old->debounce_delay != controls->debounce_delay)
+        SET_FLAG (changed, XkbBounceKeysMask);
+
+    if (HAS_FLAG (enabled_changes, XkbMouseKeysMask)
+        || old->mk_delay != controls->mk_delay
+        || old->mk_interval != controls->mk_interval
+        || old->mk_time_to_max != controls->mk_time_to_max
+        || old->mk_max_speed != controls->mk_max_speed
+        || old->mk_curve != controls->mk_curve)
+        SET_FLAG (changed, XkbMouseKeysMask);
+
+    return mask & changed;
+}
+
+
+
+static void
+xfce_accessibility_helper_set_enabled (XkbDescPtr                       xkb,
+                                       const XfceAccessibilityControls *controls,
+                                       gulong                           control)
+{
+    if (HAS_FLAG (controls->enabled_ctrls, control))
+    {
+        SET_FLAG (xkb->ctrls->enabled_ctrls, control);
+        UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, control);
+        UNSET_FLAG (xkb->ctrls->axt_ctrls_values, control);
+    }
+    else
+    {
+        UNSET_FLAG (xkb->ctrls->enabled_ctrls, control);
+        SET_FLAG (xkb->ctrls->axt_ctrls_mask, control);
+        UNSET_FLAG (xkb->ctrls->axt_ctrls_values, control);
+    }
+}
+
+
+
 static void
 xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
                                    gulong                   mask)
 {
+    XkbDescPtr                xkb;
+    XfceAccessibilityControls controls = { 0, };
+    gint64                    begin;
 
-    XkbDescPtr xkb;
-    gint       delay, interval, time_to_max;
-    gint       max_speed, curve;
+    /* compute the new values, starting from the last applied state */
+    if (helper->applied != NULL)
+        controls = *helper->applied;
+    xfce_accessibility_helper_load_controls (helper, mask, &controls);
+
+    /* only set the controls that changed since the last time */
+    if (helper->applied != NULL)
+    {
+        mask = xfce_accessibility_helper_diff_controls (helper->applied, &controls, mask);
+        if (mask == 0)
+            return;
+    }
+    else
+    {
+        helper->applied = g_slice_new0 (XfceAccessibilityControls);
+    }
 
     gdk_error_trap_push ();
 
@@ -185,11 +464,7 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         SET_FLAG (mask, XkbControlsEnabledMask);
 
         /* if setting sticky keys, we set expiration too */
-        if (HAS_FLAG (mask, XkbStickyKeysMask) ||
-                HAS_FLAG (mask, XkbSlowKeysMask) ||
-                HAS_FLAG (mask, XkbBounceKeysMask) ||
-                HAS_FLAG (mask, XkbMouseKeysMask) ||
-                HAS_FLAG (mask, XkbAccessXKeysMask))
+        if (HAS_FLAG (mask, ACCESSX_CONTROLS))
           SET_FLAG (mask, XkbAccessXTimeoutMask);
 
         /* add the mouse keys values mask if needed */
@@ -197,57 +472,34 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
             SET_FLAG (mask, XkbMouseKeysAccelMask);
 
         /* load the xkb controls into the structure */
+        begin = blsettings_stats_begin ();
         XkbGetControls (GDK_DISPLAY (), mask, xkb);
+        blsettings_stats_end (XFSD_DEBUG_ACCESSIBILITY, "XkbGetControls", 1, begin);
 
         /* AccessXKeys */
         if (HAS_FLAG (mask, XkbAccessXKeysMask))
         {
-            if (blconf_channel_get_bool (helper->channel, "/AccessXKeys", FALSE))
-            {
-                SET_FLAG (xkb->ctrls->enabled_ctrls, XkbAccessXKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbAccessXKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbAccessXKeysMask);
-
-                blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "AccessXKeys enabled");
-            }
-            else
-            {
-                UNSET_FLAG (xkb->ctrls->enabled_ctrls, XkbAccessXKeysMask);
-                SET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbAccessXKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbAccessXKeysMask);
+            xfce_accessibility_helper_set_enabled (xkb, &controls, XkbAccessXKeysMask);
 
-                blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "AccessXKeys disabled");
-            }
+            blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "AccessXKeys %s",
+                            HAS_FLAG (controls.enabled_ctrls, XkbAccessXKeysMask) ? "enabled" : "disabled");
         }
 
         /* Sticky keys */
         if (HAS_FLAG (mask, XkbStickyKeysMask))
         {
-            if (blconf_channel_get_bool (helper->channel, "/StickyKeys", FALSE))
-            {
-                SET_FLAG (xkb->ctrls->enabled_ctrls, XkbStickyKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbStickyKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbStickyKeysMask);
+            xfce_accessibility_helper_set_enabled (xkb, &controls, XkbStickyKeysMask);
 
-                if (blconf_channel_get_bool (helper->channel, "/StickyKeys/LatchToLock", FALSE))
-                    SET_FLAG (xkb->ctrls->ax_options, XkbAX_LatchToLockMask);
-                else
-                    UNSET_FLAG (xkb->ctrls->ax_options, XkbAX_LatchToLockMask);
-
-                if (blconf_channel_get_bool (helper->channel, "/StickyKeys/TwoKeysDisable", FALSE))
-                    SET_FLAG (xkb->ctrls->ax_options, XkbAX_TwoKeysMask);
-                else
-                    UNSET_FLAG (xkb->ctrls->ax_options, XkbAX_TwoKeysMask);
+            if (HAS_FLAG (controls.enabled_ctrls, XkbStickyKeysMask))
+            {
+                UNSET_FLAG (xkb->ctrls->ax_options, XkbAX_LatchToLockMask | XkbAX_TwoKeysMask);
+                SET_FLAG (xkb->ctrls->ax_options, controls.ax_options);
 
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "stickykeys enabled (ax_options=%d)",
                                 xkb->ctrls->ax_options);
             }
             else
             {
-                UNSET_FLAG (xkb->ctrls->enabled_ctrls, XkbStickyKeysMask);
-                SET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbStickyKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbStickyKeysMask);
-
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "stickykeys disabled");
             }
         }
@@ -255,24 +507,17 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Slow keys */
         if (HAS_FLAG (mask, XkbSlowKeysMask))
         {
-            if (blconf_channel_get_bool (helper->channel, "/SlowKeys", FALSE))
-            {
-                SET_FLAG (xkb->ctrls->enabled_ctrls, XkbSlowKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbSlowKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbSlowKeysMask);
+            xfce_accessibility_helper_set_enabled (xkb, &controls, XkbSlowKeysMask);
 
-                delay = blconf_channel_get_int (helper->channel, "/SlowKeys/Delay", 100);
-                xkb->ctrls->slow_keys_delay = CLAMP (delay, 1, G_MAXUSHORT);
+            if (HAS_FLAG (controls.enabled_ctrls, XkbSlowKeysMask))
+            {
+                xkb->ctrls->slow_keys_delay = controls.slow_keys_delay;
 
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "slowkeys enabled (delay=%d)",
                                 xkb->ctrls->slow_keys_delay);
             }
             else
             {
-                UNSET_FLAG (xkb->ctrls->enabled_ctrls, XkbSlowKeysMask);
-                SET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbSlowKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbSlowKeysMask);
-
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "slowkeys disabled");
             }
         }
@@ -280,24 +525,17 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Bounce keys */
         if (HAS_FLAG (mask, XkbBounceKeysMask))
         {
-            if (blconf_channel_get_bool (helper->channel, "/BounceKeys", FALSE))
-            {
-                SET_FLAG (xkb->ctrls->enabled_ctrls, XkbBounceKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbBounceKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbBounceKeysMask);
+            xfce_accessibility_helper_set_enabled (xkb, &controls, XkbBounceKeysMask);
 
-                delay = blconf_channel_get_int (helper->channel, "/BounceKeys/Delay", 100);
-                xkb->ctrls->debounce_delay = CLAMP (delay, 1, G_MAXUSHORT);
+            if (HAS_FLAG (controls.enabled_ctrls, XkbBounceKeysMask))
+            {
+                xkb->ctrls->debounce_delay = controls.debounce_delay;
 
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "bouncekeys enabled (delay=%d)",
                                 xkb->ctrls->debounce_delay);
             }
             else
             {
-                UNSET_FLAG (xkb->ctrls->enabled_ctrls, XkbBounceKeysMask);
-                SET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbBounceKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbBounceKeysMask);
-
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "bouncekeys disabled");
             }
         }
@@ -305,30 +543,15 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Mouse keys */
         if (HAS_FLAG (mask, XkbMouseKeysMask))
         {
-            if (blconf_channel_get_bool (helper->channel, "/MouseKeys", FALSE))
+            xfce_accessibility_helper_set_enabled (xkb, &controls, XkbMouseKeysMask);
+
+            if (HAS_FLAG (controls.enabled_ctrls, XkbMouseKeysMask))
             {
-                SET_FLAG (xkb->ctrls->enabled_ctrls, XkbMouseKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbMouseKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbMouseKeysMask);
-
-                /* get values */
-                delay = blconf_channel_get_int (helper->channel, "/MouseKeys/Delay", 160);
-                interval = blconf_channel_get_int (helper->channel, "/MouseKeys/Interval", 20);
-                time_to_max = blconf_channel_get_int (helper->channel, "/MouseKeys/TimeToMax", 3000);
-                max_speed = blconf_channel_get_int (helper->channel, "/MouseKeys/MaxSpeed", 1000);
-                curve = blconf_channel_get_int (helper->channel, "/MouseKeys/Curve", 0);
-
-                /* calculate maximum speed and to to reach it */
-                interval = CLAMP (interval, 1, G_MAXUSHORT);
-                max_speed = (max_speed * interval) / 1000;
-                time_to_max = (time_to_max + interval / 2) / interval;
-
-                /* set new values, clamp to limits */
-                xkb->ctrls->mk_delay = CLAMP (delay, 1, G_MAXUSHORT);
-                xkb->ctrls->mk_interval = interval;
-                xkb->ctrls->mk_time_to_max = CLAMP (time_to_max, 1, G_MAXUSHORT);
-                xkb->ctrls->mk_max_speed = CLAMP (max_speed, 1, G_MAXUSHORT);
-                xkb->ctrls->mk_curve = CLAMP (curve, -1000, 1000);
+                xkb->ctrls->mk_delay = controls.mk_delay;
+                xkb->ctrls->mk_interval = controls.mk_interval;
+                xkb->ctrls->mk_time_to_max = controls.mk_time_to_max;
+                xkb->ctrls->mk_max_speed = controls.mk_max_speed;
+                xkb->ctrls->mk_curve = controls.mk_curve;
 
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "mousekeys enabled (delay=%d, interval=%d, "
                                 "time_to_max=%d, max_speed=%d, curve=%d)",
@@ -338,9 +561,6 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
             }
             else
             {
-                UNSET_FLAG (xkb->ctrls->enabled_ctrls, XkbMouseKeysMask);
-                SET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbMouseKeysMask);
-                UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbMouseKeysMask);
                 UNSET_FLAG (mask, XkbMouseKeysAccelMask);
 
                 blsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "mousekeys disabled");
@@ -351,6 +571,9 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         if (!XkbSetControls (GDK_DISPLAY (), mask, xkb))
             g_message ("Setting the xkb controls failed");
 
+        /* remember what has been set */
+        *helper->applied = controls;
+
         /* free the structure */
         XkbFreeControls (xkb, mask, True);
         XFree (xkb);
@@ -367,17 +590,37 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
 
 
 
+static gboolean
+xfce_accessibility_helper_apply_timeout (gpointer user_data)
+{
+    XfceAccessibilityHelper *helper = XFCE_ACCESSIBILITY_HELPER (user_data);
+    gulong                   mask = helper->pending_mask;
+
+    helper->apply_timeout_id = 0;
+    helper->pending_mask = 0;
+
+    /* update the xkb settings */
+    xfce_accessibility_helper_set_xkb (helper, mask);
+
+    return FALSE;
+}
+
+
+
 static void
 xfce_accessibility_helper_channel_property_changed (BlconfChannel           *channel,
                                                     const gchar             *property_name,
                                                     const GValue            *value,
                                                     XfceAccessibilityHelper *helper)
 {
-    gulong mask;
+    gulong  mask;
+    GValue *copy;
 
     g_return_if_fail (helper->channel == channel);
 
-    if (strncmp (property_name, "/StickyKeys", 11) == 0)
+    if (strncmp (property_name, "/AccessXKeys", 12) == 0)
+        mask = XkbAccessXKeysMask;
+    else if (strncmp (property_name, "/StickyKeys", 11) == 0)
         mask = XkbStickyKeysMask;
     else if (strncmp (property_name, "/SlowKeys", 9) == 0)
         mask = XkbSlowKeysMask;
@@ -388,11 +631,27 @@ xfce_accessibility_helper_channel_property_changed (BlconfChannel           *cha
     else
         return;
 
-    /* update the xkb settings */
-    xfce_accessibility_helper_set_xkb (helper, mask);
+    /* update the copy of the property */
+    if (value != NULL && G_VALUE_TYPE (value) != G_TYPE_INVALID)
+    {
+        copy = g_new0 (GValue, 1);
+        g_value_init (copy, G_VALUE_TYPE (value));
+        g_value_copy (value, copy);
+        g_hash_table_replace (helper->props, g_strdup (property_name), copy);
+    }
+    else
+    {
+        g_hash_table_remove (helper->props, property_name);
+    }
+
+    /* apply the changes of a burst (like a dragged slider) at once */
+    helper->pending_mask |= mask;
+    if (helper->apply_timeout_id == 0)
+        helper->apply_timeout_id = g_timeout_add (APPLY_DELAY, xfce_accessibility_helper_apply_timeout, helper);
 }
 
 
+
 #ifdef HAVE_LIBNOTIFY
 static GdkFilterReturn
 xfce_accessibility_helper_event_filter (GdkXEvent *xevent,
@@ -37,6 +37,7 @@
 #include <gdk/gdkx.h>
 #include <gtk/gtk.h>
 
+#include "debug.h"
 #include "clipboard-manager.h"
 #include "xsettings.h"
 
@@ -169,6 +170,7 @@ send_selection_notify (GsdClipboardManager *manager,
                        Bool                 success)
 {
         XSelectionEvent notify;
+        gint64          begin;
 
         notify.type = SelectionNotify;
         notify.serial = 0;
@@ -187,7 +189,9 @@ send_selection_notify (GsdClipboardManager *manager,
                     False,
                     NoEventMask,
                     (XEvent *)&notify);
+        begin = blsettings_stats_begin ();
         XSync (manager->priv->display, False);
+        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XSync", 1, begin);
 
         if (gdk_error_trap_pop () != 0)
         {
@@ -201,6 +205,7 @@ finish_selection_request (GsdClipboardManager *manager,
                           Bool                 success)
 {
         XSelectionEvent notify;
+        gint64          begin;
 
         notify.type = SelectionNotify;
         notify.serial = 0;
@@ -217,7 +222,9 @@ finish_selection_request (GsdClipboardManager *manager,
         XSendEvent (xev->xselectionrequest.display,
                     xev->xselectionrequest.requestor,
                     False, NoEventMask, (XEvent *) &notify);
+        begin = blsettings_stats_begin ();
         XSync (manager->priv->display, False);
+        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XSync", 1, begin);
 
         if (gdk_error_trap_pop () != 0)
         {
@@ -314,7 +321,9 @@ get_property (TargetData          *tdata,
         gulong  length;
         gulong  remaining;
         guchar *data;
+        gint64  begin;
 
+        begin = blsettings_stats_begin ();
         XGetWindowProperty (manager->priv->display,
                             manager->priv->window,
                             tdata->target,
@@ -327,6 +336,7 @@ get_property (TargetData          *tdata,
                             &length,
                             &remaining,
                             &data);
+        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XGetWindowProperty", 1, begin);
 
         if (type == None) {
                 manager->priv->contents = g_slist_remove (manager->priv->contents, tdata);
@@ -353,6 +363,7 @@ receive_incrementally (GsdClipboardManager *manager,
         gint        format;
         gulong      length, nitems, remaining;
         guchar     *data;
+        gint64      begin;
 
         if (xev->xproperty.window != manager->priv->window)
                 return False;
@@ -369,11 +380,13 @@ receive_incrementally (GsdClipboardManager *manager,
         if (tdata->type != XA_INCR)
                 return False;
 
+        begin = blsettings_stats_begin ();
         XGetWindowProperty (xev->xproperty.display,
                             xev->xproperty.window,
                             xev->xproperty.atom,
                             0, 0x1FFFFFFF, True, AnyPropertyType,
                             &type, &format, &nitems, &remaining, &data);
+        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XGetWindowProperty", 1, begin);
 
         length = nitems * clipboard_bytes_per_item (format);
         if (length == 0) {
@@ -456,6 +469,7 @@ convert_clipboard_manager (GsdClipboardManager *manager,
         Atom   *targets = NULL;
         Atom    targets2[3];
         gint    n_targets;
+        gint64  begin;
 
         if (xev->xselectionrequest.target == XA_SAVE_TARGETS) {
                 if (manager->priv->requestor != None || manager->priv->contents != NULL) {
@@ -474,7 +488,9 @@ convert_clipboard_manager (GsdClipboardManager *manager,
                         XSelectInput (manager->priv->display,
                                       xev->xselectionrequest.requestor,
                                       StructureNotifyMask);
+                        begin = blsettings_stats_begin ();
                         XSync (manager->priv->display, False);
+                        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XSync", 1, begin);
 
                         if (gdk_error_trap_pop () != Success)
                                 return;
@@ -482,12 +498,14 @@ convert_clipboard_manager (GsdClipboardManager *manager,
                         gdk_error_trap_push ();
 
                         if (xev->xselectionrequest.property != None) {
+                                begin = blsettings_stats_begin ();
                                 XGetWindowProperty (manager->priv->display,
                                                     xev->xselectionrequest.requestor,
                                                     xev->xselectionrequest.property,
                                                     0, 0x1FFFFFFF, False, XA_ATOM,
                                                     &type, &format, &nitems, &remaining,
                                                     (guchar **) &targets);
+                                blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XGetWindowProperty", 1, begin);
 
                                 if (gdk_error_trap_pop () != Success) {
                                         if (targets)
@@ -544,6 +562,7 @@ convert_clipboard_target (IncrConversion      *rdata,
         gulong             items;
         gulong             bytes;
         XWindowAttributes  atts;
+        gint64             begin;
 
         if (rdata->target == XA_TARGETS) {
                 n_targets = g_slist_length (manager->priv->contents) + 2;
@@ -603,7 +622,9 @@ convert_clipboard_target (IncrConversion      *rdata,
                                          XA_INCR, 32, PropModeReplace,
                                          (guchar *) &items, 1);
 
+                        begin = blsettings_stats_begin ();
                         XSync (manager->priv->display, False);
+                        blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XSync", 1, begin);
 
                         if (gdk_error_trap_pop () != 0)
                         {
@@ -635,14 +656,17 @@ convert_clipboard (GsdClipboardManager *manager,
         gulong          i, nitems;
         gulong          remaining;
         Atom           *multiple;
+        gint64          begin;
 
         if (xev->xselectionrequest.target == XA_MULTIPLE) {
+                begin = blsettings_stats_begin ();
                 XGetWindowProperty (xev->xselectionrequest.display,
                                     xev->xselectionrequest.requestor,
                                     xev->xselectionrequest.property,
                                     0, 0x1FFFFFFF, False, XA_ATOM_PAIR,
                                     &type, &format, &nitems, &remaining,
                                     (guchar **) &multiple);
+                blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XGetWindowProperty", 1, begin);
 
                 if (type != XA_ATOM_PAIR || nitems == 0) {
                         if (multiple)
@@ -709,6 +733,7 @@ clipboard_manager_process_event (GsdClipboardManager *manager,
         gulong  remaining;
         Atom   *targets = NULL;
         GSList *tmp;
+        gint64  begin;
 
         switch (xev->xany.type) {
         case DestroyNotify:
@@ -775,12 +800,14 @@ clipboard_manager_process_event (GsdClipboardManager *manager,
                 if (xev->xselection.selection == XA_CLIPBOARD) {
                         /* a CLIPBOARD conversion is done */
                         if (xev->xselection.property == XA_TARGETS) {
+                                begin = blsettings_stats_begin ();
                                 XGetWindowProperty (xev->xselection.display,
                                                     xev->xselection.requestor,
                                                     xev->xselection.property,
                                                     0, 0x1FFFFFFF, True, XA_ATOM,
                                                     &type, &format, &nitems, &remaining,
                                                     (guchar **) &targets);
+                                blsettings_stats_end (XFSD_DEBUG_CLIPBOARD, "XGetWindowProperty", 1, begin);
 
                                 save_targets (manager, targets, nitems);
                         } else if (xev->xselection.property == XA_MULTIPLE) {
@@ -41,8 +41,12 @@ static const GDebugKey dbg_keys[] =
     { "accessibility", XFSD_DEBUG_ACCESSIBILITY },
     { "pointers", XFSD_DEBUG_POINTERS },
     { "displays", XFSD_DEBUG_DISPLAYS },
+    { "clipboard", XFSD_DEBUG_CLIPBOARD },
 };
 
+/* XfsdStats by "helper/operation" */
+static GHashTable *stats_table = NULL;
+
 
 static XfsdDebugDomain
 blsettings_dbg_init (void)
@@ -70,25 +74,32 @@ blsettings_dbg_init (void)
 
 
 
-static void __attribute__((format (gnu_printf, 2,0)))
-blsettings_dbg_print (XfsdDebugDomain  domain,
-                      const gchar     *message,
-                      va_list          args)
+static const gchar *
+blsettings_dbg_domain_name (XfsdDebugDomain domain)
 {
-    const gchar *domain_name = NULL;
-    guint        i;
-    gchar       *string;
+    guint i;
 
     /* lookup domain name */
     for (i = 0; i < G_N_ELEMENTS (dbg_keys); i++)
     {
         if (dbg_keys[i].value == domain)
-        {
-            domain_name = dbg_keys[i].key;
-            break;
-        }
+            return dbg_keys[i].key;
     }
 
+    return NULL;
+}
+
+
+
+static void __attribute__((format (gnu_printf, 2,0)))
+blsettings_dbg_print (XfsdDebugDomain  domain,
+                      const gchar     *message,
+                      va_list          args)
+{
+    const gchar *domain_name;
+    gchar       *string;
+
+    domain_name = blsettings_dbg_domain_name (domain);
     g_assert (domain_name != NULL);
 
     string = g_strdup_vprintf (message, args);
@@ -135,3 +146,114 @@ blsettings_dbg_filtered (XfsdDebugDomain  domain,
     blsettings_dbg_print (domain, message, args);
     va_end (args);
 }
+
+
+
+static void
+blsettings_stats_free (XfsdStats *stats)
+{
+    g_slice_free (XfsdStats, stats);
+}
+
+
+
+gint64
+blsettings_stats_begin (void)
+{
+    GTimeVal now;
+
+    g_get_current_time (&now);
+
+    return (gint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+}
+
+
+
+void
+blsettings_stats_end (XfsdDebugDomain  domain,
+                      const gchar     *operation,
+                      guint            round_trips,
+                      gint64           begin)
+{
+    XfsdStats   *stats;
+    const gchar *domain_name;
+    gchar        key[128];
+    gint64       elapsed;
+
+    g_return_if_fail (operation != NULL);
+
+    elapsed = MAX (blsettings_stats_begin () - begin, 0);
+
+    domain_name = blsettings_dbg_domain_name (domain);
+    g_assert (domain_name != NULL);
+
+    if (G_UNLIKELY (stats_table == NULL))
+    {
+        stats_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) blsettings_stats_free);
+    }
+
+    g_snprintf (key, sizeof (key), "%s/%s", domain_name, operation);
+    stats = g_hash_table_lookup (stats_table, key);
+    if (G_UNLIKELY (stats == NULL))
+    {
+        /* the operation is a string literal at the call site */
+        stats = g_slice_new0 (XfsdStats);
+        stats->helper = domain_name;
+        stats->operation = operation;
+        g_hash_table_insert (stats_table, g_strdup (key), stats);
+    }
+
+    stats->calls++;
+    stats->round_trips += round_trips;
+    stats->total_time += elapsed;
+    stats->max_time = MAX (stats->max_time, elapsed);
+}
+
+
+
+void
+blsettings_stats_foreach (XfsdStatsFunc func,
+                          gpointer      user_data)
+{
+    GHashTableIter iter;
+    gpointer       stats;
+
+    g_return_if_fail (func != NULL);
+
+    if (stats_table == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, stats_table);
+    while (g_hash_table_iter_next (&iter, NULL, &stats))
+        func (stats, user_data);
+}
+
+
+
+void
+blsettings_stats_reset (void)
+{
+    if (stats_table != NULL)
+        g_hash_table_remove_all (stats_table);
+}
+
+
+
+static void
+blsettings_stats_print (const XfsdStats *stats,
+                        gpointer         user_data)
+{
+    g_printerr (PACKAGE_NAME "(%s): %s: %u calls, %u round trips, "
+                "%.3f ms total, %.3f ms max\n", stats->helper, stats->operation,
+                stats->calls, stats->round_trips, stats->total_time / 1000.0,
+                stats->max_time / 1000.0);
+}
+
+
+
+void
+blsettings_stats_dump (void)
+{
+    blsettings_stats_foreach (blsettings_stats_print, NULL);
+}
@@ -33,9 +33,28 @@ typedef enum
    XFSD_DEBUG_ACCESSIBILITY      = 1 << 7,
    XFSD_DEBUG_POINTERS           = 1 << 8,
    XFSD_DEBUG_DISPLAYS           = 1 << 9,
+   XFSD_DEBUG_CLIPBOARD          = 1 << 10,
 }
 XfsdDebugDomain;
 
+typedef struct _XfsdStats XfsdStats;
+
+/* counters of a synchronous X operation of a helper */
+struct _XfsdStats
+{
+    const gchar *helper;
+    const gchar *operation;
+    guint        calls;
+    guint        round_trips;
+
+    /* wall time in microseconds */
+    gint64       total_time;
+    gint64       max_time;
+};
+
+typedef void (*XfsdStatsFunc) (const XfsdStats *stats,
+                               gpointer         user_data);
+
 void blsettings_dbg          (XfsdDebugDomain  domain,
                               const gchar     *message,
                               ...) G_GNUC_PRINTF (2, 3);
@@ -44,4 +63,18 @@ void blsettings_dbg_filtered (XfsdDebugDomain  domain,
                               const gchar     *message,
                               ...) G_GNUC_PRINTF (2, 3);
 
+gint64 blsettings_stats_begin   (void);
+
+void   blsettings_stats_end     (XfsdDebugDomain  domain,
+                                 const gchar     *operation,
+                                 guint            round_trips,
+                                 gint64           begin);
+
+void   blsettings_stats_foreach (XfsdStatsFunc    func,
+                                 gpointer         user_data);
+
+void   blsettings_stats_reset   (void);
+
+void   blsettings_stats_dump    (void);
+
 #endif /* !__DEBUG_H__ */
@@ -33,7 +33,23 @@
 
 
 
+typedef enum
+{
+    XFCE_DISPLAYS_LID_OPEN,
+    XFCE_DISPLAYS_LID_CLOSED,
+    XFCE_DISPLAYS_LID_CLOSING,  /* closed, not settled yet */
+    XFCE_DISPLAYS_LID_RESUMING  /* opened or resumed, not settled yet */
+}
+XfceDisplaysLidState;
+
+static const gchar *lid_state_names[] = { "open", "closed", "closing", "resuming" };
+
+
+
 static void             xfce_displays_upower_dispose                        (GObject                 *object);
+static void             xfce_displays_upower_set_state                      (XfceDisplaysUPower      *upower,
+                                                                             XfceDisplaysLidState     state);
+static gboolean         xfce_displays_upower_settle                         (gpointer                 data);
 
 #if UP_CHECK_VERSION(0, 99, 0)
 static void             xfce_displays_upower_property_changed               (UpClient                *client,
@@ -42,6 +58,9 @@ static void             xfce_displays_upower_property_changed               (UpC
 #else
 static void             xfce_displays_upower_property_changed               (UpClient                *client,
                                                                              XfceDisplaysUPower      *upower);
+static void             xfce_displays_upower_notify_resume                  (UpClient                *client,
+                                                                             UpSleepKind              sleep_kind,
+                                                                             XfceDisplaysUPower      *upower);
 #endif
 
 
@@ -55,12 +74,23 @@ struct _XfceDisplaysUPowerClass
 
 struct _XfceDisplaysUPower
 {
-    GObject   __parent__;
+    GObject               __parent__;
 
-    UpClient *client;
-    gint      handler;
+    UpClient             *client;
+    gint                  handler;
+#if !UP_CHECK_VERSION(0, 99, 0)
+    gint                  resume_handler;
+#endif
+
+    /* state of the internal panel */
+    XfceDisplaysLidState  state;
 
-    guint     lid_is_closed : 1;
+    /* transitions settle after this delay (ms) */
+    guint                 settle_delay;
+    guint                 settle_id;
+
+    /* last state sent with lid-changed */
+    guint                 lid_is_closed : 1;
 };
 
 enum
@@ -101,6 +131,9 @@ xfce_displays_upower_init (XfceDisplaysUPower *upower)
 {
     upower->client = up_client_new ();
     upower->lid_is_closed = up_client_get_lid_is_closed (upower->client);
+    upower->state = upower->lid_is_closed ? XFCE_DISPLAYS_LID_CLOSED : XFCE_DISPLAYS_LID_OPEN;
+    upower->settle_delay = XFSD_LID_SETTLE_DELAY;
+    upower->settle_id = 0;
 #if UP_CHECK_VERSION(0, 99, 0)
     upower->handler = g_signal_connect (G_OBJECT (upower->client),
                                         "notify",
@@ -111,6 +144,10 @@ xfce_displays_upower_init (XfceDisplaysUPower *upower)
                                         "changed",
                                         G_CALLBACK (xfce_displays_upower_property_changed),
                                         upower);
+    upower->resume_handler = g_signal_connect (G_OBJECT (upower->client),
+                                               "notify-resume",
+                                               G_CALLBACK (xfce_displays_upower_notify_resume),
+                                               upower);
 #endif
 }
 
@@ -121,10 +158,20 @@ xfce_displays_upower_dispose (GObject *object)
 {
     XfceDisplaysUPower *upower = XFCE_DISPLAYS_UPOWER (object);
 
+    if (upower->settle_id != 0)
+    {
+        g_source_remove (upower->settle_id);
+        upower->settle_id = 0;
+    }
+
     if (upower->handler > 0)
     {
         g_signal_handler_disconnect (G_OBJECT (upower->client),
                                      upower->handler);
+#if !UP_CHECK_VERSION(0, 99, 0)
+        g_signal_handler_disconnect (G_OBJECT (upower->client),
+                                     upower->resume_handler);
+#endif
         g_object_unref (upower->client);
         upower->handler = 0;
     }
@@ -151,12 +198,88 @@ xfce_displays_upower_property_changed (UpClient           *client,
         return;
 
     lid_is_closed = up_client_get_lid_is_closed (client);
+
+    /* the settled state did not change, this is another property */
+    if (upower->settle_id == 0 && upower->lid_is_closed == lid_is_closed)
+        return;
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "UPower lid event received (%s -> %s).",
+                    XFSD_LID_STR (upower->lid_is_closed), XFSD_LID_STR (lid_is_closed));
+
+    xfce_displays_upower_set_state (upower, lid_is_closed ?
+                                    XFCE_DISPLAYS_LID_CLOSING : XFCE_DISPLAYS_LID_RESUMING);
+}
+
+
+
+#if !UP_CHECK_VERSION(0, 99, 0)
+static void
+xfce_displays_upower_notify_resume (UpClient           *client,
+                                    UpSleepKind         sleep_kind,
+                                    XfceDisplaysUPower *upower)
+{
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "UPower resume event received.");
+
+    /* the lid state is reliable once the system settled */
+    xfce_displays_upower_set_state (upower, XFCE_DISPLAYS_LID_RESUMING);
+}
+#endif
+
+
+
+static void
+xfce_displays_upower_set_state (XfceDisplaysUPower   *upower,
+                                XfceDisplaysLidState  state)
+{
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Lid state %s -> %s.",
+                    lid_state_names[upower->state], lid_state_names[state]);
+
+    upower->state = state;
+
+    /* restart the delay, so a bouncing lid or a suspend/resume
+       sequence is collapsed into a single transition */
+    if (upower->settle_id != 0)
+        g_source_remove (upower->settle_id);
+    upower->settle_id = g_timeout_add (upower->settle_delay,
+                                       xfce_displays_upower_settle, upower);
+}
+
+
+
+static gboolean
+xfce_displays_upower_settle (gpointer data)
+{
+    XfceDisplaysUPower *upower = XFCE_DISPLAYS_UPOWER (data);
+    gboolean            lid_is_closed;
+
+    upower->settle_id = 0;
+
+    /* use the state after the transition, not the one that started it */
+    lid_is_closed = up_client_get_lid_is_present (upower->client)
+                    && up_client_get_lid_is_closed (upower->client);
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Lid state %s settled as %s.",
+                    lid_state_names[upower->state], XFSD_LID_STR (lid_is_closed));
+
+    upower->state = lid_is_closed ? XFCE_DISPLAYS_LID_CLOSED : XFCE_DISPLAYS_LID_OPEN;
+
+    /* at most one apply per settled state */
     if (upower->lid_is_closed != lid_is_closed)
     {
-        blsettings_dbg (XFSD_DEBUG_DISPLAYS, "UPower lid event received (%s -> %s).",
-                        XFSD_LID_STR (upower->lid_is_closed), XFSD_LID_STR (lid_is_closed));
-
         upower->lid_is_closed = lid_is_closed;
         g_signal_emit (G_OBJECT (upower), signals[LID_CHANGED], 0, upower->lid_is_closed);
     }
+
+    return FALSE;
+}
+
+
+
+void
+xfce_displays_upower_set_settle_delay (XfceDisplaysUPower *upower,
+                                       guint               settle_delay)
+{
+    g_return_if_fail (XFCE_IS_DISPLAYS_UPOWER (upower));
+
+    upower->settle_delay = settle_delay;
 }
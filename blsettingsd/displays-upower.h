@@ -33,6 +33,12 @@ typedef struct _XfceDisplaysUPower      XfceDisplaysUPower;
 
 #define XFSD_LID_STR(b) (b ? "closed" : "open")
 
-GType xfce_displays_upower_get_type (void) G_GNUC_CONST;
+/* default delay (ms) before a lid transition is applied */
+#define XFSD_LID_SETTLE_DELAY 500
+
+GType xfce_displays_upower_get_type         (void) G_GNUC_CONST;
+
+void  xfce_displays_upower_set_settle_delay (XfceDisplaysUPower *upower,
+                                             guint               settle_delay);
 
 #endif /* !__DISPLAYS_UPOWER_H__ */
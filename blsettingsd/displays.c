@@ -34,6 +34,7 @@
 #include <blconf/blconf.h>
 #include <libbladeui/libbladeui.h>
 
+#include <X11/Xatom.h>
 #include <X11/extensions/Xrandr.h>
 
 #include "debug.h"
@@ -62,6 +63,11 @@
 #define POSX_PROP           OUTPUT_FMT "/Position/X"
 #define POSY_PROP           OUTPUT_FMT "/Position/Y"
 #define NOTIFY_PROP         "/Notify"
+#define PROFILES_PROP       "/Profiles"
+#define LID_DELAY_PROP      "/LidSettleDelay"
+
+/* only the EDID base block is used to identify a display */
+#define EDID_BLOCK_SIZE     128
 
 
 
@@ -81,7 +87,10 @@ static void             xfce_displays_helper_set_screen_size                (Xfc
 static gboolean         xfce_displays_helper_load_from_blconf               (XfceDisplaysHelper      *helper,
                                                                              const gchar             *scheme,
                                                                              GHashTable              *saved_outputs,
-                                                                             XfceRROutput            *output);
+                                                                             XfceRROutput            *output,
+                                                                             const gchar             *name);
+static gchar           *xfce_displays_helper_get_fingerprint                (XfceDisplaysHelper      *helper,
+                                                                             RROutput                 output);
 static GPtrArray       *xfce_displays_helper_list_outputs                   (XfceDisplaysHelper      *helper);
 static void             xfce_displays_helper_free_output                    (XfceRROutput            *output);
 static GPtrArray       *xfce_displays_helper_list_crtcs                     (XfceDisplaysHelper      *helper);
@@ -103,8 +112,19 @@ static void             xfce_displays_helper_apply_crtc                     (Xfc
 static void             xfce_displays_helper_set_outputs                    (XfceRRCrtc              *crtc,
                                                                              XfceRROutput            *output);
 static void             xfce_displays_helper_apply_all                      (XfceDisplaysHelper      *helper);
-static void             xfce_displays_helper_channel_apply                  (XfceDisplaysHelper      *helper,
-                                                                             const gchar             *scheme);
+static gboolean         xfce_displays_helper_channel_apply                  (XfceDisplaysHelper      *helper,
+                                                                             const gchar             *scheme,
+                                                                             gboolean                 save_profile);
+static void             xfce_displays_helper_load_profiles                  (XfceDisplaysHelper      *helper);
+static void             xfce_displays_helper_profile_set                    (XfceDisplaysHelper      *helper,
+                                                                             const gchar             *property,
+                                                                             const GValue            *value);
+static gchar           *xfce_displays_helper_get_profile                    (XfceDisplaysHelper      *helper);
+static void             xfce_displays_helper_save_profile                   (XfceDisplaysHelper      *helper,
+                                                                             const gchar             *scheme,
+                                                                             GHashTable              *saved_outputs);
+static gboolean         xfce_displays_helper_apply_profile                  (XfceDisplaysHelper      *helper,
+                                                                             GPtrArray               *old_outputs);
 static void             xfce_displays_helper_channel_property_changed       (BlconfChannel           *channel,
                                                                              const gchar             *property_name,
                                                                              const GValue            *value,
@@ -142,6 +162,7 @@ struct _XfceDisplaysHelper
     GdkWindow          *root_window;
     Display            *xdisplay;
     gint                event_base;
+    Atom                edid_atom;
 
     /* RandR cache */
     XRRScreenResources *resources;
@@ -157,6 +178,14 @@ struct _XfceDisplaysHelper
     /* used to normalize positions */
     gint                min_x;
     gint                min_y;
+
+    /* saved layouts by the set of connected displays, each
+     * is a table of blconf properties like in the channel */
+    GHashTable         *profiles;
+
+    /* profile of the connected displays, NULL if they
+     * can not be identified */
+    gchar              *profile;
 };
 
 struct _XfceRRCrtc
@@ -182,6 +211,9 @@ struct _XfceRROutput
     XRROutputInfo *info;
     RRMode         preferred_mode;
     guint          active : 1;
+
+    /* checksum of the EDID, NULL if the output has none */
+    gchar         *fingerprint;
 };
 
 
@@ -203,8 +235,9 @@ xfce_displays_helper_class_init (XfceDisplaysHelperClass *klass)
 static void
 xfce_displays_helper_init (XfceDisplaysHelper *helper)
 {
-    gint major = 0, minor = 0;
-    gint error_base, err;
+    gint   major = 0, minor = 0;
+    gint   error_base, err;
+    gint64 begin;
 
 #ifdef HAVE_UPOWERGLIB
     helper->power = NULL;
@@ -214,11 +247,15 @@ xfce_displays_helper_init (XfceDisplaysHelper *helper)
     helper->outputs = NULL;
     helper->crtcs = NULL;
     helper->handler = 0;
+    helper->profiles = NULL;
+    helper->profile = NULL;
 
     /* get the default display */
     helper->display = gdk_display_get_default ();
     helper->xdisplay = gdk_x11_display_get_xdisplay (helper->display);
     helper->root_window = gdk_get_default_root_window ();
+    helper->edid_atom = gdk_x11_get_xatom_by_name_for_display (helper->display,
+                                                               RR_PROPERTY_RANDR_EDID);
 
     /* check if the randr extension is running */
     if (XRRQueryExtension (helper->xdisplay, &helper->event_base, &error_base))
@@ -227,12 +264,14 @@ xfce_displays_helper_init (XfceDisplaysHelper *helper)
         if (XRRQueryVersion (helper->xdisplay, &major, &minor)
             && (major > 1 || (major == 1 && minor >= 2)))
         {
+            begin = blsettings_stats_begin ();
             gdk_error_trap_push ();
             /* get the screen resource */
             helper->resources = XRRGetScreenResources (helper->xdisplay,
                                                        GDK_WINDOW_XID (helper->root_window));
             gdk_flush ();
             err = gdk_error_trap_pop ();
+            blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRGetScreenResources", 2, begin);
             if (err)
             {
                 g_critical ("XRRGetScreenResources failed (err: %d). "
@@ -269,6 +308,14 @@ xfce_displays_helper_init (XfceDisplaysHelper *helper)
             /* remove any leftover apply property before setting the monitor */
             blconf_channel_reset_property (helper->channel, APPLY_SCHEME_PROP, FALSE);
 
+#ifdef HAVE_UPOWERGLIB
+            /* delay before a lid transition is applied */
+            xfce_displays_upower_set_settle_delay (helper->power,
+                                                   blconf_channel_get_uint (helper->channel,
+                                                                            LID_DELAY_PROP,
+                                                                            XFSD_LID_SETTLE_DELAY));
+#endif
+
             /* monitor channel changes */
             helper->handler = g_signal_connect (G_OBJECT (helper->channel),
                                                 "property-changed",
@@ -278,8 +325,13 @@ xfce_displays_helper_init (XfceDisplaysHelper *helper)
 #ifdef HAS_RANDR_ONE_POINT_THREE
             helper->has_1_3 = (major > 1 || (major == 1 && minor >= 3));
 #endif
-            /* restore the default scheme */
-            xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME);
+            /* load the saved profiles and identify the connected displays */
+            xfce_displays_helper_load_profiles (helper);
+            helper->profile = xfce_displays_helper_get_profile (helper);
+
+            /* restore the profile of these displays or the default scheme */
+            if (!xfce_displays_helper_apply_profile (helper, NULL))
+                xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME, FALSE);
         }
         else
         {
@@ -358,6 +410,10 @@ xfce_displays_helper_finalize (GObject *object)
         helper->resources = NULL;
     }
 
+    if (helper->profiles)
+        g_hash_table_destroy (helper->profiles);
+    g_free (helper->profile);
+
     (*G_OBJECT_CLASS (xfce_displays_helper_parent_class)->finalize) (object);
 }
 
@@ -366,7 +422,8 @@ xfce_displays_helper_finalize (GObject *object)
 static void
 xfce_displays_helper_reload (XfceDisplaysHelper *helper)
 {
-    gint err;
+    gint   err;
+    gint64 begin;
 
     blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Refreshing RandR cache.");
 
@@ -374,6 +431,7 @@ xfce_displays_helper_reload (XfceDisplaysHelper *helper)
     g_ptr_array_unref (helper->outputs);
     g_ptr_array_unref (helper->crtcs);
 
+    begin = blsettings_stats_begin ();
     gdk_error_trap_push ();
 
     /* Free the screen resources */
@@ -394,6 +452,7 @@ xfce_displays_helper_reload (XfceDisplaysHelper *helper)
 
     gdk_flush ();
     err = gdk_error_trap_pop ();
+    blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRGetScreenResources", 2, begin);
     if (err)
         g_critical ("Failed to reload the RandR cache (err: %d).", err);
 
@@ -418,6 +477,8 @@ xfce_displays_helper_screen_on_event (GdkXEvent *xevent,
     gint                j;
     guint               n, m, nactive = 0;
     gboolean            found = FALSE, changed = FALSE;
+    gchar              *profile;
+    gboolean            new_profile = FALSE;
 
     if (!e)
         return GDK_FILTER_CONTINUE;
@@ -434,7 +495,23 @@ xfce_displays_helper_screen_on_event (GdkXEvent *xevent,
         blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Noutput: before = %d, after = %d.",
                         old_outputs->len, helper->outputs->len);
 
-        if (old_outputs->len > helper->outputs->len)
+        /* identify the new set of displays */
+        profile = xfce_displays_helper_get_profile (helper);
+        if (g_strcmp0 (profile, helper->profile) != 0)
+        {
+            g_free (helper->profile);
+            helper->profile = profile;
+            new_profile = TRUE;
+        }
+        else
+            g_free (profile);
+
+        if (new_profile && xfce_displays_helper_apply_profile (helper, old_outputs))
+        {
+            /* the saved layout of these displays has been restored, so
+               there is no need for connector matching or the dialog */
+        }
+        else if (old_outputs->len > helper->outputs->len)
         {
             /* Diff the new and old output list to find removed outputs */
             for (n = 0; n < old_outputs->len; ++n)
@@ -588,7 +665,8 @@ static gboolean
 xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
                                        const gchar        *scheme,
                                        GHashTable         *saved_outputs,
-                                       XfceRROutput       *output)
+                                       XfceRROutput       *output,
+                                       const gchar        *name)
 {
     XfceRRCrtc  *crtc = NULL;
     GValue      *value;
@@ -605,7 +683,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     active = output->active;
 
     /* does this output exist in blconf? */
-    g_snprintf (property, sizeof (property), OUTPUT_FMT, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), OUTPUT_FMT, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
 
     if (value == NULL || !G_VALUE_HOLDS_STRING (value))
@@ -615,8 +693,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     if (helper->has_1_3)
     {
         /* is it the primary output? */
-        g_snprintf (property, sizeof (property), PRIMARY_PROP, scheme,
-                    output->info->name);
+        g_snprintf (property, sizeof (property), PRIMARY_PROP, scheme, name);
         value = g_hash_table_lookup (saved_outputs, property);
         if (G_VALUE_HOLDS_BOOLEAN (value) && g_value_get_boolean (value))
             helper->primary = output->id;
@@ -624,7 +701,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
 #endif
 
     /* status */
-    g_snprintf (property, sizeof (property), ACTIVE_PROP, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), ACTIVE_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
 
     if (value == NULL || !G_VALUE_HOLDS_BOOLEAN (value))
@@ -652,7 +729,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     }
 
     /* rotation */
-    g_snprintf (property, sizeof (property), ROTATION_PROP, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), ROTATION_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (G_VALUE_HOLDS_INT (value))
         int_value = g_value_get_int (value);
@@ -669,7 +746,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     }
 
     /* reflection */
-    g_snprintf (property, sizeof (property), REFLECTION_PROP, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), REFLECTION_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (G_VALUE_HOLDS_STRING (value))
         str_value = g_value_get_string (value);
@@ -699,7 +776,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     }
 
     /* resolution */
-    g_snprintf (property, sizeof (property), RESOLUTION_PROP, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), RESOLUTION_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (value == NULL || !G_VALUE_HOLDS_STRING (value))
         str_value = "";
@@ -707,7 +784,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
         str_value = g_value_get_string (value);
 
     /* refresh rate */
-    g_snprintf (property, sizeof (property), RRATE_PROP, scheme, output->info->name);
+    g_snprintf (property, sizeof (property), RRATE_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (G_VALUE_HOLDS_DOUBLE (value))
         output_rate = g_value_get_double (value);
@@ -777,8 +854,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
     }
 
     /* position, x */
-    g_snprintf (property, sizeof (property), POSX_PROP, scheme,
-                output->info->name);
+    g_snprintf (property, sizeof (property), POSX_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (G_VALUE_HOLDS_INT (value))
         x = g_value_get_int (value);
@@ -786,8 +862,7 @@ xfce_displays_helper_load_from_blconf (XfceDisplaysHelper *helper,
         x = 0;
 
     /* position, y */
-    g_snprintf (property, sizeof (property), POSY_PROP, scheme,
-                output->info->name);
+    g_snprintf (property, sizeof (property), POSY_PROP, scheme, name);
     value = g_hash_table_lookup (saved_outputs, property);
     if (G_VALUE_HOLDS_INT (value))
         y = g_value_get_int (value);
@@ -817,6 +892,7 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
     XfceRROutput  *output;
     XfceRRCrtc    *crtc;
     gint           best_dist, dist, n, m, l, err;
+    gint64         begin;
 
     g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
 
@@ -826,10 +902,12 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
     outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) xfce_displays_helper_free_output);
     for (n = 0; n < helper->resources->noutput; ++n)
     {
+        begin = blsettings_stats_begin ();
         gdk_error_trap_push ();
         output_info = XRRGetOutputInfo (helper->xdisplay, helper->resources, helper->resources->outputs[n]);
         gdk_flush ();
         err = gdk_error_trap_pop ();
+        blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRGetOutputInfo", 2, begin);
         if (err || !output_info)
         {
             g_warning ("Failed to load info for output %lu (err: %d). Skipping.",
@@ -884,8 +962,11 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
         /* Translate output->name into blconf compatible format in place */
         g_strcanon(output->info->name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_<>", '_');
 
-        blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Detected output %lu %s.", output->id,
-                        output->info->name);
+        /* identify the display for the profiles */
+        output->fingerprint = xfce_displays_helper_get_fingerprint (helper, output->id);
+
+        blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Detected output %lu %s (%s).", output->id,
+                        output->info->name, output->fingerprint ? output->fingerprint : "no EDID");
 
         /* cache it */
         g_ptr_array_add (outputs, output);
@@ -899,9 +980,12 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
 static void
 xfce_displays_helper_free_output (XfceRROutput *output)
 {
+    gint64 begin;
+
     if (output == NULL)
         return;
 
+    begin = blsettings_stats_begin ();
     gdk_error_trap_push ();
     XRRFreeOutputInfo (output->info);
     gdk_flush ();
@@ -909,11 +993,58 @@ xfce_displays_helper_free_output (XfceRROutput *output)
     {
         g_critical ("Failed to free output info");
     }
+    blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRFreeOutputInfo", 1, begin);
+    g_free (output->fingerprint);
     g_free (output);
 }
 
 
 
+static gchar *
+xfce_displays_helper_get_fingerprint (XfceDisplaysHelper *helper,
+                                      RROutput            output)
+{
+    Atom    actual_type;
+    gint    actual_format;
+    gulong  nitems, bytes_after;
+    guchar *prop = NULL;
+    gchar  *fingerprint = NULL;
+    gint64  begin;
+    gint    err;
+
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay);
+
+    /* the base block holds the vendor, product and serial number, so
+       it is enough to tell the displays apart */
+    begin = blsettings_stats_begin ();
+    gdk_error_trap_push ();
+    if (XRRGetOutputProperty (helper->xdisplay, output, helper->edid_atom,
+                              0, EDID_BLOCK_SIZE / 4, False, False,
+                              AnyPropertyType, &actual_type, &actual_format,
+                              &nitems, &bytes_after, &prop) == Success
+        && actual_type == XA_INTEGER && actual_format == 8
+        && nitems >= EDID_BLOCK_SIZE)
+    {
+        fingerprint = g_compute_checksum_for_data (G_CHECKSUM_MD5, prop, EDID_BLOCK_SIZE);
+    }
+
+    if (prop != NULL)
+        XFree (prop);
+
+    gdk_flush ();
+    err = gdk_error_trap_pop ();
+    blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRGetOutputProperty", 2, begin);
+    if (err != 0)
+    {
+        g_free (fingerprint);
+        return NULL;
+    }
+
+    return fingerprint;
+}
+
+
+
 static GPtrArray *
 xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
 {
@@ -921,6 +1052,7 @@ xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
     XRRCrtcInfo *crtc_info;
     XfceRRCrtc  *crtc;
     gint         n, err;
+    gint64       begin;
 
     g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
 
@@ -930,10 +1062,12 @@ xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
     {
         blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Detected CRTC %lu.", helper->resources->crtcs[n]);
 
+        begin = blsettings_stats_begin ();
         gdk_error_trap_push ();
         crtc_info = XRRGetCrtcInfo (helper->xdisplay, helper->resources, helper->resources->crtcs[n]);
         gdk_flush ();
         err = gdk_error_trap_pop ();
+        blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "XRRGetCrtcInfo", 2, begin);
         if (err || !crtc_info)
         {
             g_warning ("Failed to load info for CRTC %lu (err: %d). Skipping.",
@@ -1219,6 +1353,8 @@ xfce_displays_helper_set_outputs (XfceRRCrtc   *crtc,
 static void
 xfce_displays_helper_apply_all (XfceDisplaysHelper *helper)
 {
+    gint64 begin;
+
     g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->crtcs);
 
     helper->mm_width = helper->mm_height = helper->width = helper->height = 0;
@@ -1228,6 +1364,7 @@ xfce_displays_helper_apply_all (XfceDisplaysHelper *helper)
     g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_get_topleftmost_pos, helper);
     g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_normalize_crtc, helper);
 
+    begin = blsettings_stats_begin ();
     gdk_error_trap_push ();
 
     /* grab server to prevent clients from thinking no output is enabled */
@@ -1255,17 +1392,22 @@ xfce_displays_helper_apply_all (XfceDisplaysHelper *helper)
     {
         g_critical ("Failed to apply display settings");
     }
+    /* each CRTC is queried once, plus the final flush */
+    blsettings_stats_end (XFSD_DEBUG_DISPLAYS, "apply", helper->crtcs->len + 1, begin);
 }
 
 
 
-static void
+static gboolean
 xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
-                                    const gchar        *scheme)
+                                    const gchar        *scheme,
+                                    gboolean            save_profile)
 {
-    gchar       property[512];
-    guint       n, nactive;
-    GHashTable *saved_outputs;
+    gchar         property[512];
+    guint         n, nactive;
+    GHashTable   *saved_outputs;
+    XfceRROutput *output;
+    gboolean      applied = FALSE;
 
     saved_outputs = NULL;
 #ifdef HAS_RANDR_ONE_POINT_THREE
@@ -1284,9 +1426,9 @@ xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
     nactive = 0;
     for (n = 0; n < helper->outputs->len; ++n)
     {
+        output = g_ptr_array_index (helper->outputs, n);
         if (xfce_displays_helper_load_from_blconf (helper, scheme, saved_outputs,
-                                                   g_ptr_array_index (helper->outputs,
-                                                                      n)))
+                                                   output, output->info->name))
             ++nactive;
     }
 
@@ -1301,11 +1443,18 @@ xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
 
     /* apply settings */
     xfce_displays_helper_apply_all (helper);
+    applied = TRUE;
+
+    /* remember the layout for this set of displays */
+    if (save_profile)
+        xfce_displays_helper_save_profile (helper, scheme, saved_outputs);
 
 err_cleanup:
     /* Free the blconf properties */
     if (saved_outputs)
         g_hash_table_destroy (saved_outputs);
+
+    return applied;
 }
 
 
@@ -1320,10 +1469,302 @@ xfce_displays_helper_channel_property_changed (BlconfChannel      *channel,
         g_strcmp0 (property_name, APPLY_SCHEME_PROP) == 0))
     {
         /* apply */
-        xfce_displays_helper_channel_apply (helper, g_value_get_string (value));
+        xfce_displays_helper_channel_apply (helper, g_value_get_string (value), TRUE);
         /* remove the apply property */
         blconf_channel_reset_property (channel, APPLY_SCHEME_PROP, FALSE);
     }
+    else if (g_str_has_prefix (property_name, PROFILES_PROP "/"))
+    {
+        /* keep the profile cache in sync with the channel */
+        xfce_displays_helper_profile_set (helper, property_name, value);
+    }
+#ifdef HAVE_UPOWERGLIB
+    else if (G_VALUE_HOLDS_UINT (value)
+             && g_strcmp0 (property_name, LID_DELAY_PROP) == 0)
+    {
+        xfce_displays_upower_set_settle_delay (helper->power, g_value_get_uint (value));
+    }
+#endif
+}
+
+
+
+static void
+xfce_displays_helper_free_value (GValue *value)
+{
+    g_value_unset (value);
+    g_free (value);
+}
+
+
+
+static void
+xfce_displays_helper_load_profiles (XfceDisplaysHelper *helper)
+{
+    GHashTable     *props;
+    GHashTableIter  iter;
+    gpointer        key, value;
+
+    helper->profiles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify) g_hash_table_destroy);
+
+    /* fetch all the profiles at once, they are looked up on every
+       screen change */
+    props = blconf_channel_get_properties (helper->channel, PROFILES_PROP);
+    if (props == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, props);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        xfce_displays_helper_profile_set (helper, key, value);
+
+    g_hash_table_destroy (props);
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Loaded %d display profile(s).",
+                    g_hash_table_size (helper->profiles));
+}
+
+
+
+static void
+xfce_displays_helper_profile_set (XfceDisplaysHelper *helper,
+                                  const gchar        *property,
+                                  const GValue       *value)
+{
+    GHashTable  *profile;
+    const gchar *id, *p;
+    gchar       *name;
+    GValue      *copy;
+
+    /* properties are /Profiles/<id>/<fingerprint>/... */
+    id = property + strlen (PROFILES_PROP "/");
+    p = strchr (id, '/');
+    if (p == NULL || p == id)
+        return;
+
+    name = g_strndup (id, p - id);
+    profile = g_hash_table_lookup (helper->profiles, name);
+
+    if (value == NULL || G_VALUE_TYPE (value) == G_TYPE_INVALID)
+    {
+        /* the property was removed */
+        if (profile != NULL)
+        {
+            g_hash_table_remove (profile, property);
+            if (g_hash_table_size (profile) == 0)
+                g_hash_table_remove (helper->profiles, name);
+        }
+        g_free (name);
+        return;
+    }
+
+    if (profile == NULL)
+    {
+        profile = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) xfce_displays_helper_free_value);
+        g_hash_table_insert (helper->profiles, name, profile);
+    }
+    else
+        g_free (name);
+
+    copy = g_new0 (GValue, 1);
+    g_value_init (copy, G_VALUE_TYPE (value));
+    g_value_copy (value, copy);
+    g_hash_table_insert (profile, g_strdup (property), copy);
+}
+
+
+
+static gint
+xfce_displays_helper_compare_fingerprints (gconstpointer a,
+                                           gconstpointer b)
+{
+    return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+
+
+static gchar *
+xfce_displays_helper_get_profile (XfceDisplaysHelper *helper)
+{
+    GPtrArray    *fingerprints;
+    GChecksum    *checksum;
+    XfceRROutput *output;
+    gchar        *profile = NULL;
+    guint         n;
+
+    if (helper->outputs == NULL || helper->outputs->len == 0)
+        return NULL;
+
+    fingerprints = g_ptr_array_sized_new (helper->outputs->len);
+    for (n = 0; n < helper->outputs->len; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+
+        /* all displays must be identified */
+        if (output->fingerprint == NULL)
+            goto out;
+
+        g_ptr_array_add (fingerprints, output->fingerprint);
+    }
+
+    /* the profile does not depend on the connectors used */
+    g_ptr_array_sort (fingerprints, xfce_displays_helper_compare_fingerprints);
+
+    checksum = g_checksum_new (G_CHECKSUM_MD5);
+    for (n = 0; n < fingerprints->len; ++n)
+    {
+        /* identical displays without a serial number can not be
+           told apart, leave these to the connector matching */
+        if (n > 0 && strcmp (g_ptr_array_index (fingerprints, n - 1),
+                             g_ptr_array_index (fingerprints, n)) == 0)
+        {
+            g_checksum_free (checksum);
+            goto out;
+        }
+
+        g_checksum_update (checksum, g_ptr_array_index (fingerprints, n), -1);
+    }
+
+    profile = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Connected displays have profile %s.", profile);
+
+out:
+    g_ptr_array_free (fingerprints, TRUE);
+
+    return profile;
+}
+
+
+
+static void
+xfce_displays_helper_save_profile (XfceDisplaysHelper *helper,
+                                   const gchar        *scheme,
+                                   GHashTable         *saved_outputs)
+{
+    GHashTableIter  iter;
+    gpointer        key, value;
+    XfceRROutput   *output;
+    gchar           prefix[512], property[512];
+    const gchar    *suffix;
+    gsize           len;
+    guint           n;
+
+    if (helper->profile == NULL)
+        return;
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Saving scheme %s as profile %s.",
+                    scheme, helper->profile);
+
+    /* forget the previous layout of these displays */
+    g_snprintf (property, sizeof (property), PROFILES_PROP "/%s", helper->profile);
+    blconf_channel_reset_property (helper->channel, property, TRUE);
+    g_hash_table_remove (helper->profiles, helper->profile);
+
+    /* copy the settings of the outputs, keyed by display instead of connector */
+    for (n = 0; n < helper->outputs->len; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+
+        g_snprintf (prefix, sizeof (prefix), OUTPUT_FMT, scheme, output->info->name);
+        len = strlen (prefix);
+
+        g_hash_table_iter_init (&iter, saved_outputs);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+            if (strncmp (key, prefix, len) != 0)
+                continue;
+
+            suffix = (const gchar *) key + len;
+            if (*suffix != '\0' && *suffix != '/')
+                continue;
+
+            g_snprintf (property, sizeof (property), PROFILES_PROP "/%s/%s%s",
+                        helper->profile, output->fingerprint, suffix);
+            blconf_channel_set_property (helper->channel, property, value);
+            xfce_displays_helper_profile_set (helper, property, value);
+        }
+    }
+}
+
+
+
+static gboolean
+xfce_displays_helper_apply_profile (XfceDisplaysHelper *helper,
+                                    GPtrArray          *old_outputs)
+{
+    GHashTable   *saved_outputs;
+    XfceRROutput *output, *o;
+    XfceRRCrtc   *crtc;
+    gchar         scheme[512], property[512];
+    GValue       *value;
+    guint         n, m;
+    gboolean      found = FALSE;
+
+    if (helper->profile == NULL)
+        return FALSE;
+
+    /* O(1) lookup of the decoded layout of these displays */
+    saved_outputs = g_hash_table_lookup (helper->profiles, helper->profile);
+    if (saved_outputs == NULL)
+        return FALSE;
+
+    /* the scheme of the profile, without the leading slash */
+    g_snprintf (scheme, sizeof (scheme), "%s/%s", PROFILES_PROP + 1, helper->profile);
+
+    /* never apply a profile that disables all the outputs */
+    for (n = 0; n < helper->outputs->len && !found; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+        g_snprintf (property, sizeof (property), ACTIVE_PROP, scheme, output->fingerprint);
+        value = g_hash_table_lookup (saved_outputs, property);
+        found = G_VALUE_HOLDS_BOOLEAN (value) && g_value_get_boolean (value);
+    }
+
+    if (!found)
+        return FALSE;
+
+    blsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applying profile %s.", helper->profile);
+
+    /* deconfigure the CRTCs of removed outputs in the same modeset */
+    for (n = 0; old_outputs != NULL && n < old_outputs->len; ++n)
+    {
+        o = g_ptr_array_index (old_outputs, n);
+        found = FALSE;
+        for (m = 0; m < helper->outputs->len && !found; ++m)
+        {
+            output = g_ptr_array_index (helper->outputs, m);
+            found = output->id == o->id;
+        }
+
+        if (found || o->info->crtc == None)
+            continue;
+
+        crtc = xfce_displays_helper_find_crtc_by_id (helper, o->info->crtc);
+        if (crtc && crtc->mode != None)
+        {
+            crtc->mode = None;
+            crtc->noutput = 0;
+            crtc->changed = TRUE;
+        }
+    }
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->primary = None;
+#endif
+
+    for (n = 0; n < helper->outputs->len; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+        xfce_displays_helper_load_from_blconf (helper, scheme, saved_outputs, output,
+                                               output->fingerprint);
+    }
+
+    xfce_displays_helper_apply_all (helper);
+
+    return TRUE;
 }
 
 
@@ -1388,12 +1829,14 @@ xfce_displays_helper_toggle_internal (gpointer           *power,
                     continue;
 
                 xfce_displays_helper_load_from_blconf (helper, DEFAULT_SCHEME_NAME,
-                                                       saved_outputs, output);
+                                                       saved_outputs, output,
+                                                       output->info->name);
             }
 
             /* try to load user saved settings for lvds */
             active = xfce_displays_helper_load_from_blconf (helper, DEFAULT_SCHEME_NAME,
-                                                            saved_outputs, lvds);
+                                                            saved_outputs, lvds,
+                                                            lvds->info->name);
             g_hash_table_destroy (saved_outputs);
         }
         if (!active)
@@ -27,11 +27,16 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#include <sys/stat.h>
 
 #include <X11/Xlib.h>
 #include <X11/XKBlib.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 #include <blconf/blconf.h>
@@ -44,10 +49,40 @@
 #include "debug.h"
 #include "keyboard-layout.h"
 
+/* delay after the last xkb activation before ~/.Xmodmap is applied */
+#define XMODMAP_DELAY        (250)
+
+/* times the modifier map is set again while keys are pressed */
+#define XMODMAP_BUSY_RETRIES (10)
+
+/* a line of the xmodmap file */
+typedef enum
+{
+    XMODMAP_EDIT_KEYCODE, /* keycode NUMBER = KEYSYMNAME ... */
+    XMODMAP_EDIT_KEYSYM,  /* keysym KEYSYMNAME = KEYSYMNAME ... */
+    XMODMAP_EDIT_CLEAR,   /* clear MODIFIERNAME */
+    XMODMAP_EDIT_ADD,     /* add MODIFIERNAME = KEYSYMNAME ... */
+    XMODMAP_EDIT_REMOVE   /* remove MODIFIERNAME = KEYSYMNAME ... */
+}
+XmodmapEditType;
+
+typedef struct
+{
+    XmodmapEditType  type;
+
+    /* keycode, keysym or modifier index of the left hand side */
+    gulong           target;
+
+    KeySym          *keysyms;
+    guint            n_keysyms;
+}
+XmodmapEdit;
+
 static void xfce_keyboard_layout_helper_finalize                  (GObject                       *object);
-static void xfce_keyboard_layout_helper_process_xmodmap           (void);
+static void xfce_keyboard_layout_helper_queue_xmodmap             (XfceKeyboardLayoutHelper      *helper);
 
 #ifdef HAVE_LIBXKLAVIER
+static void xfce_keyboard_layout_helper_activate                  (XfceKeyboardLayoutHelper      *helper);
 static void xfce_keyboard_layout_helper_set_model                 (XfceKeyboardLayoutHelper      *helper);
 static void xfce_keyboard_layout_helper_set_layout                (XfceKeyboardLayoutHelper      *helper);
 static void xfce_keyboard_layout_helper_set_variant               (XfceKeyboardLayoutHelper      *helper);
@@ -81,6 +116,22 @@ struct _XfceKeyboardLayoutHelper
 
     gboolean           xkb_disable_settings;
 
+    /* ~/.Xmodmap parsed into edits, loaded again when the file changes */
+    GArray            *xmodmap_edits;
+    guint              xmodmap_loaded : 1;
+    guint              xmodmap_parsed : 1;
+    time_t             xmodmap_mtime;
+    off_t              xmodmap_size;
+
+    /* checksum of the mapping after the edits were last applied */
+    gchar             *xmodmap_applied;
+
+    /* modifier map that could not be set while keys were pressed */
+    XModifierKeymap   *xmodmap_modmap;
+    guint              xmodmap_retries;
+
+    guint              xmodmap_timeout_id;
+
 #ifdef HAVE_LIBXKLAVIER
     /* libxklavier */
     XklEngine         *engine;
@@ -112,6 +163,8 @@ xfce_keyboard_layout_helper_init (XfceKeyboardLayoutHelper *helper)
 
     helper->xkb_disable_settings = blconf_channel_get_bool (helper->channel, "/Default/XkbDisable", TRUE);
 
+    helper->xmodmap_edits = g_array_new (FALSE, FALSE, sizeof (XmodmapEdit));
+
 #ifdef HAVE_LIBXKLAVIER
     /* monitor channel changes */
     g_signal_connect (G_OBJECT (helper->channel), "property-changed", G_CALLBACK (xfce_keyboard_layout_helper_channel_property_changed), helper);
@@ -134,15 +187,36 @@ xfce_keyboard_layout_helper_init (XfceKeyboardLayoutHelper *helper)
     xfce_keyboard_layout_helper_set_composekey (helper);
 #endif /* HAVE_LIBXKLAVIER */
 
-    xfce_keyboard_layout_helper_process_xmodmap ();
+    xfce_keyboard_layout_helper_queue_xmodmap (helper);
+}
+
+static void
+xfce_keyboard_layout_xmodmap_edits_clear (GArray *edits)
+{
+    guint i;
+
+    for (i = 0; i < edits->len; i++)
+        g_free (g_array_index (edits, XmodmapEdit, i).keysyms);
+
+    g_array_set_size (edits, 0);
 }
 
 static void
 xfce_keyboard_layout_helper_finalize (GObject *object)
 {
-#ifdef HAVE_LIBXKLAVIER
     XfceKeyboardLayoutHelper *helper = XFCE_KEYBOARD_LAYOUT_HELPER (object);
 
+    if (helper->xmodmap_timeout_id != 0)
+        g_source_remove (helper->xmodmap_timeout_id);
+
+    if (helper->xmodmap_modmap != NULL)
+        XFreeModifiermap (helper->xmodmap_modmap);
+
+    xfce_keyboard_layout_xmodmap_edits_clear (helper->xmodmap_edits);
+    g_array_free (helper->xmodmap_edits, TRUE);
+    g_free (helper->xmodmap_applied);
+
+#ifdef HAVE_LIBXKLAVIER
     xkl_engine_stop_listen (helper->engine, XKLL_TRACK_KEYBOARD_STATE);
     gdk_window_remove_filter (NULL, (GdkFilterFunc) handle_xevent, helper);
     g_object_unref (helper->config);
@@ -154,36 +228,650 @@ xfce_keyboard_layout_helper_finalize (GObject *object)
 }
 
 
+static gchar **
+xfce_keyboard_layout_xmodmap_tokenize (const gchar *line)
+{
+    GPtrArray   *tokens;
+    const gchar *p, *start;
+
+    tokens = g_ptr_array_new ();
+
+    /* whitespace separated words, the '=' is a token on its own */
+    for (p = line; *p != '\0';)
+    {
+        if (g_ascii_isspace (*p))
+        {
+            p++;
+        }
+        else if (*p == '=')
+        {
+            g_ptr_array_add (tokens, g_strdup ("="));
+            p++;
+        }
+        else
+        {
+            for (start = p; *p != '\0' && !g_ascii_isspace (*p) && *p != '='; p++);
+            g_ptr_array_add (tokens, g_strndup (start, p - start));
+        }
+    }
+
+    g_ptr_array_add (tokens, NULL);
+
+    return (gchar **) g_ptr_array_free (tokens, FALSE);
+}
+
+static gboolean
+xfce_keyboard_layout_xmodmap_modifier (const gchar *name,
+                                       gulong      *index)
+{
+    static const gchar *names[] = { "shift", "lock", "control", "mod1",
+                                    "mod2", "mod3", "mod4", "mod5" };
+    guint               i;
+
+    /* same order as ShiftMapIndex ... Mod5MapIndex */
+    for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        if (g_ascii_strcasecmp (name, names[i]) == 0)
+        {
+            *index = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+xfce_keyboard_layout_xmodmap_keysyms (gchar       **names,
+                                      XmodmapEdit  *edit)
+{
+    guint i;
+
+    edit->n_keysyms = g_strv_length (names);
+    edit->keysyms = g_new0 (KeySym, MAX (edit->n_keysyms, 1));
+
+    for (i = 0; i < edit->n_keysyms; i++)
+    {
+        edit->keysyms[i] = XStringToKeysym (names[i]);
+        if (edit->keysyms[i] == NoSymbol && strcmp (names[i], "NoSymbol") != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Parse a line of an xmodmap file and append the edit to @edits.
+ * Returns FALSE for expressions the helper leaves to xmodmap, like
+ * "keycode any" and "pointer".
+ */
+static gboolean
+xfce_keyboard_layout_xmodmap_parse_line (const gchar *line,
+                                         GArray      *edits)
+{
+    gchar       **tokens;
+    guint         n_tokens;
+    gchar        *end;
+    guint64       keycode;
+    XmodmapEdit   edit = { 0, };
+    gboolean      is_edit = FALSE;
+    gboolean      result = FALSE;
+
+    tokens = xfce_keyboard_layout_xmodmap_tokenize (line);
+    n_tokens = g_strv_length (tokens);
+
+    if (n_tokens == 0 || tokens[0][0] == '!')
+    {
+        /* empty line or comment */
+        result = TRUE;
+    }
+    else if (strcmp (tokens[0], "keycode") == 0
+             && n_tokens >= 3 && strcmp (tokens[2], "=") == 0)
+    {
+        /* decimal, octal or hex like xmodmap */
+        keycode = g_ascii_strtoull (tokens[1], &end, 0);
+        if (end != tokens[1] && *end == '\0' && keycode <= 255)
+        {
+            edit.type = XMODMAP_EDIT_KEYCODE;
+            edit.target = keycode;
+            result = is_edit = xfce_keyboard_layout_xmodmap_keysyms (tokens + 3, &edit);
+        }
+    }
+    else if (strcmp (tokens[0], "keysym") == 0
+             && n_tokens >= 3 && strcmp (tokens[2], "=") == 0)
+    {
+        edit.type = XMODMAP_EDIT_KEYSYM;
+        edit.target = XStringToKeysym (tokens[1]);
+        if (edit.target != NoSymbol)
+            result = is_edit = xfce_keyboard_layout_xmodmap_keysyms (tokens + 3, &edit);
+    }
+    else if (strcmp (tokens[0], "clear") == 0 && n_tokens == 2)
+    {
+        edit.type = XMODMAP_EDIT_CLEAR;
+        result = is_edit = xfce_keyboard_layout_xmodmap_modifier (tokens[1], &edit.target);
+    }
+    else if ((strcmp (tokens[0], "add") == 0 || strcmp (tokens[0], "remove") == 0)
+             && n_tokens >= 3 && strcmp (tokens[2], "=") == 0)
+    {
+        edit.type = tokens[0][0] == 'a' ? XMODMAP_EDIT_ADD : XMODMAP_EDIT_REMOVE;
+        if (xfce_keyboard_layout_xmodmap_modifier (tokens[1], &edit.target))
+            result = is_edit = xfce_keyboard_layout_xmodmap_keysyms (tokens + 3, &edit);
+    }
+
+    if (is_edit)
+        g_array_append_val (edits, edit);
+    else
+        g_free (edit.keysyms);
+
+    g_strfreev (tokens);
+
+    return result;
+}
+
+static void
+xfce_keyboard_layout_helper_load_xmodmap (XfceKeyboardLayoutHelper *helper,
+                                          const gchar              *xmodmap_path)
+{
+    gchar   *contents;
+    gchar  **lines;
+    guint    i;
+    GError  *error = NULL;
+
+    xfce_keyboard_layout_xmodmap_edits_clear (helper->xmodmap_edits);
+    helper->xmodmap_parsed = FALSE;
+
+    /* leave reporting the error to xmodmap */
+    if (!g_file_get_contents (xmodmap_path, &contents, NULL, &error))
+    {
+        DBG ("Failed to read \"%s\": %s", xmodmap_path, error->message);
+        g_error_free (error);
+        return;
+    }
+
+    helper->xmodmap_parsed = TRUE;
+
+    lines = g_strsplit (contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (!xfce_keyboard_layout_xmodmap_parse_line (lines[i], helper->xmodmap_edits))
+        {
+            blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT,
+                            "line %u of \"%s\" is not supported, using xmodmap",
+                            i + 1, xmodmap_path);
+
+            xfce_keyboard_layout_xmodmap_edits_clear (helper->xmodmap_edits);
+            helper->xmodmap_parsed = FALSE;
+            break;
+        }
+    }
+
+    g_strfreev (lines);
+    g_free (contents);
+
+    if (helper->xmodmap_parsed)
+        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "parsed %u edits from \"%s\"",
+                        helper->xmodmap_edits->len, xmodmap_path);
+}
+
+/* number of keysyms in a row, without the trailing NoSymbols */
+static gint
+xfce_keyboard_layout_xmodmap_row_length (const KeySym *row,
+                                         gint          width)
+{
+    while (width > 0 && row[width - 1] == NoSymbol)
+        width--;
+
+    return width;
+}
+
+static gboolean
+xfce_keyboard_layout_xmodmap_row_has (const KeySym *row,
+                                      gint          width,
+                                      KeySym        keysym)
+{
+    gint col;
+
+    for (col = 0; col < width; col++)
+        if (row[col] == keysym)
+            return TRUE;
+
+    return FALSE;
+}
+
+static void
+xfce_keyboard_layout_xmodmap_row_set (KeySym            *row,
+                                      gint               width,
+                                      const XmodmapEdit *edit)
+{
+    gint col;
+
+    for (col = 0; col < width; col++)
+        row[col] = (guint) col < edit->n_keysyms ? edit->keysyms[col] : NoSymbol;
+}
+
+static gboolean
+xfce_keyboard_layout_xmodmap_modmap_has (XModifierKeymap *modmap,
+                                         gint             modifier,
+                                         KeyCode          keycode)
+{
+    gint i;
+
+    for (i = 0; i < modmap->max_keypermod; i++)
+        if (modmap->modifiermap[modifier * modmap->max_keypermod + i] == keycode)
+            return TRUE;
+
+    return FALSE;
+}
+
+/* compare the keycodes of each modifier, regardless of the order */
+static gboolean
+xfce_keyboard_layout_xmodmap_modmap_equal (XModifierKeymap *a,
+                                           XModifierKeymap *b)
+{
+    gint    modifier, i;
+    KeyCode keycode;
+
+    for (modifier = 0; modifier < 8; modifier++)
+    {
+        for (i = 0; i < a->max_keypermod; i++)
+        {
+            keycode = a->modifiermap[modifier * a->max_keypermod + i];
+            if (keycode != 0 && !xfce_keyboard_layout_xmodmap_modmap_has (b, modifier, keycode))
+                return FALSE;
+        }
+
+        for (i = 0; i < b->max_keypermod; i++)
+        {
+            keycode = b->modifiermap[modifier * b->max_keypermod + i];
+            if (keycode != 0 && !xfce_keyboard_layout_xmodmap_modmap_has (a, modifier, keycode))
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gchar *
+xfce_keyboard_layout_xmodmap_checksum (const KeySym    *map,
+                                       gint             width,
+                                       gint             n_keycodes,
+                                       XModifierKeymap *modmap)
+{
+    GChecksum *checksum;
+    gint       k, length, modifier, keycode;
+    guchar     byte;
+    gchar     *result;
+
+    checksum = g_checksum_new (G_CHECKSUM_MD5);
+
+    /* the rows without padding, the server may use another width */
+    for (k = 0; k < n_keycodes; k++)
+    {
+        length = xfce_keyboard_layout_xmodmap_row_length (map + k * width, width);
+        g_checksum_update (checksum, (const guchar *) &length, sizeof (length));
+        g_checksum_update (checksum, (const guchar *) (map + k * width), length * sizeof (KeySym));
+    }
+
+    /* the keycodes of each modifier in order */
+    for (modifier = 0; modifier < 8; modifier++)
+    {
+        byte = modifier;
+        g_checksum_update (checksum, &byte, 1);
+
+        for (keycode = 1; keycode < 256; keycode++)
+        {
+            if (xfce_keyboard_layout_xmodmap_modmap_has (modmap, modifier, keycode))
+            {
+                byte = keycode;
+                g_checksum_update (checksum, &byte, 1);
+            }
+        }
+    }
+
+    result = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+
+    return result;
+}
+
+static gchar *
+xfce_keyboard_layout_xmodmap_get_mapping (Display          *xdisplay,
+                                          gint              min_keycode,
+                                          gint              n_keycodes,
+                                          KeySym          **map,
+                                          gint             *width,
+                                          XModifierKeymap **modmap)
+{
+    gint64 begin;
+
+    begin = blsettings_stats_begin ();
+    *map = XGetKeyboardMapping (xdisplay, min_keycode, n_keycodes, width);
+    *modmap = XGetModifierMapping (xdisplay);
+    blsettings_stats_end (XFSD_DEBUG_KEYBOARD_LAYOUT, "XGetKeyboardMapping", 2, begin);
+
+    if (*map == NULL || *modmap == NULL)
+    {
+        if (*map != NULL)
+            XFree (*map);
+        if (*modmap != NULL)
+            XFreeModifiermap (*modmap);
+
+        return NULL;
+    }
+
+    return xfce_keyboard_layout_xmodmap_checksum (*map, *width, n_keycodes, *modmap);
+}
+
+static void
+xfce_keyboard_layout_helper_set_modmap (XfceKeyboardLayoutHelper *helper)
+{
+    gint   result;
+    gint64 begin;
+
+    begin = blsettings_stats_begin ();
+    result = XSetModifierMapping (GDK_DISPLAY (), helper->xmodmap_modmap);
+    blsettings_stats_end (XFSD_DEBUG_KEYBOARD_LAYOUT, "XSetModifierMapping", 1, begin);
+
+    if (result == MappingBusy)
+    {
+        /* modifier keys are pressed, the timeout tries again */
+        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "modifier keys are pressed, retrying");
+        return;
+    }
+
+    if (result != MappingSuccess)
+        DBG ("Failed to set the modifier mapping from ~/.Xmodmap");
+
+    XFreeModifiermap (helper->xmodmap_modmap);
+    helper->xmodmap_modmap = NULL;
+}
+
+/**
+ * Apply the parsed xmodmap edits to a copy of the server mapping and
+ * only send the keycodes and modifier map that changed. Like xmodmap,
+ * the keysyms of "keysym" and "remove" are looked up in the mapping
+ * before the file is applied, those of "add" after the previous lines.
+ */
+static void
+xfce_keyboard_layout_helper_apply_xmodmap (XfceKeyboardLayoutHelper *helper)
+{
+    Display         *xdisplay = GDK_DISPLAY ();
+    gint             min_keycode, max_keycode;
+    gint             n_keycodes;
+    KeySym          *old_map, *map;
+    gint             old_width, width;
+    XModifierKeymap *old_modmap, *modmap;
+    const XmodmapEdit *edit;
+    gchar           *checksum;
+    gint             first = -1;
+    gboolean         changed = FALSE;
+    gint             k, col;
+    guint            i, n;
+
+    if (helper->xmodmap_edits->len == 0)
+        return;
+
+    XDisplayKeycodes (xdisplay, &min_keycode, &max_keycode);
+    n_keycodes = max_keycode - min_keycode + 1;
+
+    checksum = xfce_keyboard_layout_xmodmap_get_mapping (xdisplay, min_keycode, n_keycodes,
+                                                         &old_map, &old_width, &old_modmap);
+    if (G_UNLIKELY (checksum == NULL))
+        return;
+
+    /* the edits are not idempotent (swapping keysyms for example), so
+     * skip the file if the keymap was not replaced since it was applied */
+    if (g_strcmp0 (checksum, helper->xmodmap_applied) == 0)
+    {
+        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "xmodmap edits are still applied");
+
+        g_free (checksum);
+        XFree (old_map);
+        XFreeModifiermap (old_modmap);
+        return;
+    }
+
+    /* widen the rows for the longest edit, like xmodmap */
+    width = old_width;
+    for (i = 0; i < helper->xmodmap_edits->len; i++)
+    {
+        edit = &g_array_index (helper->xmodmap_edits, XmodmapEdit, i);
+        if (edit->type == XMODMAP_EDIT_KEYCODE || edit->type == XMODMAP_EDIT_KEYSYM)
+            width = MAX (width, (gint) edit->n_keysyms);
+    }
+
+    map = g_new (KeySym, n_keycodes * width);
+    for (k = 0; k < n_keycodes; k++)
+        for (col = 0; col < width; col++)
+            map[k * width + col] = col < old_width ? old_map[k * old_width + col] : NoSymbol;
+
+    modmap = XNewModifiermap (old_modmap->max_keypermod);
+    memcpy (modmap->modifiermap, old_modmap->modifiermap, 8 * old_modmap->max_keypermod);
+
+    for (i = 0; i < helper->xmodmap_edits->len; i++)
+    {
+        edit = &g_array_index (helper->xmodmap_edits, XmodmapEdit, i);
+
+        switch (edit->type)
+        {
+            case XMODMAP_EDIT_KEYCODE:
+                if ((gint) edit->target >= min_keycode && (gint) edit->target <= max_keycode)
+                    xfce_keyboard_layout_xmodmap_row_set (map + (edit->target - min_keycode) * width,
+                                                          width, edit);
+                break;
+
+            case XMODMAP_EDIT_KEYSYM:
+                for (k = 0; k < n_keycodes; k++)
+                    if (xfce_keyboard_layout_xmodmap_row_has (old_map + k * old_width, old_width, edit->target))
+                        xfce_keyboard_layout_xmodmap_row_set (map + k * width, width, edit);
+                break;
+
+            case XMODMAP_EDIT_CLEAR:
+                memset (modmap->modifiermap + edit->target * modmap->max_keypermod,
+                        0, modmap->max_keypermod);
+                break;
+
+            case XMODMAP_EDIT_ADD:
+                for (n = 0; n < edit->n_keysyms; n++)
+                    for (k = 0; k < n_keycodes; k++)
+                        if (xfce_keyboard_layout_xmodmap_row_has (map + k * width, width, edit->keysyms[n]))
+                            modmap = XInsertModifiermapEntry (modmap, k + min_keycode, edit->target);
+                break;
+
+            case XMODMAP_EDIT_REMOVE:
+                for (n = 0; n < edit->n_keysyms; n++)
+                    for (k = 0; k < n_keycodes; k++)
+                        if (xfce_keyboard_layout_xmodmap_row_has (old_map + k * old_width, old_width, edit->keysyms[n]))
+                            modmap = XDeleteModifiermapEntry (modmap, k + min_keycode, edit->target);
+                break;
+        }
+    }
+
+    /* send only the keycodes that changed, one request per run of
+     * adjacent changed keycodes so unchanged keys are not re-sent */
+    for (k = 0; k <= n_keycodes; k++)
+    {
+        if (k < n_keycodes
+            && (xfce_keyboard_layout_xmodmap_row_length (old_map + k * old_width, old_width)
+                    != xfce_keyboard_layout_xmodmap_row_length (map + k * width, width)
+                || memcmp (old_map + k * old_width, map + k * width,
+                           xfce_keyboard_layout_xmodmap_row_length (map + k * width, width) * sizeof (KeySym)) != 0))
+        {
+            if (first < 0)
+                first = k;
+            continue;
+        }
+
+        if (first >= 0)
+        {
+            XChangeKeyboardMapping (xdisplay, first + min_keycode, width,
+                                    map + first * width, k - first);
+
+            blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "changed keycodes %d to %d from ~/.Xmodmap",
+                            first + min_keycode, k - 1 + min_keycode);
+
+            first = -1;
+            changed = TRUE;
+        }
+    }
+
+    if (!xfce_keyboard_layout_xmodmap_modmap_equal (old_modmap, modmap))
+    {
+        helper->xmodmap_modmap = modmap;
+        modmap = NULL;
+
+        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "setting modifier map from ~/.Xmodmap");
+        xfce_keyboard_layout_helper_set_modmap (helper);
+    }
+
+    XFree (old_map);
+    XFreeModifiermap (old_modmap);
+
+    if (changed || modmap == NULL)
+    {
+        /* remember the mapping as the server reports it, with the
+         * modifier map that waits for the keys to be released */
+        g_free (checksum);
+        checksum = xfce_keyboard_layout_xmodmap_get_mapping (xdisplay, min_keycode, n_keycodes,
+                                                             &old_map, &old_width, &old_modmap);
+        if (checksum != NULL)
+        {
+            if (helper->xmodmap_modmap != NULL)
+            {
+                g_free (checksum);
+                checksum = xfce_keyboard_layout_xmodmap_checksum (old_map, old_width, n_keycodes,
+                                                                  helper->xmodmap_modmap);
+            }
+
+            XFree (old_map);
+            XFreeModifiermap (old_modmap);
+        }
+    }
+
+    g_free (helper->xmodmap_applied);
+    helper->xmodmap_applied = checksum;
+
+    if (modmap != NULL)
+        XFreeModifiermap (modmap);
+    g_free (map);
+}
+
 static void
-xfce_keyboard_layout_helper_process_xmodmap (void)
+xfce_keyboard_layout_helper_process_xmodmap (XfceKeyboardLayoutHelper *helper)
 {
-    const gchar *xmodmap_path;
+    gchar       *xmodmap_path;
+    struct stat  st;
 
     xmodmap_path = g_build_filename (xfce_get_homedir (), ".Xmodmap", NULL);
 
-    if (g_file_test (xmodmap_path, G_FILE_TEST_EXISTS))
+    if (g_stat (xmodmap_path, &st) == 0)
     {
-        /* There is a .Xmodmap file, try to use it */
-        const gchar *xmodmap_command;
-        GError      *error = NULL;
+        /* There is a .Xmodmap file, parse it again only if it changed */
+        if (!helper->xmodmap_loaded
+            || st.st_mtime != helper->xmodmap_mtime
+            || st.st_size != helper->xmodmap_size)
+        {
+            xfce_keyboard_layout_helper_load_xmodmap (helper, xmodmap_path);
 
-        xmodmap_command = g_strconcat ("xmodmap ", xmodmap_path, NULL);
+            helper->xmodmap_loaded = TRUE;
+            helper->xmodmap_mtime = st.st_mtime;
+            helper->xmodmap_size = st.st_size;
 
-        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "spawning \"%s\"", xmodmap_command);
+            /* apply the new file even if the keymap did not change */
+            g_free (helper->xmodmap_applied);
+            helper->xmodmap_applied = NULL;
+        }
 
-        /* Launch the xmodmap command and only print errors when in debugging mode */
-        if (!g_spawn_command_line_async (xmodmap_command, &error))
+        if (helper->xmodmap_parsed)
         {
-            DBG ("Xmodmap call failed: %s", error->message);
-            g_error_free (error);
+            xfce_keyboard_layout_helper_apply_xmodmap (helper);
+        }
+        else
+        {
+            /* Fall back to xmodmap for files the helper cannot parse */
+            gchar       *xmodmap_command;
+            GError      *error = NULL;
+
+            xmodmap_command = g_strconcat ("xmodmap ", xmodmap_path, NULL);
+
+            blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "spawning \"%s\"", xmodmap_command);
+
+            /* Launch the xmodmap command and only print errors when in debugging mode */
+            if (!g_spawn_command_line_async (xmodmap_command, &error))
+            {
+                DBG ("Xmodmap call failed: %s", error->message);
+                g_error_free (error);
+            }
+
+            g_free (xmodmap_command);
         }
     }
+    else
+    {
+        helper->xmodmap_loaded = FALSE;
+    }
 
-    g_free ((gchar*) xmodmap_path);
+    g_free (xmodmap_path);
+}
+
+static gboolean
+xfce_keyboard_layout_helper_xmodmap_timeout (gpointer user_data)
+{
+    XfceKeyboardLayoutHelper *helper = XFCE_KEYBOARD_LAYOUT_HELPER (user_data);
+
+    if (helper->xmodmap_modmap != NULL)
+        xfce_keyboard_layout_helper_set_modmap (helper);
+    else
+        xfce_keyboard_layout_helper_process_xmodmap (helper);
+
+    if (helper->xmodmap_modmap != NULL)
+    {
+        /* keys are still pressed, try again */
+        if (helper->xmodmap_retries++ < XMODMAP_BUSY_RETRIES)
+            return TRUE;
+
+        blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "giving up setting the modifier map");
+
+        XFreeModifiermap (helper->xmodmap_modmap);
+        helper->xmodmap_modmap = NULL;
+    }
+
+    helper->xmodmap_timeout_id = 0;
+
+    return FALSE;
+}
+
+static void
+xfce_keyboard_layout_helper_queue_xmodmap (XfceKeyboardLayoutHelper *helper)
+{
+    /* the edits are applied to the new keymap */
+    if (helper->xmodmap_modmap != NULL)
+    {
+        XFreeModifiermap (helper->xmodmap_modmap);
+        helper->xmodmap_modmap = NULL;
+    }
+    helper->xmodmap_retries = 0;
+
+    /* restart the delay, so a burst of xkb activations
+     * applies the xmodmap file only once */
+    if (helper->xmodmap_timeout_id != 0)
+        g_source_remove (helper->xmodmap_timeout_id);
+
+    helper->xmodmap_timeout_id = g_timeout_add (XMODMAP_DELAY,
+        xfce_keyboard_layout_helper_xmodmap_timeout, helper);
 }
 
 #ifdef HAVE_LIBXKLAVIER
 
+static void
+xfce_keyboard_layout_helper_activate (XfceKeyboardLayoutHelper *helper)
+{
+    xkl_config_rec_activate (helper->config, helper->engine);
+
+    /* the new keymap replaced the xmodmap changes */
+    xfce_keyboard_layout_helper_queue_xmodmap (helper);
+}
+
 static void
 xfce_keyboard_layout_helper_set_model (XfceKeyboardLayoutHelper *helper)
 {
@@ -203,7 +891,7 @@ xfce_keyboard_layout_helper_set_model (XfceKeyboardLayoutHelper *helper)
         {
             g_free (helper->config->model);
             helper->config->model = xkbmodel;
-            xkl_config_rec_activate (helper->config, helper->engine);
+            xfce_keyboard_layout_helper_activate (helper);
 
             blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "set model to \"%s\"", xkbmodel);
         }
@@ -234,7 +922,7 @@ xfce_keyboard_layout_helper_set (XfceKeyboardLayoutHelper *helper,
             values = g_strsplit_set (xkl_values, ",", 0);
             g_strfreev (*xkl_config_option);
             *xkl_config_option = values;
-            xkl_config_rec_activate (helper->config, helper->engine);
+            xfce_keyboard_layout_helper_activate (helper);
 
             blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "set %s to \"%s\"", debug_name, xkl_values);
         }
@@ -341,7 +1029,7 @@ xfce_keyboard_layout_helper_set_option (XfceKeyboardLayoutHelper *helper,
 
             g_strfreev (helper->config->options);
             helper->config->options = g_strsplit (options_string, ",", 0);
-            xkl_config_rec_activate (helper->config, helper->engine);
+            xfce_keyboard_layout_helper_activate (helper);
 
             blsettings_dbg (XFSD_DEBUG_KEYBOARD_LAYOUT, "set %s to \"%s\"",
                             xkb_option_name, option_value);
@@ -402,8 +1090,6 @@ xfce_keyboard_layout_helper_channel_property_changed (BlconfChannel      *channe
     {
         xfce_keyboard_layout_helper_set_composekey (helper);
     }
-
-    xfce_keyboard_layout_helper_process_xmodmap ();
 }
 
 static GdkFilterReturn
@@ -458,7 +1144,8 @@ xfce_keyboard_layout_reset_xkl_config (XklEngine *xklengine,
         xfce_keyboard_layout_helper_set_grpkey (helper);
         xfce_keyboard_layout_helper_set_composekey (helper);
 
-        xfce_keyboard_layout_helper_process_xmodmap ();
+        /* the server loaded a fresh keymap for the device */
+        xfce_keyboard_layout_helper_queue_xmodmap (helper);
     }
 }
 #endif /* HAVE_LIBXKLAVIER */
@@ -41,6 +41,8 @@
 #include <libxfce4kbd-private/xfce-shortcuts-provider.h>
 #include <libxfce4kbd-private/xfce-shortcuts-grabber.h>
 
+#include <common/find-cursor.h>
+
 #include "debug.h"
 #include "keyboard-shortcuts.h"
 
@@ -196,6 +198,37 @@ xfce_keyboard_shortcuts_helper_load_shortcuts (XfceKeyboardShortcutsHelper *help
 
 
 
+static gboolean
+_xfce_keyboard_shortcuts_helper_find_cursor (gchar **argv)
+{
+  gchar         *basename;
+  gboolean       is_find_cursor;
+  BlconfChannel *channel;
+
+  /* Only the plain command, arguments are handled by the program */
+  if (argv[0] == NULL || argv[1] != NULL)
+    return FALSE;
+
+  basename = g_path_get_basename (argv[0]);
+  is_find_cursor = g_strcmp0 (basename, "xfce4-find-cursor") == 0;
+  g_free (basename);
+
+  if (!is_find_cursor)
+    return FALSE;
+
+  /* Like the program, don't do anything if the setting is disabled */
+  channel = blconf_channel_get ("accessibility");
+  if (blconf_channel_get_bool (channel, "/FindCursor", TRUE))
+    {
+      blsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "showing the cursor locator");
+      xfce_find_cursor_show (xfce_gdk_screen_get_active (NULL), NULL, NULL);
+    }
+
+  return TRUE;
+}
+
+
+
 static void
 xfce_keyboard_shortcuts_helper_shortcut_activated (XfceShortcutsGrabber        *grabber,
                                                    const gchar                 *shortcut,
@@ -230,7 +263,13 @@ xfce_keyboard_shortcuts_helper_shortcut_activated (XfceShortcutsGrabber        *
   /* Handle the argv ourselfs, because xfce_spawn_command_line_on_screen() does
    * not accept a custom timestamp for startup notification */
   succeed = g_shell_parse_argv (sc->command, NULL, &argv, &error);
-  if (G_LIKELY (succeed))
+  if (G_LIKELY (succeed)
+      && _xfce_keyboard_shortcuts_helper_find_cursor (argv))
+    {
+      /* Run the cursor locator in-process instead of spawning it */
+      g_strfreev (argv);
+    }
+  else if (G_LIKELY (succeed))
     {
       succeed = xfce_spawn_on_screen (xfce_gdk_screen_get_active (NULL),
                                       NULL, argv, NULL, G_SPAWN_SEARCH_PATH,
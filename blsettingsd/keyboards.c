@@ -196,6 +196,7 @@ xfce_keyboards_helper_set_repeat_rate (XfceKeyboardsHelper *helper)
 {
     XkbDescPtr xkb;
     gint       delay, rate;
+    gint64     begin;
 
     /* load settings */
     delay = blconf_channel_get_int (helper->channel, "/Default/KeyRepeat/Delay", 500);
@@ -208,7 +209,9 @@ xfce_keyboards_helper_set_repeat_rate (XfceKeyboardsHelper *helper)
     if (G_LIKELY (xkb))
     {
         /* load controls */
+        begin = blsettings_stats_begin ();
         XkbGetControls (GDK_DISPLAY (), XkbRepeatKeysMask, xkb);
+        blsettings_stats_end (XFSD_DEBUG_KEYBOARDS, "XkbGetControls", 1, begin);
 
         /* set new values */
         xkb->ctrls->repeat_delay = delay;
@@ -66,8 +66,58 @@
 #endif
 
 #define XFSETTINGS_DBUS_NAME    "org.blade.SettingsDaemon"
+#define XFSETTINGS_DBUS_PATH    "/org/blade/SettingsDaemon"
+#define XFSETTINGS_STATS_IFACE  XFSETTINGS_DBUS_NAME ".Stats"
 #define XFSETTINGS_DESKTOP_FILE (SYSCONFIGDIR "/xdg/autostart/blsettingsd.desktop")
 
+/* how long deferred helpers wait for a window manager */
+#define WM_POLL_INTERVAL        250
+#define WM_POLL_MAX             40
+
+/* time in ms between startup and the first XSETTINGS publish */
+#define XSETTINGS_PUBLISH_BUDGET 250
+
+
+
+/* a helper started from the main loop once the xsettings are published */
+typedef struct
+{
+    const gchar     *name;
+    XfsdDebugDomain  domain;
+
+    /* NULL for the clipboard manager, which needs to be started */
+    GType          (*get_type) (void);
+
+    /* priority of the idle source starting the helper */
+    gint             priority;
+
+    /* wait for the window manager before starting */
+    guint            needs_wm : 1;
+}
+StartupStage;
+
+/* in the order they are started, critical helpers first */
+static const StartupStage startup_stages[] =
+{
+#ifdef HAVE_XRANDR
+    { "displays", XFSD_DEBUG_DISPLAYS, xfce_displays_helper_get_type, G_PRIORITY_HIGH_IDLE, FALSE },
+#endif
+    { "pointers", XFSD_DEBUG_POINTERS, xfce_pointers_helper_get_type, G_PRIORITY_HIGH_IDLE, FALSE },
+    { "keyboards", XFSD_DEBUG_KEYBOARDS, xfce_keyboards_helper_get_type, G_PRIORITY_HIGH_IDLE, FALSE },
+    { "accessibility", XFSD_DEBUG_ACCESSIBILITY, xfce_accessibility_helper_get_type, G_PRIORITY_DEFAULT_IDLE, FALSE },
+    { "keyboard-shortcuts", XFSD_DEBUG_KEYBOARD_SHORTCUTS, xfce_keyboard_shortcuts_helper_get_type, G_PRIORITY_DEFAULT_IDLE, FALSE },
+    { "keyboard-layout", XFSD_DEBUG_KEYBOARD_LAYOUT, xfce_keyboard_layout_helper_get_type, G_PRIORITY_DEFAULT_IDLE, FALSE },
+    { "workspaces", XFSD_DEBUG_WORKSPACES, xfce_workspaces_helper_get_type, G_PRIORITY_LOW, TRUE },
+    { "gtk-decorations", XFSD_DEBUG_XSETTINGS, xfce_decorations_helper_get_type, G_PRIORITY_LOW, TRUE },
+    { "clipboard", XFSD_DEBUG_CLIPBOARD, NULL, G_PRIORITY_LOW, TRUE },
+};
+
+static GObject  *startup_helpers[G_N_ELEMENTS (startup_stages)];
+static guint     startup_next = 0;
+static guint     startup_source_id = 0;
+static guint     startup_wm_polls = 0;
+
+
 
 static XfceSMClient *sm_client = NULL;
 
@@ -94,6 +144,186 @@ signal_handler (gint signum,
 
 
 
+static gboolean
+startup_wm_running (void)
+{
+    Display *xdisplay = gdk_x11_get_default_xdisplay ();
+    gchar    selection[32];
+
+    /* window managers own the WM_Sn manager selection */
+    g_snprintf (selection, sizeof (selection), "WM_S%d",
+                gdk_screen_get_number (gdk_screen_get_default ()));
+
+    return XGetSelectionOwner (xdisplay, gdk_x11_get_xatom_by_name (selection)) != None;
+}
+
+
+
+static GObject *
+startup_clipboard (void)
+{
+    GObject *clipboard_daemon;
+
+    if (g_getenv ("XFSETTINGSD_NO_CLIPBOARD") != NULL)
+        return NULL;
+
+    clipboard_daemon = g_object_new (GSD_TYPE_CLIPBOARD_MANAGER, NULL);
+    if (!gsd_clipboard_manager_start (GSD_CLIPBOARD_MANAGER (clipboard_daemon), opt_replace))
+    {
+        g_object_unref (G_OBJECT (clipboard_daemon));
+        clipboard_daemon = NULL;
+
+        g_printerr (G_LOG_DOMAIN ": %s\n", "Another clipboard manager is already running.");
+    }
+
+    return clipboard_daemon;
+}
+
+
+
+static gboolean startup_run_stage (gpointer user_data);
+
+
+
+static void
+startup_schedule (void)
+{
+    if (startup_next < G_N_ELEMENTS (startup_stages))
+    {
+        startup_source_id = g_idle_add_full (startup_stages[startup_next].priority,
+                                             startup_run_stage, NULL, NULL);
+    }
+    else
+    {
+        startup_source_id = 0;
+        blsettings_dbg (XFSD_DEBUG_XSETTINGS, "All helpers started.");
+    }
+}
+
+
+
+static gboolean
+startup_run_stage (gpointer user_data)
+{
+    const StartupStage *stage = &startup_stages[startup_next];
+    gint64              begin;
+
+    if (stage->needs_wm
+        && startup_wm_polls < WM_POLL_MAX
+        && !startup_wm_running ())
+    {
+        /* check again later, the remaining helpers start anyway
+         * if no window manager shows up */
+        if (++startup_wm_polls == WM_POLL_MAX)
+            blsettings_dbg (XFSD_DEBUG_XSETTINGS, "No window manager found.");
+
+        startup_source_id = g_timeout_add (WM_POLL_INTERVAL, startup_run_stage, NULL);
+        return FALSE;
+    }
+
+    /* stop polling once the window manager has been seen */
+    if (stage->needs_wm)
+        startup_wm_polls = WM_POLL_MAX;
+
+    begin = blsettings_stats_begin ();
+
+    if (stage->get_type != NULL)
+        startup_helpers[startup_next] = g_object_new (stage->get_type (), NULL);
+    else
+        startup_helpers[startup_next] = startup_clipboard ();
+
+    blsettings_stats_end (stage->domain, "startup", 0, begin);
+    blsettings_dbg (XFSD_DEBUG_XSETTINGS, "Started the %s helper in %.3f ms.",
+                    stage->name, (blsettings_stats_begin () - begin) / 1000.0);
+
+    startup_next++;
+    startup_schedule ();
+
+    return FALSE;
+}
+
+
+
+static void
+stats_signal_handler (gint     signum,
+                      gpointer user_data)
+{
+    /* print the round trip counters of the helpers */
+    blsettings_stats_dump ();
+}
+
+
+
+static void
+dbus_stats_append (const XfsdStats *stats,
+                   gpointer         user_data)
+{
+    DBusMessageIter *array = user_data;
+    DBusMessageIter  entry;
+    dbus_uint32_t    calls = stats->calls;
+    dbus_uint32_t    round_trips = stats->round_trips;
+    dbus_int64_t     total_time = stats->total_time;
+    dbus_int64_t     max_time = stats->max_time;
+
+    dbus_message_iter_open_container (array, DBUS_TYPE_STRUCT, NULL, &entry);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &stats->helper);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &stats->operation);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT32, &calls);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT32, &round_trips);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_INT64, &total_time);
+    dbus_message_iter_append_basic (&entry, DBUS_TYPE_INT64, &max_time);
+    dbus_message_iter_close_container (array, &entry);
+}
+
+
+
+static DBusHandlerResult
+dbus_stats_message_func (DBusConnection *connection,
+                         DBusMessage    *message,
+                         void           *user_data)
+{
+    DBusMessage     *reply;
+    DBusMessageIter  iter, array;
+
+    if (dbus_message_is_method_call (message, XFSETTINGS_STATS_IFACE, "GetStats"))
+    {
+        /* array of (helper, operation, calls, round trips,
+         * total time, max time), times in microseconds */
+        reply = dbus_message_new_method_return (message);
+        dbus_message_iter_init_append (reply, &iter);
+        dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "(ssuuxx)", &array);
+        blsettings_stats_foreach (dbus_stats_append, &array);
+        dbus_message_iter_close_container (&iter, &array);
+    }
+    else if (dbus_message_is_method_call (message, XFSETTINGS_STATS_IFACE, "ResetStats"))
+    {
+        blsettings_stats_reset ();
+        reply = dbus_message_new_method_return (message);
+    }
+    else
+    {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    if (G_LIKELY (reply != NULL))
+    {
+        dbus_connection_send (connection, reply, NULL);
+        dbus_message_unref (reply);
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+
+
+static const DBusObjectPathVTable dbus_stats_vtable =
+{
+    NULL,
+    dbus_stats_message_func
+};
+
+
+
 static DBusHandlerResult
 dbus_connection_filter_func (DBusConnection *connection,
                              DBusMessage    *message,
@@ -171,23 +401,17 @@ main (gint argc, gchar **argv)
 {
     GError               *error = NULL;
     GOptionContext       *context;
-    GObject              *pointer_helper;
-    GObject              *keyboards_helper;
-    GObject              *accessibility_helper;
-    GObject              *shortcuts_helper;
-    GObject              *keyboard_layout_helper;
-    GObject              *gtk_decorations_helper;
     GObject              *xsettings_helper;
-    GObject              *clipboard_daemon = NULL;
-#ifdef HAVE_XRANDR
-    GObject              *displays_helper;
-#endif
-    GObject              *workspaces_helper;
     guint                 i;
     const gint            signums[] = { SIGQUIT, SIGTERM };
     DBusConnection       *dbus_connection;
     gint                  result;
     guint                 dbus_flags;
+    gint64                begin;
+    gdouble               published;
+
+    /* measure the time until the xsettings are published */
+    begin = blsettings_stats_begin ();
 
     xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
 
@@ -279,6 +503,11 @@ main (gint argc, gchar **argv)
             "type='signal',interface='"DBUS_INTERFACE_DBUS"',member='NameLost',arg0='"XFSETTINGS_DBUS_NAME"'",
             NULL);
         dbus_connection_add_filter (dbus_connection, dbus_connection_filter_func, NULL, NULL);
+
+        /* expose the round trip counters of the helpers */
+        if (!dbus_connection_register_object_path (dbus_connection, XFSETTINGS_DBUS_PATH,
+                                                   &dbus_stats_vtable, NULL))
+            g_warning ("Failed to register the statistics object.");
     }
     else
     {
@@ -294,6 +523,22 @@ main (gint argc, gchar **argv)
         return EXIT_FAILURE;
     }
 
+    /* publish the xsettings first, gtk clients started by the session
+     * block on them */
+    xsettings_helper = g_object_new (XFCE_TYPE_XSETTINGS_HELPER, NULL);
+    xfce_xsettings_helper_register (XFCE_XSETTINGS_HELPER (xsettings_helper),
+                                    gdk_display_get_default (), opt_replace);
+
+    /* the startup stages of the helpers are recorded as "startup",
+     * keep the publish time apart from the decorations stage */
+    blsettings_stats_end (XFSD_DEBUG_XSETTINGS, "publish", 0, begin);
+    published = (blsettings_stats_begin () - begin) / 1000.0;
+    blsettings_dbg (XFSD_DEBUG_XSETTINGS, "XSETTINGS published %.3f ms after startup.", published);
+
+    if (G_UNLIKELY (published > XSETTINGS_PUBLISH_BUDGET))
+        g_warning ("XSETTINGS were published %.3f ms after startup, the budget is %d ms.",
+                   published, XSETTINGS_PUBLISH_BUDGET);
+
     /* connect to session always, even if we quit below.  this way the
      * session manager won't wait for us to time out. */
     sm_client = xfce_sm_client_get ();
@@ -307,40 +552,17 @@ main (gint argc, gchar **argv)
         g_clear_error (&error);
     }
 
-    /* launch settings manager */
-    xsettings_helper = g_object_new (XFCE_TYPE_XSETTINGS_HELPER, NULL);
-    xfce_xsettings_helper_register (XFCE_XSETTINGS_HELPER (xsettings_helper),
-                                    gdk_display_get_default (), opt_replace);
-
-    /* create the sub daemons */
-#ifdef HAVE_XRANDR
-    displays_helper = g_object_new (XFCE_TYPE_DISPLAYS_HELPER, NULL);
-#endif
-    pointer_helper = g_object_new (XFCE_TYPE_POINTERS_HELPER, NULL);
-    keyboards_helper = g_object_new (XFCE_TYPE_KEYBOARDS_HELPER, NULL);
-    accessibility_helper = g_object_new (XFCE_TYPE_ACCESSIBILITY_HELPER, NULL);
-    shortcuts_helper = g_object_new (XFCE_TYPE_KEYBOARD_SHORTCUTS_HELPER, NULL);
-    keyboard_layout_helper = g_object_new (XFCE_TYPE_KEYBOARD_LAYOUT_HELPER, NULL);
-    workspaces_helper = g_object_new (XFCE_TYPE_WORKSPACES_HELPER, NULL);
-    gtk_decorations_helper = g_object_new (XFCE_TYPE_DECORATIONS_HELPER, NULL);
-
-    if (g_getenv ("XFSETTINGSD_NO_CLIPBOARD") == NULL)
-    {
-        clipboard_daemon = g_object_new (GSD_TYPE_CLIPBOARD_MANAGER, NULL);
-        if (!gsd_clipboard_manager_start (GSD_CLIPBOARD_MANAGER (clipboard_daemon), opt_replace))
-        {
-            g_object_unref (G_OBJECT (clipboard_daemon));
-            clipboard_daemon = NULL;
-
-            g_printerr (G_LOG_DOMAIN ": %s\n", "Another clipboard manager is already running.");
-        }
-    }
+    /* start the sub daemons from the main loop */
+    startup_schedule ();
 
     /* setup signal handlers to properly quit the main loop */
     if (xfce_posix_signal_handler_init (NULL))
     {
         for (i = 0; i < G_N_ELEMENTS (signums); i++)
             xfce_posix_signal_handler_set_handler (signums[i], signal_handler, NULL, NULL);
+
+        /* dump the statistics on request */
+        xfce_posix_signal_handler_set_handler (SIGUSR1, stats_signal_handler, NULL, NULL);
     }
 
     gtk_main();
@@ -348,28 +570,26 @@ main (gint argc, gchar **argv)
     /* release the dbus name */
     if (dbus_connection != NULL)
     {
+        dbus_connection_unregister_object_path (dbus_connection, XFSETTINGS_DBUS_PATH);
         dbus_connection_remove_filter (dbus_connection, dbus_connection_filter_func, NULL);
         dbus_bus_release_name (dbus_connection, XFSETTINGS_DBUS_NAME, NULL);
         dbus_connection_unref (dbus_connection);
     }
 
+    /* abort the helpers that were not started yet */
+    if (startup_source_id != 0)
+        g_source_remove (startup_source_id);
+
     /* release the sub daemons */
     g_object_unref (G_OBJECT (xsettings_helper));
-#ifdef HAVE_XRANDR
-    g_object_unref (G_OBJECT (displays_helper));
-#endif
-    g_object_unref (G_OBJECT (pointer_helper));
-    g_object_unref (G_OBJECT (keyboards_helper));
-    g_object_unref (G_OBJECT (accessibility_helper));
-    g_object_unref (G_OBJECT (shortcuts_helper));
-    g_object_unref (G_OBJECT (keyboard_layout_helper));
-    g_object_unref (G_OBJECT (workspaces_helper));
-    g_object_unref (G_OBJECT (gtk_decorations_helper));
-
-    if (G_LIKELY (clipboard_daemon != NULL))
+    for (i = 0; i < startup_next; i++)
     {
-        gsd_clipboard_manager_stop (GSD_CLIPBOARD_MANAGER (clipboard_daemon));
-        g_object_unref (G_OBJECT (clipboard_daemon));
+        if (startup_helpers[i] == NULL)
+            continue;
+
+        if (startup_stages[i].get_type == NULL)
+            gsd_clipboard_manager_stop (GSD_CLIPBOARD_MANAGER (startup_helpers[i]));
+        g_object_unref (startup_helpers[i]);
     }
 
     blconf_shutdown ();
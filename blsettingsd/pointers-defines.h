@@ -45,6 +45,13 @@
 #  define DEVICE_PROPERTIES
 #endif
 
+/* test if XI2 property events are available */
+#undef DEVICE_XI2
+#if defined (HAVE_X11_EXTENSIONS_XINPUT2_H) && defined (DEVICE_PROPERTIES)
+#  include <X11/extensions/XInput2.h>
+#  define DEVICE_XI2
+#endif
+
 #ifndef IsXExtensionPointer
 #define IsXExtensionPointer 4
 #endif
@@ -41,20 +41,13 @@
 #include <libbladeutil/libbladeutil.h>
 #include <locale.h>
 
-#include <dbus/dbus-glib.h>
+#include <common/pointers-properties.h>
 
 #include "debug.h"
 #include "pointers.h"
 #include "pointers-defines.h"
 
 #define MAX_DENOMINATOR (100.00)
-#define BLCONF_TYPE_G_VALUE_ARRAY (dbus_g_type_get_collection ("GPtrArray", G_TYPE_VALUE))
-
-#ifdef XI_PROP_ENABLED
-#define DEVICE_ENABLED XI_PROP_ENABLED
-#else
-#define DEVICE_ENABLED "Device Enabled"
-#endif /* XI_PROP_ENABLED */
 
 static void             xfce_pointers_helper_finalize                 (GObject            *object);
 static void             xfce_pointers_helper_syndaemon_stop           (XfcePointersHelper *helper);
@@ -71,6 +64,11 @@ static GdkFilterReturn  xfce_pointers_helper_event_filter             (GdkXEvent
                                                                        gpointer            user_data);
 #endif
 #if defined(DEVICE_PROPERTIES) || defined(HAVE_LIBINPUT)
+static void             xfce_pointers_helper_change_properties        (XDeviceInfo        *device_info,
+                                                                       XDevice            *device,
+                                                                       Display            *xdisplay,
+                                                                       const XfcePointersWrite *writes,
+                                                                       guint               n_writes);
 static void             xfce_pointers_helper_change_property          (XDeviceInfo        *device_info,
                                                                        XDevice            *device,
                                                                        Display            *xdisplay,
@@ -102,17 +100,6 @@ struct _XfcePointersHelper
 #endif
 };
 
-typedef struct
-{
-    Display     *xdisplay;
-    XDevice     *device;
-    XDeviceInfo *device_info;
-    gsize        prop_name_len;
-}
-XfcePointerData;
-
-
-
 G_DEFINE_TYPE (XfcePointersHelper, xfce_pointers_helper, G_TYPE_OBJECT);
 
 
@@ -205,56 +192,22 @@ xfce_pointers_helper_finalize (GObject *object)
 
 
 #ifdef HAVE_LIBINPUT
-static gboolean
-xfce_pointers_is_enabled (Display *xdisplay,
-                          XDevice *device)
-{
-    Atom     prop, type;
-    gulong   n_items, bytes_after;
-    gint     rc, format;
-    guchar  *data;
-    gboolean enabled;
-
-    prop = XInternAtom (xdisplay, DEVICE_ENABLED, False);
-    gdk_error_trap_push ();
-    rc = XGetDeviceProperty (xdisplay, device, prop, 0, 1, False,
-                             XA_INTEGER, &type, &format, &n_items,
-                             &bytes_after, &data);
-    gdk_error_trap_pop ();
-    if (rc == Success)
-    {
-        enabled = (gboolean) *data;
-        XFree (data);
-        return (enabled);
-    }
-
-    return FALSE;
-}
-
-
-
 static gboolean
 xfce_pointers_is_libinput (Display *xdisplay,
                            XDevice *device)
 {
-    Atom     prop, type;
-    gulong   n_items, bytes_after;
-    gint     rc, format;
-    guchar  *data;
+    XfcePointersRead read;
+    guint            n_found;
+
+    read.property = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_LIBINPUT_LEFT_HANDED);
 
-    prop = XInternAtom (xdisplay, LIBINPUT_PROP_LEFT_HANDED, False);
     gdk_error_trap_push ();
-    rc = XGetDeviceProperty (xdisplay, device, prop, 0, 1, False,
-                             XA_INTEGER, &type, &format, &n_items,
-                             &bytes_after, &data);
+    n_found = xfce_pointers_properties_read (xdisplay, device, &read, 1);
     gdk_error_trap_pop ();
-    if (rc == Success)
-    {
-        XFree (data);
-        return (n_items > 0);
-    }
 
-    return FALSE;
+    xfce_pointers_properties_free (&read, 1);
+
+    return (n_found > 0);
 }
 #endif /* HAVE_LIBINPUT */
 
@@ -305,8 +258,8 @@ xfce_pointers_helper_syndaemon_check (XfcePointersHelper *helper)
     if (gdk_error_trap_pop () != 0 || device_list == NULL)
         goto start_stop_daemon;
 
-    touchpad_type = XInternAtom (xdisplay, XI_TOUCHPAD, True);
-    touchpad_off_prop = XInternAtom (xdisplay, "Synaptics Off", True);
+    touchpad_type = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_TOUCHPAD);
+    touchpad_off_prop = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_SYNAPTICS_OFF);
 
     for (n = 0; n < ndevices; n++)
     {
@@ -429,28 +382,33 @@ xfce_pointers_helper_change_button_mapping (XDeviceInfo *device_info,
 #ifdef HAVE_LIBINPUT
     if (xfce_pointers_is_libinput (xdisplay, device))
     {
+        GValue            left_handed = G_VALUE_INIT;
+        GValue            natural_scroll = G_VALUE_INIT;
+        XfcePointersWrite writes[2];
+        guint             n_writes = 0;
+
         if (right_handed != -1)
         {
-            GValue value = G_VALUE_INIT;
-
-            g_value_init (&value, G_TYPE_INT);
-            g_value_set_int (&value, !right_handed);
+            g_value_init (&left_handed, G_TYPE_INT);
+            g_value_set_int (&left_handed, !right_handed);
 
-            xfce_pointers_helper_change_property (device_info, device, xdisplay,
-                                                  LIBINPUT_PROP_LEFT_HANDED, &value);
+            writes[n_writes].name = LIBINPUT_PROP_LEFT_HANDED;
+            writes[n_writes++].value = &left_handed;
         }
 
         if (reverse_scrolling != -1)
         {
-            GValue value = G_VALUE_INIT;
+            g_value_init (&natural_scroll, G_TYPE_INT);
+            g_value_set_int (&natural_scroll, reverse_scrolling);
 
-            g_value_init (&value, G_TYPE_INT);
-            g_value_set_int (&value, reverse_scrolling);
-
-            xfce_pointers_helper_change_property (device_info, device, xdisplay,
-                                                  LIBINPUT_PROP_NATURAL_SCROLL, &value);
+            writes[n_writes].name = LIBINPUT_PROP_NATURAL_SCROLL;
+            writes[n_writes++].value = &natural_scroll;
         }
 
+        /* both in one batch */
+        xfce_pointers_helper_change_properties (device_info, device, xdisplay,
+                                                writes, n_writes);
+
         return;
     }
 #endif /* HAVE_LIBINPUT */
@@ -700,41 +658,41 @@ xfce_pointers_helper_change_mode (XDeviceInfo  *device_info,
 
 
 
-static gchar *
-xfce_pointers_helper_device_blconf_name (const gchar *name)
+#if defined(DEVICE_PROPERTIES) || defined(HAVE_LIBINPUT)
+static void
+xfce_pointers_helper_change_properties (XDeviceInfo             *device_info,
+                                        XDevice                 *device,
+                                        Display                 *xdisplay,
+                                        const XfcePointersWrite *writes,
+                                        guint                    n_writes)
 {
-    GString     *string;
-    const gchar *p;
-
-    /* NOTE: this function exists in both the dialog and
-     *       helper code and they have to identical! */
+    guint  n_written;
+    gint64 begin;
 
-    /* allocate a string */
-    string = g_string_sized_new (strlen (name));
+    if (n_writes == 0)
+        return;
 
-    /* create a name with only valid chars */
-    for (p = name; *p != '\0'; p++)
+    /* the changes are not synced by the library, so one trap
+     * and round trip covers the whole batch */
+    begin = blsettings_stats_begin ();
+    gdk_error_trap_push ();
+    n_written = xfce_pointers_properties_write (xdisplay, device, writes, n_writes);
+    XSync (xdisplay, FALSE);
+    blsettings_stats_end (XFSD_DEBUG_POINTERS, "XSync", 1, begin);
+    if (gdk_error_trap_pop ())
     {
-        if ((*p >= 'A' && *p <= 'Z')
-            || (*p >= 'a' && *p <= 'z')
-            || (*p >= '0' && *p <= '9')
-            || *p == '_' || *p == '-')
-        {
-            g_string_append_c (string, *p);
-        }
-        else if (*p == ' ')
-        {
-            string = g_string_append_c (string, '_');
-        }
+        g_critical ("Failed to set device properties for %s",
+                    device_info->name);
+        return;
     }
 
-    /* return the new string */
-    return g_string_free (string, FALSE);
+    blsettings_dbg (XFSD_DEBUG_POINTERS,
+                    "[%s] Changed %d of %d device properties",
+                    device_info->name, n_written, n_writes);
 }
 
 
 
-#if defined(DEVICE_PROPERTIES) || defined(HAVE_LIBINPUT)
 static void
 xfce_pointers_helper_change_property (XDeviceInfo  *device_info,
                                       XDevice      *device,
@@ -742,187 +700,16 @@ xfce_pointers_helper_change_property (XDeviceInfo  *device_info,
                                       const gchar  *prop_name,
                                       const GValue *value)
 {
-    Atom         *props;
-    gint          n, n_props;
-    Atom          prop;
-    gchar        *atom_name;
-    Atom          type;
-    gint          format;
-    gulong        n_items, bytes_after, i;
-    gulong        n_succeeds;
-    Atom          float_atom;
-    GPtrArray    *array = NULL;
-    int           rc;
-    const GValue *val;
-    union {
-        guchar *c;
-        gshort *s;
-        glong  *l;
-        float  *f;
-        Atom   *a;
-    } data;
-
-    /* assuming the device property never contained underscores... */
-    atom_name = g_strdup (prop_name);
-    g_strdelimit (atom_name, "_", ' ');
-    prop = XInternAtom (xdisplay, atom_name, True);
-    g_free (atom_name);
-
-    /* because of the True in XInternAtom we quit here if the property
-     * does not exists on any of the devices */
-    if (prop == None)
-        return;
+    XfcePointersWrite write;
 
-#ifdef HAVE_LIBINPUT
-    /*
-     * libinput cannot change properties on disabled devices
-     * see: https://bugs.freedesktop.org/show_bug.cgi?id=89296
-     * and: http://lists.x.org/archives/xorg-devel/2015-February/045716.html
-     */
-    if (prop != XInternAtom (xdisplay, DEVICE_ENABLED, True) &&
-        !xfce_pointers_is_enabled (xdisplay, device))
-        return;
-#endif /* HAVE_LIBINPUT */
+    write.name = prop_name;
+    write.value = value;
 
-    gdk_error_trap_push ();
-    props = XListDeviceProperties (xdisplay, device, &n_props);
-    if (gdk_error_trap_pop () || props == NULL)
-        return;
-
-    float_atom = XInternAtom (xdisplay, "FLOAT", False);
-
-    for (n = 0; n < n_props; n++)
-    {
-        /* find the matching property */
-        if (props[n] != prop)
-            continue;
-
-        gdk_error_trap_push ();
-        rc = XGetDeviceProperty (xdisplay, device, prop, 0, 1000, False,
-                                 AnyPropertyType, &type, &format,
-                                 &n_items, &bytes_after, &data.c);
-        if (!gdk_error_trap_pop () && rc == Success)
-        {
-            if (n_items == 1
-                && (G_VALUE_HOLDS_INT (value)
-                    || G_VALUE_HOLDS_STRING (value)
-                    || G_VALUE_HOLDS_DOUBLE (value)))
-            {
-                /* only 1 items to set */
-                val = value;
-            }
-            else if (G_VALUE_TYPE (value) == BLCONF_TYPE_G_VALUE_ARRAY)
-            {
-                array = g_value_get_boxed (value);
-                if (array->len != n_items)
-                {
-                    g_critical ("Nr device property items (%ld) and blconf value (%d) differ",
-                                n_items, array->len);
-                    break;
-                }
-            }
-            else
-            {
-                g_critical ("Invalid device property combination");
-                break;
-            }
-
-            /* reset check counter */
-            n_succeeds = 0;
-
-            for (i = 0; i < n_items; i++)
-            {
-                /* get value from pointer array */
-                if (array != NULL)
-                    val = g_ptr_array_index (array, i);
-                else
-                    val = value;
-
-                if (G_VALUE_HOLDS_INT (val)
-                    && type == XA_INTEGER)
-                {
-                    if (format == 8)
-                        data.c[i] = g_value_get_int (val);
-                    else if (format == 16)
-                        data.s[i] = g_value_get_int (val);
-                    else if (format == 32)
-                        data.l[i] = g_value_get_int (val);
-                    else
-                    {
-                        g_critical ("Unknown format %d for integer", format);
-                        break;
-                    }
-                }
-                else if (G_VALUE_HOLDS_STRING (val)
-                         && type == XA_ATOM
-                         && format == 32)
-                {
-                    /* set atom (reference to a string) */
-                    data.a[i] = XInternAtom (xdisplay, g_value_get_string (val), False);
-                }
-                else if (G_VALUE_HOLDS_DOUBLE (val) /* blconf doesn't support floats */
-                         && type == float_atom
-                         && format == 32)
-                {
-                    data.f[i] = (float) g_value_get_double (val);
-                }
-                else
-                {
-                    g_critical ("Unknown property type %s: target = %s, format = %d",
-                                G_VALUE_TYPE_NAME (val), XGetAtomName (xdisplay, type), format);
-                    break;
-                }
-
-                /* the item was successfully updated */
-                n_succeeds++;
-            }
-
-            if (n_succeeds == n_items)
-            {
-                gdk_error_trap_push ();
-                XChangeDeviceProperty (xdisplay, device, prop, type, format,
-                                       PropModeReplace, data.c, n_items);
-                XSync (xdisplay, FALSE);
-                if (gdk_error_trap_pop ())
-                {
-                    g_critical ("Failed to set device property %s for %s",
-                                prop_name, device_info->name);
-                }
-
-                blsettings_dbg (XFSD_DEBUG_POINTERS,
-                                "[%s] Changed device property %s",
-                                device_info->name, prop_name);
-            }
-        }
-
-        if (data.c)
-            XFree (data.c);
-
-        break;
-    }
-
-    XFree (props);
+    xfce_pointers_helper_change_properties (device_info, device, xdisplay, &write, 1);
 }
 #endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
 
 
-#ifdef DEVICE_PROPERTIES
-static void
-xfce_pointers_helper_change_properties (gpointer key,
-                                        gpointer value,
-                                        gpointer user_data)
-{
-    XfcePointerData *pointer_data = user_data;
-    const gchar     *prop_name = ((gchar *) key) + pointer_data->prop_name_len;
-
-    xfce_pointers_helper_change_property (pointer_data->device_info,
-                                          pointer_data->device,
-                                          pointer_data->xdisplay,
-                                          prop_name, value);
-}
-#endif
-
-
 
 static void
 xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
@@ -939,8 +726,12 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
     gint             threshold;
     gdouble          acceleration;
 #ifdef DEVICE_PROPERTIES
-    GHashTable      *props;
-    XfcePointerData  pointer_data;
+    GHashTable        *props;
+    GHashTableIter     iter;
+    gpointer           key, value;
+    XfcePointersWrite *writes;
+    guint              n_writes;
+    gsize              prop_name_len;
 #endif
     const gchar     *mode;
 
@@ -974,7 +765,7 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
         }
 
         /* create a valid blconf property name for the device */
-        device_name = xfce_pointers_helper_device_blconf_name (device_info->name);
+        device_name = xfce_pointers_device_blconf_name (device_info->name);
 
         /* read buttonmap properties */
         g_snprintf (prop, sizeof (prop), "/%s/RightHanded", device_name);
@@ -1016,13 +807,23 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
 
         if (props != NULL)
         {
-            pointer_data.xdisplay = xdisplay;
-            pointer_data.device = device;
-            pointer_data.device_info = device_info;
-            pointer_data.prop_name_len = strlen (prop) + 1;
+            prop_name_len = strlen (prop) + 1;
+
+            /* collect the properties, they are written in one batch */
+            writes = g_new (XfcePointersWrite, g_hash_table_size (props));
+            n_writes = 0;
+
+            g_hash_table_iter_init (&iter, props);
+            while (g_hash_table_iter_next (&iter, &key, &value))
+            {
+                writes[n_writes].name = ((gchar *) key) + prop_name_len;
+                writes[n_writes++].value = value;
+            }
 
-            g_hash_table_foreach (props, xfce_pointers_helper_change_properties, &pointer_data);
+            xfce_pointers_helper_change_properties (device_info, device, xdisplay,
+                                                    writes, n_writes);
 
+            g_free (writes);
             g_hash_table_destroy (props);
         }
 #endif
@@ -1082,7 +883,7 @@ xfce_pointers_helper_channel_property_changed (BlconfChannel      *channel,
                 continue;
 
             /* search the device name */
-            device_name = xfce_pointers_helper_device_blconf_name (device_info->name);
+            device_name = xfce_pointers_device_blconf_name (device_info->name);
             if (strcmp (names[0], device_name) == 0)
             {
                 /* open the device */
@@ -39,6 +39,9 @@
 #include <X11/Xlib.h>
 #include <X11/Xmd.h>
 #include <X11/Xatom.h>
+#ifdef HAVE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
 
 #include <glib.h>
 #include <gtk/gtk.h>
@@ -61,23 +64,43 @@
 #define DPI_FALLBACK        96
 #define DPI_LOW_REASONABLE  50
 #define DPI_HIGH_REASONABLE 500
+#define DPI_HIDPI_LIMIT     (2 * DPI_FALLBACK)
+#define HIDPI_MIN_HEIGHT    1200
+
+#define OUTPUT_PREFIX      "/Blade/Outputs/"
 
-#define FC_TIMEOUT_SEC 2 /* timeout before xsettings notify */
-#define FC_PROPERTY    "/Fontconfig/Timestamp"
+#define FC_TIMEOUT_SEC     2  /* timeout before xsettings notify */
+#define FC_TIMEOUT_MAX_SEC 16 /* longest timeout during bulk changes */
+#define FC_PROPERTY        "/Fontconfig/Timestamp"
+
+/* check for randr 1.3 or better */
+#ifdef HAVE_XRANDR
+#if RANDR_MAJOR > 1 || (RANDR_MAJOR == 1 && RANDR_MINOR >= 3)
+#define HAS_RANDR_ONE_POINT_THREE
+#else
+#undef HAS_RANDR_ONE_POINT_THREE
+#endif
+#endif
 
 
 
 typedef struct _XfceXSettingsScreen XfceXSettingsScreen;
 typedef struct _XfceXSetting        XfceXSetting;
 typedef struct _XfceXSettingsNotify XfceXSettingsNotify;
+#ifdef HAVE_XRANDR
+typedef struct _XfceXSettingsOutput XfceXSettingsOutput;
+#endif
 
 
 
 static void     xfce_xsettings_helper_finalize     (GObject             *object);
 static void     xfce_xsettings_helper_fc_free      (XfceXSettingsHelper *helper);
 static gboolean xfce_xsettings_helper_fc_init      (gpointer             data);
+static gboolean xfce_xsettings_helper_fc_notify    (gpointer             data);
 static gboolean xfce_xsettings_helper_notify_idle  (gpointer             data);
 static void     xfce_xsettings_helper_setting_free (gpointer             data);
+static void     xfce_xsettings_helper_setting_encode (const gchar       *name,
+                                                      XfceXSetting      *setting);
 static void     xfce_xsettings_helper_prop_changed (BlconfChannel       *channel,
                                                     const gchar         *prop_name,
                                                     const GValue        *value,
@@ -86,6 +109,7 @@ static void     xfce_xsettings_helper_load         (XfceXSettingsHelper *helper)
 static void     xfce_xsettings_helper_screen_free  (XfceXSettingsScreen *screen);
 static void     xfce_xsettings_helper_notify_xft   (XfceXSettingsHelper *helper);
 static void     xfce_xsettings_helper_notify       (XfceXSettingsHelper *helper);
+static void     xfce_xsettings_helper_notify_free  (XfceXSettingsNotify *notify);
 
 
 
@@ -116,16 +140,41 @@ struct _XfceXSettingsHelper
     /* atom for xsetting property changes */
     Atom           xsettings_atom;
 
-    /* fontconfig monitoring */
-    GPtrArray     *fc_monitors;
+    /* fontconfig monitoring, GFileMonitors by directory */
+    GHashTable    *fc_monitors;
     guint          fc_notify_timeout_id;
     guint          fc_init_id;
+
+    /* current timeout and changes since it was started */
+    guint          fc_timeout_sec;
+    guint          fc_changes;
+
+    /* last notification, without the settings of the screens */
+    XfceXSettingsNotify *notify;
+
+#ifdef HAVE_XRANDR
+    /* randr events for the per-output settings */
+    guint          has_randr : 1;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    guint          has_1_3 : 1;
+#endif
+    gint           randr_event_base;
+    guint          outputs_idle_id;
+#endif
 };
 
 struct _XfceXSetting
 {
     GValue *value;
     gulong  last_change_serial;
+
+    /* the setting record in its wire form, copied
+     * into the buffer on each notification */
+    guchar *record;
+    gsize   record_len;
+
+    /* the value is replaced by the dpi of each screen */
+    guint   screen_dpi : 1;
 };
 
 struct _XfceXSettingsNotify
@@ -138,11 +187,40 @@ struct _XfceXSettingsNotify
 
 struct _XfceXSettingsScreen
 {
-    Display *xdisplay;
-    Window   window;
-    Atom     selection_atom;
-    gint     screen_num;
+    Display             *xdisplay;
+    Window               window;
+    Atom                 selection_atom;
+    gint                 screen_num;
+
+    /* cached dpi for Xft/DPI */
+    gint                 dpi;
+
+    /* the buffer last set on the window */
+    XfceXSettingsNotify *notify;
+
+#ifdef HAVE_XRANDR
+    /* active XfceXSettingsOutput, sorted by name */
+    GPtrArray           *outputs;
+#endif
+};
+
+#ifdef HAVE_XRANDR
+struct _XfceXSettingsOutput
+{
+    RROutput  id;
+
+    /* output name, usable in a setting name */
+    gchar    *name;
+
+    gint      dpi;
+    gint      scale;
+    gulong    last_change_serial;
+
+    /* offset of the values in the buffer of the screen */
+    gsize     dpi_offset;
+    gsize     scale_offset;
 };
+#endif
 
 
 
@@ -193,6 +271,11 @@ xfce_xsettings_helper_finalize (GObject *object)
     if (helper->notify_xft_idle_id != 0)
         g_source_remove (helper->notify_xft_idle_id);
 
+#ifdef HAVE_XRANDR
+    if (helper->outputs_idle_id != 0)
+        g_source_remove (helper->outputs_idle_id);
+#endif
+
     g_object_unref (G_OBJECT (helper->channel));
 
     /* remove screens */
@@ -202,11 +285,184 @@ xfce_xsettings_helper_finalize (GObject *object)
 
     g_hash_table_destroy (helper->settings);
 
+    xfce_xsettings_helper_notify_free (helper->notify);
+
     (*G_OBJECT_CLASS (xfce_xsettings_helper_parent_class)->finalize) (object);
 }
 
 
 
+static void
+xfce_xsettings_helper_fc_collect_link (GHashTable  *paths,
+                                       const gchar *path)
+{
+    gchar *target;
+    gchar *link;
+    gchar *dir;
+    guint  n;
+
+    /* conf.d usually holds symlinks into conf.avail, the files are
+     * edited there, so also watch the directories of the targets */
+    target = g_strdup (path);
+    for (n = 0; n < 8 && g_file_test (target, G_FILE_TEST_IS_SYMLINK); n++)
+    {
+        link = g_file_read_link (target, NULL);
+        if (G_UNLIKELY (link == NULL))
+            break;
+
+        if (!g_path_is_absolute (link))
+        {
+            dir = g_path_get_dirname (target);
+            g_free (target);
+            target = g_build_filename (dir, link, NULL);
+            g_free (dir);
+            g_free (link);
+        }
+        else
+        {
+            g_free (target);
+            target = link;
+        }
+
+        dir = g_path_get_dirname (target);
+        g_hash_table_replace (paths, dir, dir);
+    }
+    g_free (target);
+}
+
+
+
+static void
+xfce_xsettings_helper_fc_collect (GHashTable *paths,
+                                  FcStrList  *files,
+                                  gboolean    config_files)
+{
+    const gchar *path;
+    gchar       *dir;
+
+    if (G_UNLIKELY (files == NULL))
+        return;
+
+    for (;;)
+    {
+        path = (const gchar *) FcStrListNext (files);
+        if (G_UNLIKELY (path == NULL))
+            break;
+
+        /* watch the directory of config files, so a conf.d
+         * directory with many files needs only one monitor */
+        if (config_files && !g_file_test (path, G_FILE_TEST_IS_DIR))
+            dir = g_path_get_dirname (path);
+        else
+            dir = g_strdup (path);
+
+        g_hash_table_replace (paths, dir, dir);
+
+        if (config_files)
+            xfce_xsettings_helper_fc_collect_link (paths, path);
+    }
+
+    FcStrListDone (files);
+}
+
+
+
+static void
+xfce_xsettings_helper_fc_changed (GFileMonitor        *monitor,
+                                  GFile               *file,
+                                  GFile               *other_file,
+                                  GFileMonitorEvent    event_type,
+                                  XfceXSettingsHelper *helper)
+{
+    gchar    *basename;
+    gboolean  hidden;
+
+    /* only changes in the directory contents matter */
+    if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED
+        || event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+        || event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT
+        || event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+        return;
+
+    /* ignore hidden files, like the .uuid files of fc-cache */
+    basename = g_file_get_basename (file);
+    hidden = basename != NULL && *basename == '.';
+    g_free (basename);
+    if (hidden)
+        return;
+
+    if (helper->fc_notify_timeout_id == 0)
+    {
+        helper->fc_changes = 0;
+        helper->fc_timeout_sec = FC_TIMEOUT_SEC;
+        helper->fc_notify_timeout_id = g_timeout_add_seconds (helper->fc_timeout_sec,
+            xfce_xsettings_helper_fc_notify, helper);
+    }
+    else
+    {
+        /* the timeout is extended when it fires, this avoids
+         * rescheduling on every file of a bulk install */
+        helper->fc_changes++;
+    }
+}
+
+
+
+static void
+xfce_xsettings_helper_fc_monitor (XfceXSettingsHelper *helper)
+{
+    GHashTable     *paths;
+    GHashTableIter  iter;
+    gpointer        path;
+    GFile          *file;
+    GFileMonitor   *monitor;
+
+    paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    xfce_xsettings_helper_fc_collect (paths, FcConfigGetConfigFiles (NULL), TRUE);
+    xfce_xsettings_helper_fc_collect (paths, FcConfigGetFontDirs (NULL), FALSE);
+
+    /* remove the monitors of directories fontconfig no longer uses */
+    g_hash_table_iter_init (&iter, helper->fc_monitors);
+    while (g_hash_table_iter_next (&iter, &path, NULL))
+    {
+        if (g_hash_table_lookup (paths, path) == NULL)
+        {
+            blsettings_dbg_filtered (XFSD_DEBUG_FONTCONFIG, "stop monitoring \"%s\"",
+                                     (const gchar *) path);
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    /* add monitors for the new directories */
+    g_hash_table_iter_init (&iter, paths);
+    while (g_hash_table_iter_next (&iter, &path, NULL))
+    {
+        if (g_hash_table_lookup (helper->fc_monitors, path) != NULL)
+            continue;
+
+        file = g_file_new_for_path (path);
+        monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+        g_object_unref (G_OBJECT (file));
+
+        if (G_LIKELY (monitor != NULL))
+        {
+            g_hash_table_insert (helper->fc_monitors, g_strdup (path), monitor);
+            g_signal_connect (G_OBJECT (monitor), "changed",
+                G_CALLBACK (xfce_xsettings_helper_fc_changed), helper);
+
+            blsettings_dbg_filtered (XFSD_DEBUG_FONTCONFIG, "monitoring \"%s\"",
+                                     (const gchar *) path);
+        }
+    }
+
+    g_hash_table_destroy (paths);
+
+    blsettings_dbg (XFSD_DEBUG_FONTCONFIG, "monitoring %d directories",
+                    g_hash_table_size (helper->fc_monitors));
+}
+
+
+
 static gboolean
 xfce_xsettings_helper_fc_notify (gpointer data)
 {
@@ -215,12 +471,22 @@ xfce_xsettings_helper_fc_notify (gpointer data)
 
     helper->fc_notify_timeout_id = 0;
 
-    /* check if the font config setup changed */
-    if (!FcConfigUptoDate (NULL) && FcInitReinitialize ())
+    if (helper->fc_changes > 0)
     {
-        /* stop the monitors */
-        xfce_xsettings_helper_fc_free (helper);
+        /* still changing, probably a bulk install; wait longer so
+         * it results in a single reinitialization */
+        helper->fc_changes = 0;
+        helper->fc_timeout_sec = MIN (helper->fc_timeout_sec * 2, FC_TIMEOUT_MAX_SEC);
+        helper->fc_notify_timeout_id = g_timeout_add_seconds (helper->fc_timeout_sec,
+            xfce_xsettings_helper_fc_notify, helper);
+
+        return FALSE;
+    }
 
+    /* check the directory and config timestamps against the
+     * fontconfig configuration before rescanning all fonts */
+    if (!FcConfigUptoDate (NULL) && FcInitReinitialize ())
+    {
         setting = g_hash_table_lookup (helper->settings, FC_PROPERTY);
         if (setting == NULL)
         {
@@ -234,6 +500,7 @@ xfce_xsettings_helper_fc_notify (gpointer data)
         /* update setting */
         setting->last_change_serial = helper->serial;
         g_value_set_int (setting->value, time (NULL));
+        xfce_xsettings_helper_setting_encode (FC_PROPERTY, setting);
 
         blsettings_dbg (XFSD_DEBUG_FONTCONFIG, "timestamp updated (time=%d)",
                         g_value_get_int (setting->value));
@@ -242,8 +509,9 @@ xfce_xsettings_helper_fc_notify (gpointer data)
         if (helper->notify_idle_id == 0)
             helper->notify_idle_id = g_idle_add (xfce_xsettings_helper_notify_idle, helper);
 
-        /* restart monitoring */
-        helper->fc_init_id = g_idle_add (xfce_xsettings_helper_fc_init, helper);
+        /* follow added or removed font directories */
+        if (helper->fc_monitors != NULL)
+            xfce_xsettings_helper_fc_monitor (helper);
     }
 
     return FALSE;
@@ -251,19 +519,6 @@ xfce_xsettings_helper_fc_notify (gpointer data)
 
 
 
-static void
-xfce_xsettings_helper_fc_changed (XfceXSettingsHelper *helper)
-{
-    /* reschedule monitor */
-    if (helper->fc_notify_timeout_id != 0)
-        g_source_remove (helper->fc_notify_timeout_id);
-
-    helper->fc_notify_timeout_id = g_timeout_add_seconds (FC_TIMEOUT_SEC,
-        xfce_xsettings_helper_fc_notify, helper);
-}
-
-
-
 static void
 xfce_xsettings_helper_fc_free (XfceXSettingsHelper *helper)
 {
@@ -284,51 +539,13 @@ xfce_xsettings_helper_fc_free (XfceXSettingsHelper *helper)
     if (helper->fc_monitors != NULL)
     {
         /* remove monitors */
-        g_ptr_array_foreach (helper->fc_monitors, (GFunc) (void (*)(void)) g_object_unref, NULL);
-        g_ptr_array_free (helper->fc_monitors, TRUE);
+        g_hash_table_destroy (helper->fc_monitors);
         helper->fc_monitors = NULL;
     }
 }
 
 
 
-static void
-xfce_xsettings_helper_fc_monitor (XfceXSettingsHelper *helper,
-                                  FcStrList           *files)
-{
-    const gchar  *path;
-    GFile        *file;
-    GFileMonitor *monitor;
-
-    if (G_UNLIKELY (files == NULL))
-        return;
-
-    for (;;)
-    {
-        path = (const gchar *) FcStrListNext (files);
-        if (G_UNLIKELY (path == NULL))
-            break;
-
-        file = g_file_new_for_path (path);
-        monitor = g_file_monitor (file, G_FILE_MONITOR_NONE, NULL, NULL);
-        g_object_unref (G_OBJECT (file));
-
-        if (G_LIKELY (monitor != NULL))
-        {
-            g_ptr_array_add (helper->fc_monitors, monitor);
-            g_signal_connect_swapped (G_OBJECT (monitor), "changed",
-                G_CALLBACK (xfce_xsettings_helper_fc_changed), helper);
-
-            blsettings_dbg_filtered (XFSD_DEBUG_FONTCONFIG, "monitoring \"%s\"",
-                                     path);
-        }
-    }
-
-    FcStrListDone (files);
-}
-
-
-
 static gboolean
 xfce_xsettings_helper_fc_init (gpointer data)
 {
@@ -340,14 +557,11 @@ xfce_xsettings_helper_fc_init (gpointer data)
 
     if (FcInit ())
     {
-        helper->fc_monitors = g_ptr_array_new ();
-
-        /* start monitoring config files and font directories */
-        xfce_xsettings_helper_fc_monitor (helper, FcConfigGetConfigFiles (NULL));
-        xfce_xsettings_helper_fc_monitor (helper, FcConfigGetFontDirs (NULL));
+        helper->fc_monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                     g_object_unref);
 
-        blsettings_dbg (XFSD_DEBUG_FONTCONFIG, "monitoring %d paths",
-                        helper->fc_monitors->len);
+        /* start monitoring config and font directories */
+        xfce_xsettings_helper_fc_monitor (helper);
     }
 
     return FALSE;
@@ -387,6 +601,38 @@ xfce_xsettings_helper_notify_xft_idle (gpointer data)
 
 
 
+static gboolean
+xfce_xsettings_helper_prop_color (const GValue *value,
+                                  guint16      *color)
+{
+    GPtrArray    *array;
+    const GValue *val;
+    guint         i;
+
+    /* colors are stored as an array of four uint16 values
+     * for red, green, blue and alpha */
+    if (G_VALUE_TYPE (value) != BLCONF_TYPE_G_VALUE_ARRAY)
+        return FALSE;
+
+    array = g_value_get_boxed (value);
+    if (array == NULL || array->len != 4)
+        return FALSE;
+
+    for (i = 0; i < array->len; i++)
+    {
+        val = g_ptr_array_index (array, i);
+        if (G_VALUE_TYPE (val) != BLCONF_TYPE_UINT16)
+            return FALSE;
+
+        if (color != NULL)
+            color[i] = blconf_g_value_get_uint16 (val);
+    }
+
+    return TRUE;
+}
+
+
+
 static gboolean
 xfce_xsettings_helper_prop_valid (const gchar  *prop_name,
                                   const GValue *value)
@@ -400,7 +646,8 @@ xfce_xsettings_helper_prop_valid (const gchar  *prop_name,
     /* notify if the property has an unsupported type */
     if (!G_VALUE_HOLDS_BOOLEAN (value)
         && !G_VALUE_HOLDS_INT (value)
-        && !G_VALUE_HOLDS_STRING (value))
+        && !G_VALUE_HOLDS_STRING (value)
+        && !xfce_xsettings_helper_prop_color (value, NULL))
     {
         g_warning ("Property \"%s\" has an unsupported type \"%s\".",
                    prop_name, G_VALUE_TYPE_NAME (value));
@@ -427,6 +674,7 @@ xfce_xsettings_helper_prop_load (gchar               *prop_name,
     setting = g_slice_new0 (XfceXSetting);
     setting->value = value;
     setting->last_change_serial = helper->serial;
+    xfce_xsettings_helper_setting_encode (prop_name, setting);
 
     blsettings_dbg_filtered (XFSD_DEBUG_XSETTINGS, "prop \"%s\" loaded (type=%s)",
                              prop_name, G_VALUE_TYPE_NAME (value));
@@ -455,7 +703,16 @@ xfce_xsettings_helper_prop_changed (BlconfChannel       *channel,
     if (G_LIKELY (value != NULL))
     {
         setting = g_hash_table_lookup (helper->settings, prop_name);
-        if (G_LIKELY (setting != NULL))
+        if (!xfce_xsettings_helper_prop_valid (prop_name, value))
+        {
+            /* leave, so not notification is scheduled, unless
+             * the value of a color array became invalid */
+            if (G_LIKELY (setting == NULL))
+                return;
+
+            g_hash_table_remove (helper->settings, prop_name);
+        }
+        else if (G_LIKELY (setting != NULL))
         {
             /* update the value, assuming the types match because
              * you cannot changes types in blconf without removing
@@ -465,8 +722,9 @@ xfce_xsettings_helper_prop_changed (BlconfChannel       *channel,
 
             /* update the serial */
             setting->last_change_serial = helper->serial;
+            xfce_xsettings_helper_setting_encode (prop_name, setting);
         }
-        else if (xfce_xsettings_helper_prop_valid (prop_name, value))
+        else
         {
             /* insert a new setting */
             setting = g_slice_new0 (XfceXSetting);
@@ -475,14 +733,10 @@ xfce_xsettings_helper_prop_changed (BlconfChannel       *channel,
 
             g_value_init (setting->value, G_VALUE_TYPE (value));
             g_value_copy (value, setting->value);
+            xfce_xsettings_helper_setting_encode (prop_name, setting);
 
             g_hash_table_insert (helper->settings, g_strdup (prop_name), setting);
         }
-        else
-        {
-           /* leave, so not notification is scheduled */
-           return;
-        }
     }
     else
     {
@@ -534,39 +788,54 @@ xfce_xsettings_helper_setting_free (gpointer data)
 
     g_value_unset (setting->value);
     g_free (setting->value);
+    g_free (setting->record);
     g_slice_free (XfceXSetting, setting);
 }
 
 
 
+static gint
+xfce_xsettings_helper_calc_dpi (gint width,
+                                gint width_mm,
+                                gint height,
+                                gint height_mm)
+{
+    gint width_dpi;
+    gint height_dpi;
+
+    if (G_LIKELY (width_mm > 0 && height_mm > 0))
+    {
+        width_dpi = 25.4 * width / width_mm;
+        height_dpi = 25.4 * height / height_mm;
+
+        /* both values need to be reasonable */
+        if (width_dpi > DPI_LOW_REASONABLE && width_dpi < DPI_HIGH_REASONABLE
+            && height_dpi > DPI_LOW_REASONABLE && height_dpi < DPI_HIGH_REASONABLE)
+        {
+            /* gnome takes the average between the two, however the
+             * minimin seems to result in sharper font in more cases */
+            return MIN (width_dpi, height_dpi);
+        }
+    }
+
+    return DPI_FALLBACK;
+}
+
+
+
 static gint
 xfce_xsettings_helper_screen_dpi (XfceXSettingsScreen *screen)
 {
     Screen *xscreen;
-    gint    width_mm, width_dpi;
-    gint    height_mm, height_dpi;
     gint    dpi = DPI_FALLBACK;
 
     xscreen = ScreenOfDisplay (screen->xdisplay, screen->screen_num);
     if (G_LIKELY (xscreen != NULL))
     {
-        width_mm = WidthMMOfScreen (xscreen);
-        height_mm = HeightMMOfScreen (xscreen);
-
-        if (G_LIKELY (width_mm > 0 && height_mm > 0))
-        {
-            width_dpi = 25.4 * WidthOfScreen (xscreen) / width_mm;
-            height_dpi = 25.4 * HeightOfScreen (xscreen) / height_mm;
-
-            /* both values need to be reasonable */
-            if (width_dpi > DPI_LOW_REASONABLE && width_dpi < DPI_HIGH_REASONABLE
-                && height_dpi > DPI_LOW_REASONABLE && height_dpi < DPI_HIGH_REASONABLE)
-            {
-                /* gnome takes the average between the two, however the
-                 * minimin seems to result in sharper font in more cases */
-                dpi = MIN (width_dpi, height_dpi);
-            }
-        }
+        dpi = xfce_xsettings_helper_calc_dpi (WidthOfScreen (xscreen),
+                                              WidthMMOfScreen (xscreen),
+                                              HeightOfScreen (xscreen),
+                                              HeightMMOfScreen (xscreen));
     }
 
     blsettings_dbg_filtered (XFSD_DEBUG_XSETTINGS, "calculated dpi of %d for screen %d",
@@ -715,18 +984,38 @@ xfce_xsettings_helper_notify_xft (XfceXSettingsHelper *helper)
 
 
 
+/**
+ * Read a color body the way the GTK xsettings client does, this is
+ * used to check the encoder against the order the clients expect.
+ **/
 static void
-xfce_xsettings_helper_setting_append (const gchar         *name,
-                                      XfceXSetting        *setting,
-                                      XfceXSettingsNotify *notify)
+xfce_xsettings_helper_setting_decode_color (const guchar *body,
+                                            guint16       color[4])
 {
-    gsize        buf_len, new_len;
+    /* red, green, blue, alpha */
+    color[0] = *(const CARD16 *)body;
+    color[1] = *(const CARD16 *)(body + 2);
+    color[2] = *(const CARD16 *)(body + 4);
+    color[3] = *(const CARD16 *)(body + 6);
+}
+
+
+
+static void
+xfce_xsettings_helper_setting_encode (const gchar  *name,
+                                      XfceXSetting *setting)
+{
+    gsize        buf_len;
     gsize        name_len, name_len_pad;
     gsize        value_len, value_len_pad;
     const gchar *str = NULL;
     guchar      *needle;
     guchar       type = 0;
     gint         num;
+    guint16      color[4];
+    guint16      decoded[4];
+
+    setting->screen_dpi = FALSE;
 
     name_len = strlen (name) - 1 /* -1 for the blconf slash */;
     name_len_pad = XSETTINGS_PAD (name_len, 4);
@@ -755,25 +1044,21 @@ xfce_xsettings_helper_setting_append (const gchar         *name,
             }
             break;
 
-        case G_TYPE_INT64 /* TODO */:
+        default:
+            /* a valid setting can only be a color here */
+            if (!xfce_xsettings_helper_prop_color (setting->value, color))
+                g_assert_not_reached ();
+
             type = XSettingsTypeColor;
             buf_len += 8;
             break;
-
-        default:
-            g_assert_not_reached ();
-            break;
     }
 
-    /* additional length for this setting */
-    new_len = notify->buf_len + buf_len;
-
-    /* resize the buffer to fit this setting */
-    notify->buf = g_renew (guchar, notify->buf, new_len);
-    if (G_UNLIKELY (notify->buf == NULL))
-      return;
-    needle = notify->buf + notify->buf_len;
-    notify->buf_len = new_len;
+    /* allocate the record */
+    g_free (setting->record);
+    setting->record = g_new (guchar, buf_len);
+    setting->record_len = buf_len;
+    needle = setting->record;
 
     /* setting record:
      *
@@ -851,11 +1136,11 @@ xfce_xsettings_helper_setting_append (const gchar         *name,
                 /* special case handling for DPI */
                 if (strcmp (name, "/Xft/DPI") == 0)
                 {
-                    /* remember the offset for screen dependend dpi
-                     * or clamp the value and set 1/1024ths of an inch
-                     * for Xft */
+                    /* the value is set for each screen if the dpi is
+                     * automatic, else clamp the value and set 1/1024ths
+                     * of an inch for Xft */
                     if (num < 1)
-                        notify->dpi_offset = needle - notify->buf;
+                        setting->screen_dpi = TRUE;
                     else
                         num = CLAMP (num, DPI_LOW_REASONABLE, DPI_HIGH_REASONABLE) * 1024;
                 }
@@ -869,19 +1154,26 @@ xfce_xsettings_helper_setting_append (const gchar         *name,
             needle += 4;
             break;
 
-        /* TODO */
         case XSettingsTypeColor:
             /* body for XSettingsTypeColor:
             *
             * 2  CARD16  red
-            * 2  CARD16  blue
             * 2  CARD16  green
+            * 2  CARD16  blue
             * 2  CARD16  alpha
+            *
+            * the specification lists blue before green, but GTK and
+            * gnome-settings-daemon read and write red, green, blue
             */
-            *(CARD16 *)needle = 0;
-            *(CARD16 *)(needle + 2) = 0;
-            *(CARD16 *)(needle + 4) = 0;
-            *(CARD16 *)(needle + 6) = 0;
+            *(CARD16 *)needle = color[0];
+            *(CARD16 *)(needle + 2) = color[1];
+            *(CARD16 *)(needle + 4) = color[2];
+            *(CARD16 *)(needle + 6) = color[3];
+
+            /* the record must decode to the same channels in the client */
+            xfce_xsettings_helper_setting_decode_color (needle, decoded);
+            g_assert (memcmp (color, decoded, sizeof (color)) == 0);
+
             needle += 8;
             break;
 
@@ -890,11 +1182,406 @@ xfce_xsettings_helper_setting_append (const gchar         *name,
             break;
     }
 
+    g_assert (needle == setting->record + setting->record_len);
+}
+
+
+
+static void
+xfce_xsettings_helper_setting_append (const gchar         *name,
+                                      XfceXSetting        *setting,
+                                      XfceXSettingsNotify *notify)
+{
+    if (G_UNLIKELY (setting->record == NULL))
+        xfce_xsettings_helper_setting_encode (name, setting);
+
+    /* resize the buffer to fit this setting */
+    notify->buf = g_renew (guchar, notify->buf, notify->buf_len + setting->record_len);
+    if (G_UNLIKELY (notify->buf == NULL))
+      return;
+
+    /* remember the offset for screen dependend dpi */
+    if (setting->screen_dpi)
+        notify->dpi_offset = notify->buf_len + setting->record_len - 4;
+
+    memcpy (notify->buf + notify->buf_len, setting->record, setting->record_len);
+    notify->buf_len += setting->record_len;
+
     notify->n_settings++;
 }
 
 
 
+static void
+xfce_xsettings_helper_notify_free (XfceXSettingsNotify *notify)
+{
+    if (notify != NULL)
+    {
+        g_free (notify->buf);
+        g_slice_free (XfceXSettingsNotify, notify);
+    }
+}
+
+
+
+#ifdef HAVE_XRANDR
+static void
+xfce_xsettings_helper_output_free (gpointer data)
+{
+    XfceXSettingsOutput *output = data;
+
+    g_free (output->name);
+    g_slice_free (XfceXSettingsOutput, output);
+}
+
+
+
+static gint
+xfce_xsettings_helper_output_compare (gconstpointer a,
+                                      gconstpointer b)
+{
+    const XfceXSettingsOutput *output_a = *(XfceXSettingsOutput **) a;
+    const XfceXSettingsOutput *output_b = *(XfceXSettingsOutput **) b;
+
+    return strcmp (output_a->name, output_b->name);
+}
+
+
+
+static GPtrArray *
+xfce_xsettings_helper_screen_outputs (XfceXSettingsHelper *helper,
+                                      XfceXSettingsScreen *screen,
+                                      gint                *primary_dpi)
+{
+    XRRScreenResources  *resources;
+    XRROutputInfo       *output_info;
+    XRRCrtcInfo         *crtc_info;
+    XfceXSettingsOutput *output;
+    GPtrArray           *outputs;
+    Window               root_window;
+    RROutput             primary = None;
+    gint                 width_mm, height_mm;
+    gint                 n;
+    gchar               *p;
+    guint                round_trips = 1;
+    gint64               begin;
+
+    outputs = g_ptr_array_new_with_free_func (xfce_xsettings_helper_output_free);
+    *primary_dpi = -1;
+
+    root_window = RootWindow (screen->xdisplay, screen->screen_num);
+
+    begin = blsettings_stats_begin ();
+    gdk_error_trap_push ();
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    /* the displays helper already probed the outputs */
+    if (helper->has_1_3)
+    {
+        resources = XRRGetScreenResourcesCurrent (screen->xdisplay, root_window);
+        primary = XRRGetOutputPrimary (screen->xdisplay, root_window);
+        round_trips++;
+    }
+    else
+#endif
+    resources = XRRGetScreenResources (screen->xdisplay, root_window);
+
+    for (n = 0; resources != NULL && n < resources->noutput; n++)
+    {
+        output_info = XRRGetOutputInfo (screen->xdisplay, resources, resources->outputs[n]);
+        round_trips++;
+        if (output_info == NULL)
+            continue;
+
+        if (output_info->connection == RR_Connected && output_info->crtc != None)
+        {
+            crtc_info = XRRGetCrtcInfo (screen->xdisplay, resources, output_info->crtc);
+            round_trips++;
+            if (crtc_info != NULL)
+            {
+                /* the physical size is not rotated with the crtc */
+                if ((crtc_info->rotation & (RR_Rotate_90 | RR_Rotate_270)) != 0)
+                {
+                    width_mm = output_info->mm_height;
+                    height_mm = output_info->mm_width;
+                }
+                else
+                {
+                    width_mm = output_info->mm_width;
+                    height_mm = output_info->mm_height;
+                }
+
+                output = g_slice_new0 (XfceXSettingsOutput);
+                output->id = resources->outputs[n];
+                output->dpi = xfce_xsettings_helper_calc_dpi (crtc_info->width, width_mm,
+                                                              crtc_info->height, height_mm);
+
+                /* only suggest scaling if there is enough room left for
+                 * applications at the doubled size */
+                if (output->dpi >= DPI_HIDPI_LIMIT
+                    && MIN (crtc_info->width, crtc_info->height) >= HIDPI_MIN_HEIGHT)
+                    output->scale = 2;
+                else
+                    output->scale = 1;
+
+                /* setting names only allow letters, digits and underscores */
+                output->name = g_strdup (output_info->name);
+                for (p = output->name; *p != '\0'; p++)
+                    if (!g_ascii_isalnum (*p))
+                        *p = '_';
+
+                /* use the primary output, or else the first one, for Xft/DPI */
+                if (*primary_dpi == -1 || output->id == primary)
+                    *primary_dpi = output->dpi;
+
+                blsettings_dbg_filtered (XFSD_DEBUG_XSETTINGS, "output %s: dpi %d, scale %d",
+                                         output->name, output->dpi, output->scale);
+
+                g_ptr_array_add (outputs, output);
+
+                XRRFreeCrtcInfo (crtc_info);
+            }
+        }
+
+        XRRFreeOutputInfo (output_info);
+    }
+
+    if (resources != NULL)
+        XRRFreeScreenResources (resources);
+
+    gdk_flush ();
+    if (gdk_error_trap_pop () != 0)
+        g_warning ("Failed to get the outputs of screen %d", screen->screen_num);
+    blsettings_stats_end (XFSD_DEBUG_XSETTINGS, "outputs", round_trips, begin);
+
+    g_ptr_array_sort (outputs, xfce_xsettings_helper_output_compare);
+
+    return outputs;
+}
+
+
+
+static void
+xfce_xsettings_helper_output_append (const gchar         *name,
+                                     const gchar         *suffix,
+                                     gint                 num,
+                                     gulong               serial,
+                                     XfceXSettingsNotify *notify)
+{
+    XfceXSetting  setting = { NULL, };
+    GValue        value = { 0, };
+    gchar        *setting_name;
+
+    g_value_init (&value, G_TYPE_INT);
+    g_value_set_int (&value, num);
+
+    setting.value = &value;
+    setting.last_change_serial = serial;
+
+    setting_name = g_strconcat (OUTPUT_PREFIX, name, suffix, NULL);
+    xfce_xsettings_helper_setting_append (setting_name, &setting, notify);
+    g_free (setting_name);
+
+    g_free (setting.record);
+    g_value_unset (&value);
+}
+
+
+
+static void
+xfce_xsettings_helper_output_patch (XfceXSettingsNotify *notify,
+                                    gsize                offset,
+                                    gint                 num,
+                                    gulong               serial)
+{
+    /* the last change serial precedes the value in the record */
+    *(CARD32 *)(notify->buf + offset - 4) = serial;
+    *(INT32 *)(notify->buf + offset) = num;
+}
+#endif
+
+
+
+static void
+xfce_xsettings_helper_screen_compose (XfceXSettingsHelper *helper,
+                                      XfceXSettingsScreen *screen)
+{
+    XfceXSettingsNotify *notify;
+#ifdef HAVE_XRANDR
+    XfceXSettingsOutput *output;
+    guint                i;
+#endif
+
+    /* start with the settings shared by all screens */
+    notify = g_slice_new0 (XfceXSettingsNotify);
+    notify->buf = g_memdup (helper->notify->buf, helper->notify->buf_len);
+    notify->buf_len = helper->notify->buf_len;
+    notify->n_settings = helper->notify->n_settings;
+    notify->dpi_offset = helper->notify->dpi_offset;
+
+#ifdef HAVE_XRANDR
+    /* append the settings of the outputs and remember their
+     * offsets, so they can be updated in place */
+    for (i = 0; screen->outputs != NULL && i < screen->outputs->len; i++)
+    {
+        output = g_ptr_array_index (screen->outputs, i);
+
+        xfce_xsettings_helper_output_append (output->name, "/DPI", output->dpi,
+                                             output->last_change_serial, notify);
+        output->dpi_offset = notify->buf_len - 4;
+
+        xfce_xsettings_helper_output_append (output->name, "/WindowScale", output->scale,
+                                             output->last_change_serial, notify);
+        output->scale_offset = notify->buf_len - 4;
+    }
+
+    /* number of settings */
+    *(CARD32 *)(notify->buf + 8) = notify->n_settings;
+#endif
+
+    /* set the accurate dpi for this screen */
+    if (notify->dpi_offset > 0)
+        *(INT32 *)(notify->buf + notify->dpi_offset) = screen->dpi * 1024;
+
+    xfce_xsettings_helper_notify_free (screen->notify);
+    screen->notify = notify;
+}
+
+
+
+static void
+xfce_xsettings_helper_screen_update (XfceXSettingsHelper *helper,
+                                     XfceXSettingsScreen *screen)
+{
+    gint                 dpi = -1;
+    gboolean             changed = FALSE;
+#ifdef HAVE_XRANDR
+    GPtrArray           *outputs = NULL;
+    XfceXSettingsOutput *output, *old;
+    gboolean             relayout = FALSE;
+    guint                i;
+
+    if (helper->has_randr)
+    {
+        outputs = xfce_xsettings_helper_screen_outputs (helper, screen, &dpi);
+
+        /* the records can only be updated in place if the same
+         * outputs are active */
+        relayout = screen->outputs == NULL || screen->outputs->len != outputs->len;
+        for (i = 0; !relayout && i < outputs->len; i++)
+        {
+            output = g_ptr_array_index (outputs, i);
+            old = g_ptr_array_index (screen->outputs, i);
+            relayout = strcmp (output->name, old->name) != 0;
+        }
+    }
+#endif
+
+    /* fall back to the size of the whole screen */
+    if (dpi < 1)
+        dpi = xfce_xsettings_helper_screen_dpi (screen);
+
+#ifdef HAVE_XRANDR
+    if (relayout)
+    {
+        for (i = 0; i < outputs->len; i++)
+        {
+            output = g_ptr_array_index (outputs, i);
+            output->last_change_serial = helper->serial;
+        }
+
+        if (screen->outputs != NULL)
+            g_ptr_array_unref (screen->outputs);
+        screen->outputs = outputs;
+        screen->dpi = dpi;
+
+        /* a hot-plug changes the buffer size, rebuild the records */
+        if (screen->notify != NULL)
+        {
+            xfce_xsettings_helper_screen_compose (helper, screen);
+            changed = TRUE;
+        }
+    }
+    else if (outputs != NULL)
+    {
+        for (i = 0; i < outputs->len; i++)
+        {
+            output = g_ptr_array_index (outputs, i);
+            old = g_ptr_array_index (screen->outputs, i);
+
+            if (output->dpi == old->dpi && output->scale == old->scale)
+                continue;
+
+            old->id = output->id;
+            old->dpi = output->dpi;
+            old->scale = output->scale;
+            old->last_change_serial = helper->serial;
+
+            if (screen->notify != NULL)
+            {
+                xfce_xsettings_helper_output_patch (screen->notify, old->dpi_offset,
+                                                    old->dpi, old->last_change_serial);
+                xfce_xsettings_helper_output_patch (screen->notify, old->scale_offset,
+                                                    old->scale, old->last_change_serial);
+                changed = TRUE;
+            }
+        }
+
+        g_ptr_array_unref (outputs);
+    }
+#endif
+
+    if (screen->dpi != dpi)
+    {
+        screen->dpi = dpi;
+
+        if (screen->notify != NULL && screen->notify->dpi_offset > 0)
+        {
+            *(INT32 *)(screen->notify->buf + screen->notify->dpi_offset) = dpi * 1024;
+            changed = TRUE;
+        }
+    }
+
+    if (changed)
+    {
+        /* serial for this notification */
+        *(CARD32 *)(screen->notify->buf + 4) = helper->serial++;
+
+        XChangeProperty (screen->xdisplay, screen->window,
+                         helper->xsettings_atom, helper->xsettings_atom,
+                         8, PropModeReplace, screen->notify->buf, screen->notify->buf_len);
+
+        blsettings_dbg (XFSD_DEBUG_XSETTINGS,
+                        "outputs of screen %d changed (serial=%lu, len=%"G_GSIZE_FORMAT")",
+                        screen->screen_num, helper->serial - 1, screen->notify->buf_len);
+    }
+}
+
+
+
+#ifdef HAVE_XRANDR
+static gboolean
+xfce_xsettings_helper_outputs_idle (gpointer data)
+{
+    XfceXSettingsHelper *helper = XFCE_XSETTINGS_HELPER (data);
+    GSList              *li;
+
+    helper->outputs_idle_id = 0;
+
+    gdk_error_trap_push ();
+
+    for (li = helper->screens; li != NULL; li = li->next)
+        xfce_xsettings_helper_screen_update (helper, li->data);
+
+    if (gdk_error_trap_pop () != 0)
+        g_critical ("Failed to update the output settings");
+
+    return FALSE;
+}
+#endif
+
+
+
 static void
 xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
 {
@@ -903,7 +1590,6 @@ xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
     guchar              *needle;
     XfceXSettingsScreen *screen;
     GSList              *li;
-    gint                 dpi;
 
     g_return_if_fail (XFCE_IS_XSETTINGS_HELPER (helper));
 
@@ -940,6 +1626,11 @@ xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
     needle = notify->buf + 8;
     *(CARD32 *)needle = notify->n_settings;
 
+    /* keep the buffer, the screens append their own settings
+     * and it is reused when only the outputs change */
+    xfce_xsettings_helper_notify_free (helper->notify);
+    helper->notify = notify;
+
     gdk_error_trap_push ();
 
     /* set new xsettings buffer to the screens */
@@ -947,17 +1638,11 @@ xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
     {
         screen = li->data;
 
-        /* set the accurate dpi for this screen */
-        if (notify->dpi_offset > 0)
-        {
-            dpi = xfce_xsettings_helper_screen_dpi (screen);
-            needle = notify->buf + notify->dpi_offset;
-            *(INT32 *)needle = dpi * 1024;
-        }
+        xfce_xsettings_helper_screen_compose (helper, screen);
 
         XChangeProperty (screen->xdisplay, screen->window,
                          helper->xsettings_atom, helper->xsettings_atom,
-                         8, PropModeReplace, notify->buf, notify->buf_len);
+                         8, PropModeReplace, screen->notify->buf, screen->notify->buf_len);
     }
 
     if (gdk_error_trap_pop () != 0)
@@ -969,7 +1654,8 @@ xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
                     "%d settings changed (serial=%lu, len=%"G_GSIZE_FORMAT")",
                     notify->n_settings, helper->serial - 1, notify->buf_len);
 
-    g_free (notify->buf);
+    return;
+
   errnomem:
     g_slice_free (XfceXSettingsNotify, notify);
 }
@@ -980,6 +1666,11 @@ static void
 xfce_xsettings_helper_screen_free (XfceXSettingsScreen *screen)
 {
     XDestroyWindow (screen->xdisplay, screen->window);
+    xfce_xsettings_helper_notify_free (screen->notify);
+#ifdef HAVE_XRANDR
+    if (screen->outputs != NULL)
+        g_ptr_array_unref (screen->outputs);
+#endif
     g_slice_free (XfceXSettingsScreen, screen);
 }
 
@@ -995,6 +1686,19 @@ xfce_xsettings_helper_event_filter (GdkXEvent *gdkxevent,
     XfceXSettingsScreen *screen;
     XEvent              *xevent = gdkxevent;
 
+#ifdef HAVE_XRANDR
+    /* the outputs changed, update the settings once for all
+     * the events of a hot-plug */
+    if (helper->has_randr
+        && xevent->type - helper->randr_event_base == RRScreenChangeNotify)
+    {
+        if (helper->outputs_idle_id == 0)
+            helper->outputs_idle_id = g_idle_add (xfce_xsettings_helper_outputs_idle, helper);
+
+        return GDK_FILTER_CONTINUE;
+    }
+#endif
+
     /* check if another settings manager took over the selection
      * of one of the windows */
     if (xevent->xany.type == SelectionClear)
@@ -1077,6 +1781,10 @@ xfce_xsettings_helper_register (XfceXSettingsHelper *helper,
     Time                 timestamp;
     XClientMessageEvent  xev;
     gboolean             succeed;
+#ifdef HAVE_XRANDR
+    gint                 error_base;
+    gint                 major = 0, minor = 0;
+#endif
 
     g_return_val_if_fail (GDK_IS_DISPLAY (gdkdisplay), FALSE);
     g_return_val_if_fail (XFCE_IS_XSETTINGS_HELPER (helper), FALSE);
@@ -1087,6 +1795,19 @@ xfce_xsettings_helper_register (XfceXSettingsHelper *helper,
 
     gdk_error_trap_push ();
 
+#ifdef HAVE_XRANDR
+    /* randr 1.2 is needed for the per-output settings */
+    if (XRRQueryExtension (xdisplay, &helper->randr_event_base, &error_base)
+        && XRRQueryVersion (xdisplay, &major, &minor)
+        && (major > 1 || (major == 1 && minor >= 2)))
+    {
+        helper->has_randr = TRUE;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+        helper->has_1_3 = (major > 1 || minor >= 3);
+#endif
+    }
+#endif
+
     n_screens = gdk_display_get_n_screens (gdkdisplay);
     for (n = 0; n < n_screens; n++)
     {
@@ -1154,6 +1875,15 @@ xfce_xsettings_helper_register (XfceXSettingsHelper *helper,
             screen->xdisplay = xdisplay;
             screen->screen_num = n;
 
+#ifdef HAVE_XRANDR
+            /* watch for output changes */
+            if (helper->has_randr)
+                XRRSelectInput (xdisplay, root_window, RRScreenChangeNotifyMask);
+#endif
+
+            /* get the dpi and outputs, the buffer is set below */
+            xfce_xsettings_helper_screen_update (helper, screen);
+
             blsettings_dbg (XFSD_DEBUG_XSETTINGS, "%s registered on screen %d", atom_name, n);
 
             helper->screens = g_slist_prepend (helper->screens, screen);
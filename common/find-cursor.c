@@ -0,0 +1,272 @@
+/*
+ *  Copyright (c) 2018 Simon Steinbeiß <simon@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "find-cursor.h"
+
+/* The locator is a popup window shaped to the rings around the pointer,
+ * using the X shape extension through gdk. The server fills the shaped
+ * area with the window background, so there is no screenshot to fake
+ * transparency and the client never repaints the window. Each frame only
+ * replaces the shape with the rings for the elapsed time. */
+
+
+
+/* size of the window and circles */
+#define CIRCLE_SIZE    500
+#define CIRCLE_RADIUS  250
+
+/* rings drawn inside the outer circle */
+#define RING_WIDTH     3
+#define RING_SPACING   30
+#define RING_MAX       4
+
+/* number of points of the polygons approximating a circle */
+#define CIRCLE_POINTS  96
+
+/* time for the outer ring to reach the window border */
+#define DURATION       0.8
+
+/* about 60 frames per second */
+#define FRAME_INTERVAL 16
+
+
+
+typedef struct _XfceFindCursor XfceFindCursor;
+
+struct _XfceFindCursor
+{
+    GtkWidget          *window;
+
+    /* animation */
+    GTimer             *timer;
+    guint               frame_id;
+
+    /* pointer position the window is centered on */
+    gint                x, y;
+
+    XfceFindCursorFunc  func;
+    gpointer            user_data;
+};
+
+
+
+/* there is only one locator per process */
+static XfceFindCursor *locator = NULL;
+
+
+
+static GdkRegion *
+xfce_find_cursor_circle (gdouble radius)
+{
+    GdkPoint points[CIRCLE_POINTS];
+    gdouble  angle;
+    guint    i;
+
+    for (i = 0; i < CIRCLE_POINTS; i++)
+    {
+        angle = 2 * M_PI * i / CIRCLE_POINTS;
+        points[i].x = CIRCLE_RADIUS + rint (radius * cos (angle));
+        points[i].y = CIRCLE_RADIUS + rint (radius * sin (angle));
+    }
+
+    return gdk_region_polygon (points, CIRCLE_POINTS, GDK_WINDING_RULE);
+}
+
+
+
+static GdkRegion *
+xfce_find_cursor_rings (gdouble radius)
+{
+    GdkRegion *region;
+    GdkRegion *outer, *inner;
+    gdouble    r;
+    guint      i;
+
+    region = gdk_region_new ();
+
+    /* an annulus for each ring, like the arcs of the old locator */
+    for (i = 0; i < RING_MAX; i++)
+    {
+        r = radius - i * RING_SPACING;
+        if (r <= RING_WIDTH)
+            break;
+
+        outer = xfce_find_cursor_circle (r + RING_WIDTH / 2.0);
+        inner = xfce_find_cursor_circle (r - RING_WIDTH / 2.0);
+
+        gdk_region_subtract (outer, inner);
+        gdk_region_union (region, outer);
+
+        gdk_region_destroy (outer);
+        gdk_region_destroy (inner);
+    }
+
+    return region;
+}
+
+
+
+static void
+xfce_find_cursor_finish (void)
+{
+    XfceFindCursorFunc func;
+    gpointer           user_data;
+
+    g_return_if_fail (locator != NULL);
+
+    if (locator->frame_id != 0)
+        g_source_remove (locator->frame_id);
+
+    gtk_widget_destroy (locator->window);
+    g_timer_destroy (locator->timer);
+
+    func = locator->func;
+    user_data = locator->user_data;
+
+    g_slice_free (XfceFindCursor, locator);
+    locator = NULL;
+
+    if (func != NULL)
+        func (user_data);
+}
+
+
+
+static void
+xfce_find_cursor_move (gint x,
+                       gint y)
+{
+    locator->x = x;
+    locator->y = y;
+
+    /* center the window around the mouse cursor */
+    gtk_window_move (GTK_WINDOW (locator->window), x - CIRCLE_RADIUS, y - CIRCLE_RADIUS);
+}
+
+
+
+static gboolean
+xfce_find_cursor_frame (gpointer user_data)
+{
+    GdkRegion *region;
+    gdouble    elapsed;
+    gdouble    radius;
+    gint       x, y;
+
+    g_return_val_if_fail (locator != NULL, FALSE);
+
+    /* the radius follows the time, not the number of frames */
+    elapsed = g_timer_elapsed (locator->timer, NULL);
+    if (elapsed >= DURATION)
+    {
+        locator->frame_id = 0;
+        xfce_find_cursor_finish ();
+
+        return FALSE;
+    }
+
+    radius = 1 + (CIRCLE_RADIUS - RING_WIDTH - 1) * elapsed / DURATION;
+
+    /* make the rings follow the mouse cursor */
+    gdk_display_get_pointer (gtk_widget_get_display (locator->window), NULL, &x, &y, NULL);
+    if (x != locator->x || y != locator->y)
+        xfce_find_cursor_move (x, y);
+
+    /* the server paints the newly exposed ring area with the background
+     * and the area of the previous rings is given back to the windows
+     * below, so nothing else is drawn */
+    region = xfce_find_cursor_rings (radius);
+    gdk_window_shape_combine_region (gtk_widget_get_window (locator->window), region, 0, 0);
+    gdk_region_destroy (region);
+
+    return TRUE;
+}
+
+
+
+static void
+xfce_find_cursor_realize (GtkWidget *widget)
+{
+    GdkRegion *region;
+
+    /* start with an empty shape, so nothing shows before the first frame */
+    region = gdk_region_new ();
+    gdk_window_shape_combine_region (gtk_widget_get_window (widget), region, 0, 0);
+    gdk_region_destroy (region);
+}
+
+
+
+void
+xfce_find_cursor_show (GdkScreen          *screen,
+                       XfceFindCursorFunc  func,
+                       gpointer            user_data)
+{
+    GdkColor  color = { 0, 0xffff, 0x0000, 0x0000 };
+    gint      x, y;
+
+    g_return_if_fail (screen == NULL || GDK_IS_SCREEN (screen));
+
+    if (screen == NULL)
+        screen = gdk_screen_get_default ();
+
+    /* just get the position of the mouse cursor */
+    gdk_display_get_pointer (gdk_screen_get_display (screen), NULL, &x, &y, NULL);
+
+    if (locator != NULL)
+    {
+        /* restart the running animation at the new position */
+        g_timer_start (locator->timer);
+        xfce_find_cursor_move (x, y);
+
+        return;
+    }
+
+    locator = g_slice_new0 (XfceFindCursor);
+    locator->func = func;
+    locator->user_data = user_data;
+
+    /* popup tells the wm to ignore if parts of the window are offscreen */
+    locator->window = gtk_window_new (GTK_WINDOW_POPUP);
+    gtk_window_set_screen (GTK_WINDOW (locator->window), screen);
+    gtk_window_set_resizable (GTK_WINDOW (locator->window), FALSE);
+    gtk_widget_set_size_request (locator->window, CIRCLE_SIZE, CIRCLE_SIZE);
+    gtk_widget_set_app_paintable (locator->window, TRUE);
+    gtk_widget_set_double_buffered (locator->window, FALSE);
+
+    /* the window background is the color of the rings */
+    gtk_widget_modify_bg (locator->window, GTK_STATE_NORMAL, &color);
+
+    g_signal_connect (G_OBJECT (locator->window), "realize",
+                      G_CALLBACK (xfce_find_cursor_realize), NULL);
+
+    xfce_find_cursor_move (x, y);
+    gtk_widget_show (locator->window);
+
+    locator->timer = g_timer_new ();
+    locator->frame_id = g_timeout_add (FRAME_INTERVAL, xfce_find_cursor_frame, NULL);
+}
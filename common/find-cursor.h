@@ -0,0 +1,35 @@
+/*
+ *  Copyright (c) 2018 Simon Steinbeiß <simon@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gtk/gtk.h>
+
+#ifndef __FIND_CURSOR_H__
+#define __FIND_CURSOR_H__
+
+G_BEGIN_DECLS
+
+/* called when the animation of the locator is done */
+typedef void (*XfceFindCursorFunc) (gpointer user_data);
+
+void xfce_find_cursor_show (GdkScreen          *screen,
+                            XfceFindCursorFunc  func,
+                            gpointer            user_data);
+
+G_END_DECLS
+
+#endif /* !__FIND_CURSOR_H__ */
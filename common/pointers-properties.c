@@ -0,0 +1,560 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_LIBINPUT
+#include "libinput-properties.h"
+#endif /* HAVE_LIBINPUT */
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "pointers-properties.h"
+
+/* Device property access shared by the mouse dialog and the pointers
+ * helper. Atoms are identical for every connection to the server, so
+ * they are interned once per process and shared between threads; the
+ * known atoms are requested in a single pipelined XInternAtoms call.
+ *
+ * None of the functions below trap X errors or sync the connection,
+ * that is up to the caller so a whole batch costs one trap and one
+ * XSync instead of one per property. */
+
+
+
+#ifdef XI_PROP_ENABLED
+#define DEVICE_ENABLED XI_PROP_ENABLED
+#else
+#define DEVICE_ENABLED "Device Enabled"
+#endif /* XI_PROP_ENABLED */
+
+/* maximum number of 32 bit items requested for a property */
+#define PROPERTY_MAX_LENGTH (1000)
+
+
+
+static gchar *atom_names[] =
+{
+    "FLOAT",
+    DEVICE_ENABLED,
+    XI_TOUCHPAD,
+    "Synaptics Off",
+    "Synaptics Tap Action",
+    "Synaptics Edge Scrolling",
+    "Synaptics Two-Finger Scrolling",
+    "Synaptics Circular Scrolling",
+    "Wacom Tool Type",
+    "Wacom Rotation",
+#ifdef HAVE_LIBINPUT
+    LIBINPUT_PROP_TAP,
+    LIBINPUT_PROP_ACCEL,
+    LIBINPUT_PROP_LEFT_HANDED,
+    LIBINPUT_PROP_NATURAL_SCROLL,
+    LIBINPUT_PROP_SCROLL_METHOD_ENABLED,
+    LIBINPUT_PROP_SCROLL_METHODS_AVAILABLE,
+#endif /* HAVE_LIBINPUT */
+};
+
+static Atom        atoms[XFCE_POINTERS_N_ATOMS];
+static gboolean    atoms_loaded = FALSE;
+
+/* blconf property name to atom, only atoms that exist on the server */
+static GHashTable *atoms_by_name = NULL;
+
+G_LOCK_DEFINE_STATIC (atoms);
+
+
+
+Atom
+xfce_pointers_atom (Display          *xdisplay,
+                    XfcePointersAtom  atom_id)
+{
+    Atom atom;
+
+    g_return_val_if_fail (atom_id < XFCE_POINTERS_N_ATOMS, None);
+    G_STATIC_ASSERT (G_N_ELEMENTS (atom_names) == XFCE_POINTERS_N_ATOMS);
+
+    G_LOCK (atoms);
+
+    /* intern the names even if they don't exist yet, a driver can
+     * register them later and this way we never have to ask again */
+    if (G_UNLIKELY (!atoms_loaded))
+    {
+        XInternAtoms (xdisplay, atom_names, XFCE_POINTERS_N_ATOMS, False, atoms);
+        atoms_loaded = TRUE;
+    }
+
+    atom = atoms[atom_id];
+
+    G_UNLOCK (atoms);
+
+    return atom;
+}
+
+
+
+gchar *
+xfce_pointers_device_blconf_name (const gchar *name)
+{
+    GString     *string;
+    const gchar *p;
+
+    g_return_val_if_fail (name != NULL, NULL);
+
+    /* allocate a string */
+    string = g_string_sized_new (strlen (name));
+
+    /* create a name with only valid chars */
+    for (p = name; *p != '\0'; p++)
+    {
+        if ((*p >= 'A' && *p <= 'Z')
+            || (*p >= 'a' && *p <= 'z')
+            || (*p >= '0' && *p <= '9')
+            || *p == '_' || *p == '-')
+        {
+            g_string_append_c (string, *p);
+        }
+        else if (*p == ' ')
+        {
+            g_string_append_c (string, '_');
+        }
+    }
+
+    /* return the new string */
+    return g_string_free (string, FALSE);
+}
+
+
+
+#if defined(DEVICE_PROPERTIES) || defined(HAVE_LIBINPUT)
+static void
+xfce_pointers_atoms_lookup (Display                 *xdisplay,
+                            const XfcePointersWrite *writes,
+                            guint                    n_writes,
+                            Atom                    *retval)
+{
+    gchar    **missing;
+    guint     *missing_idx;
+    Atom      *missing_atoms;
+    guint      n_missing = 0;
+    guint      i;
+    gpointer   atom;
+
+    missing = g_new (gchar *, n_writes);
+    missing_idx = g_new (guint, n_writes);
+
+    G_LOCK (atoms);
+
+    if (G_UNLIKELY (atoms_by_name == NULL))
+        atoms_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    for (i = 0; i < n_writes; i++)
+    {
+        atom = g_hash_table_lookup (atoms_by_name, writes[i].name);
+        if (atom != NULL)
+        {
+            retval[i] = GPOINTER_TO_UINT (atom);
+        }
+        else
+        {
+            /* assuming the device property never contained underscores... */
+            missing[n_missing] = g_strdup (writes[i].name);
+            g_strdelimit (missing[n_missing], "_", ' ');
+            missing_idx[n_missing++] = i;
+        }
+    }
+
+    if (n_missing > 0)
+    {
+        /* only if they exist, a property unknown to the server
+         * does not exist on any of the devices */
+        missing_atoms = g_new0 (Atom, n_missing);
+        XInternAtoms (xdisplay, missing, n_missing, True, missing_atoms);
+
+        for (i = 0; i < n_missing; i++)
+        {
+            retval[missing_idx[i]] = missing_atoms[i];
+            if (missing_atoms[i] != None)
+            {
+                g_hash_table_insert (atoms_by_name, g_strdup (writes[missing_idx[i]].name),
+                                     GUINT_TO_POINTER (missing_atoms[i]));
+            }
+
+            g_free (missing[i]);
+        }
+
+        g_free (missing_atoms);
+    }
+
+    G_UNLOCK (atoms);
+
+    g_free (missing);
+    g_free (missing_idx);
+}
+
+
+
+static gboolean
+xfce_pointers_properties_has (const Atom *props,
+                              gint        n_props,
+                              Atom        prop)
+{
+    gint n;
+
+    if (prop == None)
+        return FALSE;
+
+    for (n = 0; n < n_props; n++)
+        if (props[n] == prop)
+            return TRUE;
+
+    return FALSE;
+}
+
+
+
+static gboolean
+xfce_pointers_properties_get (Display          *xdisplay,
+                              XDevice          *device,
+                              XfcePointersRead *read)
+{
+    gulong bytes_after;
+    gint   rc;
+
+    rc = XGetDeviceProperty (xdisplay, device, read->property, 0, PROPERTY_MAX_LENGTH,
+                             False, AnyPropertyType, &read->type, &read->format,
+                             &read->n_items, &bytes_after, &read->data);
+    if (rc == Success && read->data != NULL && read->n_items > 0)
+        return TRUE;
+
+    if (rc == Success && read->data != NULL)
+        XFree (read->data);
+
+    read->data = NULL;
+    read->n_items = 0;
+
+    return FALSE;
+}
+
+
+
+guint
+xfce_pointers_properties_read (Display          *xdisplay,
+                               XDevice          *device,
+                               XfcePointersRead *reads,
+                               guint             n_reads)
+{
+    Atom  *props;
+    gint   n_props;
+    guint  i;
+    guint  n_found = 0;
+
+    g_return_val_if_fail (reads != NULL || n_reads == 0, 0);
+
+    for (i = 0; i < n_reads; i++)
+    {
+        reads[i].data = NULL;
+        reads[i].n_items = 0;
+    }
+
+    /* one request tells which of the properties we have to fetch */
+    props = XListDeviceProperties (xdisplay, device, &n_props);
+    if (props == NULL)
+        return 0;
+
+    for (i = 0; i < n_reads; i++)
+    {
+        if (xfce_pointers_properties_has (props, n_props, reads[i].property)
+            && xfce_pointers_properties_get (xdisplay, device, &reads[i]))
+            n_found++;
+    }
+
+    XFree (props);
+
+    return n_found;
+}
+
+
+
+void
+xfce_pointers_properties_free (XfcePointersRead *reads,
+                               guint             n_reads)
+{
+    guint i;
+
+    for (i = 0; i < n_reads; i++)
+    {
+        if (reads[i].data != NULL)
+            XFree (reads[i].data);
+        reads[i].data = NULL;
+        reads[i].n_items = 0;
+    }
+}
+
+
+
+gboolean
+xfce_pointers_property_get_int (const XfcePointersRead *read,
+                                guint                   index,
+                                gint                   *value)
+{
+    g_return_val_if_fail (read != NULL, FALSE);
+
+    if (read->data == NULL || index >= read->n_items)
+        return FALSE;
+
+    if (read->type == XA_INTEGER)
+    {
+        switch (read->format)
+        {
+            case 8:
+                *value = ((gchar *) read->data)[index];
+                return TRUE;
+            case 16:
+                *value = ((gint16 *) read->data)[index];
+                return TRUE;
+            case 32:
+                /* Xlib returns 32 bit items as longs */
+                *value = ((glong *) read->data)[index];
+                return TRUE;
+        }
+    }
+    else if (read->type == XA_CARDINAL)
+    {
+        switch (read->format)
+        {
+            case 8:
+                *value = ((guchar *) read->data)[index];
+                return TRUE;
+            case 16:
+                *value = ((guint16 *) read->data)[index];
+                return TRUE;
+            case 32:
+                *value = ((gulong *) read->data)[index];
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+
+gboolean
+xfce_pointers_property_get_float (Display                *xdisplay,
+                                  const XfcePointersRead *read,
+                                  guint                   index,
+                                  gfloat                 *value)
+{
+    guint32 bits;
+
+    g_return_val_if_fail (read != NULL, FALSE);
+
+    if (read->data == NULL || index >= read->n_items
+        || read->format != 32
+        || read->type != xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_FLOAT))
+        return FALSE;
+
+    /* the float is stored in the lower 32 bits of the long */
+    bits = ((gulong *) read->data)[index];
+    memcpy (value, &bits, sizeof (gfloat));
+
+    return TRUE;
+}
+
+
+
+static gboolean
+xfce_pointers_properties_convert (Display                 *xdisplay,
+                                  const XfcePointersWrite *write,
+                                  XfcePointersRead        *read)
+{
+    GPtrArray    *array = NULL;
+    const GValue *val;
+    gulong        i;
+    gfloat        f;
+    guint32       bits;
+    Atom          float_atom;
+
+    if (read->n_items == 1
+        && (G_VALUE_HOLDS_INT (write->value)
+            || G_VALUE_HOLDS_STRING (write->value)
+            || G_VALUE_HOLDS_DOUBLE (write->value)))
+    {
+        /* only 1 items to set */
+    }
+    else if (G_VALUE_HOLDS_BOXED (write->value))
+    {
+        array = g_value_get_boxed (write->value);
+        if (array == NULL || array->len != read->n_items)
+        {
+            g_critical ("Nr device property items (%ld) and blconf value (%d) differ",
+                        read->n_items, array != NULL ? array->len : 0);
+            return FALSE;
+        }
+    }
+    else
+    {
+        g_critical ("Invalid device property combination");
+        return FALSE;
+    }
+
+    float_atom = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_FLOAT);
+
+    for (i = 0; i < read->n_items; i++)
+    {
+        /* get value from pointer array */
+        if (array != NULL)
+            val = g_ptr_array_index (array, i);
+        else
+            val = write->value;
+
+        if (G_VALUE_HOLDS_INT (val)
+            && read->type == XA_INTEGER)
+        {
+            if (read->format == 8)
+                ((gchar *) read->data)[i] = g_value_get_int (val);
+            else if (read->format == 16)
+                ((gint16 *) read->data)[i] = g_value_get_int (val);
+            else if (read->format == 32)
+                ((glong *) read->data)[i] = g_value_get_int (val);
+            else
+            {
+                g_critical ("Unknown format %d for integer", read->format);
+                return FALSE;
+            }
+        }
+        else if (G_VALUE_HOLDS_STRING (val)
+                 && read->type == XA_ATOM
+                 && read->format == 32)
+        {
+            /* set atom (reference to a string) */
+            ((Atom *) read->data)[i] = XInternAtom (xdisplay, g_value_get_string (val), False);
+        }
+        else if (G_VALUE_HOLDS_DOUBLE (val) /* blconf doesn't support floats */
+                 && read->type == float_atom
+                 && read->format == 32)
+        {
+            /* 32 bit items are passed to Xlib as longs */
+            f = g_value_get_double (val);
+            memcpy (&bits, &f, sizeof (bits));
+            ((gulong *) read->data)[i] = bits;
+        }
+        else
+        {
+            g_critical ("Unknown property type %s for %s: format = %d",
+                        G_VALUE_TYPE_NAME (val), write->name, read->format);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+
+guint
+xfce_pointers_properties_write (Display                 *xdisplay,
+                                XDevice                 *device,
+                                const XfcePointersWrite *writes,
+                                guint                    n_writes)
+{
+    Atom             *props;
+    Atom             *write_atoms;
+    gint              n_props;
+    guint             i;
+    guint             n_written = 0;
+    XfcePointersRead  read;
+#ifdef HAVE_LIBINPUT
+    Atom              enabled_atom;
+    gboolean          enabled = FALSE;
+    gint              val;
+#endif /* HAVE_LIBINPUT */
+
+    g_return_val_if_fail (writes != NULL || n_writes == 0, 0);
+
+    if (n_writes == 0)
+        return 0;
+
+    write_atoms = g_new (Atom, n_writes);
+    xfce_pointers_atoms_lookup (xdisplay, writes, n_writes, write_atoms);
+
+    props = XListDeviceProperties (xdisplay, device, &n_props);
+    if (props == NULL)
+    {
+        g_free (write_atoms);
+        return 0;
+    }
+
+#ifdef HAVE_LIBINPUT
+    /*
+     * libinput cannot change properties on disabled devices
+     * see: https://bugs.freedesktop.org/show_bug.cgi?id=89296
+     * and: http://lists.x.org/archives/xorg-devel/2015-February/045716.html
+     */
+    enabled_atom = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_DEVICE_ENABLED);
+    read.property = enabled_atom;
+    if (xfce_pointers_properties_has (props, n_props, enabled_atom)
+        && xfce_pointers_properties_get (xdisplay, device, &read))
+    {
+        enabled = xfce_pointers_property_get_int (&read, 0, &val) && val != 0;
+        XFree (read.data);
+    }
+#endif /* HAVE_LIBINPUT */
+
+    for (i = 0; i < n_writes; i++)
+    {
+        /* find the matching property */
+        if (!xfce_pointers_properties_has (props, n_props, write_atoms[i]))
+            continue;
+
+#ifdef HAVE_LIBINPUT
+        if (!enabled && write_atoms[i] != enabled_atom)
+            continue;
+#endif /* HAVE_LIBINPUT */
+
+        /* fetch the current value, for the type, format and size */
+        read.property = write_atoms[i];
+        if (!xfce_pointers_properties_get (xdisplay, device, &read))
+            continue;
+
+        /* no reply is needed, the caller syncs once for the batch */
+        if (xfce_pointers_properties_convert (xdisplay, &writes[i], &read))
+        {
+            XChangeDeviceProperty (xdisplay, device, read.property, read.type,
+                                   read.format, PropModeReplace, read.data,
+                                   read.n_items);
+            n_written++;
+        }
+
+        XFree (read.data);
+    }
+
+    XFree (props);
+    g_free (write_atoms);
+
+    return n_written;
+}
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
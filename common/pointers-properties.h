@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib-object.h>
+#include <blsettingsd/pointers-defines.h>
+
+#ifndef __POINTERS_PROPERTIES_H__
+#define __POINTERS_PROPERTIES_H__
+
+G_BEGIN_DECLS
+
+/* atoms of the device properties the dialog and helper know about */
+typedef enum
+{
+    XFCE_POINTERS_ATOM_FLOAT,
+    XFCE_POINTERS_ATOM_DEVICE_ENABLED,
+    XFCE_POINTERS_ATOM_TOUCHPAD,
+    XFCE_POINTERS_ATOM_SYNAPTICS_OFF,
+    XFCE_POINTERS_ATOM_SYNAPTICS_TAP_ACTION,
+    XFCE_POINTERS_ATOM_SYNAPTICS_EDGE_SCROLLING,
+    XFCE_POINTERS_ATOM_SYNAPTICS_TWO_FINGER_SCROLLING,
+    XFCE_POINTERS_ATOM_SYNAPTICS_CIRCULAR_SCROLLING,
+    XFCE_POINTERS_ATOM_WACOM_TOOL_TYPE,
+    XFCE_POINTERS_ATOM_WACOM_ROTATION,
+#ifdef HAVE_LIBINPUT
+    XFCE_POINTERS_ATOM_LIBINPUT_TAP,
+    XFCE_POINTERS_ATOM_LIBINPUT_ACCEL,
+    XFCE_POINTERS_ATOM_LIBINPUT_LEFT_HANDED,
+    XFCE_POINTERS_ATOM_LIBINPUT_NATURAL_SCROLL,
+    XFCE_POINTERS_ATOM_LIBINPUT_SCROLL_METHOD_ENABLED,
+    XFCE_POINTERS_ATOM_LIBINPUT_SCROLL_METHODS_AVAILABLE,
+#endif /* HAVE_LIBINPUT */
+    XFCE_POINTERS_N_ATOMS
+}
+XfcePointersAtom;
+
+typedef struct _XfcePointersRead  XfcePointersRead;
+typedef struct _XfcePointersWrite XfcePointersWrite;
+
+/* a property to read, the result fields are filled by the batch */
+struct _XfcePointersRead
+{
+    Atom    property;
+
+    /* result, data is NULL if the device lacks the property */
+    Atom    type;
+    gint    format;
+    gulong  n_items;
+    guchar *data;
+};
+
+/* a property to write, the name uses underscores for spaces
+ * like the blconf properties; arrays are a GPtrArray of GValues */
+struct _XfcePointersWrite
+{
+    const gchar  *name;
+    const GValue *value;
+};
+
+Atom      xfce_pointers_atom                (Display                 *xdisplay,
+                                             XfcePointersAtom         atom_id);
+
+gchar    *xfce_pointers_device_blconf_name  (const gchar             *name) G_GNUC_MALLOC;
+
+#if defined(DEVICE_PROPERTIES) || defined(HAVE_LIBINPUT)
+guint     xfce_pointers_properties_read     (Display                 *xdisplay,
+                                             XDevice                 *device,
+                                             XfcePointersRead        *reads,
+                                             guint                    n_reads);
+
+void      xfce_pointers_properties_free     (XfcePointersRead        *reads,
+                                             guint                    n_reads);
+
+gboolean  xfce_pointers_property_get_int    (const XfcePointersRead  *read,
+                                             guint                    index,
+                                             gint                    *value);
+
+gboolean  xfce_pointers_property_get_float  (Display                 *xdisplay,
+                                             const XfcePointersRead  *read,
+                                             guint                    index,
+                                             gfloat                  *value);
+
+guint     xfce_pointers_properties_write    (Display                 *xdisplay,
+                                             XDevice                 *device,
+                                             const XfcePointersWrite *writes,
+                                             guint                    n_writes);
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+
+G_END_DECLS
+
+#endif /* !__POINTERS_PROPERTIES_H__ */
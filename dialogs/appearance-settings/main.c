@@ -31,10 +31,11 @@
 #include <sys/wait.h>
 #endif
 
+#include <sys/stat.h>
 #include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
-#include <fcntl.h>
+#include <gio/gio.h>
 #include <gtk/gtk.h>
 
 #include <libbladeui/libbladeui.h>
@@ -53,11 +54,12 @@
 /* Increase this number if new gtk settings have been added */
 #define INITIALIZE_UINT (1)
 
-#define COLOR_SCHEME_SYMBOL ((gpointer) 1)
-#define GTK_RC_TOKEN_FG ((gpointer) 2)
-#define GTK_RC_TOKEN_BG ((gpointer) 3)
-#define GTK_RC_TOKEN_NORMAL ((gpointer) 4)
-#define GTK_RC_TOKEN_SELECTED ((gpointer) 5)
+/* Size of the palette preview of the ui themes */
+#define THEME_PREVIEW_WIDTH  44
+#define THEME_PREVIEW_HEIGHT 22
+
+/* Cache of the colors found in the gtkrc files */
+#define GTKRC_COLOR_CACHE "xfce4/appearance-settings/gtkrc-colors.cache"
 
 gchar *gtkrc_get_color_scheme_for_theme (const gchar *gtkrc_filename);
 gboolean color_scheme_parse_colors (const gchar *scheme, GdkColor *colors);
@@ -87,6 +89,21 @@ enum {
 	NUM_SYMBOLIC_COLORS
 };
 
+/* Names of the symbolic colors in a gtk-color-scheme */
+static const gchar *symbolic_color_names[] =
+{
+    "fg_color", "bg_color", "selected_bg_color"
+};
+
+enum
+{
+    GTKRC_TOKEN_EOF,
+    GTKRC_TOKEN_IDENTIFIER,
+    GTKRC_TOKEN_STRING,
+    GTKRC_TOKEN_NUMBER,
+    GTKRC_TOKEN_CHAR
+};
+
 /* String arrays with the settings in combo boxes */
 static const gchar* toolbar_styles_array[] =
 {
@@ -185,214 +202,334 @@ compute_xsettings_dpi (GtkWidget *widget)
     return dpi;
 }
 
-/* Try to retrieve the color scheme and alternatively parse the colors from the gtkrc */
+/* Read the next token from a gtkrc buffer, skipping whitespace and comments.
+ * Only what the color lookup needs is recognized: identifiers, strings,
+ * numbers and single characters */
+static gint
+gtkrc_scan_token (const gchar **cursor,
+                  const gchar  *end,
+                  GString      *value,
+                  gdouble      *number)
+{
+    const gchar *p = *cursor;
+    const gchar *start;
+    gchar       *endptr;
+    gchar        quote;
+    gint         token;
+
+    g_string_truncate (value, 0);
+
+    for (;;)
+    {
+        while (p < end && g_ascii_isspace (*p))
+            p++;
+
+        if (p < end && *p == '#')
+        {
+            /* Single line comment */
+            while (p < end && *p != '\n')
+                p++;
+        }
+        else if (p + 1 < end && p[0] == '/' && p[1] == '*')
+        {
+            /* Multi line comment */
+            for (p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++);
+            p = MIN (p + 2, end);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (p >= end)
+    {
+        token = GTKRC_TOKEN_EOF;
+    }
+    else if (g_ascii_isalpha (*p) || *p == '_')
+    {
+        for (start = p; p < end && (g_ascii_isalnum (*p) || *p == '_' || *p == '-'); p++);
+        g_string_append_len (value, start, p - start);
+        token = GTKRC_TOKEN_IDENTIFIER;
+    }
+    else if (*p == '"' || *p == '\'')
+    {
+        /* Only double quoted strings know escapes */
+        for (quote = *p++; p < end && *p != quote; p++)
+        {
+            if (quote == '"' && *p == '\\' && p + 1 < end)
+            {
+                p++;
+                if (*p == 'n')
+                    g_string_append_c (value, '\n');
+                else if (*p == 't')
+                    g_string_append_c (value, '\t');
+                else
+                    g_string_append_c (value, *p);
+            }
+            else
+            {
+                g_string_append_c (value, *p);
+            }
+        }
+
+        if (p < end)
+            p++;
+
+        token = GTKRC_TOKEN_STRING;
+    }
+    else if (g_ascii_isdigit (*p) || (*p == '.' && p + 1 < end && g_ascii_isdigit (p[1])))
+    {
+        /* The buffer is nul-terminated, so strtod stops in time */
+        *number = g_ascii_strtod (p, &endptr);
+        p = MAX (endptr, p + 1);
+        token = GTKRC_TOKEN_NUMBER;
+    }
+    else
+    {
+        g_string_append_c (value, *p++);
+        token = GTKRC_TOKEN_CHAR;
+    }
+
+    *cursor = p;
+
+    return token;
+}
+
+/* Check whether the next token is the character c */
+static gboolean
+gtkrc_scan_char (const gchar **cursor,
+                 const gchar  *end,
+                 GString      *value,
+                 gchar         c)
+{
+    gdouble number;
+
+    return gtkrc_scan_token (cursor, end, value, &number) == GTKRC_TOKEN_CHAR
+           && value->str[0] == c;
+}
+
+/* Parse a color value in "#rrggbb" or { r, g, b } format */
+static gchar *
+gtkrc_scan_color (const gchar **cursor,
+                  const gchar  *end,
+                  GString      *value)
+{
+    GString *color;
+    gdouble  number;
+    gint     token;
+
+    token = gtkrc_scan_token (cursor, end, value, &number);
+    if (token == GTKRC_TOKEN_STRING)
+        return g_strdup (value->str);
+
+    if (token != GTKRC_TOKEN_CHAR || value->str[0] != '{')
+        return NULL;
+
+    color = g_string_new ("#");
+    for (;;)
+    {
+        token = gtkrc_scan_token (cursor, end, value, &number);
+        if (token == GTKRC_TOKEN_EOF
+            || (token == GTKRC_TOKEN_CHAR && value->str[0] == '}'))
+            break;
+
+        if (token == GTKRC_TOKEN_NUMBER)
+            g_string_append_printf (color, "%02x", (guint) CLAMP (number * 255, 0, 255));
+    }
+
+    return g_string_free (color, FALSE);
+}
+
+/* Try to retrieve the color scheme and alternatively parse the colors from the gtkrc.
+ * This is a single pass over the file; for a gtk-color-scheme we're done as soon
+ * as all colors are known, otherwise the first bg[NORMAL], bg[SELECTED] and
+ * fg[NORMAL] colors are used */
 gchar *
 gtkrc_get_color_scheme_for_theme (const gchar *gtkrc_filename)
 {
-    gint file = -1;
-    GString *result_string = g_string_new("");
-    GString *fallback_string = g_string_new("");
-    GString *tmp_string = g_string_new("");
-    gchar *result = NULL;
-    gboolean bg_normal = FALSE;
-    gboolean bg_selected = FALSE;
-    gboolean fg_normal = FALSE;
-    GSList *files = NULL;
-    GSList *read_files = NULL;
-    GTokenType token;
-    GScanner *scanner = gtk_rc_scanner_new ();
-
-    g_return_val_if_fail (gtkrc_filename != NULL, "");
-
-    g_scanner_scope_add_symbol (scanner, 0, "gtk_color_scheme", COLOR_SCHEME_SYMBOL);
-    g_scanner_scope_add_symbol (scanner, 0, "gtk-color-scheme", COLOR_SCHEME_SYMBOL);
-    g_scanner_scope_add_symbol (scanner, 0, "fg", GTK_RC_TOKEN_FG);
-    g_scanner_scope_add_symbol (scanner, 0, "bg", GTK_RC_TOKEN_BG);
-    g_scanner_scope_add_symbol (scanner, 0, "NORMAL", GTK_RC_TOKEN_NORMAL);
-    g_scanner_scope_add_symbol (scanner, 0, "SELECTED", GTK_RC_TOKEN_SELECTED);
-
-    files = g_slist_prepend (files, g_strdup (gtkrc_filename));
-    while (files != NULL)
+    gchar       *contents;
+    gsize        length;
+    const gchar *cursor, *end;
+    GString     *value;
+    GString     *result_string;
+    gchar       *fallback[NUM_SYMBOLIC_COLORS] = { NULL, };
+    gchar       *result;
+    gboolean     bg_normal = FALSE;
+    gboolean     bg_selected = FALSE;
+    gboolean     fg_normal = FALSE;
+    gdouble      number;
+    gint         token;
+    gint         color;
+    gint         i;
+
+    g_return_val_if_fail (gtkrc_filename != NULL, g_strdup (""));
+
+    if (!g_file_get_contents (gtkrc_filename, &contents, &length, NULL))
     {
-        gchar *filename = files->data;
-        files = g_slist_delete_link (files, files);
+        g_warning ("Could not open file \"%s\"", gtkrc_filename);
+        return g_strdup ("");
+    }
 
-        if (filename == NULL)
+    value = g_string_new (NULL);
+    result_string = g_string_new (NULL);
+
+    cursor = contents;
+    end = contents + length;
+
+    while ((token = gtkrc_scan_token (&cursor, end, value, &number)) != GTKRC_TOKEN_EOF)
+    {
+        if (token != GTKRC_TOKEN_IDENTIFIER)
             continue;
 
-        if (g_slist_find_custom (read_files, filename, (GCompareFunc) strcmp))
+        /* Scan the gtkrc file for the gtk-color-scheme */
+        if (strcmp (value->str, "gtk-color-scheme") == 0
+            || strcmp (value->str, "gtk_color_scheme") == 0)
         {
-            g_warning ("Recursion in the gtkrc detected!");
-            g_free (filename);
-            continue; /* skip this file since we've done it before... */
+            if (gtkrc_scan_char (&cursor, end, value, '='))
+            {
+                if (gtkrc_scan_token (&cursor, end, value, &number) == GTKRC_TOKEN_STRING)
+                    g_string_append_printf (result_string, "\n%s", value->str);
+
+                bg_normal = strstr (result_string->str, "bg_color") != NULL;
+                bg_selected = strstr (result_string->str, "selected_bg_color") != NULL;
+                fg_normal = strstr (result_string->str, "fg_color") != NULL;
+            }
         }
+        /* Scan the gtkrc file for first occurences of bg[NORMAL], bg[SELECTED] and fg[NORMAL] in case
+         * it doesn't provide a gtk-color-scheme */
+        else if (result_string->len == 0
+                 && (strcmp (value->str, "bg") == 0 || strcmp (value->str, "fg") == 0))
+        {
+            color = value->str[0] == 'f' ? COLOR_FG : COLOR_BG;
 
-        read_files = g_slist_prepend (read_files, filename);
+            if (!gtkrc_scan_char (&cursor, end, value, '[')
+                || gtkrc_scan_token (&cursor, end, value, &number) != GTKRC_TOKEN_IDENTIFIER)
+                continue;
 
-        file = g_open (filename, O_RDONLY);
-        if (file == -1)
-            g_warning ("Could not open file \"%s\"", filename);
-        else
-        {
-            g_scanner_input_file (scanner, file);
-            while ((token = g_scanner_get_next_token (scanner)) != G_TOKEN_EOF)
+            if (color == COLOR_BG && strcmp (value->str, "SELECTED") == 0)
+                color = COLOR_SELECTED_BG;
+            else if (strcmp (value->str, "NORMAL") != 0)
+                continue;
+
+            if (fallback[color] == NULL
+                && gtkrc_scan_char (&cursor, end, value, ']')
+                && gtkrc_scan_char (&cursor, end, value, '='))
             {
-                /* Scan the gtkrc file for the gtk-color-scheme */
-                if (GINT_TO_POINTER (token) == COLOR_SCHEME_SYMBOL)
-                {
-                    if (g_scanner_get_next_token (scanner) == '=')
-                    {
-                        token = g_scanner_get_next_token (scanner);
-                        if (token == G_TOKEN_STRING)
-                        {
-                            g_string_append_printf(result_string, "\n%s", scanner->value.v_string);
-                        }
-                        bg_normal = g_strstr_len(result_string->str, -1, "bg_color") != NULL;
-                        bg_selected = g_strstr_len(result_string->str, -1, "selected_bg_color") != NULL;
-                        fg_normal = g_strstr_len(result_string->str, -1, "fg_color") != NULL;
-                    }
-                }
-                /* Scan the gtkrc file for first occurences of bg[NORMAL], bg[SELECTED] and fg[NORMAL] in case
-                 * it doesn't provide a gtk-color-scheme */
-                if (result_string->len == 0)
-                {
-                    if (GINT_TO_POINTER (token) == GTK_RC_TOKEN_BG)
-                    {
-                        if (g_scanner_get_next_token (scanner) == G_TOKEN_LEFT_BRACE)
-                        {
-                            /* bg[SELECTED] */
-                            if (GINT_TO_POINTER (token = g_scanner_get_next_token (scanner)) == GTK_RC_TOKEN_SELECTED
-                                && g_scanner_get_next_token (scanner) == G_TOKEN_RIGHT_BRACE
-                                && g_scanner_get_next_token (scanner) == '=')
-                            {
-                                token = g_scanner_get_next_token (scanner);
-                                /* Parse colors in hex #rrggbb format */
-                                if (token == G_TOKEN_STRING)
-                                {
-                                    if (!g_strrstr (fallback_string->str, "selected_bg_color"))
-                                    {
-                                        g_string_append_printf(fallback_string, "\nselected_bg_color:%s", scanner->value.v_string);
-                                        bg_selected = TRUE;
-                                    }
-                                }
-                                /* Parse colors in { r, g, b } format */
-                                else if (token == G_TOKEN_LEFT_CURLY)
-                                {
-                                    if (!g_strrstr (fallback_string->str, "selected_bg_color"))
-                                    {
-                                        g_string_erase(tmp_string, 0, -1);
-                                        while (token != G_TOKEN_RIGHT_CURLY)
-                                        {
-                                            token = g_scanner_get_next_token (scanner);
-                                            if (token == G_TOKEN_FLOAT)
-                                                g_string_append_printf(tmp_string, "%02x", (uint) (scanner->value.v_float*255));
-                                        }
-                                        g_string_append_printf(fallback_string, "\nselected_bg_color:#%s", tmp_string->str);
-                                        bg_selected = TRUE;
-                                    }
-                                }
-                            }
-                            /* bg[NORMAL] */
-                            else if (GINT_TO_POINTER (token) == GTK_RC_TOKEN_NORMAL
-                                     && g_scanner_get_next_token (scanner) == G_TOKEN_RIGHT_BRACE
-                                     && g_scanner_get_next_token (scanner) == '=')
-                            {
-                                token = g_scanner_get_next_token (scanner);
-                                /* Parse colors in hex #rrggbb format */
-                                if (token == G_TOKEN_STRING)
-                                {
-                                    if (!g_strrstr (fallback_string->str, "bg_color"))
-                                    {
-                                        g_string_append_printf(fallback_string, "\nbg_color:%s", scanner->value.v_string);
-                                        bg_normal = TRUE;
-                                    }
-                                }
-                                /* Parse colors in { r, g, b } format */
-                                else if (token == G_TOKEN_LEFT_CURLY)
-                                {
-                                    if (!g_strrstr (fallback_string->str, "bg_color"))
-                                    {
-                                        g_string_erase(tmp_string, 0, -1);
-                                        while (token != G_TOKEN_RIGHT_CURLY)
-                                        {
-                                            token = g_scanner_get_next_token (scanner);
-                                            if (token == G_TOKEN_FLOAT)
-                                                g_string_append_printf(tmp_string, "%02x", (uint) (scanner->value.v_float*255));
-                                        }
-                                        g_string_append_printf(fallback_string, "\nbg_color:#%s", tmp_string->str);
-                                        bg_normal = TRUE;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    else if (GINT_TO_POINTER (token) == GTK_RC_TOKEN_FG)
-                    {
-                        /* fg[NORMAL] */
-                        if (g_scanner_get_next_token (scanner) == G_TOKEN_LEFT_BRACE
-                            && GINT_TO_POINTER (token = g_scanner_get_next_token (scanner)) == GTK_RC_TOKEN_NORMAL
-                                && g_scanner_get_next_token (scanner) == G_TOKEN_RIGHT_BRACE
-                                && g_scanner_get_next_token (scanner) == '=')
-                        {
-                            token = g_scanner_get_next_token (scanner);
-                            /* Parse colors in hex #rrggbb format */
-                            if (token == G_TOKEN_STRING)
-                            {
-                                if (!g_strrstr (fallback_string->str, "fg_color"))
-                                {
-                                    g_string_append_printf(fallback_string, "\nfg_color:%s", scanner->value.v_string);
-                                    fg_normal = TRUE;
-                                }
-                            }
-                            /* Parse colors in { r, g, b } format */
-                            else if (token == G_TOKEN_LEFT_CURLY)
-                            {
-                                if (!g_strrstr (fallback_string->str, "fg_color"))
-                                {
-                                    g_string_erase(tmp_string, 0, -1);
-                                    while (token != G_TOKEN_RIGHT_CURLY)
-                                    {
-                                        token = g_scanner_get_next_token (scanner);
-                                        if (token == G_TOKEN_FLOAT)
-                                            g_string_append_printf(tmp_string, "%02x", (uint) (scanner->value.v_float*255));
-                                    }
-                                    g_string_append_printf(fallback_string, "\nfg_color:#%s", tmp_string->str);
-                                    fg_normal = TRUE;
-                                }
-                            }
-                        }
-                    }
-                }
-                /* Check whether we can stop parsing because all colors have been retrieved somehow */
-                if (bg_normal && bg_selected && fg_normal)
-                    break;
+                fallback[color] = gtkrc_scan_color (&cursor, end, value);
             }
-        close (file);
-        }
-    }
 
-    g_slist_foreach (read_files, (GFunc) (void (*)(void)) g_free, NULL);
-    g_slist_free (read_files);
+            fg_normal = fallback[COLOR_FG] != NULL;
+            bg_normal = fallback[COLOR_BG] != NULL;
+            bg_selected = fallback[COLOR_SELECTED_BG] != NULL;
+        }
 
-    g_scanner_destroy (scanner);
+        /* Check whether we can stop parsing because all colors have been retrieved somehow */
+        if (bg_normal && bg_selected && fg_normal)
+            break;
+    }
 
     /* Use the fallback colors parsed from the theme if gtk-color-scheme is not defined */
-    /*
-    if (!result)
-        result = fallback;
-    */
     if (result_string->len == 0)
-        result = g_strdup(fallback_string->str);
-    else
-        result = g_strdup(result_string->str);
+    {
+        for (i = 0; i < NUM_SYMBOLIC_COLORS; i++)
+        {
+            if (fallback[i] != NULL)
+                g_string_append_printf (result_string, "\n%s:%s", symbolic_color_names[i], fallback[i]);
+        }
+    }
+
+    for (i = 0; i < NUM_SYMBOLIC_COLORS; i++)
+        g_free (fallback[i]);
 
-    g_string_free(result_string, TRUE);
-    g_string_free(fallback_string, TRUE);
-    g_string_free(tmp_string, TRUE);
+    result = g_string_free (result_string, FALSE);
+    g_string_free (value, TRUE);
+    g_free (contents);
 
     return result;
 }
 
+static GKeyFile *
+gtkrc_color_cache_load (void)
+{
+    GKeyFile *cache;
+    gchar    *filename;
+
+    cache = g_key_file_new ();
+
+    filename = xfce_resource_lookup (XFCE_RESOURCE_CACHE, GTKRC_COLOR_CACHE);
+    if (filename != NULL)
+    {
+        /* A missing or broken cache simply means all themes are scanned */
+        g_key_file_load_from_file (cache, filename, G_KEY_FILE_NONE, NULL);
+        g_free (filename);
+    }
+
+    return cache;
+}
+
+static void
+gtkrc_color_cache_save (GKeyFile *cache)
+{
+    gchar  *filename;
+    gchar  *data;
+    gsize   length;
+    GError *error = NULL;
+
+    filename = xfce_resource_save_location (XFCE_RESOURCE_CACHE, GTKRC_COLOR_CACHE, TRUE);
+    if (G_UNLIKELY (filename == NULL))
+        return;
+
+    data = g_key_file_to_data (cache, &length, NULL);
+    if (!g_file_set_contents (filename, data, length, &error))
+    {
+        g_warning ("Failed to save the gtkrc color cache: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+    g_free (filename);
+}
+
+/* Return the color scheme of the gtkrc, from the old cache if the file did not change
+ * since. The result is stored in the new cache, so uninstalled themes are dropped */
+static gchar *
+gtkrc_color_cache_lookup (GKeyFile    *old_cache,
+                          GKeyFile    *new_cache,
+                          const gchar *gtkrc_filename,
+                          gboolean    *changed)
+{
+    struct stat  st;
+    gchar       *mtime = NULL;
+    gchar       *cached_mtime;
+    gchar       *color_scheme = NULL;
+
+    if (g_stat (gtkrc_filename, &st) == 0)
+    {
+        mtime = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) st.st_mtime);
+
+        cached_mtime = g_key_file_get_string (old_cache, gtkrc_filename, "MTime", NULL);
+        if (g_strcmp0 (mtime, cached_mtime) == 0)
+            color_scheme = g_key_file_get_string (old_cache, gtkrc_filename, "ColorScheme", NULL);
+        g_free (cached_mtime);
+    }
+
+    if (color_scheme == NULL)
+    {
+        color_scheme = gtkrc_get_color_scheme_for_theme (gtkrc_filename);
+        *changed = TRUE;
+    }
+
+    if (mtime != NULL)
+    {
+        g_key_file_set_string (new_cache, gtkrc_filename, "MTime", mtime);
+        g_key_file_set_string (new_cache, gtkrc_filename, "ColorScheme", color_scheme);
+        g_free (mtime);
+    }
+
+    return color_scheme;
+}
+
 gboolean
 color_scheme_parse_colors (const gchar *scheme, GdkColor *colors)
 {
@@ -450,39 +587,34 @@ color_scheme_parse_colors (const gchar *scheme, GdkColor *colors)
     return found;
 }
 
+static void
+theme_preview_fill_stripe (GdkPixbuf *preview,
+                           gint       x,
+                           gint       width,
+                           GdkColor  *color)
+{
+    GdkPixbuf *stripe;
+
+    stripe = gdk_pixbuf_new_subpixbuf (preview, x, 0, width, gdk_pixbuf_get_height (preview));
+    gdk_pixbuf_fill (stripe, ((guint32) (color->red >> 8) << 24)
+                             | ((guint32) (color->green >> 8) << 16)
+                             | ((guint32) (color->blue >> 8) << 8)
+                             | 0xff);
+    g_object_unref (stripe);
+}
+
 static GdkPixbuf *
 theme_create_preview (GdkColor *colors)
 {
     GdkPixbuf *theme_preview;
-    GdkPixmap *drawable;
-    GdkColormap *cmap = gdk_colormap_get_system ();
-    cairo_t *cr;
-    gint width = 44;
-    gint height = 22;
-
-    drawable = gdk_pixmap_new (gdk_get_default_root_window(), width, height,
-                               gdk_drawable_get_depth (gdk_get_default_root_window ()));
-    cr = gdk_cairo_create (drawable);
-    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 
-    /* Draw three rectangles showcasing the background, foreground and selected background colors */
-    cairo_rectangle (cr, 0, 0, 16, 22);
-    cairo_set_source_rgb (cr, colors[COLOR_BG].red / 65535.0, colors[COLOR_BG].green / 65535.0, colors[COLOR_BG].blue / 65535.0);
-    cairo_fill (cr);
+    /* Rendered in client memory, so there is no round trip to the X server per theme */
+    theme_preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, THEME_PREVIEW_WIDTH, THEME_PREVIEW_HEIGHT);
 
-    cairo_rectangle (cr, 15, 0, 30, 22);
-    cairo_set_source_rgb (cr, colors[COLOR_FG].red / 65535.0, colors[COLOR_FG].green / 65535.0, colors[COLOR_FG].blue / 65535.0);
-    cairo_fill (cr);
-
-    cairo_rectangle (cr, 29, 0, 42, 22);
-    cairo_set_source_rgb (cr, colors[COLOR_SELECTED_BG].red / 65535.0, colors[COLOR_SELECTED_BG].green / 65535.0, colors[COLOR_SELECTED_BG].blue / 65535.0);
-    cairo_fill (cr);
-
-    theme_preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
-    gdk_pixbuf_get_from_drawable (theme_preview, drawable, cmap, 0, 0, 0, 0, width, height);
-
-    g_object_unref (drawable);
-    cairo_destroy (cr);
+    /* Draw three stripes showcasing the background, foreground and selected background colors */
+    theme_preview_fill_stripe (theme_preview, 0, 15, &colors[COLOR_BG]);
+    theme_preview_fill_stripe (theme_preview, 15, 14, &colors[COLOR_FG]);
+    theme_preview_fill_stripe (theme_preview, 29, THEME_PREVIEW_WIDTH - 29, &colors[COLOR_SELECTED_BG]);
 
     return theme_preview;
 }
@@ -641,48 +773,197 @@ cb_enable_event_sounds_check_button_toggled (GtkToggleButton *toggle, GtkWidget
 }
 #endif
 
+/* Theme directories which are watched for changes, one for each theme list */
+typedef struct
+{
+    XfceResourceType  type;
+    GtkTreeView      *tree_view;
+    GSList           *monitors;
+
+    /* Names of the themes that changed since the last update */
+    GHashTable       *pending;
+    guint             timeout_id;
+
+    /* Theme directories that did not hold a valid theme yet */
+    GHashTable       *retry;
+} theme_watch;
+
+static theme_watch icon_theme_watch = { XFCE_RESOURCE_ICONS, NULL, NULL, NULL, 0, NULL };
+static theme_watch ui_theme_watch = { XFCE_RESOURCE_THEMES, NULL, NULL, NULL, 0, NULL };
+
+static gchar **
+appearance_settings_theme_dirs (XfceResourceType type)
+{
+    gchar **theme_dirs;
+
+    /* Determine directories to look in for themes */
+    if (type == XFCE_RESOURCE_ICONS)
+        xfce_resource_push_path (type, DATADIR G_DIR_SEPARATOR_S "icons");
+    else
+        xfce_resource_push_path (type, DATADIR G_DIR_SEPARATOR_S "themes");
+    theme_dirs = xfce_resource_dirs (type);
+    xfce_resource_pop_path (type);
+
+    return theme_dirs;
+}
+
+static void
+appearance_settings_select_theme (GtkListStore *list_store,
+                                  GtkTreeView  *tree_view,
+                                  GtkTreeIter  *iter)
+{
+    GtkTreePath *tree_path;
+
+    tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (list_store), iter);
+    gtk_tree_selection_select_path (gtk_tree_view_get_selection (tree_view), tree_path);
+    gtk_tree_view_scroll_to_cell (tree_view, tree_path, NULL, TRUE, 0.5, 0);
+    gtk_tree_path_free (tree_path);
+}
+
 static gboolean
-appearance_settings_load_icon_themes (preview_data *pd)
+appearance_settings_load_icon_theme (GtkListStore *list_store,
+                                     GtkTreeView  *tree_view,
+                                     GtkTreeIter  *update_iter,
+                                     const gchar  *theme_dir,
+                                     const gchar  *file,
+                                     const gchar  *active_theme_name)
 {
-    GtkListStore *list_store;
-    GtkTreeView  *tree_view;
-    GDir         *dir;
-    GtkTreePath  *tree_path;
     GtkTreeIter   iter;
     XfceRc       *index_file;
-    const gchar  *file;
-    gchar       **icon_theme_dirs;
     gchar        *index_filename;
     const gchar  *theme_name;
     const gchar  *theme_comment;
     gchar        *name_escaped;
     gchar        *comment_escaped;
     gchar        *visible_name;
-    gchar        *active_theme_name;
-    gsize         i;
     gsize         p;
-    GSList       *check_list = NULL;
     gchar        *cache_filename;
     gboolean      has_cache;
     gchar        *cache_tooltip;
     GtkIconTheme *icon_theme;
     GdkPixbuf    *preview;
     GdkPixbuf    *icon;
+    gboolean      is_valid;
     gchar*        preview_icons[4] = { "folder", "go-down", "audio-volume-high", "web-browser" };
     int           coords[4][2] = { { 4, 4 }, { 24, 4 }, { 4, 24 }, { 24, 24 } };
 
+    /* Build filename for the index.theme of the current icon theme directory */
+    index_filename = g_build_filename (theme_dir, file, "index.theme", NULL);
+
+    /* Try to open the theme index file */
+    index_file = xfce_rc_simple_open (index_filename, TRUE);
+    g_free (index_filename);
+
+    if (index_file == NULL)
+        return FALSE;
+
+    /* Set the icon theme group */
+    xfce_rc_set_group (index_file, "Icon Theme");
+
+    /* Check if the icon theme is valid and visible to the user */
+    is_valid = xfce_rc_has_entry (index_file, "Directories")
+               && !xfce_rc_read_bool_entry (index_file, "Hidden", FALSE);
+
+    if (G_LIKELY (is_valid))
+    {
+        /* Create the icon-theme preview */
+        preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 44, 44);
+        gdk_pixbuf_fill (preview, 0x00);
+        icon_theme = gtk_icon_theme_new ();
+        gtk_icon_theme_set_custom_theme (icon_theme, file);
+
+        for (p = 0; p < 4; p++)
+        {
+            icon = NULL;
+            if (gtk_icon_theme_has_icon (icon_theme, preview_icons[p]))
+                icon = gtk_icon_theme_load_icon (icon_theme, preview_icons[p], 16, 0, NULL);
+            else if (gtk_icon_theme_has_icon (icon_theme, "image-missing"))
+                icon = gtk_icon_theme_load_icon (icon_theme, "image-missing", 16, 0, NULL);
+
+            if (icon)
+            {
+                gdk_pixbuf_copy_area (icon, 0, 0, 16, 16, preview, coords[p][0], coords[p][1]);
+                g_object_unref (icon);
+            }
+        }
+
+        /* Get translated icon theme name and comment */
+        theme_name = xfce_rc_read_entry (index_file, "Name", file);
+        theme_comment = xfce_rc_read_entry (index_file, "Comment", NULL);
+
+        /* Escape the theme's name and comment, since they are markup, not text */
+        name_escaped = g_markup_escape_text (theme_name, -1);
+        comment_escaped = theme_comment ? g_markup_escape_text (theme_comment, -1) : NULL;
+        visible_name = g_strdup_printf ("<b>%s</b>\n%s", name_escaped, comment_escaped);
+        g_free (name_escaped);
+        g_free (comment_escaped);
+
+        /* Cache filename */
+        cache_filename = g_build_filename (theme_dir, file, "icon-theme.cache", NULL);
+        has_cache = g_file_test (cache_filename, G_FILE_TEST_IS_REGULAR);
+        g_free (cache_filename);
+
+        /* If the theme has no cache, mention this in the tooltip */
+        if (!has_cache)
+            cache_tooltip = g_strdup_printf (_("Warning: this icon theme has no cache file. You can create this by "
+                                               "running <i>gtk-update-icon-cache %s/%s/</i> in a terminal emulator."),
+                                             theme_dir, file);
+        else
+            cache_tooltip = NULL;
+
+        /* Append icon theme to the list store, or update the existing row */
+        if (update_iter == NULL)
+        {
+            gtk_list_store_append (list_store, &iter);
+            update_iter = &iter;
+        }
+        gtk_list_store_set (list_store, update_iter,
+                            COLUMN_THEME_PREVIEW, preview,
+                            COLUMN_THEME_NAME, file,
+                            COLUMN_THEME_DISPLAY_NAME, visible_name,
+                            COLUMN_THEME_NO_CACHE, !has_cache,
+                            COLUMN_THEME_COMMENT, cache_tooltip,
+                            -1);
+
+        /* Check if this is the active theme, if so, select it */
+        if (G_UNLIKELY (g_utf8_collate (file, active_theme_name) == 0))
+            appearance_settings_select_theme (list_store, tree_view, update_iter);
+
+        g_free (visible_name);
+        g_free (cache_tooltip);
+        g_object_unref (icon_theme);
+        g_object_unref (preview);
+    }
+
+    /* Close theme index file */
+    xfce_rc_close (index_file);
+
+    return is_valid;
+}
+
+static gboolean
+appearance_settings_load_icon_themes (preview_data *pd)
+{
+    GDir         *dir;
+    const gchar  *file;
+    gchar       **icon_theme_dirs;
+    gchar        *active_theme_name;
+    gsize         i;
+    GHashTable   *check_table;
+
     g_return_val_if_fail (pd != NULL, FALSE);
 
-    list_store = pd->list_store;
-    tree_view = pd->tree_view;
+    /* Drop rows the directory watch added since the list was cleared */
+    gtk_list_store_clear (pd->list_store);
 
     /* Determine current theme */
     active_theme_name = blconf_channel_get_string (xsettings_channel, "/Net/IconThemeName", "Rodent");
 
     /* Determine directories to look in for icon themes */
-    xfce_resource_push_path (XFCE_RESOURCE_ICONS, DATADIR G_DIR_SEPARATOR_S "icons");
-    icon_theme_dirs = xfce_resource_dirs (XFCE_RESOURCE_ICONS);
-    xfce_resource_pop_path (XFCE_RESOURCE_ICONS);
+    icon_theme_dirs = appearance_settings_theme_dirs (XFCE_RESOURCE_ICONS);
+
+    /* Themes already in the list, the first base directory wins */
+    check_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
     /* Iterate over all base directories */
     for (i = 0; icon_theme_dirs[i] != NULL; ++i)
@@ -697,100 +978,13 @@ appearance_settings_load_icon_themes (preview_data *pd)
         /* Iterate over filenames in the directory */
         while ((file = g_dir_read_name (dir)) != NULL)
         {
-            /* Build filename for the index.theme of the current icon theme directory */
-            index_filename = g_build_filename (icon_theme_dirs[i], file, "index.theme", NULL);
-
-            /* Try to open the theme index file */
-            index_file = xfce_rc_simple_open (index_filename, TRUE);
-
-            if (index_file != NULL
-                && g_slist_find_custom (check_list, file, (GCompareFunc) g_utf8_collate) == NULL)
-            {
-                /* Set the icon theme group */
-                xfce_rc_set_group (index_file, "Icon Theme");
-
-                /* Check if the icon theme is valid and visible to the user */
-                if (G_LIKELY (xfce_rc_has_entry (index_file, "Directories")
-                              && !xfce_rc_read_bool_entry (index_file, "Hidden", FALSE)))
-                {
-                    /* Insert the theme in the check list */
-                    check_list = g_slist_prepend (check_list, g_strdup (file));
-
-                    /* Create the icon-theme preview */
-                    preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 44, 44);
-                    gdk_pixbuf_fill (preview, 0x00);
-                    icon_theme = gtk_icon_theme_new ();
-                    gtk_icon_theme_set_custom_theme (icon_theme, file);
-
-                    for (p = 0; p < 4; p++)
-                    {
-                        icon = NULL;
-                        if (gtk_icon_theme_has_icon (icon_theme, preview_icons[p]))
-                            icon = gtk_icon_theme_load_icon (icon_theme, preview_icons[p], 16, 0, NULL);
-                        else if (gtk_icon_theme_has_icon (icon_theme, "image-missing"))
-                            icon = gtk_icon_theme_load_icon (icon_theme, "image-missing", 16, 0, NULL);
-
-                        if (icon)
-                        {
-                            gdk_pixbuf_copy_area (icon, 0, 0, 16, 16, preview, coords[p][0], coords[p][1]);
-                            g_object_unref (icon);
-                        }
-                    }
-
-                    /* Get translated icon theme name and comment */
-                    theme_name = xfce_rc_read_entry (index_file, "Name", file);
-                    theme_comment = xfce_rc_read_entry (index_file, "Comment", NULL);
-
-                    /* Escape the theme's name and comment, since they are markup, not text */
-                    name_escaped = g_markup_escape_text (theme_name, -1);
-                    comment_escaped = theme_comment ? g_markup_escape_text (theme_comment, -1) : NULL;
-                    visible_name = g_strdup_printf ("<b>%s</b>\n%s", name_escaped, comment_escaped);
-                    g_free (name_escaped);
-                    g_free (comment_escaped);
-
-                    /* Cache filename */
-                    cache_filename = g_build_filename (icon_theme_dirs[i], file, "icon-theme.cache", NULL);
-                    has_cache = g_file_test (cache_filename, G_FILE_TEST_IS_REGULAR);
-                    g_free (cache_filename);
-
-                    /* If the theme has no cache, mention this in the tooltip */
-                    if (!has_cache)
-                        cache_tooltip = g_strdup_printf (_("Warning: this icon theme has no cache file. You can create this by "
-                                                           "running <i>gtk-update-icon-cache %s/%s/</i> in a terminal emulator."),
-                                                         icon_theme_dirs[i], file);
-                    else
-                        cache_tooltip = NULL;
-
-                    /* Append icon theme to the list store */
-                    gtk_list_store_append (list_store, &iter);
-                    gtk_list_store_set (list_store, &iter,
-                                        COLUMN_THEME_PREVIEW, preview,
-                                        COLUMN_THEME_NAME, file,
-                                        COLUMN_THEME_DISPLAY_NAME, visible_name,
-                                        COLUMN_THEME_NO_CACHE, !has_cache,
-                                        COLUMN_THEME_COMMENT, cache_tooltip,
-                                        -1);
-
-                    /* Check if this is the active theme, if so, select it */
-                    if (G_UNLIKELY (g_utf8_collate (file, active_theme_name) == 0))
-                    {
-                        tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (list_store), &iter);
-                        gtk_tree_selection_select_path (gtk_tree_view_get_selection (tree_view), tree_path);
-                        gtk_tree_view_scroll_to_cell (tree_view, tree_path, NULL, TRUE, 0.5, 0);
-                        gtk_tree_path_free (tree_path);
-                    }
-
-                    g_object_unref (icon_theme);
-                    g_object_unref (preview);
-                }
-            }
-
-            /* Close theme index file */
-            if (G_LIKELY (index_file))
-                xfce_rc_close (index_file);
+            if (g_hash_table_lookup (check_table, file) != NULL)
+                continue;
 
-            /* Free theme index filename */
-            g_free (index_filename);
+            /* Append the icon theme and insert it in the check table if it is valid */
+            if (appearance_settings_load_icon_theme (pd->list_store, pd->tree_view, NULL,
+                                                     icon_theme_dirs[i], file, active_theme_name))
+                g_hash_table_insert (check_table, g_strdup (file), GINT_TO_POINTER (TRUE));
         }
 
         /* Close directory handle */
@@ -803,51 +997,139 @@ appearance_settings_load_icon_themes (preview_data *pd)
     /* Free list of base directories */
     g_strfreev (icon_theme_dirs);
 
-    /* Free the check list */
-    if (G_LIKELY (check_list))
-    {
-        g_slist_foreach (check_list, (GFunc) (void (*)(void)) g_free, NULL);
-        g_slist_free (check_list);
-    }
+    /* Free the check table */
+    g_hash_table_destroy (check_table);
 
     return FALSE;
 }
 
 static gboolean
-appearance_settings_load_ui_themes (preview_data *pd)
+appearance_settings_load_ui_theme (GtkListStore *list_store,
+                                   GtkTreeView  *tree_view,
+                                   GtkTreeIter  *update_iter,
+                                   const gchar  *theme_dir,
+                                   const gchar  *file,
+                                   const gchar  *active_theme_name,
+                                   GKeyFile     *old_color_cache,
+                                   GKeyFile     *new_color_cache,
+                                   gboolean     *color_cache_changed)
 {
-    GtkListStore *list_store;
-    GtkTreeView  *tree_view;
-    GDir         *dir;
-    GtkTreePath  *tree_path;
     GtkTreeIter   iter;
     XfceRc       *index_file;
-    const gchar  *file;
-    gchar       **ui_theme_dirs;
     gchar        *index_filename;
     const gchar  *theme_name;
     const gchar  *theme_comment;
-    gchar        *active_theme_name;
     gchar        *gtkrc_filename;
     gchar        *comment_escaped;
-    gint          i;
-    GSList       *check_list = NULL;
-    gchar        *color_scheme = NULL;
+    gchar        *color_scheme;
     GdkPixbuf    *preview;
     GdkColor      colors[NUM_SYMBOLIC_COLORS];
 
+    /* Build the theme style filename */
+    gtkrc_filename = g_build_filename (theme_dir, file, "gtk-2.0", "gtkrc", NULL);
+
+    /* Check if the gtkrc file exists */
+    if (!g_file_test (gtkrc_filename, G_FILE_TEST_EXISTS))
+    {
+        g_free (gtkrc_filename);
+        return FALSE;
+    }
+
+    /* Build filename for the index.theme of the current ui theme directory */
+    index_filename = g_build_filename (theme_dir, file, "index.theme", NULL);
+
+    /* Try to open the theme index file */
+    index_file = xfce_rc_simple_open (index_filename, TRUE);
+
+    if (G_LIKELY (index_file != NULL))
+    {
+        /* Get translated ui theme name and comment */
+        theme_name = xfce_rc_read_entry (index_file, "Name", file);
+        theme_comment = xfce_rc_read_entry (index_file, "Comment", NULL);
+
+        /* Escape the comment because tooltips are markup, not text */
+        comment_escaped = theme_comment ? g_markup_escape_text (theme_comment, -1) : NULL;
+    }
+    else
+    {
+        /* Set defaults */
+        theme_name = file;
+        comment_escaped = NULL;
+    }
+
+    /* Retrieve the color values from the theme, parse them and create the palette preview pixbuf */
+    color_scheme = gtkrc_color_cache_lookup (old_color_cache, new_color_cache,
+                                             gtkrc_filename, color_cache_changed);
+    if (color_scheme_parse_colors (color_scheme, colors))
+        preview = theme_create_preview (colors);
+    /* If the color scheme parsing doesn't return anything useful, show a blank pixbuf */
+    else
+    {
+        preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, THEME_PREVIEW_WIDTH, THEME_PREVIEW_HEIGHT);
+        gdk_pixbuf_fill (preview, 0x00);
+    }
+    g_free (color_scheme);
+
+    /* Append ui theme to the list store, or update the existing row */
+    if (update_iter == NULL)
+    {
+        gtk_list_store_append (list_store, &iter);
+        update_iter = &iter;
+    }
+    gtk_list_store_set (list_store, update_iter,
+                        COLUMN_THEME_PREVIEW, preview,
+                        COLUMN_THEME_NAME, file,
+                        COLUMN_THEME_DISPLAY_NAME, theme_name,
+                        COLUMN_THEME_COMMENT, comment_escaped, -1);
+
+    /* Cleanup */
+    if (G_LIKELY (index_file != NULL))
+        xfce_rc_close (index_file);
+    g_free (comment_escaped);
+    g_object_unref (preview);
+
+    /* Check if this is the active theme, if so, select it */
+    if (G_UNLIKELY (g_utf8_collate (file, active_theme_name) == 0))
+        appearance_settings_select_theme (list_store, tree_view, update_iter);
+
+    /* Free theme index and gtkrc filenames */
+    g_free (index_filename);
+    g_free (gtkrc_filename);
+
+    return TRUE;
+}
+
+static gboolean
+appearance_settings_load_ui_themes (preview_data *pd)
+{
+    GDir         *dir;
+    const gchar  *file;
+    gchar       **ui_theme_dirs;
+    gchar        *active_theme_name;
+    gint          i;
+    GHashTable   *check_table;
+    GKeyFile     *old_color_cache;
+    GKeyFile     *new_color_cache;
+    gboolean      color_cache_changed = FALSE;
+    gsize         n_old_themes, n_new_themes;
+
     g_return_val_if_fail (pd != NULL, FALSE);
 
-    list_store = pd->list_store;
-    tree_view = pd->tree_view;
+    /* Drop rows the directory watch added since the list was cleared */
+    gtk_list_store_clear (pd->list_store);
 
     /* Determine current theme */
     active_theme_name = blconf_channel_get_string (xsettings_channel, "/Net/ThemeName", "Default");
 
     /* Determine directories to look in for ui themes */
-    xfce_resource_push_path (XFCE_RESOURCE_THEMES, DATADIR G_DIR_SEPARATOR_S "themes");
-    ui_theme_dirs = xfce_resource_dirs (XFCE_RESOURCE_THEMES);
-    xfce_resource_pop_path (XFCE_RESOURCE_THEMES);
+    ui_theme_dirs = appearance_settings_theme_dirs (XFCE_RESOURCE_THEMES);
+
+    /* Themes already in the list, the first base directory wins */
+    check_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Colors of the themes found last time */
+    old_color_cache = gtkrc_color_cache_load ();
+    new_color_cache = g_key_file_new ();
 
     /* Iterate over all base directories */
     for (i = 0; ui_theme_dirs[i] != NULL; ++i)
@@ -862,79 +1144,15 @@ appearance_settings_load_ui_themes (preview_data *pd)
         /* Iterate over filenames in the directory */
         while ((file = g_dir_read_name (dir)) != NULL)
         {
-            /* Build the theme style filename */
-            gtkrc_filename = g_build_filename (ui_theme_dirs[i], file, "gtk-2.0", "gtkrc", NULL);
-
-            /* Check if the gtkrc file exists and the theme is not already in the list */
-            if (g_file_test (gtkrc_filename, G_FILE_TEST_EXISTS)
-                && g_slist_find_custom (check_list, file, (GCompareFunc) g_utf8_collate) == NULL)
-            {
-                /* Insert the theme in the check list */
-                check_list = g_slist_prepend (check_list, g_strdup (file));
-
-                /* Build filename for the index.theme of the current ui theme directory */
-                index_filename = g_build_filename (ui_theme_dirs[i], file, "index.theme", NULL);
-
-                /* Try to open the theme index file */
-                index_file = xfce_rc_simple_open (index_filename, TRUE);
-
-                if (G_LIKELY (index_file != NULL))
-                {
-                    /* Get translated ui theme name and comment */
-                    theme_name = xfce_rc_read_entry (index_file, "Name", file);
-                    theme_comment = xfce_rc_read_entry (index_file, "Comment", NULL);
-
-                    /* Escape the comment because tooltips are markup, not text */
-                    comment_escaped = theme_comment ? g_markup_escape_text (theme_comment, -1) : NULL;
-                }
-                else
-                {
-                    /* Set defaults */
-                    theme_name = file;
-                    comment_escaped = NULL;
-                }
-
-                /* Retrieve the color values from the theme, parse them and create the palette preview pixbuf */
-                color_scheme = gtkrc_get_color_scheme_for_theme (gtkrc_filename);
-                if (color_scheme_parse_colors (color_scheme, colors))
-                    preview = theme_create_preview (colors);
-                /* If the color scheme parsing doesn't return anything useful, show a blank pixbuf */
-                else
-                {
-                    preview = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 44, 22);
-                    gdk_pixbuf_fill (preview, 0x00);
-                }
-                g_free (color_scheme);
-
-                /* Append ui theme to the list store */
-                gtk_list_store_append (list_store, &iter);
-                gtk_list_store_set (list_store, &iter,
-                                    COLUMN_THEME_PREVIEW, preview,
-                                    COLUMN_THEME_NAME, file,
-                                    COLUMN_THEME_DISPLAY_NAME, theme_name,
-                                    COLUMN_THEME_COMMENT, comment_escaped, -1);
-
-                /* Cleanup */
-                if (G_LIKELY (index_file != NULL))
-                    xfce_rc_close (index_file);
-                g_free (comment_escaped);
-                g_object_unref (preview);
-
-                /* Check if this is the active theme, if so, select it */
-                if (G_UNLIKELY (g_utf8_collate (file, active_theme_name) == 0))
-                {
-                    tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (list_store), &iter);
-                    gtk_tree_selection_select_path (gtk_tree_view_get_selection (tree_view), tree_path);
-                    gtk_tree_view_scroll_to_cell (tree_view, tree_path, NULL, TRUE, 0.5, 0);
-                    gtk_tree_path_free (tree_path);
-                }
-
-                /* Free theme index filename */
-                g_free (index_filename);
-            }
-
-            /* Free gtkrc filename */
-            g_free (gtkrc_filename);
+            if (g_hash_table_lookup (check_table, file) != NULL)
+                continue;
+
+            /* Append the ui theme and insert it in the check table if it has a gtkrc file */
+            if (appearance_settings_load_ui_theme (pd->list_store, pd->tree_view, NULL,
+                                                   ui_theme_dirs[i], file, active_theme_name,
+                                                   old_color_cache, new_color_cache,
+                                                   &color_cache_changed))
+                g_hash_table_insert (check_table, g_strdup (file), GINT_TO_POINTER (TRUE));
         }
 
         /* Close directory handle */
@@ -947,16 +1165,250 @@ appearance_settings_load_ui_themes (preview_data *pd)
     /* Free list of base directories */
     g_strfreev (ui_theme_dirs);
 
-    /* Free the check list */
-    if (G_LIKELY (check_list))
+    /* Only write the cache if a theme was scanned or removed */
+    g_strfreev (g_key_file_get_groups (old_color_cache, &n_old_themes));
+    g_strfreev (g_key_file_get_groups (new_color_cache, &n_new_themes));
+    if (color_cache_changed || n_old_themes != n_new_themes)
+        gtkrc_color_cache_save (new_color_cache);
+
+    g_key_file_free (old_color_cache);
+    g_key_file_free (new_color_cache);
+
+    /* Free the check table */
+    g_hash_table_destroy (check_table);
+
+    return FALSE;
+}
+
+static gboolean
+appearance_settings_find_theme (GtkTreeModel *model,
+                                const gchar  *name,
+                                GtkTreeIter  *iter)
+{
+    gboolean  valid;
+    gchar    *theme_name;
+    gboolean  found;
+
+    for (valid = gtk_tree_model_get_iter_first (model, iter);
+         valid;
+         valid = gtk_tree_model_iter_next (model, iter))
     {
-        g_slist_foreach (check_list, (GFunc) (void (*)(void)) g_free, NULL);
-        g_slist_free (check_list);
+        gtk_tree_model_get (model, iter, COLUMN_THEME_NAME, &theme_name, -1);
+        found = (g_strcmp0 (theme_name, name) == 0);
+        g_free (theme_name);
+
+        if (found)
+            return TRUE;
     }
 
     return FALSE;
 }
 
+static gboolean theme_watch_update (gpointer user_data);
+
+static void
+theme_watch_queue (theme_watch *watch,
+                   const gchar *name)
+{
+    GHashTableIter  iter;
+    gpointer        retry_name;
+
+    if (name != NULL)
+        g_hash_table_insert (watch->pending, g_strdup (name), GINT_TO_POINTER (TRUE));
+
+    /* Incomplete themes are checked again on every change */
+    g_hash_table_iter_init (&iter, watch->retry);
+    while (g_hash_table_iter_next (&iter, &retry_name, NULL))
+        g_hash_table_insert (watch->pending, g_strdup (retry_name), GINT_TO_POINTER (TRUE));
+
+    /* Wait for things to settle down, an install touches a theme many times */
+    if (watch->timeout_id != 0)
+        g_source_remove (watch->timeout_id);
+    watch->timeout_id = g_timeout_add (500, theme_watch_update, watch);
+}
+
+/* Whether a directory with this name exists in any base directory */
+static gboolean
+theme_watch_theme_exists (gchar       **theme_dirs,
+                          const gchar  *name)
+{
+    gint      i;
+    gchar    *path;
+    gboolean  exists = FALSE;
+
+    for (i = 0; !exists && theme_dirs[i] != NULL; ++i)
+    {
+        path = g_build_filename (theme_dirs[i], name, NULL);
+        exists = g_file_test (path, G_FILE_TEST_IS_DIR);
+        g_free (path);
+    }
+
+    return exists;
+}
+
+static gboolean
+theme_watch_update (gpointer user_data)
+{
+    theme_watch    *watch = user_data;
+    GtkListStore   *list_store;
+    GtkTreeIter     iter;
+    GHashTableIter  pending_iter;
+    gpointer        name;
+    gchar         **theme_dirs;
+    gchar          *active_theme_name;
+    gboolean        found, loaded;
+    gint            i;
+    GKeyFile       *color_cache = NULL;
+    gboolean        color_cache_changed = FALSE;
+
+    list_store = GTK_LIST_STORE (gtk_tree_view_get_model (watch->tree_view));
+    theme_dirs = appearance_settings_theme_dirs (watch->type);
+
+    if (watch->type == XFCE_RESOURCE_ICONS)
+    {
+        active_theme_name = blconf_channel_get_string (xsettings_channel, "/Net/IconThemeName", "Rodent");
+    }
+    else
+    {
+        active_theme_name = blconf_channel_get_string (xsettings_channel, "/Net/ThemeName", "Default");
+        color_cache = gtkrc_color_cache_load ();
+    }
+
+    /* Only reload the themes that changed, the rest of the list is untouched */
+    g_hash_table_iter_init (&pending_iter, watch->pending);
+    while (g_hash_table_iter_next (&pending_iter, &name, NULL))
+    {
+        found = appearance_settings_find_theme (GTK_TREE_MODEL (list_store), name, &iter);
+
+        /* Use the first base directory that has a valid theme with this name */
+        for (i = 0, loaded = FALSE; !loaded && theme_dirs[i] != NULL; ++i)
+        {
+            if (watch->type == XFCE_RESOURCE_ICONS)
+                loaded = appearance_settings_load_icon_theme (list_store, watch->tree_view,
+                                                              found ? &iter : NULL,
+                                                              theme_dirs[i], name,
+                                                              active_theme_name);
+            else
+                loaded = appearance_settings_load_ui_theme (list_store, watch->tree_view,
+                                                            found ? &iter : NULL,
+                                                            theme_dirs[i], name,
+                                                            active_theme_name,
+                                                            color_cache, color_cache,
+                                                            &color_cache_changed);
+        }
+
+        /* The theme was removed */
+        if (!loaded && found)
+            gtk_list_store_remove (list_store, &iter);
+
+        /* Check the directory again on the next event if the theme is
+         * still being written, e.g. index.theme or gtkrc is missing */
+        if (loaded || !theme_watch_theme_exists (theme_dirs, name))
+            g_hash_table_remove (watch->retry, name);
+        else
+            g_hash_table_insert (watch->retry, g_strdup (name), GINT_TO_POINTER (TRUE));
+    }
+
+    g_hash_table_remove_all (watch->pending);
+    watch->timeout_id = 0;
+
+    if (color_cache != NULL)
+    {
+        if (color_cache_changed)
+            gtkrc_color_cache_save (color_cache);
+        g_key_file_free (color_cache);
+    }
+
+    g_free (active_theme_name);
+    g_strfreev (theme_dirs);
+
+    return FALSE;
+}
+
+static void
+cb_theme_watch_changed (GFileMonitor      *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event_type,
+                        theme_watch       *watch)
+{
+    gchar *name;
+
+    /* A theme directory was created, removed or touched in the base
+     * directory, a rename arrives as a delete and a create */
+    if (event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT
+        || event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+        return;
+
+    /* Only the theme named by the event is checked again */
+    name = g_file_get_basename (file);
+    theme_watch_queue (watch, name);
+    g_free (name);
+}
+
+static void
+theme_watch_start (theme_watch *watch,
+                   GtkTreeView *tree_view)
+{
+    gchar        **theme_dirs;
+    gint           i;
+    GFile         *dir;
+    GFileMonitor  *monitor;
+
+    watch->tree_view = tree_view;
+    watch->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    watch->retry = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Watch all base directories, including the ones that do not exist yet */
+    theme_dirs = appearance_settings_theme_dirs (watch->type);
+    for (i = 0; theme_dirs[i] != NULL; ++i)
+    {
+        dir = g_file_new_for_path (theme_dirs[i]);
+        monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+        g_object_unref (dir);
+
+        if (G_LIKELY (monitor != NULL))
+        {
+            g_signal_connect (G_OBJECT (monitor), "changed",
+                G_CALLBACK (cb_theme_watch_changed), watch);
+            watch->monitors = g_slist_prepend (watch->monitors, monitor);
+        }
+    }
+    g_strfreev (theme_dirs);
+}
+
+static void
+theme_watch_stop (theme_watch *watch)
+{
+    GSList *li;
+
+    if (watch->timeout_id != 0)
+    {
+        g_source_remove (watch->timeout_id);
+        watch->timeout_id = 0;
+    }
+
+    for (li = watch->monitors; li != NULL; li = li->next)
+    {
+        g_file_monitor_cancel (G_FILE_MONITOR (li->data));
+        g_object_unref (G_OBJECT (li->data));
+    }
+    g_slist_free (watch->monitors);
+    watch->monitors = NULL;
+
+    if (watch->pending != NULL)
+    {
+        g_hash_table_destroy (watch->pending);
+        watch->pending = NULL;
+    }
+
+    if (watch->retry != NULL)
+    {
+        g_hash_table_destroy (watch->retry);
+        watch->retry = NULL;
+    }
+}
+
 static void
 appearance_settings_dialog_channel_property_changed (BlconfChannel *channel,
                                                      const gchar   *property_name,
@@ -1238,7 +1690,9 @@ cb_theme_uri_dropped (GtkWidget        *widget,
     gdk_window_set_cursor (gdkwindow, NULL);
     gdk_cursor_unref (cursor);
 
-    if (something_installed)
+    /* the directory watches pick up the installed themes, only
+     * reload the lists if the theme directories are not watched */
+    if (something_installed && icon_theme_watch.monitors == NULL)
     {
         /* reload icon theme treeview in an idle loop */
         object = gtk_builder_get_object (builder, "icon_theme_treeview");
@@ -1249,7 +1703,10 @@ cb_theme_uri_dropped (GtkWidget        *widget,
                          (GSourceFunc) appearance_settings_load_icon_themes,
                          pd,
                          (GDestroyNotify) preview_data_free);
+    }
 
+    if (something_installed && ui_theme_watch.monitors == NULL)
+    {
         /* reload gtk theme treeview */
         object = gtk_builder_get_object (builder, "gtk_theme_treeview");
         model = gtk_tree_view_get_model (GTK_TREE_VIEW (object));
@@ -1310,6 +1767,9 @@ appearance_settings_dialog_configure_widgets (GtkBuilder *builder)
                      pd,
                      (GDestroyNotify) preview_data_free);
 
+    /* Update the list when icon themes are installed or removed */
+    theme_watch_start (&icon_theme_watch, GTK_TREE_VIEW (object));
+
     g_object_unref (G_OBJECT (list_store));
 
     selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (object));
@@ -1350,6 +1810,9 @@ appearance_settings_dialog_configure_widgets (GtkBuilder *builder)
                      pd,
                      (GDestroyNotify) preview_data_free);
 
+    /* Update the list when ui themes are installed or removed */
+    theme_watch_start (&ui_theme_watch, GTK_TREE_VIEW (object));
+
     g_object_unref (G_OBJECT (list_store));
 
     selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (object));
@@ -1582,6 +2045,10 @@ main (gint argc, gchar **argv)
             g_error_free (error);
         }
 
+        /* Stop watching the theme directories */
+        theme_watch_stop (&icon_theme_watch);
+        theme_watch_stop (&ui_theme_watch);
+
         /* Release Builder */
         g_object_unref (G_OBJECT (builder));
 
@@ -56,9 +56,14 @@ struct Vendor
  *
  * Give back! When contributing vendor names, submit patches upstream
  * to https://git.fedorahosted.org/cgit/hwdata.git/plain/pnp.ids
+ *
+ * Keep the list sorted by vendor code in strcmp() order, find_vendor()
+ * does a binary search.
  */
 static const struct Vendor vendors[] =
 {
+    { "???", "Unknown" },
+
     { "AAA", "Avolites Ltd" },
     { "AAE", "Anatek Electronics Inc." },
     { "AAT", "Ann Arbor Technologies" },
@@ -1133,7 +1138,6 @@ static const struct Vendor vendors[] =
     { "INS", "Ines GmbH" },
     //{ "INT", "Interphase Corporation" },
     { "INT", "Intel" }, // ezix
-    { "inu", "Inovatec S.p.A." },
     { "INV", "Inviso, Inc." },
     { "INX", "Communications Supply Corporation (A division of WESCO)" },
     { "INZ", "Best Buy" },
@@ -2560,65 +2564,84 @@ static const struct Vendor vendors[] =
     //{ "ZZZ", "Boca Research Inc" },
     { "ZZZ", "Boca Research" },
 
-    { "???", "Unknown" },
+    /* lower case sorts after the upper case codes */
+    { "inu", "Inovatec S.p.A." },
 };
 
+/* vendor names found in the pnp.ids file, by code, only for
+ * the codes that were looked up */
 static GHashTable *pnp_ids = NULL;
+static GMappedFile *pnp_ids_file = NULL;
 
-static void
-read_pnp_ids (void)
+static const char *
+find_pnp_id (const char *code)
 {
-    gchar *contents;
-    gchar **lines;
-    gchar *line;
-    gchar *code, *name;
-    gint i;
+    const gchar *contents, *end;
+    const gchar *line, *line_end;
+    gpointer     vendor_name;
 
-    if (pnp_ids)
-        return;
+    if (pnp_ids == NULL)
+    {
+        pnp_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        /* map the file instead of reading and splitting it, only
+         * the lines of the monitors we see are ever touched */
+        pnp_ids_file = g_mapped_file_new (PNP_IDS, FALSE, NULL);
+    }
 
-    pnp_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    if (g_hash_table_lookup_extended (pnp_ids, code, NULL, &vendor_name))
+        return vendor_name;
+
+    vendor_name = NULL;
 
-    if (g_file_get_contents (PNP_IDS, &contents, NULL, NULL))
+    if (pnp_ids_file != NULL)
     {
-        lines = g_strsplit (contents, "\n", -1);
-        for (i = 0; lines[i]; i++)
+        contents = g_mapped_file_get_contents (pnp_ids_file);
+        end = contents + g_mapped_file_get_length (pnp_ids_file);
+
+        for (line = contents; line < end; line = line_end + 1)
         {
-             line = lines[i];
-             if (line[3] == '\t')
-             {
-                 code = line;
-                 line[3] = '\0';
-                 name = line + 4;
-                 g_hash_table_insert (pnp_ids, code, name);
-             }
+            line_end = memchr (line, '\n', end - line);
+            if (line_end == NULL)
+                line_end = end;
+
+            if (line_end - line > 4
+                && line[3] == '\t'
+                && strncmp (line, code, 3) == 0)
+            {
+                vendor_name = g_strndup (line + 4, line_end - line - 4);
+                break;
+            }
         }
-        g_free (lines);
-        g_free (contents);
     }
+
+    /* also remember the codes that are not in the file */
+    g_hash_table_insert (pnp_ids, g_strdup (code), vendor_name);
+
+    return vendor_name;
 }
 
+static int
+compare_vendor (const void *code,
+                const void *vendor)
+{
+    return strcmp (code, ((const Vendor *) vendor)->vendor_id);
+}
 
 static const char *
 find_vendor (const char *code)
 {
     const char *vendor_name;
-    unsigned int i;
-
-    read_pnp_ids ();
+    const Vendor *v;
 
-    vendor_name = g_hash_table_lookup (pnp_ids, code);
+    vendor_name = find_pnp_id (code);
 
     if (vendor_name)
         return vendor_name;
 
-    for (i = 0; i < sizeof (vendors) / sizeof (vendors[0]); ++i)
-    {
-        const Vendor *v = &(vendors[i]);
-
-        if (strcmp (v->vendor_id, code) == 0)
-            return v->vendor_name;
-    }
+    v = bsearch (code, vendors, G_N_ELEMENTS (vendors), sizeof (Vendor), compare_vendor);
+    if (v != NULL)
+        return v->vendor_name;
 
     return code;
 };
@@ -2632,6 +2655,15 @@ make_display_name (const MonitorInfo *info, guint output)
     if (info)
     {
         vendor = find_vendor (info->manufacturer_code);
+
+        /* the vendor is unknown, the product name is better than the code */
+        if (vendor == info->manufacturer_code)
+        {
+            if (info->displayid_product_name[0] != '\0')
+                vendor = info->displayid_product_name;
+            else if (info->dsc_product_name[0] != '\0')
+                vendor = info->dsc_product_name;
+        }
     }
     else
     {
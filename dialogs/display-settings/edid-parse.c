@@ -392,7 +392,9 @@ decode_display_descriptor (const uchar *desc,
             decode_lf_string (desc + 5, 13, info->dsc_string);
             break;
         case 0xFD:
-            /* Range Limits */
+            /* Range Limits, EDID 1.4 adds offsets for rates over 255 Hz */
+            info->min_vrefresh = desc[0x05] + (get_bit (desc[0x04], 0) ? 255 : 0);
+            info->max_vrefresh = desc[0x06] + (get_bit (desc[0x04], 1) ? 255 : 0);
             break;
         case 0xFB:
             /* Color Point */
@@ -477,6 +479,24 @@ decode_detailed_timing (const uchar *timing,
     }
 }
 
+static void
+update_vrefresh (const DetailedTiming *detailed,
+                 MonitorInfo *info)
+{
+    int total, refresh;
+
+    total = (detailed->h_addr + detailed->h_blank) * (detailed->v_addr + detailed->v_blank);
+    if (total <= 0 || detailed->pixel_clock <= 0)
+        return;
+
+    refresh = (detailed->pixel_clock + total / 2) / total;
+
+    if (info->max_vrefresh < refresh)
+        info->max_vrefresh = refresh;
+    if (info->min_vrefresh == -1 || info->min_vrefresh > refresh)
+        info->min_vrefresh = refresh;
+}
+
 static int
 decode_descriptors (const uchar *edid, MonitorInfo *info)
 {
@@ -502,9 +522,109 @@ decode_descriptors (const uchar *edid, MonitorInfo *info)
 
     info->n_detailed_timings = timing_idx;
 
+    for (i = 0; i < timing_idx; ++i)
+        update_vrefresh (&(info->detailed_timings[i]), info);
+
     return TRUE;
 }
 
+static void
+decode_cea_extension (const uchar *ext,
+                      MonitorInfo *info)
+{
+    DetailedTiming detailed;
+    int dtd_offset = ext[0x02];
+    int i, tag, len;
+
+    info->has_cea_extension = TRUE;
+
+    /* No data blocks and no detailed timings */
+    if (dtd_offset < 4 || dtd_offset > 127)
+        return;
+
+    /* Data block collection, from byte 4 up to the detailed timings */
+    for (i = 4; i < dtd_offset; i += len + 1)
+    {
+        tag = get_bits (ext[i], 5, 7);
+        len = get_bits (ext[i], 0, 4);
+
+        if (i + len >= dtd_offset)
+            break;
+
+        /* Extended tag, HDR static metadata */
+        if (tag == 7 && len >= 3 && ext[i + 1] == 0x06)
+        {
+            info->hdr_eotfs = get_bits (ext[i + 2], 0, 5);
+
+            if (len >= 4 && ext[i + 4] != 0)
+                info->hdr_max_luminance = 50.0 * pow (2.0, ext[i + 4] / 32.0);
+        }
+    }
+
+    /* Detailed timings, until the padding */
+    for (i = dtd_offset; i + 18 <= 127; i += 18)
+    {
+        if (ext[i] == 0x00 && ext[i + 1] == 0x00)
+            break;
+
+        decode_detailed_timing (ext + i, &detailed);
+        update_vrefresh (&detailed, info);
+    }
+}
+
+static void
+decode_displayid_extension (const uchar *ext,
+                            MonitorInfo *info)
+{
+    int i, end, len, name_len;
+
+    /* Data blocks start after the section header, the section
+     * length does not include the header and checksum */
+    end = MIN (5 + ext[0x02], 127);
+
+    for (i = 5; i + 3 <= end; i += len + 3)
+    {
+        len = ext[i + 2];
+
+        if (i + 3 + len > end)
+            break;
+
+        /* Product identification, DisplayID 1.3 and 2.0 */
+        if ((ext[i] == 0x00 || ext[i] == 0x20) && len >= 12)
+        {
+            name_len = MIN (ext[i + 3 + 11], len - 12);
+            name_len = MIN (name_len, (int) sizeof (info->displayid_product_name) - 1);
+
+            memcpy (info->displayid_product_name, ext + i + 3 + 12, name_len);
+            info->displayid_product_name[name_len] = '\0';
+        }
+    }
+}
+
+static void
+decode_extensions (const uchar *edid,
+                   gsize length,
+                   MonitorInfo *info)
+{
+    int i;
+    const uchar *ext;
+
+    for (i = 1; i <= edid[0x7e] && (gsize) (i + 1) * 128 <= length; ++i)
+    {
+        ext = edid + i * 128;
+
+        switch (ext[0x00])
+        {
+            case 0x02:
+                decode_cea_extension (ext, info);
+                break;
+            case 0x70:
+                decode_displayid_extension (ext, info);
+                break;
+        }
+    }
+}
+
 static void
 decode_check_sum (const uchar *edid,
           MonitorInfo *info)
@@ -519,9 +639,17 @@ decode_check_sum (const uchar *edid,
 }
 
 MonitorInfo *
-decode_edid (const uchar *edid)
+decode_edid (const uchar *edid, gsize length)
 {
-    MonitorInfo *info = g_new0 (MonitorInfo, 1);
+    MonitorInfo *info;
+
+    if (length < 128)
+        return NULL;
+
+    info = g_new0 (MonitorInfo, 1);
+    info->min_vrefresh = -1;
+    info->max_vrefresh = -1;
+    info->hdr_max_luminance = -1;
 
     decode_check_sum (edid, info);
 
@@ -534,6 +662,8 @@ decode_edid (const uchar *edid)
     && decode_standard_timings (edid, info)
     && decode_descriptors (edid, info))
     {
+        decode_extensions (edid, length, info);
+
         return info;
     }
     else
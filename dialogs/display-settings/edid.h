@@ -190,9 +190,30 @@ struct MonitorInfo
     char        dsc_serial_number[14];
     char        dsc_product_name[14];
     char        dsc_string[14];     /* Unspecified ASCII data */
+
+    /* Vertical refresh range in Hz, from the range limits descriptor
+     * and the detailed timings */
+    int         min_vrefresh;       /* -1 if not specified */
+    int         max_vrefresh;       /* -1 if not specified */
+
+    /* CEA-861 extension block */
+    int         has_cea_extension;
+    int         hdr_eotfs;          /* Mask of HdrEotf, 0 if no HDR */
+    int         hdr_max_luminance;  /* cd/m^2, -1 if not specified */
+
+    /* DisplayID product identification, not limited to 13 characters */
+    char        displayid_product_name[64];
 };
 
-MonitorInfo *decode_edid (const uchar *data);
+typedef enum
+{
+    HDR_EOTF_TRADITIONAL_SDR = 1 << 0,
+    HDR_EOTF_TRADITIONAL_HDR = 1 << 1,
+    HDR_EOTF_SMPTE_ST2084    = 1 << 2,
+    HDR_EOTF_HLG             = 1 << 3
+} HdrEotf;
+
+MonitorInfo *decode_edid (const uchar *data, gsize length);
 char *make_display_name (const MonitorInfo *info, guint output);
 
 #endif
@@ -53,6 +53,9 @@
 
 #define MARGIN  16
 
+/* Distance in pixels within which outputs snap to each other */
+#define SNAP_DISTANCE 200
+
 enum
 {
     COLUMN_OUTPUT_NAME,
@@ -145,6 +148,28 @@ gboolean supports_alpha = FALSE;
 GtkWidget *randr_gui_area = NULL;
 GList *current_outputs = NULL;
 
+/* Rendering of an output on the layout canvas, reused until
+ * the appearance of the output changes */
+typedef struct
+{
+    cairo_surface_t *surface;
+    gint             width;
+    gint             height;
+    gdouble          scale;
+    Rotation         rotation;
+    gboolean         on;
+    gboolean         active;
+    gint             mirrored;
+    gdouble          alpha;
+    gchar           *text;
+
+    /* Where the output was painted last, in canvas coordinates */
+    GdkRectangle     area;
+} OutputPaintCache;
+
+static OutputPaintCache *output_paint_cache = NULL;
+static guint n_output_paint_cache = 0;
+
 /* Outputs Combobox TODO Use App() to store constant widgets once the cruft is cleaned */
 GtkWidget *randr_outputs_combobox = NULL;
 GtkWidget *apply_button = NULL;
@@ -189,6 +214,23 @@ get_nth_xfce_output_info(gint id)
     return output;
 }
 
+static void
+output_paint_cache_free (void)
+{
+    guint n;
+
+    for (n = 0; n < n_output_paint_cache; ++n)
+    {
+        if (output_paint_cache[n].surface != NULL)
+            cairo_surface_destroy (output_paint_cache[n].surface);
+        g_free (output_paint_cache[n].text);
+    }
+
+    g_free (output_paint_cache);
+    output_paint_cache = NULL;
+    n_output_paint_cache = 0;
+}
+
 static void
 initialize_connected_outputs (void)
 {
@@ -197,6 +239,9 @@ initialize_connected_outputs (void)
         g_list_free(current_outputs);
         current_outputs = NULL;
     }
+
+    /* The outputs are new, so is their rendering */
+    output_paint_cache_free ();
 }
 
 static guint
@@ -1688,8 +1733,8 @@ struct App
     GtkWidget          *dialog;
 };
 
-static gboolean output_overlaps (XfceOutputInfo *output);
 static void get_geometry (XfceOutputInfo *output, int *w, int *h);
+static void canvas_invalidate_outputs (FooScrollArea *area);
 
 static void
 lay_out_outputs_horizontally (void)
@@ -1888,6 +1933,7 @@ typedef struct Edge
     XfceOutputInfo *output;
     int x1, y1;
     int x2, y2;
+    guint order;        /* Position in the list the edge was added to */
 } Edge;
 
 typedef struct Snap
@@ -1895,6 +1941,7 @@ typedef struct Snap
     Edge *snapper;      /* Edge that should be snapped */
     Edge *snappee;
     int dy, dx;
+    int kind;           /* Which of the snaps of the edge pair this is */
 } Snap;
 
 static void
@@ -1907,6 +1954,7 @@ add_edge (XfceOutputInfo *output, int x1, int y1, int x2, int y2, GArray *edges)
     e.y1 = y1;
     e.y2 = y2;
     e.output = output;
+    e.order = edges->len;
 
     g_array_append_val (edges, e);
 }
@@ -1927,20 +1975,6 @@ list_edges_for_output (XfceOutputInfo *output, GArray *edges)
     add_edge (output, x + w, y, x + w, y + h, edges);
 }
 
-static void
-list_edges (GArray *edges)
-{
-    GList *connected_outputs = NULL;
-    GList *list;
-
-    connected_outputs = list_connected_outputs (NULL, NULL);
-
-    for (list = connected_outputs; list != NULL; list = list->next)
-    {
-        list_edges_for_output (list->data, edges);
-    }
-}
-
 static gboolean
 overlap (int s1, int e1, int s2, int e2)
 {
@@ -1968,7 +2002,7 @@ vertical_overlap (Edge *snapper, Edge *snappee)
 static void
 add_snap (GArray *snaps, Snap snap)
 {
-    if (ABS (snap.dx) <= 200 || ABS (snap.dy) <= 200)
+    if (ABS (snap.dx) <= SNAP_DISTANCE || ABS (snap.dy) <= SNAP_DISTANCE)
         g_array_append_val (snaps, snap);
 }
 
@@ -1979,6 +2013,7 @@ add_edge_snaps (Edge *snapper, Edge *snappee, GArray *snaps)
 
     snap.snapper = snapper;
     snap.snappee = snappee;
+    snap.kind = 0;
 
     if (horizontal_overlap (snapper, snappee))
     {
@@ -1999,52 +2034,32 @@ add_edge_snaps (Edge *snapper, Edge *snappee, GArray *snaps)
     /* 1->1 */
     snap.dx = snappee->x1 - snapper->x1;
     snap.dy = snappee->y1 - snapper->y1;
+    snap.kind = 1;
 
     add_snap (snaps, snap);
 
     /* 1->2 */
     snap.dx = snappee->x2 - snapper->x1;
     snap.dy = snappee->y2 - snapper->y1;
+    snap.kind = 2;
 
     add_snap (snaps, snap);
 
     /* 2->2 */
     snap.dx = snappee->x2 - snapper->x2;
     snap.dy = snappee->y2 - snapper->y2;
+    snap.kind = 3;
 
     add_snap (snaps, snap);
 
     /* 2->1 */
     snap.dx = snappee->x1 - snapper->x2;
     snap.dy = snappee->y1 - snapper->y2;
+    snap.kind = 4;
 
     add_snap (snaps, snap);
 }
 
-static void
-list_snaps (XfceOutputInfo *output, GArray *edges, GArray *snaps)
-{
-    guint i;
-
-    for (i = 0; i < edges->len; ++i)
-    {
-        Edge *output_edge = &(g_array_index (edges, Edge, i));
-
-        if (output_edge->output == output)
-        {
-            guint j;
-
-            for (j = 0; j < edges->len; ++j)
-            {
-                Edge *edge = &(g_array_index (edges, Edge, j));
-
-                if (edge->output != output)
-                    add_edge_snaps (output_edge, edge, snaps);
-            }
-        }
-    }
-}
-
 static gboolean
 corner_on_edge (int x, int y, Edge *e)
 {
@@ -2118,56 +2133,310 @@ get_output_rect (XfceOutputInfo *output, GdkRectangle *rect)
     rect->y = output->y;
 }
 
-static gboolean
-output_overlaps (XfceOutputInfo *output)
+/* The edges of the outputs that stay put while an output is dragged,
+ * sorted so the snap and alignment queries only look at nearby edges */
+typedef struct
+{
+    XfceOutputInfo *output;         /* The dragged output */
+
+    GArray         *h_edges;        /* Horizontal edges, sorted by y */
+    GArray         *v_edges;        /* Vertical edges, sorted by x */
+
+    GPtrArray      *others;         /* The outputs that stay put */
+    GPtrArray      *unaligned;      /* Those not aligned with each other */
+    gboolean        overlapping;    /* If any of them overlap each other */
+} SnapIndex;
+
+static int
+compare_h_edges (gconstpointer v1, gconstpointer v2)
+{
+    const Edge *e1 = v1;
+    const Edge *e2 = v2;
+
+    return e1->y1 - e2->y1;
+}
+
+static int
+compare_v_edges (gconstpointer v1, gconstpointer v2)
+{
+    const Edge *e1 = v1;
+    const Edge *e2 = v2;
+
+    return e1->x1 - e2->x1;
+}
+
+/* Index of the first edge with a position (y for horizontal and x for
+ * vertical edges) of at least pos */
+static guint
+snap_index_lower_bound (GArray *edges, gboolean horizontal, int pos)
+{
+    guint lo = 0, hi = edges->len, mid;
+    Edge *e;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        e = &(g_array_index (edges, Edge, mid));
+
+        if ((horizontal ? e->y1 : e->x1) < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static SnapIndex *
+snap_index_new (XfceOutputInfo *output)
 {
-    GList         *connected_outputs = NULL;
-    GList         *list;
-    gboolean       overlaps = FALSE;
-    GdkRectangle   output_rect;
+    SnapIndex    *index;
+    GArray       *edges;
+    GList        *list;
+    GdkRectangle  rect, other_rect;
+    guint         i, j;
 
-    get_output_rect (output, &output_rect);
+    index = g_slice_new0 (SnapIndex);
+    index->output = output;
+    index->h_edges = g_array_new (FALSE, FALSE, sizeof (Edge));
+    index->v_edges = g_array_new (FALSE, FALSE, sizeof (Edge));
+    index->others = g_ptr_array_new ();
+    index->unaligned = g_ptr_array_new ();
 
-    connected_outputs = list_connected_outputs (NULL, NULL);
+    edges = g_array_new (TRUE, TRUE, sizeof (Edge));
 
-    for (list = connected_outputs; list != NULL; list = list->next)
+    for (list = list_connected_outputs (NULL, NULL); list != NULL; list = list->next)
     {
-        XfceOutputInfo *other = list->data;
-        if (other != output)
+        if (list->data != output)
         {
-            GdkRectangle other_rect;
+            g_ptr_array_add (index->others, list->data);
+            list_edges_for_output (list->data, edges);
+        }
+    }
 
-            get_output_rect (other, &other_rect);
-            if (gdk_rectangle_intersect (&output_rect, &other_rect, NULL))
-            {
-                overlaps = TRUE;
+    for (i = 0; i < edges->len; ++i)
+    {
+        Edge *e = &(g_array_index (edges, Edge, i));
+
+        if (e->y1 == e->y2)
+            g_array_append_val (index->h_edges, *e);
+        else
+            g_array_append_val (index->v_edges, *e);
+    }
+
+    g_array_sort (index->h_edges, compare_h_edges);
+    g_array_sort (index->v_edges, compare_v_edges);
+
+    /* The relations between the outputs that stay put do not change
+     * during the drag, so only work them out once */
+    for (i = 0; i < index->others->len; ++i)
+    {
+        XfceOutputInfo *other = g_ptr_array_index (index->others, i);
+
+        if (!output_is_aligned (other, edges))
+            g_ptr_array_add (index->unaligned, other);
+
+        get_output_rect (other, &rect);
+        for (j = i + 1; j < index->others->len; ++j)
+        {
+            get_output_rect (g_ptr_array_index (index->others, j), &other_rect);
+            if (gdk_rectangle_intersect (&rect, &other_rect, NULL))
+                index->overlapping = TRUE;
+        }
+    }
+
+    g_array_free (edges, TRUE);
+
+    return index;
+}
+
+static void
+snap_index_free (SnapIndex *index)
+{
+    g_array_free (index->h_edges, TRUE);
+    g_array_free (index->v_edges, TRUE);
+    g_ptr_array_free (index->others, TRUE);
+    g_ptr_array_free (index->unaligned, TRUE);
+    g_slice_free (SnapIndex, index);
+}
+
+/* List the snaps of the dragged output that move it at most max_distance
+ * in either direction. The output edges are stored in output_edges, since
+ * the snaps point to them */
+static void
+snap_index_list_snaps (SnapIndex *index,
+                       GArray    *output_edges,
+                       GArray    *snaps,
+                       int        max_distance)
+{
+    guint i, j, n;
+    int   lo, hi;
+    Snap *snap;
+
+    g_array_set_size (output_edges, 0);
+    list_edges_for_output (index->output, output_edges);
+
+    for (i = 0; i < output_edges->len; ++i)
+    {
+        Edge *output_edge = &(g_array_index (output_edges, Edge, i));
+
+        /* Corners of the snappee within reach of the corners of this edge */
+        lo = MIN (output_edge->y1, output_edge->y2);
+        hi = MAX (output_edge->y1, output_edge->y2);
+        lo = lo > G_MININT + max_distance ? lo - max_distance : G_MININT;
+        hi = hi < G_MAXINT - max_distance ? hi + max_distance : G_MAXINT;
+
+        for (j = snap_index_lower_bound (index->h_edges, TRUE, lo); j < index->h_edges->len; ++j)
+        {
+            Edge *edge = &(g_array_index (index->h_edges, Edge, j));
+
+            if (edge->y1 > hi)
                 break;
-            }
+
+            add_edge_snaps (output_edge, edge, snaps);
+        }
+
+        lo = MIN (output_edge->x1, output_edge->x2);
+        hi = MAX (output_edge->x1, output_edge->x2);
+        lo = lo > G_MININT + max_distance ? lo - max_distance : G_MININT;
+        hi = hi < G_MAXINT - max_distance ? hi + max_distance : G_MAXINT;
+
+        for (j = snap_index_lower_bound (index->v_edges, FALSE, lo); j < index->v_edges->len; ++j)
+        {
+            Edge *edge = &(g_array_index (index->v_edges, Edge, j));
+
+            if (edge->x1 > hi)
+                break;
+
+            add_edge_snaps (output_edge, edge, snaps);
         }
     }
 
-    return overlaps;
+    /* Drop the candidates that are out of reach after all */
+    for (i = 0, n = 0; i < snaps->len; ++i)
+    {
+        snap = &(g_array_index (snaps, Snap, i));
+
+        if (MAX (ABS (snap->dx), ABS (snap->dy)) <= max_distance)
+            g_array_index (snaps, Snap, n++) = *snap;
+    }
+    g_array_set_size (snaps, n);
 }
 
+/* Whether an edge of the dragged output aligns with an edge that stays put */
 static gboolean
-xfce_rr_config_is_aligned (GArray *edges)
+snap_index_edge_aligns (SnapIndex *index,
+                        Edge      *e1)
 {
-    GList     *connected_outputs = NULL;
-    GList     *list;
-    gboolean   aligned = TRUE;
+    guint j;
+    int   lo, hi;
 
-    connected_outputs = list_connected_outputs (NULL, NULL);
+    if (e1->x1 == e1->x2)
+    {
+        /* Vertical edges at the same x, with e1's corner on it or their
+         * corner on e1 */
+        for (j = snap_index_lower_bound (index->v_edges, FALSE, e1->x1); j < index->v_edges->len; ++j)
+        {
+            Edge *e2 = &(g_array_index (index->v_edges, Edge, j));
+
+            if (e2->x1 != e1->x1)
+                break;
+
+            if (edges_align (e1, e2))
+                return TRUE;
+        }
 
-    for (list = connected_outputs; list != NULL; list = list->next)
+        /* Horizontal edges with their corner on e1, or through e1's corner */
+        lo = MIN (e1->y1, e1->y2);
+        hi = MAX (e1->y1, e1->y2);
+        for (j = snap_index_lower_bound (index->h_edges, TRUE, lo); j < index->h_edges->len; ++j)
+        {
+            Edge *e2 = &(g_array_index (index->h_edges, Edge, j));
+
+            if (e2->y1 > hi)
+                break;
+
+            if (edges_align (e1, e2))
+                return TRUE;
+        }
+    }
+    else
     {
-        XfceOutputInfo *output = list->data;
-        if (!output_is_aligned (output, edges) || output_overlaps (output))
+        for (j = snap_index_lower_bound (index->h_edges, TRUE, e1->y1); j < index->h_edges->len; ++j)
         {
-            aligned = FALSE;
-            break;
+            Edge *e2 = &(g_array_index (index->h_edges, Edge, j));
+
+            if (e2->y1 != e1->y1)
+                break;
+
+            if (edges_align (e1, e2))
+                return TRUE;
         }
+
+        lo = MIN (e1->x1, e1->x2);
+        hi = MAX (e1->x1, e1->x2);
+        for (j = snap_index_lower_bound (index->v_edges, FALSE, lo); j < index->v_edges->len; ++j)
+        {
+            Edge *e2 = &(g_array_index (index->v_edges, Edge, j));
+
+            if (e2->x1 > hi)
+                break;
+
+            if (edges_align (e1, e2))
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Same as checking the whole configuration is aligned, for the dragged
+ * output at its current position */
+static gboolean
+snap_index_is_aligned (SnapIndex *index)
+{
+    GArray       *output_edges;
+    GArray       *other_edges;
+    GdkRectangle  output_rect, other_rect;
+    gboolean      aligned = FALSE;
+    guint         i, j, k;
+
+    if (index->overlapping)
+        return FALSE;
+
+    get_output_rect (index->output, &output_rect);
+    for (i = 0; i < index->others->len; ++i)
+    {
+        get_output_rect (g_ptr_array_index (index->others, i), &other_rect);
+        if (gdk_rectangle_intersect (&output_rect, &other_rect, NULL))
+            return FALSE;
     }
 
+    output_edges = g_array_new (TRUE, TRUE, sizeof (Edge));
+    list_edges_for_output (index->output, output_edges);
+
+    /* The dragged output must align with one of the others */
+    for (i = 0; i < output_edges->len && !aligned; ++i)
+        aligned = snap_index_edge_aligns (index, &(g_array_index (output_edges, Edge, i)));
+
+    /* And the others that are not aligned with each other must align
+     * with the dragged output */
+    other_edges = g_array_new (TRUE, TRUE, sizeof (Edge));
+    for (k = 0; k < index->unaligned->len && aligned; ++k)
+    {
+        g_array_set_size (other_edges, 0);
+        list_edges_for_output (g_ptr_array_index (index->unaligned, k), other_edges);
+
+        aligned = FALSE;
+        for (i = 0; i < other_edges->len && !aligned; ++i)
+            for (j = 0; j < output_edges->len && !aligned; ++j)
+                aligned = edges_align (&(g_array_index (other_edges, Edge, i)),
+                                       &(g_array_index (output_edges, Edge, j)));
+    }
+
+    g_array_free (other_edges, TRUE);
+    g_array_free (output_edges, TRUE);
+
     return aligned;
 }
 
@@ -2177,6 +2446,8 @@ struct GrabInfo
     int grab_y;
     int output_x;
     int output_y;
+
+    SnapIndex *snap_index;
 };
 
 static gboolean
@@ -2213,8 +2484,18 @@ compare_snaps (gconstpointer v1, gconstpointer v2)
             return -1;
         else if (is_corner_snap (s2) && !is_corner_snap (s1))
             return 1;
-        else
-            return 0;
+
+        /* Break ties in the order the snaps were listed before the
+         * edges were indexed: by the edge of the dragged output, the
+         * edge it snaps to and the kind of snap. The candidates come
+         * from range queries in a different order, this picks the same
+         * snap as the full list did */
+        if (s1->snapper->order != s2->snapper->order)
+            return s1->snapper->order < s2->snapper->order ? -1 : 1;
+        if (s1->snappee->order != s2->snappee->order)
+            return s1->snappee->order < s2->snappee->order ? -1 : 1;
+
+        return s1->kind - s2->kind;
     }
     else
     {
@@ -2293,6 +2574,7 @@ on_output_event (FooScrollArea      *area,
             info->grab_y = event->y;
             info->output_x = output->x;
             info->output_y = output->y;
+            info->snap_index = snap_index_new (output);
 
             set_monitors_tooltip (g_strdup_printf(_("(%i, %i)"), output->x, output->y) );
 
@@ -2308,50 +2590,54 @@ on_output_event (FooScrollArea      *area,
             GrabInfo *info = output->user_data;
             double scale = compute_scale();
             int new_x, new_y;
-            guint i;
+            guint i, pass;
             GArray *edges, *snaps;
+            gboolean snapped = FALSE;
 
             new_x = info->output_x + (event->x - info->grab_x) / scale;
             new_y = info->output_y + (event->y - info->grab_y) / scale;
 
-            output->x = new_x;
-            output->y = new_y;
-
             edges = g_array_new (TRUE, TRUE, sizeof (Edge));
             snaps = g_array_new (TRUE, TRUE, sizeof (Snap));
 
-            list_edges (edges);
-            list_snaps (output, edges, snaps);
+            /* Try the nearby snaps first, only if none of them results in an
+             * aligned configuration consider the ones further away */
+            for (pass = 0; pass < 2 && !snapped; ++pass)
+            {
+                output->x = new_x;
+                output->y = new_y;
 
-            g_array_sort (snaps, compare_snaps);
+                g_array_set_size (snaps, 0);
+                snap_index_list_snaps (info->snap_index, edges, snaps,
+                                       pass == 0 ? SNAP_DISTANCE : G_MAXINT);
 
-            output->x = info->output_x;
-            output->y = info->output_y;
+                g_array_sort (snaps, compare_snaps);
 
-            for (i = 0; i < snaps->len; ++i)
-            {
-                Snap *snap = &(g_array_index (snaps, Snap, i));
-                GArray *new_edges = g_array_new (TRUE, TRUE, sizeof (Edge));
+                for (i = 0; i < snaps->len; ++i)
+                {
+                    Snap *snap = &(g_array_index (snaps, Snap, i));
 
-                output->x = new_x + snap->dx;
-                output->y = new_y + snap->dy;
+                    /* Already tried in the first pass */
+                    if (pass > 0 && MAX (ABS (snap->dx), ABS (snap->dy)) <= SNAP_DISTANCE)
+                        continue;
 
-                g_array_set_size (new_edges, 0);
-                list_edges (new_edges);
+                    output->x = new_x + snap->dx;
+                    output->y = new_y + snap->dy;
 
-                if (xfce_rr_config_is_aligned (new_edges))
-                {
-                    g_array_free (new_edges, TRUE);
-                    break;
-                }
-                else
-                {
-                    output->x = info->output_x;
-                    output->y = info->output_y;
-                    g_array_free (new_edges, TRUE);
+                    if (snap_index_is_aligned (info->snap_index))
+                    {
+                        snapped = TRUE;
+                        break;
+                    }
                 }
             }
 
+            if (!snapped)
+            {
+                output->x = info->output_x;
+                output->y = info->output_y;
+            }
+
             g_array_free (snaps, TRUE);
             g_array_free (edges, TRUE);
 
@@ -2360,6 +2646,7 @@ on_output_event (FooScrollArea      *area,
                 foo_scroll_area_end_grab (area);
                 set_monitors_tooltip (NULL);
 
+                snap_index_free (info->snap_index);
                 g_free (output->user_data);
                 output->user_data = NULL;
 
@@ -2371,7 +2658,11 @@ on_output_event (FooScrollArea      *area,
                 set_monitors_tooltip (g_strdup_printf(_("(%i, %i)"), output->x, output->y) );
             }
 
-            foo_scroll_area_invalidate (area);
+            /* Only repaint the outputs that moved while dragging */
+            if (event->type == FOO_BUTTON_RELEASE)
+                foo_scroll_area_invalidate (area);
+            else
+                canvas_invalidate_outputs (area);
         }
     }
 }
@@ -2422,64 +2713,177 @@ paint_background (FooScrollArea *area,
     cairo_stroke (cr);
 }
 
-static void
-paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
+/* Geometry of the layout canvas, computed once per paint or damage pass */
+typedef struct
 {
-    int w, h;
-    double scale = compute_scale();
-    double x, y, end_x, end_y;
-    gint total_w, total_h;
-    GList *connected_outputs = list_connected_outputs (&total_w, &total_h);
-    XfceOutputInfo *output = NULL;
-    GList *entry = NULL;
-    PangoLayout *layout;
-    PangoRectangle ink_extent, log_extent;
     GdkRectangle viewport;
-    cairo_pattern_t *pat_lin = NULL, *pat_radial = NULL;
-    double alpha = 1.0;
-    double available_w;
-    double factor = 1.0;
-    const char *text;
-    gint    mirrored;
+    gdouble      scale;
+    gint         total_w;
+    gint         total_h;
+} CanvasLayout;
 
-    mirrored = get_mirrored_configuration();
+static void
+canvas_get_layout (CanvasLayout *layout)
+{
+    foo_scroll_area_get_viewport (FOO_SCROLL_AREA (randr_gui_area), &layout->viewport);
 
-    cairo_save (cr);
+    list_connected_outputs (&layout->total_w, &layout->total_h);
 
-    foo_scroll_area_get_viewport (FOO_SCROLL_AREA (randr_gui_area), &viewport);
+    layout->viewport.height -= 2 * MARGIN;
+    layout->viewport.width -= 2 * MARGIN;
 
-    entry = g_list_nth (connected_outputs, i);
-    if (entry)
-        output = entry->data;
-    if (output)
-        get_geometry (output, &w, &h);
-    else
-        return;
+    layout->scale = MIN ((double)layout->viewport.width / (double)layout->total_w,
+                         (double)layout->viewport.height / (double)layout->total_h);
+}
+
+static void
+canvas_get_output_rect (const CanvasLayout *layout,
+                        XfceOutputInfo     *output,
+                        GdkRectangle       *rect)
+{
+    int w, h;
 
-    viewport.height -= 2 * MARGIN;
-    viewport.width -= 2 * MARGIN;
+    get_geometry (output, &w, &h);
 
     /* Center the displayed outputs in the viewport */
-    x = ceil (output->x * scale + MARGIN + (viewport.width - total_w * scale) / 2.0);
-    y = ceil (output->y * scale + MARGIN + (viewport.height - total_h * scale) / 2.0);
+    rect->x = ceil (output->x * layout->scale + MARGIN + (layout->viewport.width - layout->total_w * layout->scale) / 2.0);
+    rect->y = ceil (output->y * layout->scale + MARGIN + (layout->viewport.height - layout->total_h * layout->scale) / 2.0);
+    rect->width = ceil (w * layout->scale);
+    rect->height = ceil (h * layout->scale);
+}
 
-    /* Align endpoints */
-    end_x = x + ceil (w * scale);
-    end_y = y + ceil (h * scale);
-    if ( abs((int)end_x-(int)*snap_x) <= 1 )
+/* The outputs in the order they are painted */
+static GPtrArray *
+list_painted_outputs (gint mirrored)
+{
+    GPtrArray      *outputs;
+    GList          *list;
+    XfceOutputInfo *output;
+
+    outputs = g_ptr_array_new ();
+
+    for (list = list_connected_outputs (NULL, NULL); list != NULL; list = list->next)
     {
-        end_x = *snap_x;
+        output = list->data;
+
+        /* Always paint the currently selected display last, i.e. on top, so it's
+           visible and the name is readable */
+        if (output->id == active_output)
+            continue;
+
+        g_ptr_array_add (outputs, output);
+
+        if (mirrored == 1)
+            break;
     }
-    if ( abs((int)end_y-(int)*snap_y) <= 1 )
+
+    /* Finally also paint the active output */
+    output = get_nth_xfce_output_info (active_output);
+    if (output != NULL)
+        g_ptr_array_add (outputs, output);
+
+    return outputs;
+}
+
+static OutputPaintCache *
+output_paint_cache_get (guint id)
+{
+    if (output_paint_cache == NULL || n_output_paint_cache != xfce_randr->noutput)
     {
-        end_y = *snap_y;
+        output_paint_cache_free ();
+
+        n_output_paint_cache = xfce_randr->noutput;
+        output_paint_cache = g_new0 (OutputPaintCache, n_output_paint_cache);
     }
-    *snap_x = end_x;
-    *snap_y = end_y;
 
-    cairo_translate (cr,
-                     x + (w * scale) / 2,
-                     y + (h * scale) / 2);
+    return &output_paint_cache[id];
+}
+
+/* Invalidate the areas of the outputs that moved since they were painted,
+ * instead of the whole canvas, e.g. while an output is dragged */
+static void
+canvas_invalidate_outputs (FooScrollArea *area)
+{
+    CanvasLayout      layout;
+    GPtrArray        *outputs;
+    OutputPaintCache *cache;
+    GdkRegion        *region;
+    GdkRectangle      rect;
+    gboolean          moved, prev_moved = FALSE;
+    guint             i;
+
+    if (output_paint_cache == NULL || n_output_paint_cache != xfce_randr->noutput)
+    {
+        foo_scroll_area_invalidate (area);
+        return;
+    }
+
+    canvas_get_layout (&layout);
+    outputs = list_painted_outputs (get_mirrored_configuration ());
+    region = gdk_region_new ();
+
+    for (i = 0; i < outputs->len; ++i)
+    {
+        XfceOutputInfo *output = g_ptr_array_index (outputs, i);
+
+        cache = output_paint_cache_get (output->id);
+        canvas_get_output_rect (&layout, output, &rect);
+
+        moved = (cache->surface == NULL
+                 || rect.x != cache->area.x || rect.y != cache->area.y
+                 || rect.width != cache->area.width || rect.height != cache->area.height);
+
+        /* The end points of an output are aligned with the output painted
+         * before it, so the next output may shift by a pixel too */
+        if (moved || prev_moved)
+        {
+            rect.x -= 1;
+            rect.y -= 1;
+            rect.width += 2;
+            rect.height += 2;
+            gdk_region_union_with_rect (region, &rect);
+
+            if (cache->surface != NULL)
+            {
+                rect = cache->area;
+                rect.x -= 1;
+                rect.y -= 1;
+                rect.width += 2;
+                rect.height += 2;
+                gdk_region_union_with_rect (region, &rect);
+            }
+        }
+
+        prev_moved = moved;
+    }
+
+    if (!gdk_region_empty (region))
+        foo_scroll_area_invalidate_region (area, region);
+
+    gdk_region_destroy (region);
+    g_ptr_array_free (outputs, TRUE);
+}
+
+static void
+paint_output_surface (cairo_t        *cr,
+                      XfceOutputInfo *output,
+                      gint            mirrored,
+                      double          w,
+                      double          h,
+                      double          end_x,
+                      double          end_y,
+                      double          alpha,
+                      const gchar    *text)
+{
+    PangoLayout *layout;
+    PangoRectangle ink_extent, log_extent;
+    cairo_pattern_t *pat_lin = NULL, *pat_radial = NULL;
+    double available_w;
+    double factor = 1.0;
+
+    /* The output is drawn at the origin of its cached surface, w and h are
+     * the scaled size of the output and end_x, end_y the aligned endpoints */
+    cairo_translate (cr, w / 2, h / 2);
 
     /* rotation is already applied in get_geometry */
 
@@ -2489,35 +2893,16 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     if (output->rotation == RR_Reflect_Y)
         cairo_scale (cr, 1, -1);
 
-    cairo_translate (cr,
-                     - x - (w * scale) / 2,
-                     - y - (h * scale) / 2);
+    cairo_translate (cr, - w / 2, - h / 2);
 
-    cairo_rectangle (cr, x, y, end_x - x, end_y - y);
-    cairo_clip_preserve (cr);
-
-    foo_scroll_area_add_input_from_fill (FOO_SCROLL_AREA (randr_gui_area),
-                                         cr, on_output_event, output);
+    cairo_rectangle (cr, 0, 0, end_x, end_y);
 
     cairo_set_line_width (cr, 1.0);
 
-    /* Make overlapping displays ('mirrored') more transparent so both displays can
-       be recognized more easily */
-    if (output->id != active_output && mirrored == 2)
-        alpha = 0.5;
-    /* When displays are mirrored it makes no sense to make them semi-transparent
-       because they overlay each other completely */
-    else if (mirrored == 1)
-        alpha = 1.0;
-    /* the inactive display should be more transparent and the overlapping one as
-       well */
-    else if (output->id != active_output || mirrored == 2)
-        alpha = 0.7;
-
     if (output->on)
     {
         /* Background gradient for active display */
-        pat_lin = cairo_pattern_create_linear(x, y, x, y + (h * scale));
+        pat_lin = cairo_pattern_create_linear(0, 0, 0, h);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.0, 0.56, 0.85, 0.92, alpha);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.2, 0.33, 0.75, 0.92, alpha);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.7, 0.25, 0.57, 0.77, alpha);
@@ -2531,7 +2916,7 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     else
     {
         /* Background gradient for disabled display */
-        pat_lin = cairo_pattern_create_linear(x, y, x, y + (h * scale));
+        pat_lin = cairo_pattern_create_linear(0, 0, 0, h);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.0, 0.24, 0.3, 0.31, alpha);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.2, 0.17, 0.20, 0.22, alpha);
         cairo_pattern_add_color_stop_rgba(pat_lin, 0.7, 0.14, 0.16, 0.18, alpha);
@@ -2544,43 +2929,30 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     }
 
     /* Draw inner stroke */
-    cairo_rectangle (cr, x + 1.5, y + 1.5, end_x - x - 3, end_y - y - 3);
+    cairo_rectangle (cr, 1.5, 1.5, end_x - 3, end_y - 3);
     cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, alpha - 0.75);
     cairo_stroke (cr);
 
     /* Draw reflection as radial gradient on a polygon */
-    pat_radial = cairo_pattern_create_radial ((end_x -x) /2 + x, y, 1, (end_x -x) /2 + x, y, h * scale);
+    pat_radial = cairo_pattern_create_radial (end_x / 2, 0, 1, end_x / 2, 0, h);
     cairo_pattern_add_color_stop_rgba(pat_radial, 0.0, 1.0, 1.0, 1.0, 0.4);
     cairo_pattern_add_color_stop_rgba(pat_radial, 0.5, 1.0, 1.0, 1.0, 0.15);
     cairo_pattern_add_color_stop_rgba(pat_radial, 0.8, 1.0, 1.0, 1.0, 0.0);
 
-    cairo_move_to (cr, x + 1.5, y + 1.5);
-    cairo_line_to (cr, end_x - 1.5, y + 1.5);
-    cairo_line_to (cr, end_x - 1.5, y + (end_y - y) / 3);
-    cairo_line_to (cr, x + 1.5, y + (end_y - y) / 1.5);
+    cairo_move_to (cr, 1.5, 1.5);
+    cairo_line_to (cr, end_x - 1.5, 1.5);
+    cairo_line_to (cr, end_x - 1.5, end_y / 3);
+    cairo_line_to (cr, 1.5, end_y / 1.5);
     cairo_close_path (cr);
     cairo_set_source (cr, pat_radial);
     cairo_fill (cr);
 
     /* Display name label*/
-    if (mirrored == 1)
-    {
-    /* Translators:  this is the feature where what you see on your laptop's
-     * screen is the same as your external monitor.  Here, "Mirror" is being
-     * used as an adjective, not as a verb.  For example, the Spanish
-     * translation could be "Pantallas en Espejo", *not* "Espejar Pantallas".
-     */
-        text = _("Mirror Screens");
-    }
-    else
-    {
-        text = output->display_name;
-    }
     layout = gtk_widget_create_pango_layout (GTK_WIDGET (randr_gui_area), text);
     layout_set_font (layout, "Sans Bold 12");
     pango_layout_get_pixel_extents (layout, &ink_extent, &log_extent);
 
-    available_w = w * scale + 0.5 - 6; /* Same as the inner rectangle's width, minus 1 pixel of padding on each side */
+    available_w = w + 0.5 - 6; /* Same as the inner rectangle's width, minus 1 pixel of padding on each side */
 
     cairo_scale (cr, factor, factor);
 
@@ -2592,8 +2964,8 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     }
 
     cairo_move_to (cr,
-                   x + ((w * scale + 0.5) - factor * log_extent.width) / 2,
-                   y + ((h * scale + 0.5) - factor * log_extent.height) / 2 - 1);
+                   ((w + 0.5) - factor * log_extent.width) / 2,
+                   ((h + 0.5) - factor * log_extent.height) / 2 - 1);
     /* Try to make the text as readable as possible for overlapping displays */
     if (output->id == active_output && mirrored == 2)
        cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, alpha);
@@ -2603,8 +2975,8 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     pango_cairo_show_layout (cr, layout);
 
     cairo_move_to (cr,
-                   x + ((w * scale + 0.5) - factor * log_extent.width) / 2,
-                   y + ((h * scale + 0.5) - factor * log_extent.height) / 2);
+                   ((w + 0.5) - factor * log_extent.width) / 2,
+                   ((h + 0.5) - factor * log_extent.height) / 2);
 
     /* Try to make the text as readable as possible for overlapping displays - the
        currently selected one could be painted below the other display*/
@@ -2623,21 +2995,19 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
         layout_set_font (display_state, "Sans 9");
         pango_layout_get_pixel_extents (display_state, &ink_extent, &log_extent);
 
-        available_w = w * scale + 0.5 - 6;
+        available_w = w + 0.5 - 6;
         if (available_w < ink_extent.width)
             factor = available_w / ink_extent.width;
         else
             factor = 1.0;
         cairo_move_to (cr,
-                       x + ((w * scale + 0.5) - factor * log_extent.width) / 2,
-                       y + ((h * scale + 0.5) - factor * log_extent.height) / 2 + 18);
+                       ((w + 0.5) - factor * log_extent.width) / 2,
+                       ((h + 0.5) - factor * log_extent.height) / 2 + 18);
         cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 0.75);
         pango_cairo_show_layout (cr, display_state);
         g_object_unref (display_state);
     }
 
-    cairo_restore (cr);
-
     if (pat_lin)
         cairo_pattern_destroy(pat_lin);
     if (pat_radial)
@@ -2646,6 +3016,128 @@ paint_output (cairo_t *cr, int i, double *snap_x, double *snap_y)
     g_object_unref (layout);
 }
 
+static void
+paint_output (cairo_t            *cr,
+              const CanvasLayout *canvas,
+              XfceOutputInfo     *output,
+              gint                mirrored,
+              double             *snap_x,
+              double             *snap_y)
+{
+    int w, h;
+    double x, y, end_x, end_y;
+    double alpha = 1.0;
+    const char *text;
+    gboolean active;
+    GdkRectangle rect;
+    OutputPaintCache *cache;
+    cairo_t *cache_cr;
+
+    get_geometry (output, &w, &h);
+    canvas_get_output_rect (canvas, output, &rect);
+
+    x = rect.x;
+    y = rect.y;
+
+    /* Align endpoints */
+    end_x = x + rect.width;
+    end_y = y + rect.height;
+    if ( abs((int)end_x-(int)*snap_x) <= 1 )
+    {
+        end_x = *snap_x;
+    }
+    if ( abs((int)end_y-(int)*snap_y) <= 1 )
+    {
+        end_y = *snap_y;
+    }
+    *snap_x = end_x;
+    *snap_y = end_y;
+
+    active = (output->id == active_output);
+
+    /* Make overlapping displays ('mirrored') more transparent so both displays can
+       be recognized more easily */
+    if (!active && mirrored == 2)
+        alpha = 0.5;
+    /* When displays are mirrored it makes no sense to make them semi-transparent
+       because they overlay each other completely */
+    else if (mirrored == 1)
+        alpha = 1.0;
+    /* the inactive display should be more transparent and the overlapping one as
+       well */
+    else if (!active || mirrored == 2)
+        alpha = 0.7;
+
+    /* Display name label*/
+    if (mirrored == 1)
+    {
+    /* Translators:  this is the feature where what you see on your laptop's
+     * screen is the same as your external monitor.  Here, "Mirror" is being
+     * used as an adjective, not as a verb.  For example, the Spanish
+     * translation could be "Pantallas en Espejo", *not* "Espejar Pantallas".
+     */
+        text = _("Mirror Screens");
+    }
+    else
+    {
+        text = output->display_name;
+    }
+
+    /* Only render the output again if its appearance changed, moving it
+     * around the canvas reuses the surface */
+    cache = output_paint_cache_get (output->id);
+    if (cache->surface == NULL
+        || cache->width != (gint) (end_x - x)
+        || cache->height != (gint) (end_y - y)
+        || cache->scale != canvas->scale
+        || cache->rotation != output->rotation
+        || cache->on != output->on
+        || cache->active != active
+        || cache->mirrored != mirrored
+        || cache->alpha != alpha
+        || g_strcmp0 (cache->text, text) != 0)
+    {
+        if (cache->surface != NULL)
+            cairo_surface_destroy (cache->surface);
+        g_free (cache->text);
+
+        cache->width = end_x - x;
+        cache->height = end_y - y;
+        cache->scale = canvas->scale;
+        cache->rotation = output->rotation;
+        cache->on = output->on;
+        cache->active = active;
+        cache->mirrored = mirrored;
+        cache->alpha = alpha;
+        cache->text = g_strdup (text);
+
+        cache->surface = cairo_surface_create_similar (cairo_get_target (cr),
+                                                       CAIRO_CONTENT_COLOR_ALPHA,
+                                                       MAX (cache->width, 1),
+                                                       MAX (cache->height, 1));
+
+        cache_cr = cairo_create (cache->surface);
+        paint_output_surface (cache_cr, output, mirrored,
+                              w * canvas->scale, h * canvas->scale,
+                              end_x - x, end_y - y, alpha, text);
+        cairo_destroy (cache_cr);
+    }
+
+    cache->area = rect;
+
+    cairo_save (cr);
+
+    cairo_rectangle (cr, x, y, end_x - x, end_y - y);
+
+    foo_scroll_area_add_input_from_fill (FOO_SCROLL_AREA (randr_gui_area),
+                                         cr, on_output_event, output);
+
+    cairo_set_source_surface (cr, cache->surface, x, y);
+    cairo_fill (cr);
+
+    cairo_restore (cr);
+}
+
 static void
 on_area_paint (FooScrollArea *area,
                cairo_t       *cr,
@@ -2653,31 +3145,21 @@ on_area_paint (FooScrollArea *area,
                GdkRegion     *region,
                gpointer       data)
 {
-    GList *connected_outputs = NULL;
-    GList *list;
+    CanvasLayout  layout;
+    GPtrArray    *outputs;
+    guint         i;
+    gint          mirrored;
     double x = 0.0, y = 0.0;
 
     paint_background (area, cr);
 
-    connected_outputs = list_connected_outputs (NULL, NULL);
-
-    for (list = connected_outputs; list != NULL; list = list->next)
-    {
-        gint i;
+    mirrored = get_mirrored_configuration ();
+    canvas_get_layout (&layout);
 
-        i = g_list_position (connected_outputs, list);
-        /* Always paint the currently selected display last, i.e. on top, so it's
-           visible and the name is readable */
-        if (i >= 0 && (guint)i == active_output) {
-            continue;
-        }
-        paint_output (cr, i, &x, &y);
-
-        if (get_mirrored_configuration() == 1)
-            break;
-    }
-    /* Finally also paint the active output */
-    paint_output (cr, active_output, &x, &y);
+    outputs = list_painted_outputs (mirrored);
+    for (i = 0; i < outputs->len; ++i)
+        paint_output (cr, &layout, g_ptr_array_index (outputs, i), mirrored, &x, &y);
+    g_ptr_array_free (outputs, TRUE);
 }
 
 static XfceOutputInfo *
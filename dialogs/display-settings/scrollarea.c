@@ -17,6 +17,7 @@
  */
 
 #include <gdk/gdkprivate.h> /* For GDK_PARENT_RELATIVE_BG */
+#include <math.h>
 #include "scrollarea.h"
 #include "foo-marshal.h"
 
@@ -32,12 +33,26 @@ typedef struct InputPath InputPath;
 typedef struct InputRegion InputRegion;
 typedef struct AutoScrollInfo AutoScrollInfo;
 
+typedef struct
+{
+    double x1, y1, x2, y2;
+} Box;
+
+/* Size of the cells of the grid the input paths are indexed by */
+#define GRID_CELL_SIZE 32
+
 struct InputPath
 {
     gboolean                is_stroke;
     cairo_fill_rule_t       fill_rule;
     double                  line_width;
-    cairo_path_t           *path;       /* In canvas coordinates */
+
+    /* The flattened path in canvas coordinates, as x, y pairs,
+     * split in sub paths of n_sub_points[i] points each */
+    double                 *points;
+    guint                  *n_sub_points;
+    guint                   n_subpaths;
+    Box                     bbox;
 
     FooScrollAreaEventFunc  func;
     gpointer                data;
@@ -48,8 +63,12 @@ struct InputPath
 /* InputRegions are mutually disjoint */
 struct InputRegion
 {
-    GdkRegion *region;      /* the boundary of this area in canvas coordinates */
-    InputPath *paths;
+    GdkRegion  *region;     /* the boundary of this area in canvas coordinates */
+    InputPath  *paths;
+
+    /* The paths by the grid cells their bounding box covers,
+     * in the same order as the paths list */
+    GHashTable *grid;
 };
 
 struct AutoScrollInfo
@@ -280,63 +299,200 @@ translate_cairo_device (cairo_t       *cr,
     cairo_surface_set_device_offset (surface, dev_x, dev_y);
 }
 
-typedef void (* PathForeachFunc) (double  *x,
-                                  double  *y,
-                                  gpointer data);
+static void
+input_path_free_list (InputPath *paths)
+{
+    if (!paths)
+        return;
+
+    input_path_free_list (paths->next);
+    g_free (paths->points);
+    g_free (paths->n_sub_points);
+    g_free (paths);
+}
 
 static void
-path_foreach_point (cairo_path_t     *path,
-                    PathForeachFunc   func,
-                    gpointer          user_data)
+input_region_free_cell (gpointer key,
+                        gpointer value,
+                        gpointer user_data)
 {
-    int i;
+    g_slist_free (value);
+}
 
-    for (i = 0; i < path->num_data; i += path->data[i].header.length)
-    {
-        cairo_path_data_t *data = &(path->data[i]);
+static InputRegion *
+input_region_new (GdkRegion *region)
+{
+    InputRegion *input = g_new0 (InputRegion, 1);
 
-        switch (data->header.type)
-        {
-            case CAIRO_PATH_MOVE_TO:
-            case CAIRO_PATH_LINE_TO:
-                func (&(data[1].point.x), &(data[1].point.y), user_data);
-                break;
+    input->region = gdk_region_copy (region);
+    input->paths = NULL;
+    input->grid = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-            case CAIRO_PATH_CURVE_TO:
-                func (&(data[1].point.x), &(data[1].point.y), user_data);
-                func (&(data[2].point.x), &(data[2].point.y), user_data);
-                func (&(data[3].point.x), &(data[3].point.y), user_data);
-                break;
+    return input;
+}
 
-            case CAIRO_PATH_CLOSE_PATH:
-                break;
-        }
-    }
+static void
+input_region_free (InputRegion *region)
+{
+    input_path_free_list (region->paths);
+    gdk_region_destroy (region->region);
+
+    g_hash_table_foreach (region->grid, input_region_free_cell, NULL);
+    g_hash_table_destroy (region->grid);
+
+    g_free (region);
 }
 
-typedef struct
+static gpointer
+input_region_cell_key (int cell_x,
+                       int cell_y)
 {
-    double x1, y1, x2, y2;
-} Box;
+    return GUINT_TO_POINTER (((guint) (cell_y & 0xffff) << 16) | (guint) (cell_x & 0xffff));
+}
 
+static int
+input_region_cell (double coord)
+{
+    return (int) floor (coord / GRID_CELL_SIZE);
+}
+
+/* Add the path to the grid cells its bounding box covers, limited to
+ * the boundary of the region, since events outside it never get here */
 static void
-input_path_free_list (InputPath *paths)
+input_region_add_path (InputRegion *region,
+                       InputPath   *path)
 {
-    if (!paths)
+    GdkRectangle  clip;
+    Box           box;
+    int           cx, cy;
+    gpointer      key;
+    GSList       *cell;
+
+    path->next = region->paths;
+    region->paths = path;
+
+    gdk_region_get_clipbox (region->region, &clip);
+
+    box.x1 = MAX (path->bbox.x1, clip.x);
+    box.y1 = MAX (path->bbox.y1, clip.y);
+    box.x2 = MIN (path->bbox.x2, clip.x + clip.width);
+    box.y2 = MIN (path->bbox.y2, clip.y + clip.height);
+
+    if (box.x1 > box.x2 || box.y1 > box.y2)
         return;
 
-    input_path_free_list (paths->next);
-    cairo_path_destroy (paths->path);
-    g_free (paths);
+    for (cy = input_region_cell (box.y1); cy <= input_region_cell (box.y2); ++cy)
+    {
+        for (cx = input_region_cell (box.x1); cx <= input_region_cell (box.x2); ++cx)
+        {
+            key = input_region_cell_key (cx, cy);
+            cell = g_hash_table_lookup (region->grid, key);
+            g_hash_table_insert (region->grid, key, g_slist_prepend (cell, path));
+        }
+    }
 }
 
-static void
-input_region_free (InputRegion *region)
+static double
+segment_distance_squared (double x,
+                          double y,
+                          double x1,
+                          double y1,
+                          double x2,
+                          double y2)
 {
-    input_path_free_list (region->paths);
-    gdk_region_destroy (region->region);
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    double t = 0.0;
+    double len = dx * dx + dy * dy;
 
-    g_free (region);
+    if (len > 0.0)
+        t = CLAMP (((x - x1) * dx + (y - y1) * dy) / len, 0.0, 1.0);
+
+    dx = x - (x1 + t * dx);
+    dy = y - (y1 + t * dy);
+
+    return dx * dx + dy * dy;
+}
+
+/* Pure arithmetic replacement of cairo_in_fill() and cairo_in_stroke()
+ * on the flattened path; strokes are treated as having round joins */
+static gboolean
+input_path_contains (const InputPath *path,
+                     double           x,
+                     double           y)
+{
+    const double *p = path->points;
+    double        half_width = path->line_width / 2.0;
+    double        x1, y1, x2, y2;
+    int           winding = 0;
+    int           crossings = 0;
+    guint         i, j, n;
+
+    if (x < path->bbox.x1 || x > path->bbox.x2
+        || y < path->bbox.y1 || y > path->bbox.y2)
+        return FALSE;
+
+    for (i = 0; i < path->n_subpaths; ++i)
+    {
+        n = path->n_sub_points[i];
+
+        for (j = 0; j < n; ++j)
+        {
+            /* Fills implicitly close each sub path */
+            if (j + 1 == n && path->is_stroke)
+                break;
+
+            x1 = p[2 * j];
+            y1 = p[2 * j + 1];
+            x2 = p[2 * ((j + 1) % n)];
+            y2 = p[2 * ((j + 1) % n) + 1];
+
+            if (path->is_stroke)
+            {
+                if (segment_distance_squared (x, y, x1, y1, x2, y2) <= half_width * half_width)
+                    return TRUE;
+            }
+            else if ((y1 <= y) != (y2 <= y))
+            {
+                /* The edge crosses the horizontal ray to the right of the point */
+                if (x < x1 + (y - y1) * (x2 - x1) / (y2 - y1))
+                {
+                    crossings++;
+                    winding += (y2 > y1) ? 1 : -1;
+                }
+            }
+        }
+
+        p += 2 * n;
+    }
+
+    if (path->is_stroke)
+        return FALSE;
+
+    if (path->fill_rule == CAIRO_FILL_RULE_EVEN_ODD)
+        return (crossings & 1) != 0;
+
+    return winding != 0;
+}
+
+static InputPath *
+input_region_find_path (InputRegion *region,
+                        int          x,
+                        int          y)
+{
+    GSList *li;
+
+    li = g_hash_table_lookup (region->grid,
+                              input_region_cell_key (input_region_cell (x),
+                                                     input_region_cell (y)));
+
+    for (; li != NULL; li = li->next)
+    {
+        if (input_path_contains (li->data, x, y))
+            return li->data;
+    }
+
+    return NULL;
 }
 
 static void
@@ -501,9 +657,7 @@ foo_scroll_area_expose (GtkWidget *widget,
     /* Setup input areas */
     clear_exposed_input_region (scroll_area, scroll_area->priv->update_region);
 
-    scroll_area->priv->current_input = g_new0 (InputRegion, 1);
-    scroll_area->priv->current_input->region = gdk_region_copy (scroll_area->priv->update_region);
-    scroll_area->priv->current_input->paths = NULL;
+    scroll_area->priv->current_input = input_region_new (scroll_area->priv->update_region);
     g_ptr_array_add (scroll_area->priv->input_regions,
                      scroll_area->priv->current_input);
 
@@ -790,7 +944,6 @@ process_event (FooScrollArea           *scroll_area,
                int                      x,
                int                      y)
 {
-    GtkWidget *widget = GTK_WIDGET (scroll_area);
     guint i;
 
     allocation_to_canvas (scroll_area, &x, &y);
@@ -811,34 +964,14 @@ process_event (FooScrollArea           *scroll_area,
         {
             InputPath *path;
 
-            path = region->paths;
-            while (path)
+            path = input_region_find_path (region, x, y);
+            if (path)
             {
-                cairo_t *cr;
-                gboolean inside;
-
-                cr = gdk_cairo_create (gtk_widget_get_window (widget));
-                cairo_set_fill_rule (cr, path->fill_rule);
-                cairo_set_line_width (cr, path->line_width);
-                cairo_append_path (cr, path->path);
-
-                if (path->is_stroke)
-                    inside = cairo_in_stroke (cr, x, y);
-                else
-                    inside = cairo_in_fill (cr, x, y);
-
-                cairo_destroy (cr);
-
-                if (inside)
-                {
-                    emit_input (scroll_area, input_type,
-                                x, y,
-                                path->func,
-                                path->data);
-                    return;
-                }
-
-                path = path->next;
+                emit_input (scroll_area, input_type,
+                            x, y,
+                            path->func,
+                            path->data);
+                return;
             }
 
             /* Since the regions are all disjoint, no other region
@@ -1107,15 +1240,6 @@ foo_scroll_area_set_min_size (FooScrollArea *scroll_area,
     gtk_widget_queue_resize (GTK_WIDGET (scroll_area));
 }
 
-static void
-user_to_device (double *x, double *y,
-                gpointer data)
-{
-    cairo_t *cr = data;
-
-    cairo_user_to_device (cr, x, y);
-}
-
 static InputPath *
 make_path (FooScrollArea         *area,
            cairo_t               *cr,
@@ -1123,17 +1247,93 @@ make_path (FooScrollArea         *area,
            FooScrollAreaEventFunc func,
            gpointer               data)
 {
-    InputPath *path = g_new0 (InputPath, 1);
+    InputPath         *path = g_new0 (InputPath, 1);
+    cairo_path_t      *flat;
+    cairo_path_data_t *pdata;
+    GArray            *points;
+    GArray            *n_sub_points;
+    double             x, y, margin;
+    guint              n = 0;
+    int                i;
 
     path->is_stroke = is_stroke;
     path->fill_rule = cairo_get_fill_rule (cr);
     path->line_width = cairo_get_line_width (cr);
-    path->path = cairo_copy_path (cr);
-    path_foreach_point (path->path, user_to_device, cr);
     path->func = func;
     path->data = data;
-    path->next = area->priv->current_input->paths;
-    area->priv->current_input->paths = path;
+
+    /* Flatten the path into polygons in canvas coordinates, so hit
+     * testing needs no cairo context on the window */
+    flat = cairo_copy_path_flat (cr);
+    points = g_array_new (FALSE, FALSE, sizeof (double));
+    n_sub_points = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    path->bbox.x1 = path->bbox.y1 = G_MAXDOUBLE;
+    path->bbox.x2 = path->bbox.y2 = -G_MAXDOUBLE;
+
+    for (i = 0; i < flat->num_data; i += flat->data[i].header.length)
+    {
+        pdata = &(flat->data[i]);
+
+        switch (pdata->header.type)
+        {
+            case CAIRO_PATH_MOVE_TO:
+                if (n > 0)
+                    g_array_append_val (n_sub_points, n);
+                n = 0;
+                /* fall through */
+
+            case CAIRO_PATH_LINE_TO:
+                x = pdata[1].point.x;
+                y = pdata[1].point.y;
+                cairo_user_to_device (cr, &x, &y);
+
+                g_array_append_val (points, x);
+                g_array_append_val (points, y);
+                n++;
+
+                path->bbox.x1 = MIN (path->bbox.x1, x);
+                path->bbox.y1 = MIN (path->bbox.y1, y);
+                path->bbox.x2 = MAX (path->bbox.x2, x);
+                path->bbox.y2 = MAX (path->bbox.y2, y);
+                break;
+
+            case CAIRO_PATH_CLOSE_PATH:
+                /* Strokes draw the closing segment too */
+                if (is_stroke && n > 0)
+                {
+                    x = g_array_index (points, double, points->len - 2 * n);
+                    y = g_array_index (points, double, points->len - 2 * n + 1);
+                    g_array_append_val (points, x);
+                    g_array_append_val (points, y);
+                    n++;
+                }
+                break;
+
+            default:
+                /* Curves are flattened by cairo */
+                break;
+        }
+    }
+
+    if (n > 0)
+        g_array_append_val (n_sub_points, n);
+
+    cairo_path_destroy (flat);
+
+    /* Strokes reach half the line width beyond the path */
+    margin = is_stroke ? path->line_width / 2.0 : 0.0;
+    path->bbox.x1 -= margin;
+    path->bbox.y1 -= margin;
+    path->bbox.x2 += margin;
+    path->bbox.y2 += margin;
+
+    path->n_subpaths = n_sub_points->len;
+    path->n_sub_points = (guint *) g_array_free (n_sub_points, FALSE);
+    path->points = (double *) g_array_free (points, FALSE);
+
+    input_region_add_path (area->priv->current_input, path);
+
     return path;
 }
 
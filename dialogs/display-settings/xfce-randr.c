@@ -48,6 +48,9 @@ struct _XfceRandrPrivate
     /* cache for the output/mode info */
     XRROutputInfo      **output_info;
     XfceRRMode         **modes;
+
+    /* channel the outputs are saved to on (re)population */
+    BlconfChannel       *channel;
 };
 
 
@@ -163,8 +166,6 @@ xfce_randr_populate (XfceRandr *randr,
     guint           m, connected;
     guint          *output_ids = NULL;
 
-    BlconfChannel *display_channel = blconf_channel_new ("displays");
-
     g_return_if_fail (randr != NULL);
     g_return_if_fail (randr->priv != NULL);
     g_return_if_fail (randr->priv->resources != NULL);
@@ -248,7 +249,7 @@ xfce_randr_populate (XfceRandr *randr,
         randr->friendly_name[m] = xfce_randr_friendly_name (randr, m, output_ids[m]);
 
         /* Update display info, primary display may have changed. */
-        xfce_randr_save_output (randr, "Default", display_channel, m);
+        xfce_randr_save_output (randr, "Default", randr->priv->channel, m);
         
         /* Replace spaces with underscore in name for blconf compatibility */
         g_strcanon(randr->priv->output_info[m]->name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_<>", '_');
@@ -301,6 +302,9 @@ xfce_randr_new (GdkDisplay  *display,
     /* set display */
     randr->priv->display = display;
 
+    /* the channel is reused for every reload */
+    randr->priv->channel = blconf_channel_new ("displays");
+
     /* get the root window */
     root_window = gdk_get_default_root_window ();
 
@@ -352,6 +356,8 @@ xfce_randr_free (XfceRandr *randr)
 {
     xfce_randr_cleanup (randr);
 
+    g_object_unref (G_OBJECT (randr->priv->channel));
+
     /* free the structure */
     g_slice_free (XfceRandrPrivate, randr->priv);
     g_slice_free (XfceRandr, randr);
@@ -390,6 +396,74 @@ xfce_randr_reload (XfceRandr *randr)
 
 
 
+static void
+xfce_randr_save_string (BlconfChannel *channel,
+                        GHashTable    *props,
+                        const gchar   *property,
+                        const gchar   *str_value)
+{
+    const GValue *value;
+
+    value = props != NULL ? g_hash_table_lookup (props, property) : NULL;
+    if (value == NULL
+        || !G_VALUE_HOLDS_STRING (value)
+        || g_strcmp0 (g_value_get_string (value), str_value) != 0)
+        blconf_channel_set_string (channel, property, str_value);
+}
+
+
+
+static void
+xfce_randr_save_bool (BlconfChannel *channel,
+                      GHashTable    *props,
+                      const gchar   *property,
+                      gboolean       bool_value)
+{
+    const GValue *value;
+
+    value = props != NULL ? g_hash_table_lookup (props, property) : NULL;
+    if (value == NULL
+        || !G_VALUE_HOLDS_BOOLEAN (value)
+        || g_value_get_boolean (value) != bool_value)
+        blconf_channel_set_bool (channel, property, bool_value);
+}
+
+
+
+static void
+xfce_randr_save_int (BlconfChannel *channel,
+                     GHashTable    *props,
+                     const gchar   *property,
+                     gint           int_value)
+{
+    const GValue *value;
+
+    value = props != NULL ? g_hash_table_lookup (props, property) : NULL;
+    if (value == NULL
+        || !G_VALUE_HOLDS_INT (value)
+        || g_value_get_int (value) != int_value)
+        blconf_channel_set_int (channel, property, int_value);
+}
+
+
+
+static void
+xfce_randr_save_double (BlconfChannel *channel,
+                        GHashTable    *props,
+                        const gchar   *property,
+                        gdouble        double_value)
+{
+    const GValue *value;
+
+    value = props != NULL ? g_hash_table_lookup (props, property) : NULL;
+    if (value == NULL
+        || !G_VALUE_HOLDS_DOUBLE (value)
+        || g_value_get_double (value) != double_value)
+        blconf_channel_set_double (channel, property, double_value);
+}
+
+
+
 void
 xfce_randr_save_output (XfceRandr     *randr,
                         const gchar   *scheme,
@@ -400,15 +474,20 @@ xfce_randr_save_output (XfceRandr     *randr,
     gchar            *str_value;
     const XfceRRMode *mode;
     gint              degrees;
+    GHashTable       *props;
 
     g_return_if_fail (randr != NULL && scheme != NULL);
     g_return_if_fail (BLCONF_IS_CHANNEL (channel));
     g_return_if_fail (output < randr->noutput);
 
-    /* save the device name */
+    /* fetch the stored settings of the output in one call, only the
+     * properties that differ from the current state are written */
     g_snprintf (property, sizeof (property), "/%s/%s", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_string (channel, property, randr->friendly_name[output]);
+    props = blconf_channel_get_properties (channel, property);
+
+    /* save the device name */
+    xfce_randr_save_string (channel, props, property, randr->friendly_name[output]);
 
     /* find the resolution and refresh rate */
     mode = xfce_randr_find_mode_by_id (randr, output, randr->mode[output]);
@@ -416,22 +495,26 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* if no resolution was found, mark it as inactive and stop */
     g_snprintf (property, sizeof (property), "/%s/%s/Active", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_bool (channel, property, mode != NULL);
+    xfce_randr_save_bool (channel, props, property, mode != NULL);
 
     if (mode == NULL)
+    {
+        if (props != NULL)
+            g_hash_table_destroy (props);
         return;
+    }
 
     /* save the resolution */
     str_value = g_strdup_printf ("%dx%d", mode->width, mode->height);
     g_snprintf (property, sizeof (property), "/%s/%s/Resolution", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_string (channel, property, str_value);
+    xfce_randr_save_string (channel, props, property, str_value);
     g_free (str_value);
 
     /* save the refresh rate */
     g_snprintf (property, sizeof (property), "/%s/%s/RefreshRate", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_double (channel, property, mode->rate);
+    xfce_randr_save_double (channel, props, property, mode->rate);
 
     /* convert the rotation into degrees */
     switch (randr->rotation[output] & XFCE_RANDR_ROTATIONS_MASK)
@@ -445,7 +528,7 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* save the rotation in degrees */
     g_snprintf (property, sizeof (property), "/%s/%s/Rotation", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_int (channel, property, degrees);
+    xfce_randr_save_int (channel, props, property, degrees);
 
     /* convert the reflection into a string */
     switch (randr->rotation[output] & XFCE_RANDR_REFLECTIONS_MASK)
@@ -459,23 +542,26 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* save the reflection string */
     g_snprintf (property, sizeof (property), "/%s/%s/Reflection", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_string (channel, property, str_value);
+    xfce_randr_save_string (channel, props, property, str_value);
 
 #ifdef HAS_RANDR_ONE_POINT_THREE
     /* is it the primary output? */
     g_snprintf (property, sizeof (property), "/%s/%s/Primary", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_bool (channel, property,
-                             randr->status[output] == XFCE_OUTPUT_STATUS_PRIMARY);
+    xfce_randr_save_bool (channel, props, property,
+                          randr->status[output] == XFCE_OUTPUT_STATUS_PRIMARY);
 #endif
 
     /* save the position */
     g_snprintf (property, sizeof (property), "/%s/%s/Position/X", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_int (channel, property, MAX (randr->position[output].x, 0));
+    xfce_randr_save_int (channel, props, property, MAX (randr->position[output].x, 0));
     g_snprintf (property, sizeof (property), "/%s/%s/Position/Y", scheme,
                 randr->priv->output_info[output]->name);
-    blconf_channel_set_int (channel, property, MAX (randr->position[output].y, 0));
+    xfce_randr_save_int (channel, props, property, MAX (randr->position[output].y, 0));
+
+    if (props != NULL)
+        g_hash_table_destroy (props);
 }
 
 
@@ -504,47 +590,151 @@ xfce_randr_load (XfceRandr     *randr,
 
 
 
-static guint8 *
-xfce_randr_read_edid_data (Display  *xdisplay,
-                           RROutput  output)
+/* size of the EDID base block, extension blocks have the same size */
+#define EDID_BLOCK_SIZE 128
+
+
+
+/* decoded EDIDs by their base block, reused when the dialog reloads */
+static GHashTable *edid_cache = NULL;
+
+
+
+static guint
+xfce_randr_edid_hash (gconstpointer key)
+{
+    const guint8 *block = key;
+
+    /* manufacturer, product code, serial number and checksum */
+    return (block[0x08] << 24 | block[0x09] << 16 | block[0x0a] << 8 | block[0x0b])
+           ^ (block[0x0c] | block[0x0d] << 8 | block[0x0e] << 16 | block[0x0f] << 24)
+           ^ block[0x7f];
+}
+
+
+
+static gboolean
+xfce_randr_edid_equal (gconstpointer a,
+                       gconstpointer b)
+{
+    return memcmp (a, b, EDID_BLOCK_SIZE) == 0;
+}
+
+
+
+static gboolean
+xfce_randr_read_edid_property (Display        *xdisplay,
+                               RROutput        output,
+                               Atom            edid_atom,
+                               glong           offset,
+                               glong           length,
+                               unsigned char **data,
+                               gulong         *nitems,
+                               gulong         *bytes_after)
 {
-    unsigned char *prop;
     int            actual_format;
-    unsigned long  nitems, bytes_after;
     Atom           actual_type;
-    Atom           edid_atom;
-    guint8        *result = NULL;
-
-    edid_atom = gdk_x11_get_xatom_by_name (RR_PROPERTY_RANDR_EDID);
+    unsigned char *prop = NULL;
+    gboolean       result = FALSE;
 
-    if (edid_atom != None)
+    if (XRRGetOutputProperty (xdisplay, output, edid_atom, offset, length,
+                              False, False, AnyPropertyType,
+                              &actual_type, &actual_format, nitems,
+                              bytes_after, &prop) == Success)
     {
-        if (XRRGetOutputProperty (xdisplay, output, edid_atom, 0, 100,
-                                  False, False, AnyPropertyType,
-                                  &actual_type, &actual_format, &nitems,
-                                  &bytes_after, &prop) == Success)
+        if (actual_type == XA_INTEGER && actual_format == 8)
         {
-            if (actual_type == XA_INTEGER && actual_format == 8)
-                result = g_memdup (prop, nitems);
+            *data = prop;
+            return TRUE;
         }
+    }
 
+    if (prop != NULL)
         XFree (prop);
-    }
 
     return result;
 }
 
 
 
+static const MonitorInfo *
+xfce_randr_get_monitor_info (Display  *xdisplay,
+                             RROutput  output)
+{
+    unsigned char *base, *extensions;
+    gulong         nitems, ext_nitems, bytes_after;
+    gulong         ext_size;
+    Atom           edid_atom;
+    guint8        *edid;
+    MonitorInfo   *info = NULL;
+    gpointer       key;
+
+    edid_atom = gdk_x11_get_xatom_by_name (RR_PROPERTY_RANDR_EDID);
+    if (edid_atom == None)
+        return NULL;
+
+    /* the base block is enough to recognize a monitor we decoded before */
+    if (!xfce_randr_read_edid_property (xdisplay, output, edid_atom, 0, EDID_BLOCK_SIZE / 4,
+                                        &base, &nitems, &bytes_after))
+        return NULL;
+
+    if (nitems < EDID_BLOCK_SIZE)
+    {
+        XFree (base);
+        return NULL;
+    }
+
+    if (G_UNLIKELY (edid_cache == NULL))
+        edid_cache = g_hash_table_new_full (xfce_randr_edid_hash, xfce_randr_edid_equal,
+                                            g_free, g_free);
+
+    if (g_hash_table_lookup_extended (edid_cache, base, NULL, (gpointer *) &info))
+    {
+        XFree (base);
+        return info;
+    }
+
+    /* fetch the CEA and DisplayID extension blocks too, the whole
+     * property, instead of a fixed number of longs */
+    ext_size = bytes_after;
+    edid = g_malloc (EDID_BLOCK_SIZE + ext_size);
+    memcpy (edid, base, EDID_BLOCK_SIZE);
+    ext_nitems = 0;
+
+    if (ext_size > 0
+        && xfce_randr_read_edid_property (xdisplay, output, edid_atom,
+                                          EDID_BLOCK_SIZE / 4, (ext_size + 3) / 4,
+                                          &extensions, &ext_nitems, &bytes_after))
+    {
+        /* the read is rounded up to longs and the property may have
+         * grown since the first read, only keep what was allocated */
+        ext_nitems = MIN (ext_nitems, ext_size);
+        memcpy (edid + EDID_BLOCK_SIZE, extensions, ext_nitems);
+        XFree (extensions);
+    }
+
+    info = decode_edid (edid, EDID_BLOCK_SIZE + ext_nitems);
+    g_free (edid);
+
+    /* also remember the EDIDs that could not be decoded */
+    key = g_memdup (base, EDID_BLOCK_SIZE);
+    g_hash_table_insert (edid_cache, key, info);
+
+    XFree (base);
+
+    return info;
+}
+
+
+
 static gchar *
 xfce_randr_friendly_name (XfceRandr *randr,
                           guint      output,
                           guint      output_rr_id)
 {
-    Display        *xdisplay;
-    MonitorInfo    *info = NULL;
-    guint8         *edid_data;
-    gchar          *friendly_name = NULL;
+    Display           *xdisplay;
+    const MonitorInfo *info;
+    gchar             *friendly_name = NULL;
     const gchar *name = randr->priv->output_info[output]->name;
 
     /* special case, a laptop */
@@ -555,17 +745,11 @@ xfce_randr_friendly_name (XfceRandr *randr,
 
     /* otherwise, get the vendor & size */
     xdisplay = gdk_x11_display_get_xdisplay (randr->priv->display);
-    edid_data = xfce_randr_read_edid_data (xdisplay, randr->priv->resources->outputs[output_rr_id]);
-
-    if (edid_data)
-        info = decode_edid (edid_data);
+    info = xfce_randr_get_monitor_info (xdisplay, randr->priv->resources->outputs[output_rr_id]);
 
     if (info)
         friendly_name = make_display_name (info, output);
 
-    g_free (info);
-    g_free (edid_data);
-
     if (friendly_name)
         return friendly_name;
 
@@ -0,0 +1,1125 @@
+/* vi:set sw=2 sts=2 ts=2 et ai: */
+/*-
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_LIBXKLAVIER
+
+#include <string.h>
+#include <locale.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include <libbladeutil/libbladeutil.h>
+
+#include "xfce-keyboard-registry.h"
+
+#ifndef XKB_BASE
+#define XKB_BASE "/usr/share/X11/xkb"
+#endif
+
+#define XKB_DEFAULT_RULES      "evdev"
+
+#define REGISTRY_CACHE_FILE    "xfce4/keyboard-settings/xkb-registry.cache"
+#define REGISTRY_CACHE_MAGIC   "XKBREGI"
+#define REGISTRY_CACHE_VERSION (1)
+
+
+
+/* sections of the index, the children of a layout (group) are a
+ * contiguous range in the variants (options) section */
+enum
+{
+  SECTION_MODELS = 0,
+  SECTION_LAYOUTS,
+  SECTION_VARIANTS,
+  SECTION_GROUPS,
+  SECTION_OPTIONS,
+  N_SECTIONS
+};
+
+/* on-disk layout: header, the items of each section and the string pool,
+ * strings are referenced by their offset in the pool */
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 n_items[N_SECTIONS];
+  guint32 strings_len;
+  guint32 locale;
+  guint32 rules_file;
+  gint64  mtime;
+}
+RegistryCacheHeader;
+
+typedef struct
+{
+  guint32 name;
+  guint32 description;
+  guint32 first_child;
+  guint32 n_children;
+}
+RegistryCacheItem;
+
+/* temporary tree used while walking the xklavier registry */
+typedef struct
+{
+  gchar     *name;
+  gchar     *description;
+  gchar     *sort_key;
+  GPtrArray *children;
+}
+RegistryBuildItem;
+
+struct _XfceKeyboardRegistry
+{
+  gint                      ref_count;
+
+  /* contents of the cache file, the item strings point in here */
+  gchar                    *data;
+
+  XfceKeyboardRegistryItem *items[N_SECTIONS];
+  guint                     n_items[N_SECTIONS];
+
+  /* layout name -> index + 1 */
+  GHashTable               *layouts;
+};
+
+
+
+static RegistryBuildItem *
+xfce_keyboard_registry_build_item_new (const XklConfigItem *config_item)
+{
+  RegistryBuildItem *item;
+  gchar             *description;
+
+  item = g_slice_new0 (RegistryBuildItem);
+  item->name = g_strdup (config_item->name);
+
+  description = g_strstrip (g_strdup (config_item->description));
+  if (description[0] == '\0')
+    {
+      g_free (description);
+      description = g_strdup (config_item->name);
+    }
+  item->description = description;
+  item->sort_key = g_utf8_collate_key (description, -1);
+
+  return item;
+}
+
+
+
+static void
+xfce_keyboard_registry_build_item_free (gpointer data)
+{
+  RegistryBuildItem *item = data;
+
+  if (item->children != NULL)
+    g_ptr_array_free (item->children, TRUE);
+
+  g_free (item->name);
+  g_free (item->description);
+  g_free (item->sort_key);
+  g_slice_free (RegistryBuildItem, item);
+}
+
+
+
+static gint
+xfce_keyboard_registry_build_item_compare (gconstpointer a,
+                                           gconstpointer b)
+{
+  const RegistryBuildItem *item_a = *(RegistryBuildItem **) a;
+  const RegistryBuildItem *item_b = *(RegistryBuildItem **) b;
+
+  return strcmp (item_a->sort_key, item_b->sort_key);
+}
+
+
+
+static void
+xfce_keyboard_registry_build_add (XklConfigRegistry   *config_registry,
+                                  const XklConfigItem *config_item,
+                                  gpointer             user_data)
+{
+  GPtrArray *array = user_data;
+
+  g_ptr_array_add (array, xfce_keyboard_registry_build_item_new (config_item));
+}
+
+
+
+static void
+xfce_keyboard_registry_build_add_layout (XklConfigRegistry   *config_registry,
+                                         const XklConfigItem *config_item,
+                                         gpointer             user_data)
+{
+  GPtrArray         *array = user_data;
+  RegistryBuildItem *item;
+
+  item = xfce_keyboard_registry_build_item_new (config_item);
+  item->children = g_ptr_array_new_with_free_func (xfce_keyboard_registry_build_item_free);
+  g_ptr_array_add (array, item);
+
+  xkl_config_registry_foreach_layout_variant (config_registry, config_item->name,
+                                              xfce_keyboard_registry_build_add,
+                                              item->children);
+}
+
+
+
+static void
+xfce_keyboard_registry_build_add_group (XklConfigRegistry   *config_registry,
+                                        const XklConfigItem *config_item,
+                                        gpointer             user_data)
+{
+  GPtrArray         *array = user_data;
+  RegistryBuildItem *item;
+
+  item = xfce_keyboard_registry_build_item_new (config_item);
+  item->children = g_ptr_array_new_with_free_func (xfce_keyboard_registry_build_item_free);
+  g_ptr_array_add (array, item);
+
+  xkl_config_registry_foreach_option (config_registry, config_item->name,
+                                      xfce_keyboard_registry_build_add,
+                                      item->children);
+}
+
+
+
+static guint32
+xfce_keyboard_registry_add_string (GString     *strings,
+                                   const gchar *str)
+{
+  guint32 offset = strings->len;
+
+  /* include the nul terminator */
+  g_string_append_len (strings, str, strlen (str) + 1);
+
+  return offset;
+}
+
+
+
+static void
+xfce_keyboard_registry_serialize_section (GPtrArray *array,
+                                          GArray    *items,
+                                          GArray    *children,
+                                          GString   *strings)
+{
+  RegistryBuildItem *build_item;
+  RegistryCacheItem  item;
+  guint              i;
+
+  g_ptr_array_sort (array, xfce_keyboard_registry_build_item_compare);
+
+  for (i = 0; i < array->len; i++)
+    {
+      build_item = g_ptr_array_index (array, i);
+
+      item.name = xfce_keyboard_registry_add_string (strings, build_item->name);
+      item.description = xfce_keyboard_registry_add_string (strings, build_item->description);
+      item.first_child = 0;
+      item.n_children = 0;
+
+      if (children != NULL && build_item->children != NULL)
+        {
+          item.first_child = children->len;
+          item.n_children = build_item->children->len;
+
+          xfce_keyboard_registry_serialize_section (build_item->children,
+                                                    children, NULL, strings);
+        }
+
+      g_array_append_val (items, item);
+    }
+}
+
+
+
+static gchar *
+xfce_keyboard_registry_serialize (GPtrArray   *models,
+                                  GPtrArray   *layouts,
+                                  GPtrArray   *groups,
+                                  const gchar *locale,
+                                  const gchar *rules_file,
+                                  gint64       mtime,
+                                  gsize       *length)
+{
+  RegistryCacheHeader  header;
+  GArray              *items[N_SECTIONS];
+  GString             *strings;
+  gchar               *data, *p;
+  guint                i;
+
+  for (i = 0; i < N_SECTIONS; i++)
+    items[i] = g_array_new (FALSE, FALSE, sizeof (RegistryCacheItem));
+
+  strings = g_string_sized_new (64 * 1024);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, REGISTRY_CACHE_MAGIC, sizeof (header.magic));
+  header.version = REGISTRY_CACHE_VERSION;
+  header.locale = xfce_keyboard_registry_add_string (strings, locale);
+  header.rules_file = xfce_keyboard_registry_add_string (strings, rules_file);
+  header.mtime = mtime;
+
+  xfce_keyboard_registry_serialize_section (models, items[SECTION_MODELS], NULL, strings);
+  xfce_keyboard_registry_serialize_section (layouts, items[SECTION_LAYOUTS], items[SECTION_VARIANTS], strings);
+  xfce_keyboard_registry_serialize_section (groups, items[SECTION_GROUPS], items[SECTION_OPTIONS], strings);
+
+  *length = sizeof (header) + strings->len;
+  for (i = 0; i < N_SECTIONS; i++)
+    {
+      header.n_items[i] = items[i]->len;
+      *length += items[i]->len * sizeof (RegistryCacheItem);
+    }
+  header.strings_len = strings->len;
+
+  data = p = g_malloc (*length);
+  memcpy (p, &header, sizeof (header));
+  p += sizeof (header);
+
+  for (i = 0; i < N_SECTIONS; i++)
+    {
+      memcpy (p, items[i]->data, items[i]->len * sizeof (RegistryCacheItem));
+      p += items[i]->len * sizeof (RegistryCacheItem);
+      g_array_free (items[i], TRUE);
+    }
+
+  memcpy (p, strings->str, strings->len);
+  g_string_free (strings, TRUE);
+
+  return data;
+}
+
+
+
+/* takes ownership of data, returns NULL if the data is invalid or was
+ * generated for another locale or rules file */
+static XfceKeyboardRegistry *
+xfce_keyboard_registry_new_from_data (gchar       *data,
+                                      gsize        length,
+                                      const gchar *locale,
+                                      const gchar *rules_file,
+                                      gint64       mtime)
+{
+  XfceKeyboardRegistry    *registry;
+  RegistryCacheHeader      header;
+  const RegistryCacheItem *cache_items;
+  const gchar             *strings;
+  gsize                    expected;
+  guint                    i, n, child_section;
+
+  if (length < sizeof (header))
+    goto invalid;
+
+  memcpy (&header, data, sizeof (header));
+  if (memcmp (header.magic, REGISTRY_CACHE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != REGISTRY_CACHE_VERSION
+      || header.mtime != mtime)
+    goto invalid;
+
+  expected = sizeof (header) + header.strings_len;
+  for (i = 0; i < N_SECTIONS; i++)
+    expected += (gsize) header.n_items[i] * sizeof (RegistryCacheItem);
+
+  if (expected != length
+      || header.strings_len == 0
+      || header.locale >= header.strings_len
+      || header.rules_file >= header.strings_len)
+    goto invalid;
+
+  strings = data + length - header.strings_len;
+  if (strings[header.strings_len - 1] != '\0'
+      || strcmp (strings + header.locale, locale) != 0
+      || strcmp (strings + header.rules_file, rules_file) != 0)
+    goto invalid;
+
+  registry = g_slice_new0 (XfceKeyboardRegistry);
+  registry->ref_count = 1;
+  registry->data = data;
+  registry->layouts = g_hash_table_new (g_str_hash, g_str_equal);
+
+  cache_items = (const RegistryCacheItem *) (data + sizeof (header));
+  for (i = 0; i < N_SECTIONS; i++)
+    {
+      if (i == SECTION_LAYOUTS)
+        child_section = SECTION_VARIANTS;
+      else if (i == SECTION_GROUPS)
+        child_section = SECTION_OPTIONS;
+      else
+        child_section = N_SECTIONS;
+
+      registry->n_items[i] = header.n_items[i];
+      registry->items[i] = g_new0 (XfceKeyboardRegistryItem, header.n_items[i]);
+
+      for (n = 0; n < header.n_items[i]; n++, cache_items++)
+        {
+          if (cache_items->name >= header.strings_len
+              || cache_items->description >= header.strings_len)
+            goto invalid_registry;
+
+          if (cache_items->n_children > 0
+              && (child_section == N_SECTIONS
+                  || cache_items->first_child > header.n_items[child_section]
+                  || cache_items->n_children > header.n_items[child_section] - cache_items->first_child))
+            goto invalid_registry;
+
+          registry->items[i][n].name = strings + cache_items->name;
+          registry->items[i][n].description = strings + cache_items->description;
+          registry->items[i][n].first_child = cache_items->first_child;
+          registry->items[i][n].n_children = cache_items->n_children;
+
+          if (i == SECTION_LAYOUTS)
+            g_hash_table_insert (registry->layouts, (gpointer) registry->items[i][n].name,
+                                 GUINT_TO_POINTER (n + 1));
+        }
+    }
+
+  return registry;
+
+invalid_registry:
+  xfce_keyboard_registry_unref (registry);
+  return NULL;
+
+invalid:
+  g_free (data);
+  return NULL;
+}
+
+
+
+static gchar *
+xfce_keyboard_registry_get_rules_file (XklEngine *engine)
+{
+  Display *xdisplay = xkl_engine_get_display (engine);
+  Atom     rules_atom;
+  Atom     type;
+  gint     format;
+  gulong   n_items;
+  gulong   bytes_after;
+  guchar  *data = NULL;
+  gchar   *rules = NULL;
+  gchar   *filename;
+
+  /* the server publishes the rules it was started with, which is also
+   * the rules file xklavier loads the registry from */
+  rules_atom = XInternAtom (xdisplay, "_XKB_RULES_NAMES", True);
+  if (rules_atom != None
+      && XGetWindowProperty (xdisplay, DefaultRootWindow (xdisplay), rules_atom,
+                             0, 1024, False, XA_STRING, &type, &format,
+                             &n_items, &bytes_after, &data) == Success
+      && data != NULL)
+    {
+      /* the first string in the list is the rules name */
+      if (type == XA_STRING && format == 8 && n_items > 0 && data[0] != '\0')
+        rules = g_strndup ((const gchar *) data, n_items);
+      XFree (data);
+    }
+
+  filename = g_strdup_printf ("%s/rules/%s.xml", XKB_BASE,
+                              rules != NULL ? rules : XKB_DEFAULT_RULES);
+  g_free (rules);
+
+  return filename;
+}
+
+
+
+/**
+ * Returns the registry index, loaded from the cache file when it
+ * still matches the rules file and locale, otherwise the xklavier
+ * registry is walked once and the cache is rewritten.
+ */
+XfceKeyboardRegistry *
+xfce_keyboard_registry_get (XklEngine *engine)
+{
+  XfceKeyboardRegistry *registry = NULL;
+  XklConfigRegistry    *config_registry;
+  GPtrArray            *models;
+  GPtrArray            *layouts;
+  GPtrArray            *groups;
+  struct stat           st;
+  const gchar          *locale;
+  gchar                *rules_file;
+  gchar                *cache_file;
+  gchar                *data;
+  gsize                 length;
+  gint64                mtime = 0;
+  GError               *error = NULL;
+
+  g_return_val_if_fail (XKL_IS_ENGINE (engine), NULL);
+
+  locale = setlocale (LC_MESSAGES, NULL);
+  if (locale == NULL)
+    locale = "C";
+
+  rules_file = xfce_keyboard_registry_get_rules_file (engine);
+  if (g_stat (rules_file, &st) == 0)
+    mtime = st.st_mtime;
+
+  cache_file = xfce_resource_save_location (XFCE_RESOURCE_CACHE, REGISTRY_CACHE_FILE, TRUE);
+  if (cache_file != NULL
+      && g_file_get_contents (cache_file, &data, &length, NULL))
+    registry = xfce_keyboard_registry_new_from_data (data, length, locale, rules_file, mtime);
+
+  if (registry == NULL)
+    {
+      config_registry = xkl_config_registry_get_instance (engine);
+#ifdef HAVE_LIBXKLAVIER4
+      xkl_config_registry_load (config_registry, FALSE);
+#else
+      xkl_config_registry_load (config_registry);
+#endif
+
+      models = g_ptr_array_new_with_free_func (xfce_keyboard_registry_build_item_free);
+      layouts = g_ptr_array_new_with_free_func (xfce_keyboard_registry_build_item_free);
+      groups = g_ptr_array_new_with_free_func (xfce_keyboard_registry_build_item_free);
+
+      xkl_config_registry_foreach_model (config_registry, xfce_keyboard_registry_build_add, models);
+      xkl_config_registry_foreach_layout (config_registry, xfce_keyboard_registry_build_add_layout, layouts);
+      xkl_config_registry_foreach_option_group (config_registry, xfce_keyboard_registry_build_add_group, groups);
+
+      g_object_unref (G_OBJECT (config_registry));
+
+      data = xfce_keyboard_registry_serialize (models, layouts, groups,
+                                               locale, rules_file, mtime, &length);
+
+      g_ptr_array_free (models, TRUE);
+      g_ptr_array_free (layouts, TRUE);
+      g_ptr_array_free (groups, TRUE);
+
+      if (cache_file != NULL
+          && !g_file_set_contents (cache_file, data, length, &error))
+        {
+          g_warning ("Failed to save the keyboard registry cache: %s", error->message);
+          g_error_free (error);
+        }
+
+      registry = xfce_keyboard_registry_new_from_data (data, length, locale, rules_file, mtime);
+    }
+
+  g_free (cache_file);
+  g_free (rules_file);
+
+  return registry;
+}
+
+
+
+XfceKeyboardRegistry *
+xfce_keyboard_registry_ref (XfceKeyboardRegistry *registry)
+{
+  g_return_val_if_fail (registry != NULL, NULL);
+
+  g_atomic_int_inc (&registry->ref_count);
+
+  return registry;
+}
+
+
+
+void
+xfce_keyboard_registry_unref (XfceKeyboardRegistry *registry)
+{
+  guint i, n;
+
+  g_return_if_fail (registry != NULL);
+
+  if (!g_atomic_int_dec_and_test (&registry->ref_count))
+    return;
+
+  for (i = 0; i < N_SECTIONS; i++)
+    {
+      if (registry->items[i] == NULL)
+        continue;
+
+      for (n = 0; n < registry->n_items[i]; n++)
+        g_free (registry->items[i][n].search_key);
+      g_free (registry->items[i]);
+    }
+
+  g_hash_table_destroy (registry->layouts);
+  g_free (registry->data);
+  g_slice_free (XfceKeyboardRegistry, registry);
+}
+
+
+
+const XfceKeyboardRegistryItem *
+xfce_keyboard_registry_get_models (XfceKeyboardRegistry *registry,
+                                   guint                *n_models)
+{
+  g_return_val_if_fail (registry != NULL, NULL);
+
+  *n_models = registry->n_items[SECTION_MODELS];
+
+  return registry->items[SECTION_MODELS];
+}
+
+
+
+const XfceKeyboardRegistryItem *
+xfce_keyboard_registry_get_options (XfceKeyboardRegistry *registry,
+                                    const gchar          *group_name,
+                                    guint                *n_options)
+{
+  const XfceKeyboardRegistryItem *group;
+  guint                           i;
+
+  g_return_val_if_fail (registry != NULL, NULL);
+  g_return_val_if_fail (group_name != NULL, NULL);
+
+  for (i = 0; i < registry->n_items[SECTION_GROUPS]; i++)
+    {
+      group = &registry->items[SECTION_GROUPS][i];
+      if (strcmp (group->name, group_name) == 0)
+        {
+          *n_options = group->n_children;
+          return registry->items[SECTION_OPTIONS] + group->first_child;
+        }
+    }
+
+  *n_options = 0;
+
+  return NULL;
+}
+
+
+
+static gint
+xfce_keyboard_registry_lookup_layout (XfceKeyboardRegistry *registry,
+                                      const gchar          *layout)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (registry->layouts, layout)) - 1;
+}
+
+
+
+static gint
+xfce_keyboard_registry_lookup_variant (XfceKeyboardRegistry *registry,
+                                       guint                 layout,
+                                       const gchar          *variant)
+{
+  const XfceKeyboardRegistryItem *item = &registry->items[SECTION_LAYOUTS][layout];
+  guint                           i;
+
+  for (i = 0; i < item->n_children; i++)
+    if (strcmp (registry->items[SECTION_VARIANTS][item->first_child + i].name, variant) == 0)
+      return i;
+
+  return -1;
+}
+
+
+
+const XfceKeyboardRegistryItem *
+xfce_keyboard_registry_find_layout (XfceKeyboardRegistry *registry,
+                                    const gchar          *layout)
+{
+  gint n;
+
+  g_return_val_if_fail (registry != NULL, NULL);
+  g_return_val_if_fail (layout != NULL, NULL);
+
+  n = xfce_keyboard_registry_lookup_layout (registry, layout);
+  if (n < 0)
+    return NULL;
+
+  return &registry->items[SECTION_LAYOUTS][n];
+}
+
+
+
+const XfceKeyboardRegistryItem *
+xfce_keyboard_registry_find_variant (XfceKeyboardRegistry *registry,
+                                     const gchar          *layout,
+                                     const gchar          *variant)
+{
+  gint n, v;
+
+  g_return_val_if_fail (registry != NULL, NULL);
+  g_return_val_if_fail (layout != NULL, NULL);
+
+  if (variant == NULL)
+    return NULL;
+
+  n = xfce_keyboard_registry_lookup_layout (registry, layout);
+  if (n < 0)
+    return NULL;
+
+  v = xfce_keyboard_registry_lookup_variant (registry, n, variant);
+  if (v < 0)
+    return NULL;
+
+  return &registry->items[SECTION_VARIANTS][registry->items[SECTION_LAYOUTS][n].first_child + v];
+}
+
+
+
+/* the iter stores the layout index in user_data and the variant index
+ * plus one in user_data2, so the layout rows have a zero user_data2 */
+#define ITER_LAYOUT(iter)  (GPOINTER_TO_UINT ((iter)->user_data))
+#define ITER_VARIANT(iter) (GPOINTER_TO_UINT ((iter)->user_data2))
+
+static void               xfce_keyboard_registry_model_tree_model_init  (GtkTreeModelIface *iface);
+static void               xfce_keyboard_registry_model_finalize         (GObject           *object);
+static GtkTreeModelFlags  xfce_keyboard_registry_model_get_flags        (GtkTreeModel      *tree_model);
+static gint               xfce_keyboard_registry_model_get_n_columns    (GtkTreeModel      *tree_model);
+static GType              xfce_keyboard_registry_model_get_column_type  (GtkTreeModel      *tree_model,
+                                                                         gint               idx);
+static gboolean           xfce_keyboard_registry_model_get_iter         (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter,
+                                                                         GtkTreePath       *path);
+static GtkTreePath       *xfce_keyboard_registry_model_get_path         (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter);
+static void               xfce_keyboard_registry_model_get_value        (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter,
+                                                                         gint               column,
+                                                                         GValue            *value);
+static gboolean           xfce_keyboard_registry_model_iter_next        (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter);
+static gboolean           xfce_keyboard_registry_model_iter_children    (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter,
+                                                                         GtkTreeIter       *parent);
+static gboolean           xfce_keyboard_registry_model_iter_has_child   (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter);
+static gint               xfce_keyboard_registry_model_iter_n_children  (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter);
+static gboolean           xfce_keyboard_registry_model_iter_nth_child   (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter,
+                                                                         GtkTreeIter       *parent,
+                                                                         gint               n);
+static gboolean           xfce_keyboard_registry_model_iter_parent      (GtkTreeModel      *tree_model,
+                                                                         GtkTreeIter       *iter,
+                                                                         GtkTreeIter       *child);
+
+
+
+struct _XfceKeyboardRegistryModelClass
+{
+  GObjectClass __parent__;
+};
+
+struct _XfceKeyboardRegistryModel
+{
+  GObject               __parent__;
+
+  XfceKeyboardRegistry *registry;
+  gint                  stamp;
+};
+
+
+
+G_DEFINE_TYPE_WITH_CODE (XfceKeyboardRegistryModel, xfce_keyboard_registry_model, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, xfce_keyboard_registry_model_tree_model_init))
+
+
+
+static void
+xfce_keyboard_registry_model_class_init (XfceKeyboardRegistryModelClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = xfce_keyboard_registry_model_finalize;
+}
+
+
+
+static void
+xfce_keyboard_registry_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = xfce_keyboard_registry_model_get_flags;
+  iface->get_n_columns = xfce_keyboard_registry_model_get_n_columns;
+  iface->get_column_type = xfce_keyboard_registry_model_get_column_type;
+  iface->get_iter = xfce_keyboard_registry_model_get_iter;
+  iface->get_path = xfce_keyboard_registry_model_get_path;
+  iface->get_value = xfce_keyboard_registry_model_get_value;
+  iface->iter_next = xfce_keyboard_registry_model_iter_next;
+  iface->iter_children = xfce_keyboard_registry_model_iter_children;
+  iface->iter_has_child = xfce_keyboard_registry_model_iter_has_child;
+  iface->iter_n_children = xfce_keyboard_registry_model_iter_n_children;
+  iface->iter_nth_child = xfce_keyboard_registry_model_iter_nth_child;
+  iface->iter_parent = xfce_keyboard_registry_model_iter_parent;
+}
+
+
+
+static void
+xfce_keyboard_registry_model_init (XfceKeyboardRegistryModel *model)
+{
+  model->stamp = g_random_int ();
+}
+
+
+
+static void
+xfce_keyboard_registry_model_finalize (GObject *object)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (object);
+
+  if (model->registry != NULL)
+    xfce_keyboard_registry_unref (model->registry);
+
+  (*G_OBJECT_CLASS (xfce_keyboard_registry_model_parent_class)->finalize) (object);
+}
+
+
+
+static XfceKeyboardRegistryItem *
+xfce_keyboard_registry_model_get_item (XfceKeyboardRegistryModel *model,
+                                       GtkTreeIter               *iter)
+{
+  XfceKeyboardRegistry     *registry = model->registry;
+  XfceKeyboardRegistryItem *layout;
+
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+  layout = &registry->items[SECTION_LAYOUTS][ITER_LAYOUT (iter)];
+  if (ITER_VARIANT (iter) == 0)
+    return layout;
+
+  return &registry->items[SECTION_VARIANTS][layout->first_child + ITER_VARIANT (iter) - 1];
+}
+
+
+
+static void
+xfce_keyboard_registry_model_set_iter (XfceKeyboardRegistryModel *model,
+                                       GtkTreeIter               *iter,
+                                       guint                      layout,
+                                       guint                      variant)
+{
+  iter->stamp = model->stamp;
+  iter->user_data = GUINT_TO_POINTER (layout);
+  iter->user_data2 = GUINT_TO_POINTER (variant);
+  iter->user_data3 = NULL;
+}
+
+
+
+static GtkTreeModelFlags
+xfce_keyboard_registry_model_get_flags (GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+
+
+static gint
+xfce_keyboard_registry_model_get_n_columns (GtkTreeModel *tree_model)
+{
+  return XFCE_KEYBOARD_REGISTRY_MODEL_N_COLUMNS;
+}
+
+
+
+static GType
+xfce_keyboard_registry_model_get_column_type (GtkTreeModel *tree_model,
+                                              gint          idx)
+{
+  return G_TYPE_STRING;
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_get_iter (GtkTreeModel *tree_model,
+                                       GtkTreeIter  *iter,
+                                       GtkTreePath  *path)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (tree_model);
+  XfceKeyboardRegistry      *registry = model->registry;
+  gint                      *indices;
+  gint                       depth;
+
+  depth = gtk_tree_path_get_depth (path);
+  indices = gtk_tree_path_get_indices (path);
+
+  if (depth < 1 || depth > 2
+      || indices[0] < 0
+      || (guint) indices[0] >= registry->n_items[SECTION_LAYOUTS])
+    return FALSE;
+
+  if (depth == 2
+      && (indices[1] < 0
+          || (guint) indices[1] >= registry->items[SECTION_LAYOUTS][indices[0]].n_children))
+    return FALSE;
+
+  xfce_keyboard_registry_model_set_iter (model, iter, indices[0],
+                                         depth == 2 ? indices[1] + 1 : 0);
+
+  return TRUE;
+}
+
+
+
+static GtkTreePath *
+xfce_keyboard_registry_model_get_path (GtkTreeModel *tree_model,
+                                       GtkTreeIter  *iter)
+{
+  GtkTreePath *path;
+
+  g_return_val_if_fail (iter->stamp == XFCE_KEYBOARD_REGISTRY_MODEL (tree_model)->stamp, NULL);
+
+  path = gtk_tree_path_new ();
+  gtk_tree_path_append_index (path, ITER_LAYOUT (iter));
+  if (ITER_VARIANT (iter) > 0)
+    gtk_tree_path_append_index (path, ITER_VARIANT (iter) - 1);
+
+  return path;
+}
+
+
+
+static void
+xfce_keyboard_registry_model_get_value (GtkTreeModel *tree_model,
+                                        GtkTreeIter  *iter,
+                                        gint          column,
+                                        GValue       *value)
+{
+  XfceKeyboardRegistryItem *item;
+
+  item = xfce_keyboard_registry_model_get_item (XFCE_KEYBOARD_REGISTRY_MODEL (tree_model), iter);
+  g_return_if_fail (item != NULL);
+
+  g_value_init (value, G_TYPE_STRING);
+
+  switch (column)
+    {
+    case XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION:
+      g_value_set_string (value, item->description);
+      break;
+
+    case XFCE_KEYBOARD_REGISTRY_MODEL_ID:
+      g_value_set_string (value, item->name);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_iter_next (GtkTreeModel *tree_model,
+                                        GtkTreeIter  *iter)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (tree_model);
+  XfceKeyboardRegistry      *registry = model->registry;
+  guint                      layout = ITER_LAYOUT (iter);
+  guint                      variant = ITER_VARIANT (iter);
+
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+  if (variant > 0)
+    {
+      if (variant >= registry->items[SECTION_LAYOUTS][layout].n_children)
+        return FALSE;
+
+      xfce_keyboard_registry_model_set_iter (model, iter, layout, variant + 1);
+    }
+  else
+    {
+      if (layout + 1 >= registry->n_items[SECTION_LAYOUTS])
+        return FALSE;
+
+      xfce_keyboard_registry_model_set_iter (model, iter, layout + 1, 0);
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_iter_children (GtkTreeModel *tree_model,
+                                            GtkTreeIter  *iter,
+                                            GtkTreeIter  *parent)
+{
+  return xfce_keyboard_registry_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_iter_has_child (GtkTreeModel *tree_model,
+                                             GtkTreeIter  *iter)
+{
+  return xfce_keyboard_registry_model_iter_n_children (tree_model, iter) > 0;
+}
+
+
+
+static gint
+xfce_keyboard_registry_model_iter_n_children (GtkTreeModel *tree_model,
+                                              GtkTreeIter  *iter)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (tree_model);
+  XfceKeyboardRegistry      *registry = model->registry;
+
+  if (iter == NULL)
+    return registry->n_items[SECTION_LAYOUTS];
+
+  g_return_val_if_fail (iter->stamp == model->stamp, 0);
+
+  if (ITER_VARIANT (iter) > 0)
+    return 0;
+
+  return registry->items[SECTION_LAYOUTS][ITER_LAYOUT (iter)].n_children;
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_iter_nth_child (GtkTreeModel *tree_model,
+                                             GtkTreeIter  *iter,
+                                             GtkTreeIter  *parent,
+                                             gint          n)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (tree_model);
+
+  if (n < 0 || n >= xfce_keyboard_registry_model_iter_n_children (tree_model, parent))
+    return FALSE;
+
+  if (parent == NULL)
+    xfce_keyboard_registry_model_set_iter (model, iter, n, 0);
+  else
+    xfce_keyboard_registry_model_set_iter (model, iter, ITER_LAYOUT (parent), n + 1);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+xfce_keyboard_registry_model_iter_parent (GtkTreeModel *tree_model,
+                                          GtkTreeIter  *iter,
+                                          GtkTreeIter  *child)
+{
+  XfceKeyboardRegistryModel *model = XFCE_KEYBOARD_REGISTRY_MODEL (tree_model);
+
+  g_return_val_if_fail (child->stamp == model->stamp, FALSE);
+
+  if (ITER_VARIANT (child) == 0)
+    return FALSE;
+
+  xfce_keyboard_registry_model_set_iter (model, iter, ITER_LAYOUT (child), 0);
+
+  return TRUE;
+}
+
+
+
+GtkTreeModel *
+xfce_keyboard_registry_model_new (XfceKeyboardRegistry *registry)
+{
+  XfceKeyboardRegistryModel *model;
+
+  g_return_val_if_fail (registry != NULL, NULL);
+
+  model = g_object_new (XFCE_TYPE_KEYBOARD_REGISTRY_MODEL, NULL);
+  model->registry = xfce_keyboard_registry_ref (registry);
+
+  return GTK_TREE_MODEL (model);
+}
+
+
+
+/**
+ * Returns the path of the layout row, or of the variant row if
+ * @variant is set and known, without walking the model.
+ */
+GtkTreePath *
+xfce_keyboard_registry_model_get_path_for (XfceKeyboardRegistryModel *model,
+                                           const gchar               *layout,
+                                           const gchar               *variant)
+{
+  GtkTreePath *path;
+  gint         n, v;
+
+  g_return_val_if_fail (XFCE_IS_KEYBOARD_REGISTRY_MODEL (model), NULL);
+  g_return_val_if_fail (layout != NULL, NULL);
+
+  n = xfce_keyboard_registry_lookup_layout (model->registry, layout);
+  if (n < 0)
+    return NULL;
+
+  path = gtk_tree_path_new_from_indices (n, -1);
+
+  if (variant != NULL && *variant != '\0')
+    {
+      v = xfce_keyboard_registry_lookup_variant (model->registry, n, variant);
+      if (v >= 0)
+        gtk_tree_path_append_index (path, v);
+    }
+
+  return path;
+}
+
+
+
+/**
+ * Search function for the tree view: matches the key anywhere in the
+ * description or name of the row, ignoring case. Like all
+ * GtkTreeViewSearchEqualFunc it returns FALSE on a match.
+ */
+gboolean
+xfce_keyboard_registry_model_search_equal (GtkTreeModel *tree_model,
+                                           gint          column,
+                                           const gchar  *key,
+                                           GtkTreeIter  *iter,
+                                           gpointer      search_data)
+{
+  XfceKeyboardRegistryItem *item;
+  gchar                    *str;
+  gchar                    *folded_key;
+  gboolean                  found;
+
+  item = xfce_keyboard_registry_model_get_item (XFCE_KEYBOARD_REGISTRY_MODEL (tree_model), iter);
+  if (G_UNLIKELY (item == NULL))
+    return TRUE;
+
+  /* fold the row once, the view calls this for every row on each key press */
+  if (item->search_key == NULL)
+    {
+      str = g_strconcat (item->description, "\n", item->name, NULL);
+      item->search_key = g_utf8_casefold (str, -1);
+      g_free (str);
+    }
+
+  folded_key = g_utf8_casefold (key, -1);
+  found = strstr (item->search_key, folded_key) != NULL;
+  g_free (folded_key);
+
+  return !found;
+}
+
+#endif /* HAVE_LIBXKLAVIER */
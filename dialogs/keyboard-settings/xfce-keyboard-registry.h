@@ -0,0 +1,98 @@
+/* vi:set sw=2 sts=2 ts=2 et ai: */
+/*-
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __XFCE_KEYBOARD_REGISTRY_H__
+#define __XFCE_KEYBOARD_REGISTRY_H__
+
+#include <gtk/gtk.h>
+#include <libxklavier/xklavier.h>
+
+G_BEGIN_DECLS
+
+typedef struct _XfceKeyboardRegistry     XfceKeyboardRegistry;
+typedef struct _XfceKeyboardRegistryItem XfceKeyboardRegistryItem;
+
+struct _XfceKeyboardRegistryItem
+{
+  const gchar *name;
+  const gchar *description;
+
+  /* range in the child section (variants of a layout, options of a group) */
+  guint        first_child;
+  guint        n_children;
+
+  /*< private >*/
+  gchar       *search_key;
+};
+
+XfceKeyboardRegistry           *xfce_keyboard_registry_get          (XklEngine            *engine);
+
+XfceKeyboardRegistry           *xfce_keyboard_registry_ref          (XfceKeyboardRegistry *registry);
+
+void                            xfce_keyboard_registry_unref        (XfceKeyboardRegistry *registry);
+
+const XfceKeyboardRegistryItem *xfce_keyboard_registry_get_models   (XfceKeyboardRegistry *registry,
+                                                                     guint                *n_models);
+
+const XfceKeyboardRegistryItem *xfce_keyboard_registry_get_options  (XfceKeyboardRegistry *registry,
+                                                                     const gchar          *group_name,
+                                                                     guint                *n_options);
+
+const XfceKeyboardRegistryItem *xfce_keyboard_registry_find_layout  (XfceKeyboardRegistry *registry,
+                                                                     const gchar          *layout);
+
+const XfceKeyboardRegistryItem *xfce_keyboard_registry_find_variant (XfceKeyboardRegistry *registry,
+                                                                     const gchar          *layout,
+                                                                     const gchar          *variant);
+
+
+
+/* read-only tree model of the layouts, variants are the children */
+enum
+{
+  XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION = 0,
+  XFCE_KEYBOARD_REGISTRY_MODEL_ID,
+  XFCE_KEYBOARD_REGISTRY_MODEL_N_COLUMNS
+};
+
+typedef struct _XfceKeyboardRegistryModelClass XfceKeyboardRegistryModelClass;
+typedef struct _XfceKeyboardRegistryModel      XfceKeyboardRegistryModel;
+
+#define XFCE_TYPE_KEYBOARD_REGISTRY_MODEL            (xfce_keyboard_registry_model_get_type ())
+#define XFCE_KEYBOARD_REGISTRY_MODEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), XFCE_TYPE_KEYBOARD_REGISTRY_MODEL, XfceKeyboardRegistryModel))
+#define XFCE_KEYBOARD_REGISTRY_MODEL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), XFCE_TYPE_KEYBOARD_REGISTRY_MODEL, XfceKeyboardRegistryModelClass))
+#define XFCE_IS_KEYBOARD_REGISTRY_MODEL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XFCE_TYPE_KEYBOARD_REGISTRY_MODEL))
+#define XFCE_IS_KEYBOARD_REGISTRY_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), XFCE_TYPE_KEYBOARD_REGISTRY_MODEL))
+#define XFCE_KEYBOARD_REGISTRY_MODEL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), XFCE_TYPE_KEYBOARD_REGISTRY_MODEL, XfceKeyboardRegistryModelClass))
+
+GType         xfce_keyboard_registry_model_get_type     (void) G_GNUC_CONST;
+
+GtkTreeModel *xfce_keyboard_registry_model_new          (XfceKeyboardRegistry *registry) G_GNUC_MALLOC;
+
+GtkTreePath  *xfce_keyboard_registry_model_get_path_for (XfceKeyboardRegistryModel *model,
+                                                         const gchar               *layout,
+                                                         const gchar               *variant);
+
+gboolean      xfce_keyboard_registry_model_search_equal (GtkTreeModel              *model,
+                                                         gint                       column,
+                                                         const gchar               *key,
+                                                         GtkTreeIter               *iter,
+                                                         gpointer                   search_data);
+
+G_END_DECLS
+
+#endif /* !__XFCE_KEYBOARD_REGISTRY_H__ */
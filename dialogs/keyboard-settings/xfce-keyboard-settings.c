@@ -43,6 +43,7 @@
 
 #ifdef HAVE_LIBXKLAVIER
 #include <libxklavier/xklavier.h>
+#include "xfce-keyboard-registry.h"
 #endif /* HAVE_LIBXKLAVIER */
 
 #define CUSTOM_BASE_PROPERTY         "/commands/custom"
@@ -78,13 +79,6 @@ enum
     XKB_TREE_NUM_COLUMNS
 };
 
-enum
-{
-    XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION = 0,
-    XKB_AVAIL_LAYOUTS_TREE_ID,
-    XKB_AVAIL_LAYOUTS_TREE_NUM_COLUMNS
-};
-
 typedef enum
 {
     MOVE_LAYOUT_UP,
@@ -93,6 +87,7 @@ typedef enum
 
 
 typedef struct _XfceKeyboardShortcutInfo    XfceKeyboardShortcutInfo;
+typedef struct _XfceKeyboardShortcutRow     XfceKeyboardShortcutRow;
 
 typedef
 void (*XfceKeyboardLayoutsComboInitFunc) (XfceKeyboardSettings *settings);
@@ -122,6 +117,16 @@ static gboolean                  xfce_keyboard_settings_validate_shortcut     (X
 static XfceKeyboardShortcutInfo *xfce_keyboard_settings_get_shortcut_info     (XfceKeyboardSettings      *settings,
                                                                                const gchar               *shortcut);
 static void                      xfce_keyboard_settings_free_shortcut_info    (XfceKeyboardShortcutInfo  *info);
+static void                      xfce_keyboard_settings_free_shortcut_row     (XfceKeyboardShortcutRow   *row);
+static XfceKeyboardShortcutRow  *xfce_keyboard_settings_lookup_shortcut       (XfceKeyboardSettings      *settings,
+                                                                               const gchar               *shortcut);
+static void                      xfce_keyboard_settings_insert_shortcut       (XfceKeyboardSettings      *settings,
+                                                                               const gchar               *shortcut,
+                                                                               const gchar               *command,
+                                                                               gboolean                   snotify);
+static void                      xfce_keyboard_settings_remove_shortcut_row   (XfceKeyboardSettings      *settings,
+                                                                               GtkTreeModel              *model,
+                                                                               GtkTreeIter               *iter);
 static void                      xfce_keyboard_settings_shortcut_added        (XfceShortcutsProvider     *provider,
                                                                                const gchar               *shortcut,
                                                                                XfceKeyboardSettings      *settings);
@@ -142,6 +147,9 @@ static void                      xfce_keyboard_settings_system_default_cb     (G
                                                                                XfceKeyboardSettings      *settings);
 static void                      xfce_keyboard_settings_set_layout            (XfceKeyboardSettings      *settings);
 static void                      xfce_keyboard_settings_init_layout           (XfceKeyboardSettings      *settings);
+static XfceKeyboardRegistry     *xfce_keyboard_settings_get_registry          (XfceKeyboardSettings      *settings);
+static void                      xfce_keyboard_settings_layout_tab_mapped     (GtkWidget                 *widget,
+                                                                               XfceKeyboardSettings      *settings);
 
 static void                      xfce_keyboard_settings_layouts_combo_populate(XfceKeyboardSettings     *settings,
                                                                                const gchar              *combo_name,
@@ -152,9 +160,6 @@ static void                      xfce_keyboard_settings_layouts_combo_init    (X
                                                                                const gchar               *combo_name,
                                                                                const gchar               *blconf_prop_name,
                                                                                const gchar               *default_value);
-static void                      xfce_keyboard_settings_layouts_combo_add     (XklConfigRegistry         *config_registry,
-                                                                               const XklConfigItem       *config_item,
-                                                                               gpointer                   user_data);
 static void                      xfce_keyboard_settings_layouts_combo_changed (GtkComboBox               *combo,
                                                                                XfceKeyboardSettings      *settings,
                                                                                const gchar               *blconf_prop_name);
@@ -189,12 +194,6 @@ static void                      xfce_keyboard_settings_up_layout_button_cb   (G
                                                                                XfceKeyboardSettings      *settings);
 static void                      xfce_keyboard_settings_down_layout_button_cb (GtkWidget                 *widget,
                                                                                XfceKeyboardSettings      *settings);
-static void                      xfce_keyboard_settings_add_variant_to_list   (XklConfigRegistry         *config_registry,
-                                                                               XklConfigItem             *config_item,
-                                                                               XfceKeyboardSettings      *settings);
-static void                      xfce_keyboard_settings_add_layout_to_list    (XklConfigRegistry         *config_registry,
-                                                                               XklConfigItem             *config_item,
-                                                                               XfceKeyboardSettings      *settings);
 static gchar**                   xfce_keyboard_settings_layout_selection      (XfceKeyboardSettings      *settings,
                                                                                const gchar               *layout,
                                                                                const gchar               *variant);
@@ -207,12 +206,16 @@ struct _XfceKeyboardSettingsPrivate
 {
   XfceShortcutsProvider *provider;
 
+  /* normalized shortcut -> XfceKeyboardShortcutRow */
+  GHashTable            *shortcut_rows;
+
 #ifdef HAVE_LIBXKLAVIER
   XklEngine             *xkl_engine;
-  XklConfigRegistry     *xkl_registry;
   XklConfigRec          *xkl_rec_config;
-  GtkTreeIter            layout_selection_iter;
-  GtkTreeStore          *layout_selection_treestore;
+
+  /* loaded when the layout tab is shown for the first time */
+  XfceKeyboardRegistry  *xkb_registry;
+  GtkTreeModel          *layout_selection_model;
 #endif
 
   BlconfChannel         *keyboards_channel;
@@ -223,7 +226,21 @@ struct _XfceKeyboardSettingsPrivate
 struct _XfceKeyboardShortcutInfo
 {
   XfceShortcutsProvider *provider;
-  XfceShortcut          *shortcut;
+  gchar                 *command;
+};
+
+struct _XfceKeyboardShortcutRow
+{
+  /* the normalized accelerator name, this is also the key in the
+   * hash table */
+  gchar       *key;
+
+  /* the shortcuts as stored by the provider that map to this row,
+   * different spellings of an accelerator are different properties */
+  GSList      *spellings;
+
+  /* list store iters persist, so this stays valid until the row is removed */
+  GtkTreeIter  iter;
 };
 
 
@@ -257,6 +274,9 @@ xfce_keyboard_settings_init (XfceKeyboardSettings *settings)
   settings->priv->keyboard_layout_channel = blconf_channel_new ("keyboard-layout");
   settings->priv->xsettings_channel = blconf_channel_new ("xsettings");
 
+  settings->priv->shortcut_rows = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                         (GDestroyNotify) xfce_keyboard_settings_free_shortcut_row);
+
   settings->priv->provider = xfce_shortcuts_provider_new ("commands");
   g_signal_connect (settings->priv->provider, "shortcut-added",
                     G_CALLBACK (xfce_keyboard_settings_shortcut_added), settings);
@@ -286,10 +306,13 @@ xfce_keyboard_settings_layouts_combo_populate (XfceKeyboardSettings *settings,
                                                XfceKeyboardLayoutsComboInitFunc combo_init_func,
                                                XfceKeyboardLayoutsComboChangedFunc combo_changed_func)
 {
-  GtkListStore    *list_store;
-  GtkTreeIter      iter;
-  GObject         *xkb_combo;
-  GtkCellRenderer *renderer;
+  XfceKeyboardRegistry           *registry;
+  const XfceKeyboardRegistryItem *items;
+  GtkListStore                   *list_store;
+  GtkTreeIter                     iter;
+  GObject                        *xkb_combo;
+  GtkCellRenderer                *renderer;
+  guint                           i, n_items;
 
   list_store = gtk_list_store_new (XKB_LAYOUTS_COMBO_NUM_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
   gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (list_store), 0, GTK_SORT_ASCENDING);
@@ -299,19 +322,18 @@ xfce_keyboard_settings_layouts_combo_populate (XfceKeyboardSettings *settings,
                       XKB_LAYOUTS_COMBO_DESCRIPTION, "-",
                       XKB_LAYOUTS_COMBO_VALUE, "", -1);
 
+  registry = xfce_keyboard_settings_get_registry (settings);
   if (option_group_name != NULL)
-  {
-    xkl_config_registry_foreach_option (settings->priv->xkl_registry,
-                                        option_group_name,
-                                        xfce_keyboard_settings_layouts_combo_add,
-                                        list_store);
-  }
+    items = xfce_keyboard_registry_get_options (registry, option_group_name, &n_items);
   else
-  {
-    xkl_config_registry_foreach_model (settings->priv->xkl_registry,
-                                       xfce_keyboard_settings_layouts_combo_add,
-                                       list_store);
-  }
+    items = xfce_keyboard_registry_get_models (registry, &n_items);
+
+  for (i = 0; i < n_items; i++)
+    {
+      gtk_list_store_insert_with_values (list_store, NULL, -1,
+                                         XKB_LAYOUTS_COMBO_DESCRIPTION, items[i].description,
+                                         XKB_LAYOUTS_COMBO_VALUE, items[i].name, -1);
+    }
 
   xkb_combo = gtk_builder_get_object (GTK_BUILDER (settings), combo_name);
   gtk_combo_box_set_model (GTK_COMBO_BOX (xkb_combo), GTK_TREE_MODEL (list_store));
@@ -429,16 +451,16 @@ xfce_keyboard_settings_constructed (GObject *object)
   settings->priv->xkl_rec_config = xkl_config_rec_new ();
   xkl_config_rec_get_from_server (settings->priv->xkl_rec_config, settings->priv->xkl_engine);
 
-  settings->priv->xkl_registry = xkl_config_registry_get_instance (settings->priv->xkl_engine);
-#ifdef HAVE_LIBXKLAVIER4
-  xkl_config_registry_load (settings->priv->xkl_registry, FALSE);
-#else
-  xkl_config_registry_load (settings->priv->xkl_registry);
-#endif
+  /* The registry is only needed to fill the layout tab, so defer
+   * loading it until the tab is shown */
+  settings->priv->xkb_registry = NULL;
+  settings->priv->layout_selection_model = NULL;
 
   /* Tab */
   xkb_tab_layout_vbox = gtk_builder_get_object (GTK_BUILDER (settings), "xkb_tab_layout_vbox");
   gtk_widget_show (GTK_WIDGET (xkb_tab_layout_vbox));
+  g_signal_connect (G_OBJECT (xkb_tab_layout_vbox), "map",
+                    G_CALLBACK (xfce_keyboard_settings_layout_tab_mapped), settings);
 
   /* Use system defaults, i.e., disable options */
   xkb_use_system_default_checkbutton = gtk_builder_get_object (GTK_BUILDER (settings), "xkb_use_system_default_checkbutton");
@@ -450,27 +472,7 @@ xfce_keyboard_settings_constructed (GObject *object)
                     G_CALLBACK (xfce_keyboard_settings_system_default_cb),
                     settings);
 
-  /* Keyboard model combo */
-  xfce_keyboard_settings_layouts_combo_populate (settings,
-                                                 "xkb_model_combo",
-                                                 NULL,
-                                                 xfce_keyboard_settings_init_model,
-                                                 xfce_keyboard_settings_model_changed_cb);
-  /* Group key combo */
-  xfce_keyboard_settings_layouts_combo_populate (settings,
-                                                 "xkb_grpkey_combo",
-                                                 "grp",
-                                                 xfce_keyboard_settings_init_grpkey,
-                                                 xfce_keyboard_settings_grpkey_changed_cb);
-  /* Compose key combo */
-  xfce_keyboard_settings_layouts_combo_populate (settings,
-                                                 "xkb_composekey_combo",
-                                                 "Compose key",
-                                                 xfce_keyboard_settings_init_compkey,
-                                                 xfce_keyboard_settings_compkey_changed_cb);
-
   /* Keyboard layout/variant treeview */
-  settings->priv->layout_selection_treestore = NULL;
   xkb_layout_view = gtk_builder_get_object (GTK_BUILDER (settings), "xkb_layout_view");
   gtk_tree_selection_set_mode (gtk_tree_view_get_selection (GTK_TREE_VIEW (xkb_layout_view)), GTK_SELECTION_BROWSE);
 
@@ -480,7 +482,6 @@ xfce_keyboard_settings_constructed (GObject *object)
 
   list_store = gtk_list_store_new (XKB_TREE_NUM_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
   gtk_tree_view_set_model (GTK_TREE_VIEW (xkb_layout_view), GTK_TREE_MODEL (list_store));
-  xfce_keyboard_settings_init_layout (settings);
   g_signal_connect (G_OBJECT (xkb_layout_view), "row-activated", G_CALLBACK (xfce_keyboard_settings_row_activated_cb), settings);
 
   /* Layout buttons */
@@ -495,8 +496,6 @@ xfce_keyboard_settings_constructed (GObject *object)
   g_signal_connect (G_OBJECT (xkb_layout_delete_button), "clicked", G_CALLBACK (xfce_keyboard_settings_del_layout_button_cb), settings);
   g_signal_connect (G_OBJECT (xkb_layout_up_button),     "clicked", G_CALLBACK (xfce_keyboard_settings_up_layout_button_cb), settings);
   g_signal_connect (G_OBJECT (xkb_layout_down_button),   "clicked", G_CALLBACK (xfce_keyboard_settings_down_layout_button_cb), settings);
-
-  xfce_keyboard_settings_update_layout_buttons (settings);
 #endif /* HAVE_LIBXKLAVIER */
 }
 
@@ -515,12 +514,17 @@ xfce_keyboard_settings_finalize (GObject *object)
   xkl_engine_stop_listen (settings->priv->xkl_engine);
 #endif /* HAVE_LIBXKLAVIER5 */
 
+  if (settings->priv->layout_selection_model != NULL)
+    g_object_unref (G_OBJECT (settings->priv->layout_selection_model));
+  if (settings->priv->xkb_registry != NULL)
+    xfce_keyboard_registry_unref (settings->priv->xkb_registry);
+
   g_object_unref (settings->priv->xkl_rec_config);
-  g_object_unref (settings->priv->xkl_registry);
   g_object_unref (settings->priv->xkl_engine);
 #endif /* HAVE_LIBXKLAVIER */
 
   g_object_unref (G_OBJECT (settings->priv->provider));
+  g_hash_table_destroy (settings->priv->shortcut_rows);
 
   (*G_OBJECT_CLASS (xfce_keyboard_settings_parent_class)->finalize) (object);
 }
@@ -587,36 +591,96 @@ xfce_keyboard_settings_initialize_shortcuts (XfceKeyboardSettings *settings)
 
 
 
+static gchar *
+xfce_keyboard_settings_shortcut_key (const gchar *shortcut)
+{
+  GdkModifierType modifiers;
+  guint           keyval;
+
+  gtk_accelerator_parse (shortcut, &keyval, &modifiers);
+
+  /* Unparsable shortcuts can only match their own spelling */
+  if (G_UNLIKELY (keyval == 0))
+    return g_strdup (shortcut);
+
+  /* Normalize so different spellings of the same accelerator share a key */
+  return gtk_accelerator_name (gdk_keyval_to_lower (keyval), modifiers);
+}
+
+
+
 static void
-_xfce_keyboard_settings_load_shortcut (XfceShortcut         *shortcut,
-                                       XfceKeyboardSettings *settings)
+xfce_keyboard_settings_free_shortcut_row (XfceKeyboardShortcutRow *row)
 {
-  GdkModifierType  modifiers;
-  GtkTreeModel    *tree_model;
-  GtkTreeIter      iter;
-  GObject         *tree_view;
-  guint            keyval;
-  gchar           *label;
+  g_free (row->key);
+  g_slist_foreach (row->spellings, (GFunc) g_free, NULL);
+  g_slist_free (row->spellings);
+  g_slice_free (XfceKeyboardShortcutRow, row);
+}
 
-  g_return_if_fail (XFCE_IS_KEYBOARD_SETTINGS (settings));
-  g_return_if_fail (shortcut != NULL);
 
-  DBG ("property = %s, shortcut = %s, command = %s, snotify = %s",
-       shortcut->property_name, shortcut->shortcut,
-       shortcut->command, shortcut->snotify ? "true" : "false");
+
+static XfceKeyboardShortcutRow *
+xfce_keyboard_settings_lookup_shortcut (XfceKeyboardSettings *settings,
+                                        const gchar          *shortcut)
+{
+  XfceKeyboardShortcutRow *row;
+  gchar                   *key;
+
+  key = xfce_keyboard_settings_shortcut_key (shortcut);
+  row = g_hash_table_lookup (settings->priv->shortcut_rows, key);
+  g_free (key);
+
+  return row;
+}
+
+
+
+static void
+xfce_keyboard_settings_insert_shortcut (XfceKeyboardSettings *settings,
+                                        const gchar          *shortcut,
+                                        const gchar          *command,
+                                        gboolean              snotify)
+{
+  XfceKeyboardShortcutRow *row = NULL;
+  GdkModifierType          modifiers;
+  GtkTreeModel            *tree_model;
+  GtkTreeIter              iter;
+  GObject                 *tree_view;
+  guint                    keyval;
+  gchar                   *label;
 
   tree_view = gtk_builder_get_object (GTK_BUILDER (settings), "kbd_shortcuts_view");
   tree_model = gtk_tree_view_get_model (GTK_TREE_VIEW (tree_view));
 
-  /* Get the shortcut label */
-  gtk_accelerator_parse (shortcut->shortcut, &keyval, &modifiers);
+  row = xfce_keyboard_settings_lookup_shortcut (settings, shortcut);
+
+  gtk_accelerator_parse (shortcut, &keyval, &modifiers);
   label = gtk_accelerator_get_label (keyval, modifiers);
 
-  gtk_list_store_append (GTK_LIST_STORE (tree_model), &iter);
+  if (row != NULL)
+    {
+      /* The shortcut is already listed, update the row in place */
+      iter = row->iter;
+    }
+  else
+    {
+      gtk_list_store_append (GTK_LIST_STORE (tree_model), &iter);
+
+      row = g_slice_new (XfceKeyboardShortcutRow);
+      row->key = xfce_keyboard_settings_shortcut_key (shortcut);
+      row->spellings = NULL;
+      row->iter = iter;
+      g_hash_table_insert (settings->priv->shortcut_rows, row->key, row);
+    }
+
+  if (g_slist_find_custom (row->spellings, shortcut, (GCompareFunc) strcmp) == NULL)
+    row->spellings = g_slist_prepend (row->spellings, g_strdup (shortcut));
+
   gtk_list_store_set (GTK_LIST_STORE (tree_model), &iter,
-                      COMMAND_COLUMN, shortcut->command,
-                      SHORTCUT_COLUMN, shortcut->shortcut,
-                      SNOTIFY_COLUMN, shortcut->snotify,
+                      COMMAND_COLUMN, command,
+                      SHORTCUT_COLUMN, shortcut,
+                      SNOTIFY_COLUMN, snotify,
                       SHORTCUT_LABEL_COLUMN, label, -1);
 
   g_free (label);
@@ -624,6 +688,45 @@ _xfce_keyboard_settings_load_shortcut (XfceShortcut         *shortcut,
 
 
 
+static void
+xfce_keyboard_settings_remove_shortcut_row (XfceKeyboardSettings *settings,
+                                            GtkTreeModel         *model,
+                                            GtkTreeIter          *iter)
+{
+  XfceKeyboardShortcutRow *row;
+  gchar                   *shortcut;
+
+  gtk_tree_model_get (model, iter, SHORTCUT_COLUMN, &shortcut, -1);
+
+  /* Drop the index entry if it points to this row */
+  row = xfce_keyboard_settings_lookup_shortcut (settings, shortcut);
+  if (row != NULL && row->iter.user_data == iter->user_data)
+    g_hash_table_remove (settings->priv->shortcut_rows, row->key);
+
+  g_free (shortcut);
+
+  gtk_list_store_remove (GTK_LIST_STORE (model), iter);
+}
+
+
+
+static void
+_xfce_keyboard_settings_load_shortcut (XfceShortcut         *shortcut,
+                                       XfceKeyboardSettings *settings)
+{
+  g_return_if_fail (XFCE_IS_KEYBOARD_SETTINGS (settings));
+  g_return_if_fail (shortcut != NULL);
+
+  DBG ("property = %s, shortcut = %s, command = %s, snotify = %s",
+       shortcut->property_name, shortcut->shortcut,
+       shortcut->command, shortcut->snotify ? "true" : "false");
+
+  xfce_keyboard_settings_insert_shortcut (settings, shortcut->shortcut,
+                                          shortcut->command, shortcut->snotify);
+}
+
+
+
 static void
 xfce_keyboard_settings_load_shortcuts (XfceKeyboardSettings *settings)
 {
@@ -682,7 +785,7 @@ xfce_keyboard_settings_edit_shortcut (XfceKeyboardSettings *settings,
       if (G_LIKELY (response == GTK_RESPONSE_OK))
         {
           /* Remove old shortcut from the settings */
-          gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+          xfce_keyboard_settings_remove_shortcut_row (settings, model, &iter);
           xfce_shortcuts_provider_reset_shortcut (settings->priv->provider, shortcut);
 
           /* Get the shortcut entered by the user */
@@ -750,7 +853,7 @@ xfce_keyboard_settings_edit_command (XfceKeyboardSettings *settings,
               || snotify != new_snotify)
             {
               /* Remove the row because we add new one from the shortcut-added signal */
-              gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+              xfce_keyboard_settings_remove_shortcut_row (settings, model, &iter);
 
               /* Save settings */
               xfce_shortcuts_provider_set_shortcut (settings->priv->provider, shortcut,
@@ -802,7 +905,7 @@ xfce_keyboard_settings_validate_shortcut (XfceShortcutDialog   *dialog,
                                                 xfce_shortcuts_provider_get_name (info->provider),
                                                 shortcut,
                                                 xfce_shortcut_dialog_get_action_name (dialog),
-                                                info->shortcut->command,
+                                                info->command,
                                                 FALSE);
 
       if (G_UNLIKELY (response == GTK_RESPONSE_ACCEPT))
@@ -820,7 +923,7 @@ xfce_keyboard_settings_validate_shortcut (XfceShortcutDialog   *dialog,
       else
         {
           /* We want to keep the old owner */
-          DBG ("We want to keep using %s with %s", shortcut, info->shortcut->command);
+          DBG ("We want to keep using %s with %s", shortcut, info->command);
           accepted = FALSE;
         }
 
@@ -837,15 +940,36 @@ xfce_keyboard_settings_get_shortcut_info (XfceKeyboardSettings *settings,
                                           const gchar          *shortcut)
 {
   XfceKeyboardShortcutInfo *info = NULL;
+  XfceKeyboardShortcutRow  *row;
+  GtkTreeModel             *model;
+  GObject                  *view;
   GList                    *iter;
   XfceShortcut             *sc;
   GList                    *providers;
+  const gchar              *own_name;
 
   g_return_val_if_fail (XFCE_IS_KEYBOARD_SETTINGS (settings), FALSE);
   g_return_val_if_fail (shortcut != NULL, FALSE);
 
   DBG ("Looking for shortcut info for %s", shortcut);
 
+  /* Our own shortcuts are all in the index, no need to ask blconf */
+  row = xfce_keyboard_settings_lookup_shortcut (settings, shortcut);
+  if (row != NULL)
+    {
+      view = gtk_builder_get_object (GTK_BUILDER (settings), "kbd_shortcuts_view");
+      model = gtk_tree_view_get_model (GTK_TREE_VIEW (view));
+
+      info = g_new0 (XfceKeyboardShortcutInfo, 1);
+      info->provider = g_object_ref (settings->priv->provider);
+      gtk_tree_model_get (model, &row->iter, COMMAND_COLUMN, &info->command, -1);
+
+      return info;
+    }
+
+  /* Not in the index, so only the other providers can own it */
+  own_name = xfce_shortcuts_provider_get_name (settings->priv->provider);
+
   providers = xfce_shortcuts_provider_get_providers ();
 
   if (G_UNLIKELY (providers == NULL))
@@ -853,6 +977,9 @@ xfce_keyboard_settings_get_shortcut_info (XfceKeyboardSettings *settings,
 
   for (iter = providers; iter != NULL && info == NULL; iter = g_list_next (iter))
     {
+      if (g_strcmp0 (xfce_shortcuts_provider_get_name (iter->data), own_name) == 0)
+        continue;
+
       if (G_UNLIKELY (xfce_shortcuts_provider_has_shortcut (iter->data, shortcut)))
         {
           sc = xfce_shortcuts_provider_get_shortcut (iter->data, shortcut);
@@ -861,7 +988,8 @@ xfce_keyboard_settings_get_shortcut_info (XfceKeyboardSettings *settings,
             {
               info = g_new0 (XfceKeyboardShortcutInfo, 1);
               info->provider = g_object_ref (iter->data);
-              info->shortcut = sc;
+              info->command = g_strdup (sc->command);
+              xfce_shortcut_free (sc);
             }
         }
     }
@@ -877,7 +1005,7 @@ static void
 xfce_keyboard_settings_free_shortcut_info (XfceKeyboardShortcutInfo *info)
 {
   g_object_unref (info->provider);
-  xfce_shortcut_free (info->shortcut);
+  g_free (info->command);
   g_free (info);
 }
 
@@ -889,38 +1017,16 @@ xfce_keyboard_settings_shortcut_added (XfceShortcutsProvider *provider,
                                        XfceKeyboardSettings  *settings)
 {
   XfceShortcut *sc;
-  GtkTreeModel *model;
-  GObject      *view;
-  GtkTreeIter   iter;
 
   g_return_if_fail (XFCE_IS_KEYBOARD_SETTINGS (settings));
 
-  view = gtk_builder_get_object (GTK_BUILDER (settings), "kbd_shortcuts_view");
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (view));
-
   sc = xfce_shortcuts_provider_get_shortcut (settings->priv->provider, shortcut);
 
   if (G_LIKELY (sc != NULL))
     {
-      GdkModifierType  modifiers;
-      guint            keyval;
-      gchar           *label;
-
-      gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-
-      /* Get the shortcut label */
-      gtk_accelerator_parse (sc->shortcut, &keyval, &modifiers);
-      label = gtk_accelerator_get_label (keyval, modifiers);
-
       DBG ("Add shortcut %s for command %s", shortcut, sc->command);
 
-      gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-                          SHORTCUT_COLUMN, shortcut,
-                          COMMAND_COLUMN, sc->command,
-                          SNOTIFY_COLUMN, sc->snotify,
-                          SHORTCUT_LABEL_COLUMN, label, -1);
-
-      g_free (label);
+      xfce_keyboard_settings_insert_shortcut (settings, shortcut, sc->command, sc->snotify);
 
       xfce_shortcut_free (sc);
     }
@@ -929,37 +1035,15 @@ xfce_keyboard_settings_shortcut_added (XfceShortcutsProvider *provider,
 
 
 
-static gboolean
-_xfce_keyboard_settings_remove_shortcut (GtkTreeModel *model,
-                                         GtkTreePath  *path,
-                                         GtkTreeIter  *iter,
-                                         const gchar  *shortcut)
-{
-  gboolean finished = FALSE;
-  gchar   *row_shortcut;
-
-  gtk_tree_model_get (model, iter, SHORTCUT_COLUMN, &row_shortcut, -1);
-
-  if (G_UNLIKELY (g_utf8_collate (row_shortcut, shortcut) == 0))
-    {
-      gtk_list_store_remove (GTK_LIST_STORE (model), iter);
-      finished = TRUE;
-    }
-
-  g_free (row_shortcut);
-
-  return finished;
-}
-
-
-
 static void
 xfce_keyboard_settings_shortcut_removed (XfceShortcutsProvider *provider,
                                          const gchar           *shortcut,
                                          XfceKeyboardSettings  *settings)
 {
-  GtkTreeModel *model;
-  GObject      *view;
+  XfceKeyboardShortcutRow *row;
+  GtkTreeModel            *model;
+  GObject                 *view;
+  GSList                  *li;
 
   g_return_if_fail (XFCE_IS_KEYBOARD_SETTINGS (settings));
 
@@ -968,8 +1052,29 @@ xfce_keyboard_settings_shortcut_removed (XfceShortcutsProvider *provider,
 
   DBG ("Remove shortcut %s from treeview", shortcut);
 
-  gtk_tree_model_foreach (model, (GtkTreeModelForeachFunc) _xfce_keyboard_settings_remove_shortcut,
-                          (gpointer) shortcut);
+  /* The row may already be gone if it was removed while editing */
+  row = xfce_keyboard_settings_lookup_shortcut (settings, shortcut);
+  if (row == NULL)
+    return;
+
+  li = g_slist_find_custom (row->spellings, shortcut, (GCompareFunc) strcmp);
+  if (li != NULL)
+    {
+      g_free (li->data);
+      row->spellings = g_slist_delete_link (row->spellings, li);
+    }
+
+  if (row->spellings != NULL)
+    {
+      /* Another spelling of the accelerator is still stored */
+      gtk_list_store_set (GTK_LIST_STORE (model), &row->iter,
+                          SHORTCUT_COLUMN, row->spellings->data, -1);
+    }
+  else
+    {
+      gtk_list_store_remove (GTK_LIST_STORE (model), &row->iter);
+      g_hash_table_remove (settings->priv->shortcut_rows, row->key);
+    }
 }
 
 
@@ -1161,7 +1266,7 @@ xfce_keyboard_settings_edit_button_clicked (XfceKeyboardSettings *settings)
                     {
                       /* Remove the row because we add new one from the
                        * shortcut-added signal */
-                      gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+                      xfce_keyboard_settings_remove_shortcut_row (settings, model, &iter);
 
                       if (test_new_shortcut)
                         /* Remove old keyboard shortcut via blconf */
@@ -1282,6 +1387,7 @@ xfce_keyboard_settings_reset_button_clicked (XfceKeyboardSettings *settings)
       /* Clear out all the previous entries */
       store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (view)));
       gtk_list_store_clear (store);
+      g_hash_table_remove_all (settings->priv->shortcut_rows);
 
       xfce_shortcuts_provider_reset_to_defaults (settings->priv->provider);
     }
@@ -1291,20 +1397,48 @@ xfce_keyboard_settings_reset_button_clicked (XfceKeyboardSettings *settings)
 
 #ifdef HAVE_LIBXKLAVIER
 
-static gchar *
-xfce_keyboard_settings_xkb_description (XklConfigItem *config_item)
+static XfceKeyboardRegistry *
+xfce_keyboard_settings_get_registry (XfceKeyboardSettings *settings)
 {
-  gchar *ci_description;
-  gchar *description;
+  if (settings->priv->xkb_registry == NULL)
+    settings->priv->xkb_registry = xfce_keyboard_registry_get (settings->priv->xkl_engine);
+
+  return settings->priv->xkb_registry;
+}
 
-  ci_description = g_strstrip (config_item->description);
 
-  if (ci_description[0] == 0)
-    description = g_strdup (config_item->name);
-  else
-    description = g_strdup (ci_description);
 
-  return description;
+static void
+xfce_keyboard_settings_layout_tab_mapped (GtkWidget            *widget,
+                                          XfceKeyboardSettings *settings)
+{
+  /* Only fill the tab once */
+  g_signal_handlers_disconnect_by_func (G_OBJECT (widget),
+                                        xfce_keyboard_settings_layout_tab_mapped,
+                                        settings);
+
+  /* Keyboard model combo */
+  xfce_keyboard_settings_layouts_combo_populate (settings,
+                                                 "xkb_model_combo",
+                                                 NULL,
+                                                 xfce_keyboard_settings_init_model,
+                                                 xfce_keyboard_settings_model_changed_cb);
+  /* Group key combo */
+  xfce_keyboard_settings_layouts_combo_populate (settings,
+                                                 "xkb_grpkey_combo",
+                                                 "grp",
+                                                 xfce_keyboard_settings_init_grpkey,
+                                                 xfce_keyboard_settings_grpkey_changed_cb);
+  /* Compose key combo */
+  xfce_keyboard_settings_layouts_combo_populate (settings,
+                                                 "xkb_composekey_combo",
+                                                 "Compose key",
+                                                 xfce_keyboard_settings_init_compkey,
+                                                 xfce_keyboard_settings_compkey_changed_cb);
+
+  /* Keyboard layout/variant treeview */
+  xfce_keyboard_settings_init_layout (settings);
+  xfce_keyboard_settings_update_layout_buttons (settings);
 }
 
 
@@ -1438,6 +1572,8 @@ static void
 xfce_keyboard_settings_init_layout (XfceKeyboardSettings *settings)
 {
 
+  XfceKeyboardRegistry           *registry;
+  const XfceKeyboardRegistryItem *item;
   XklState         *xkl_state = NULL;
   GObject          *view;
   GtkTreeSelection *selection;
@@ -1463,6 +1599,8 @@ xfce_keyboard_settings_init_layout (XfceKeyboardSettings *settings)
   layouts = g_strsplit (val_layout, ",", 0);
   variants = g_strsplit (val_variant, ",", 0);
 
+  registry = xfce_keyboard_settings_get_registry (settings);
+
   view = gtk_builder_get_object (GTK_BUILDER (settings), "xkb_layout_view");
   model = gtk_tree_view_get_model (GTK_TREE_VIEW (view));
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
@@ -1473,26 +1611,14 @@ xfce_keyboard_settings_init_layout (XfceKeyboardSettings *settings)
 
   for (layout = layouts, variant = variants, group_id = 0; *layout != NULL; ++layout, ++group_id)
     {
-      XklConfigItem *litem;
-      XklConfigItem *vitem;
-      gchar         *layout_desc;
-      gchar         *variant_desc;
+      const gchar *layout_desc;
+      const gchar *variant_desc;
 
-      litem = xkl_config_item_new ();
-      vitem = xkl_config_item_new ();
+      item = xfce_keyboard_registry_find_layout (registry, *layout);
+      layout_desc = item != NULL ? item->description : *layout;
 
-      g_snprintf (litem->name, sizeof litem->name, "%s", *layout);
-      g_snprintf (vitem->name, sizeof vitem->name, "%s", *variant);
-
-      if (xkl_config_registry_find_layout (settings->priv->xkl_registry, litem))
-        layout_desc = litem->description;
-      else
-        layout_desc = *layout;
-
-      if (xkl_config_registry_find_variant (settings->priv->xkl_registry, *layout, vitem))
-        variant_desc = vitem->description;
-      else
-        variant_desc = *variant;
+      item = xfce_keyboard_registry_find_variant (registry, *layout, *variant);
+      variant_desc = item != NULL ? item->description : *variant;
 
       gtk_list_store_append (GTK_LIST_STORE (model), &iter);
       gtk_list_store_set (GTK_LIST_STORE (model), &iter, XKB_TREE_LAYOUTS, *layout,
@@ -1505,9 +1631,6 @@ xfce_keyboard_settings_init_layout (XfceKeyboardSettings *settings)
 
       if (*variant)
         variant++;
-
-      g_object_unref (litem);
-      g_object_unref (vitem);
     }
 
   g_strfreev (layouts);
@@ -1520,24 +1643,6 @@ xfce_keyboard_settings_init_layout (XfceKeyboardSettings *settings)
 
 
 
-static void
-xfce_keyboard_settings_layouts_combo_add (XklConfigRegistry    *config_registry,
-                                          const XklConfigItem  *config_item,
-                                          gpointer              user_data)
-{
-  GtkListStore *store = GTK_LIST_STORE (user_data);
-  GtkTreeIter   iter;
-  gchar        *description;
-
-  description = xfce_keyboard_settings_xkb_description ((XklConfigItem *) config_item);
-
-  gtk_list_store_append (store, &iter);
-  gtk_list_store_set (store, &iter,
-                      XKB_LAYOUTS_COMBO_DESCRIPTION, description,
-                      XKB_LAYOUTS_COMBO_VALUE, config_item->name, -1);
-  g_free (description);
-}
-
 static void
 xfce_keyboard_settings_layouts_combo_init (XfceKeyboardSettings *settings,
                                            const gchar *combo_name,
@@ -1868,52 +1973,6 @@ xfce_keyboard_settings_layout_move (GtkWidget *widget,
 
 
 
-static void
-xfce_keyboard_settings_add_variant_to_list (XklConfigRegistry    *config_registry,
-                                            XklConfigItem        *config_item,
-                                            XfceKeyboardSettings *settings)
-{
-  GtkTreeStore *treestore;
-  GtkTreeIter   iter;
-  GObject      *treeview;
-  gchar        *variant;
-
-  variant = xfce_keyboard_settings_xkb_description (config_item);
-  treeview = gtk_builder_get_object (GTK_BUILDER (settings), "layout_selection_view");
-  treestore = GTK_TREE_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (treeview)));
-  gtk_tree_store_append (treestore, &iter, &settings->priv->layout_selection_iter);
-  gtk_tree_store_set (treestore, &iter,
-                      XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION, variant,
-                      XKB_AVAIL_LAYOUTS_TREE_ID, config_item->name, -1);
-  g_free (variant);
-}
-
-
-
-static void
-xfce_keyboard_settings_add_layout_to_list (XklConfigRegistry    *config_registry,
-                                           XklConfigItem        *config_item,
-                                           XfceKeyboardSettings *settings)
-{
-  GtkTreeStore *treestore;
-  GObject      *treeview;
-  gchar        *layout;
-
-  layout = xfce_keyboard_settings_xkb_description (config_item);
-  treeview = gtk_builder_get_object (GTK_BUILDER (settings), "layout_selection_view");
-  treestore = GTK_TREE_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (treeview)));
-  gtk_tree_store_append (treestore, &settings->priv->layout_selection_iter, NULL);
-  gtk_tree_store_set (treestore, &settings->priv->layout_selection_iter,
-                      XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION, layout,
-                      XKB_AVAIL_LAYOUTS_TREE_ID, config_item->name, -1);
-  g_free (layout);
-
-  xkl_config_registry_foreach_layout_variant (config_registry, config_item->name,
-      (ConfigItemProcessFunc)xfce_keyboard_settings_add_variant_to_list, settings);
-}
-
-
-
 static void
 xfce_keyboard_settings_layout_activate_cb (GtkTreeView       *tree_view,
                                            GtkTreePath       *path,
@@ -1950,17 +2009,18 @@ xfce_keyboard_settings_layout_selection (XfceKeyboardSettings *settings,
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (layout_selection_view));
   gtk_tree_selection_set_mode (selection, GTK_SELECTION_BROWSE);
 
-  if (!settings->priv->layout_selection_treestore)
+  if (!settings->priv->layout_selection_model)
     {
-      settings->priv->layout_selection_treestore = gtk_tree_store_new (XKB_AVAIL_LAYOUTS_TREE_NUM_COLUMNS, G_TYPE_STRING, G_TYPE_STRING);
+      settings->priv->layout_selection_model =
+          xfce_keyboard_registry_model_new (xfce_keyboard_settings_get_registry (settings));
       renderer = gtk_cell_renderer_text_new ();
       column   = gtk_tree_view_column_new_with_attributes (NULL, renderer, "text",
-                                        XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION, NULL);
-      gtk_tree_view_set_model (GTK_TREE_VIEW (layout_selection_view), GTK_TREE_MODEL (settings->priv->layout_selection_treestore));
+                                        XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION, NULL);
+      gtk_tree_view_set_model (GTK_TREE_VIEW (layout_selection_view), settings->priv->layout_selection_model);
       gtk_tree_view_append_column (GTK_TREE_VIEW (layout_selection_view), column);
-      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (settings->priv->layout_selection_treestore), 0, GTK_SORT_ASCENDING);
-      xkl_config_registry_foreach_layout (settings->priv->xkl_registry,
-          (ConfigItemProcessFunc) xfce_keyboard_settings_add_layout_to_list, settings);
+      gtk_tree_view_set_search_column (GTK_TREE_VIEW (layout_selection_view), XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION);
+      gtk_tree_view_set_search_equal_func (GTK_TREE_VIEW (layout_selection_view),
+                                           xfce_keyboard_registry_model_search_equal, NULL, NULL);
       g_signal_connect (GTK_TREE_VIEW (layout_selection_view), "row-activated", G_CALLBACK (xfce_keyboard_settings_layout_activate_cb), keyboard_layout_selection_dialog);
       gtk_dialog_set_default_response (GTK_DIALOG (keyboard_layout_selection_dialog), GTK_RESPONSE_OK);
     }
@@ -1968,115 +2028,25 @@ xfce_keyboard_settings_layout_selection (XfceKeyboardSettings *settings,
   model = gtk_tree_view_get_model (GTK_TREE_VIEW (layout_selection_view));
   gtk_tree_view_collapse_all (GTK_TREE_VIEW (layout_selection_view));
 
-  /* Selected and expand the layout/variant to be edited */
+  /* Select and expand the layout/variant to be edited, fallback to the first one */
+  path = NULL;
   if (edit_layout && g_strcmp0 (edit_layout, ""))
-    {
-      gboolean found;
-
-      if (gtk_tree_model_get_iter_first (model, &iter))
-        {
-          gchar *tmp_layout;
-          found = FALSE;
+    path = xfce_keyboard_registry_model_get_path_for (XFCE_KEYBOARD_REGISTRY_MODEL (model),
+                                                      edit_layout, edit_variant);
+  if (path == NULL)
+    path = gtk_tree_path_new_first ();
 
-          do
-            {
-              gtk_tree_model_get (model, &iter, XKB_AVAIL_LAYOUTS_TREE_ID, &tmp_layout, -1);
-              path = gtk_tree_model_get_path (model, &iter);
-
-              if (found)
-                break;
-
-              if (g_strcmp0 (tmp_layout, edit_layout) == 0 )
-                {
-                  if (edit_variant && g_strcmp0 (edit_variant, "") && gtk_tree_model_iter_has_child (model, &iter))
-                    {
-                      GtkTreeIter iter2;
-                      gint n, i;
-
-                      n = gtk_tree_model_iter_n_children (model, &iter);
-
-                      for (i = 0; i < n; i ++)
-                        {
-                          if (gtk_tree_model_iter_nth_child (model, &iter2, &iter, i))
-                            {
-                              gchar *tmp_variant;
-
-                              gtk_tree_model_get (model, &iter2, XKB_AVAIL_LAYOUTS_TREE_ID, &tmp_variant, -1);
-
-                              if (g_strcmp0 (tmp_variant, edit_variant) == 0)
-                                {
-                                  GtkTreePath *path2;
-
-                                  path2 = gtk_tree_model_get_path (model, &iter2);
-
-                                  gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (layout_selection_view),
-                                                                               path2, NULL,
-                                                                               TRUE, 0.5, 0);
-                                  gtk_tree_view_expand_row (GTK_TREE_VIEW (layout_selection_view),
-                                                            path,
-                                                            TRUE);
-                                  gtk_tree_selection_select_iter (selection, &iter2);
-
-                                  found = TRUE;
-                                  g_free (tmp_variant);
-                                  gtk_tree_path_free (path2);
-                                  break;
-                                }
-
-                              g_free (tmp_variant);
-                            }
-                        }
-                    }
-                else
-                  {
-                    gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (layout_selection_view),
-                                                                 path, NULL,
-                                                                 TRUE, 0.5, 0);
-                    gtk_tree_selection_select_iter (selection, &iter);
-                    found = TRUE;
-                    break;
-                  }
-              }
-
-              gtk_tree_path_free (path);
-              path = NULL;
-              g_free (tmp_layout);
-              tmp_layout = NULL;
-            }
-          while (gtk_tree_model_iter_next (model, &iter));
-          g_free (tmp_layout);
-          if (path)
-            gtk_tree_path_free (path);
-
-          if (!found)
-            {
-              /* We did not find the iter to be edited, fallback to the first one */
-              if (gtk_tree_model_get_iter_first (model, &iter))
-                {
-                  path = gtk_tree_model_get_path (model, &iter);
-                  gtk_tree_selection_select_iter (selection, &iter);
-
-                  gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (layout_selection_view),
-                                                path, NULL,
-                                                TRUE, 0.5, 0);
-                  gtk_tree_path_free (path);
-                }
-            }
-        }
-    }
-  else
+  if (gtk_tree_model_get_iter (model, &iter, path))
     {
-      if (gtk_tree_model_get_iter_first (model, &iter))
-        {
-          path = gtk_tree_model_get_path (model, &iter);
-          gtk_tree_selection_select_iter (selection, &iter);
+      if (gtk_tree_path_get_depth (path) > 1)
+        gtk_tree_view_expand_to_path (GTK_TREE_VIEW (layout_selection_view), path);
 
-          gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (layout_selection_view),
-                                        path, NULL,
-                                        TRUE, 0.5, 0);
-          gtk_tree_path_free (path);
-        }
+      gtk_tree_selection_select_iter (selection, &iter);
+      gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (layout_selection_view),
+                                    path, NULL,
+                                    TRUE, 0.5, 0);
     }
+  gtk_tree_path_free (path);
 
   val_layout = NULL;
   gtk_widget_show (GTK_WIDGET (keyboard_layout_selection_dialog));
@@ -2085,8 +2055,8 @@ xfce_keyboard_settings_layout_selection (XfceKeyboardSettings *settings,
     {
       if (G_LIKELY (gtk_tree_selection_get_selected (selection, &model, &iter)))
       {
-        gtk_tree_model_get (model, &iter, XKB_AVAIL_LAYOUTS_TREE_ID, &layout,
-                                          XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION, &layout_desc, -1);
+        gtk_tree_model_get (model, &iter, XFCE_KEYBOARD_REGISTRY_MODEL_ID, &layout,
+                                          XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION, &layout_desc, -1);
 
         path = gtk_tree_model_get_path (model, &iter);
         if (gtk_tree_path_get_depth (path) == 1)
@@ -2101,8 +2071,8 @@ xfce_keyboard_settings_layout_selection (XfceKeyboardSettings *settings,
             gtk_tree_path_up (path);
             if (G_LIKELY (gtk_tree_model_get_iter (model, &iter, path)))
               {
-                gtk_tree_model_get (model, &iter, XKB_AVAIL_LAYOUTS_TREE_ID, &layout,
-                                                  XKB_AVAIL_LAYOUTS_TREE_DESCRIPTION, &layout_desc, -1);
+                gtk_tree_model_get (model, &iter, XFCE_KEYBOARD_REGISTRY_MODEL_ID, &layout,
+                                                  XFCE_KEYBOARD_REGISTRY_MODEL_DESCRIPTION, &layout_desc, -1);
               }
           }
 
@@ -52,6 +52,12 @@ main (gint argc, gchar **argv)
     /* setup translation domain */
     xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
 
+    /* the application chooser enumerates in a worker thread */
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+    if (!g_thread_supported ())
+        g_thread_init (NULL);
+#endif
+
     /* initialize Gtk+ */
     if(!gtk_init_with_args (&argc, &argv, "", entries, PACKAGE, &error))
     {
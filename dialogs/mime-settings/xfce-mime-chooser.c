@@ -24,6 +24,9 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
@@ -36,8 +39,16 @@
 
 #include "xfce-mime-chooser.h"
 
+/* rows added to the list per idle */
+#define CHOOSER_FILL_BATCH (50)
+
+
+
+typedef struct _XfceMimeChooserApps XfceMimeChooserApps;
 
 
+
+static void     xfce_mime_chooser_dispose           (GObject           *object);
 static void     xfce_mime_chooser_finalize          (GObject           *object);
 static void     xfce_mime_chooser_row_activated     (GtkTreeView       *tree_view,
                                                      GtkTreePath       *path,
@@ -54,6 +65,12 @@ static void     xfce_mime_chooser_notify_expanded   (GtkExpander       *expander
                                                      XfceMimeChooser   *chooser);
 static void     xfce_mime_chooser_browse_command    (GtkWidget         *button,
                                                      XfceMimeChooser   *chooser);
+static void     xfce_mime_chooser_icon_data_func    (GtkTreeViewColumn *column,
+                                                     GtkCellRenderer   *renderer,
+                                                     GtkTreeModel      *model,
+                                                     GtkTreeIter       *iter,
+                                                     gpointer           data);
+static void     xfce_mime_chooser_fill_start        (XfceMimeChooser   *chooser);
 
 
 
@@ -74,19 +91,64 @@ struct _XfceMimeChooser
     GtkWidget    *treeview;
     GtkWidget    *expander;
     GtkWidget    *entry;
+
+    /* applications of the content type, added to the model in batches */
+    XfceMimeChooserApps *apps;
+    guint                fill_id;
+    guint                fill_pos;
+    GtkTreeIter          recommended_iter;
+    GtkTreeIter          other_iter;
+};
+
+/* an application found by the worker, only plain strings are
+ * passed to the main thread, the app info is created on selection */
+typedef struct
+{
+    gchar *id;
+    gchar *name;
+    gchar *icon;
+    gchar *collate_key;
+}
+XfceMimeChooserApp;
+
+/* the applications for a content type, memoized for the lifetime
+ * of the process and shared by all choosers of the type */
+struct _XfceMimeChooserApps
+{
+    gint       ref_count;
+
+    gchar     *mime_type;
+
+    /* the recommended applications, followed by the others sorted by name */
+    GPtrArray *apps;
+    guint      n_recommended;
+
+    /* set in the main thread once the worker is done */
+    guint      loaded : 1;
+
+    /* choosers waiting for the worker */
+    GSList    *choosers;
 };
 
 enum
 {
     CHOOSER_COLUMN_NAME,
-    CHOOSER_COLUMN_APP_INFO,
-    CHOOSER_COLUMN_GICON,
+    CHOOSER_COLUMN_APP_ID,
+    CHOOSER_COLUMN_ICON,
     CHOOSER_COLUMN_ATTRS,
     N_CHOOSER_COLUMNS
 };
 
 
 
+/* content type -> XfceMimeChooserApps */
+static GHashTable  *chooser_apps_cache = NULL;
+
+/* a single worker, the desktop files are scanned one type at a time */
+static GThreadPool *chooser_pool = NULL;
+
+
+
 G_DEFINE_TYPE (XfceMimeChooser, xfce_mime_chooser, GTK_TYPE_DIALOG)
 
 
@@ -97,6 +159,7 @@ xfce_mime_chooser_class_init (XfceMimeChooserClass *klass)
     GObjectClass *gobject_class;
 
     gobject_class = G_OBJECT_CLASS (klass);
+    gobject_class->dispose = xfce_mime_chooser_dispose;
     gobject_class->finalize = xfce_mime_chooser_finalize;
 }
 
@@ -121,8 +184,8 @@ xfce_mime_chooser_init (XfceMimeChooser *chooser)
 
     chooser->model = gtk_tree_store_new (N_CHOOSER_COLUMNS,
                                          G_TYPE_STRING,
-                                         G_TYPE_APP_INFO,
-                                         G_TYPE_ICON,
+                                         G_TYPE_STRING,
+                                         G_TYPE_STRING,
                                          PANGO_TYPE_ATTR_LIST);
 
     gtk_window_set_title (GTK_WINDOW (chooser), _("Select Application"));
@@ -190,9 +253,8 @@ xfce_mime_chooser_init (XfceMimeChooser *chooser)
     renderer = gtk_cell_renderer_pixbuf_new ();
     g_object_set (G_OBJECT (renderer), "stock-size", GTK_ICON_SIZE_BUTTON, NULL);
     gtk_tree_view_column_pack_start (column, renderer, FALSE);
-    gtk_tree_view_column_set_attributes (column, renderer,
-                                         "gicon", CHOOSER_COLUMN_GICON,
-                                         NULL);
+    gtk_tree_view_column_set_cell_data_func (column, renderer,
+        xfce_mime_chooser_icon_data_func, NULL, NULL);
 
     renderer = gtk_cell_renderer_text_new ();
     gtk_tree_view_column_pack_start (column, renderer, TRUE);
@@ -229,6 +291,66 @@ xfce_mime_chooser_init (XfceMimeChooser *chooser)
 
 
 
+static XfceMimeChooserApps *
+xfce_mime_chooser_apps_ref (XfceMimeChooserApps *apps)
+{
+    g_atomic_int_inc (&apps->ref_count);
+
+    return apps;
+}
+
+
+
+static void
+xfce_mime_chooser_apps_unref (gpointer data)
+{
+    XfceMimeChooserApps *apps = data;
+
+    if (g_atomic_int_dec_and_test (&apps->ref_count))
+    {
+        g_assert (apps->choosers == NULL);
+
+        if (apps->apps != NULL)
+            g_ptr_array_free (apps->apps, TRUE);
+        g_free (apps->mime_type);
+        g_slice_free (XfceMimeChooserApps, apps);
+    }
+}
+
+
+
+static void
+xfce_mime_chooser_apps_detach (XfceMimeChooser *chooser)
+{
+    if (chooser->fill_id != 0)
+    {
+        g_source_remove (chooser->fill_id);
+        chooser->fill_id = 0;
+    }
+
+    if (chooser->apps != NULL)
+    {
+        chooser->apps->choosers = g_slist_remove (chooser->apps->choosers, chooser);
+        xfce_mime_chooser_apps_unref (chooser->apps);
+        chooser->apps = NULL;
+    }
+}
+
+
+
+static void
+xfce_mime_chooser_dispose (GObject *object)
+{
+    XfceMimeChooser *chooser = XFCE_MIME_CHOOSER (object);
+
+    /* stop filling the list of a destroyed dialog */
+    xfce_mime_chooser_apps_detach (chooser);
+
+    (*G_OBJECT_CLASS (xfce_mime_chooser_parent_class)->dispose) (object);
+}
+
+
+
 static void
 xfce_mime_chooser_finalize (GObject *object)
 {
@@ -247,6 +369,7 @@ xfce_mime_chooser_get_selected (XfceMimeChooser *chooser)
     GtkTreeIter       iter;
     GAppInfo         *app_info = NULL;
     GtkTreeSelection *selection;
+    gchar            *app_id = NULL;
 
     g_return_val_if_fail (XFCE_IS_MIME_CHOOSER (chooser), NULL);
 
@@ -254,8 +377,14 @@ xfce_mime_chooser_get_selected (XfceMimeChooser *chooser)
     if (gtk_tree_selection_get_selected (selection, NULL, &iter))
     {
         gtk_tree_model_get (GTK_TREE_MODEL (chooser->model), &iter,
-                            CHOOSER_COLUMN_APP_INFO, &app_info, -1);
+                            CHOOSER_COLUMN_APP_ID, &app_id, -1);
 
+        /* only the desktop id was stored in the model */
+        if (app_id != NULL)
+        {
+            app_info = G_APP_INFO (g_desktop_app_info_new (app_id));
+            g_free (app_id);
+        }
     }
 
     return app_info;
@@ -292,8 +421,8 @@ xfce_mime_chooser_row_can_select (GtkTreeSelection  *selection,
         /* check if there's an application for the path */
         if (G_LIKELY (gtk_tree_model_get_iter (model, &iter, path)))
         {
-            gtk_tree_model_get_value (model, &iter, CHOOSER_COLUMN_APP_INFO, &value);
-            permitted = (g_value_get_object (&value) != NULL);
+            gtk_tree_model_get_value (model, &iter, CHOOSER_COLUMN_APP_ID, &value);
+            permitted = (g_value_get_string (&value) != NULL);
             g_value_unset (&value);
         }
     }
@@ -479,75 +608,267 @@ xfce_mime_chooser_browse_command (GtkWidget       *button,
 
 
 
+static void
+xfce_mime_chooser_icon_data_func (GtkTreeViewColumn *column,
+                                  GtkCellRenderer   *renderer,
+                                  GtkTreeModel      *model,
+                                  GtkTreeIter       *iter,
+                                  gpointer           data)
+{
+    gchar *icon_name;
+    GIcon *icon = NULL;
+
+    /* the icon is only created for the rows that are drawn */
+    gtk_tree_model_get (model, iter, CHOOSER_COLUMN_ICON, &icon_name, -1);
+    if (icon_name != NULL)
+    {
+        icon = g_icon_new_for_string (icon_name, NULL);
+        g_free (icon_name);
+    }
+
+    g_object_set (G_OBJECT (renderer), "gicon", icon, NULL);
+
+    if (icon != NULL)
+        g_object_unref (G_OBJECT (icon));
+}
+
+
+
 static void
 xfce_mime_chooser_model_append (GtkTreeStore *model,
                                 const gchar  *title,
                                 const gchar  *icon_name,
-                                GList        *app_infos)
+                                GtkTreeIter  *parent_iter)
 {
-    GIcon         *icon;
-    GtkTreeIter    child_iter;
-    GtkTreeIter    parent_iter;
-    GList         *li;
     PangoAttrList *attrs;
 
     attrs = pango_attr_list_new ();
     pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
 
-    icon = g_themed_icon_new (icon_name);
-    gtk_tree_store_append (model, &parent_iter, NULL);
-    gtk_tree_store_set (model, &parent_iter,
+    gtk_tree_store_append (model, parent_iter, NULL);
+    gtk_tree_store_set (model, parent_iter,
                         CHOOSER_COLUMN_NAME, title,
-                        CHOOSER_COLUMN_GICON, icon,
+                        CHOOSER_COLUMN_ICON, icon_name,
                         CHOOSER_COLUMN_ATTRS, attrs, -1);
-    g_object_unref (G_OBJECT (icon));
     pango_attr_list_unref (attrs);
+}
+
+
 
-    if (G_LIKELY (app_infos != NULL))
+static void
+xfce_mime_chooser_model_append_none (GtkTreeStore *model,
+                                     GtkTreeIter  *parent_iter)
+{
+    GtkTreeIter    child_iter;
+    PangoAttrList *attrs;
+
+    attrs = pango_attr_list_new ();
+    pango_attr_list_insert (attrs, pango_attr_style_new (PANGO_STYLE_ITALIC));
+
+    /* tell the user that we don't have any applications for this category */
+    gtk_tree_store_append (model, &child_iter, parent_iter);
+    gtk_tree_store_set (model, &child_iter,
+                        CHOOSER_COLUMN_NAME, _("None available"),
+                        CHOOSER_COLUMN_ATTRS, attrs, -1);
+    pango_attr_list_unref (attrs);
+}
+
+
+
+static gboolean
+xfce_mime_chooser_fill (gpointer data)
+{
+    XfceMimeChooser     *chooser = XFCE_MIME_CHOOSER (data);
+    XfceMimeChooserApps *apps = chooser->apps;
+    XfceMimeChooserApp  *app;
+    GtkTreeIter          child_iter;
+    guint                end;
+
+    g_return_val_if_fail (apps != NULL && apps->loaded, FALSE);
+
+    /* insert the program items */
+    end = MIN (chooser->fill_pos + CHOOSER_FILL_BATCH, apps->apps->len);
+    for (; chooser->fill_pos < end; chooser->fill_pos++)
     {
-        /* insert the program items */
-        for (li = app_infos; li != NULL; li = li->next)
-        {
-            /* append the tree row with the program data */
-            gtk_tree_store_append (model, &child_iter, &parent_iter);
-            gtk_tree_store_set (model, &child_iter,
-                                CHOOSER_COLUMN_NAME, g_app_info_get_name (li->data),
-                                CHOOSER_COLUMN_GICON, g_app_info_get_icon (li->data),
-                                CHOOSER_COLUMN_APP_INFO, li->data,
-                                -1);
-        }
+        app = g_ptr_array_index (apps->apps, chooser->fill_pos);
+
+        /* append the tree row with the program data */
+        gtk_tree_store_append (chooser->model, &child_iter,
+                               chooser->fill_pos < apps->n_recommended
+                               ? &chooser->recommended_iter : &chooser->other_iter);
+        gtk_tree_store_set (chooser->model, &child_iter,
+                            CHOOSER_COLUMN_NAME, app->name,
+                            CHOOSER_COLUMN_ICON, app->icon,
+                            CHOOSER_COLUMN_APP_ID, app->id,
+                            -1);
     }
-    else
+
+    if (chooser->fill_pos >= apps->apps->len)
     {
-        attrs = pango_attr_list_new ();
-        pango_attr_list_insert (attrs, pango_attr_style_new (PANGO_STYLE_ITALIC));
-
-        /* tell the user that we don't have any applications for this category */
-        gtk_tree_store_append (model, &child_iter, &parent_iter);
-        gtk_tree_store_set (model, &child_iter,
-                            CHOOSER_COLUMN_NAME, _("None available"),
-                            CHOOSER_COLUMN_ATTRS, attrs, -1);
-        pango_attr_list_unref (attrs);
+        if (apps->n_recommended == 0)
+            xfce_mime_chooser_model_append_none (chooser->model, &chooser->recommended_iter);
+        if (apps->apps->len == apps->n_recommended)
+            xfce_mime_chooser_model_append_none (chooser->model, &chooser->other_iter);
+
+        chooser->fill_id = 0;
     }
+
+    /* open all */
+    gtk_tree_view_expand_all (GTK_TREE_VIEW (chooser->treeview));
+
+    return chooser->fill_id != 0;
 }
 
 
 
-static gint
-xfce_mime_chooser_compare_app_info (gconstpointer a,
-                                    gconstpointer b)
+static void
+xfce_mime_chooser_fill_start (XfceMimeChooser *chooser)
 {
-    return !g_app_info_equal (G_APP_INFO (a), G_APP_INFO (b));
+    g_return_if_fail (chooser->fill_id == 0);
+
+    /* default idle priority, so the dialog redraws between the batches */
+    chooser->fill_pos = 0;
+    chooser->fill_id = g_idle_add (xfce_mime_chooser_fill, chooser);
+}
+
+
+
+static void
+xfce_mime_chooser_app_free (gpointer data)
+{
+    XfceMimeChooserApp *app = data;
+
+    g_free (app->id);
+    g_free (app->name);
+    g_free (app->icon);
+    g_free (app->collate_key);
+    g_slice_free (XfceMimeChooserApp, app);
+}
+
+
+
+static XfceMimeChooserApp *
+xfce_mime_chooser_app_new (GAppInfo *app_info)
+{
+    XfceMimeChooserApp *app;
+    const gchar        *id;
+    GIcon              *icon;
+
+    /* the app info is recreated from its id in the main thread */
+    id = g_app_info_get_id (app_info);
+    if (G_UNLIKELY (id == NULL))
+        return NULL;
+
+    app = g_slice_new0 (XfceMimeChooserApp);
+    app->id = g_strdup (id);
+    app->name = g_strdup (g_app_info_get_name (app_info));
+
+    icon = g_app_info_get_icon (app_info);
+    if (icon != NULL)
+        app->icon = g_icon_to_string (icon);
+
+    return app;
 }
 
 
 
 static gint
-xfce_mime_chooser_sort_app_info (gconstpointer a,
-                                 gconstpointer b)
+xfce_mime_chooser_sort_app (gconstpointer a,
+                            gconstpointer b)
 {
-    return g_utf8_collate (g_app_info_get_name (G_APP_INFO (a)),
-                           g_app_info_get_name (G_APP_INFO (b)));
+    const XfceMimeChooserApp *app_a = *((XfceMimeChooserApp * const *) a);
+    const XfceMimeChooserApp *app_b = *((XfceMimeChooserApp * const *) b);
+
+    return strcmp (app_a->collate_key, app_b->collate_key);
+}
+
+
+
+static gboolean
+xfce_mime_chooser_loaded (gpointer data)
+{
+    XfceMimeChooserApps *apps = data;
+    GSList              *li;
+
+    apps->loaded = TRUE;
+
+    /* fill the choosers that were waiting for the worker */
+    for (li = apps->choosers; li != NULL; li = li->next)
+        xfce_mime_chooser_fill_start (XFCE_MIME_CHOOSER (li->data));
+
+    g_slist_free (apps->choosers);
+    apps->choosers = NULL;
+
+    /* release the reference of the worker */
+    xfce_mime_chooser_apps_unref (apps);
+
+    return FALSE;
+}
+
+
+
+static void
+xfce_mime_chooser_worker (gpointer data,
+                          gpointer user_data)
+{
+    XfceMimeChooserApps *apps = data;
+    XfceMimeChooserApp  *app;
+    GHashTable          *ids;
+    GList               *recommended;
+    GList               *all, *li;
+
+    apps->apps = g_ptr_array_new_with_free_func (xfce_mime_chooser_app_free);
+    ids = g_hash_table_new (g_str_hash, g_str_equal);
+
+    /* add recommended types */
+    recommended = g_app_info_get_all_for_type (apps->mime_type);
+    for (li = recommended; li != NULL; li = li->next)
+    {
+        app = xfce_mime_chooser_app_new (li->data);
+        if (app == NULL)
+            continue;
+
+        if (g_hash_table_lookup (ids, app->id) == NULL)
+        {
+            g_hash_table_insert (ids, app->id, app);
+            g_ptr_array_add (apps->apps, app);
+        }
+        else
+        {
+            xfce_mime_chooser_app_free (app);
+        }
+    }
+
+    apps->n_recommended = apps->apps->len;
+
+    /* filter out recommended apps from all apps */
+    all = g_app_info_get_all ();
+    for (li = all; li != NULL; li = li->next)
+    {
+        if (g_app_info_get_id (li->data) == NULL
+            || g_hash_table_lookup (ids, g_app_info_get_id (li->data)) != NULL)
+            continue;
+
+        app = xfce_mime_chooser_app_new (li->data);
+        app->collate_key = g_utf8_collate_key (app->name != NULL ? app->name : "", -1);
+        g_hash_table_insert (ids, app->id, app);
+        g_ptr_array_add (apps->apps, app);
+    }
+
+    /* sort the other applications */
+    qsort (apps->apps->pdata + apps->n_recommended,
+           apps->apps->len - apps->n_recommended,
+           sizeof (gpointer), xfce_mime_chooser_sort_app);
+
+    /* cleanup */
+    g_list_foreach (recommended, (GFunc) (void (*)(void)) g_object_unref, NULL);
+    g_list_foreach (all, (GFunc) (void (*)(void)) g_object_unref, NULL);
+    g_list_free (recommended);
+    g_list_free (all);
+    g_hash_table_destroy (ids);
+
+    /* the model is filled in the main thread */
+    g_idle_add (xfce_mime_chooser_loaded, apps);
 }
 
 
@@ -556,53 +877,56 @@ void
 xfce_mime_chooser_set_mime_type (XfceMimeChooser *chooser,
                                  const gchar     *mime_type)
 {
-    GList *recommended;
-    GList *all, *li;
-    GList *other = NULL;
-    GIcon *icon;
-    gchar *label;
-    gchar *description;
+    XfceMimeChooserApps *apps;
+    GIcon               *icon;
+    gchar               *label;
+    gchar               *description;
 
     g_return_if_fail (XFCE_IS_MIME_CHOOSER (chooser));
     g_return_if_fail (mime_type != NULL);
     g_return_if_fail (GTK_IS_TREE_STORE (chooser->model));
 
+    /* stop filling the list of a previous type */
+    xfce_mime_chooser_apps_detach (chooser);
+
     gtk_tree_store_clear (chooser->model);
 
-    /* add recommended types */
-    recommended = g_app_info_get_all_for_type (mime_type);
     xfce_mime_chooser_model_append (chooser->model,
                                     _("Recommended Applications"),
                                     "preferences-desktop-default-applications",
-                                    recommended);
+                                    &chooser->recommended_iter);
+    xfce_mime_chooser_model_append (chooser->model,
+                                    _("Other Applications"),
+                                    "gnome-applications",
+                                    &chooser->other_iter);
 
-    /* filter out recommended apps from all apps */
-    all = g_app_info_get_all ();
-    for (li = all; li != NULL; li = li->next)
+    if (chooser_apps_cache == NULL)
     {
-        if (g_list_find_custom (recommended, li->data,
-                                xfce_mime_chooser_compare_app_info) == NULL)
-        {
-            other = g_list_prepend (other, li->data);
-        }
+        chooser_apps_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                    xfce_mime_chooser_apps_unref);
     }
 
-    /* add the other applications */
-    other = g_list_sort (other, xfce_mime_chooser_sort_app_info);
-    xfce_mime_chooser_model_append (chooser->model,
-                                    _("Other Applications"),
-                                    "gnome-applications",
-                                    other);
+    /* enumerate the applications in the worker the first time the
+     * type is shown, the dialog shows up with the list filled later */
+    apps = g_hash_table_lookup (chooser_apps_cache, mime_type);
+    if (apps == NULL)
+    {
+        apps = g_slice_new0 (XfceMimeChooserApps);
+        apps->ref_count = 1;
+        apps->mime_type = g_strdup (mime_type);
+        g_hash_table_insert (chooser_apps_cache, apps->mime_type, apps);
 
-    /* open all */
-    gtk_tree_view_expand_all (GTK_TREE_VIEW (chooser->treeview));
+        if (G_UNLIKELY (chooser_pool == NULL))
+            chooser_pool = g_thread_pool_new (xfce_mime_chooser_worker, NULL, 1, FALSE, NULL);
 
-    /* cleanup */
-    g_list_foreach (recommended, (GFunc) (void (*)(void)) g_object_unref, NULL);
-    g_list_foreach (all, (GFunc) (void (*)(void)) g_object_unref, NULL);
-    g_list_free (recommended);
-    g_list_free (all);
-    g_list_free (other);
+        g_thread_pool_push (chooser_pool, xfce_mime_chooser_apps_ref (apps), NULL);
+    }
+
+    chooser->apps = xfce_mime_chooser_apps_ref (apps);
+    if (apps->loaded)
+        xfce_mime_chooser_fill_start (chooser);
+    else
+        apps->choosers = g_slist_prepend (apps->choosers, chooser);
 
     /* set label and icon */
     icon = g_content_type_get_icon (mime_type);
@@ -660,3 +984,16 @@ xfce_mime_chooser_get_app_info (XfceMimeChooser *chooser)
         return xfce_mime_chooser_get_selected (chooser);
     }
 }
+
+
+
+/**
+ * Forget the memoized applications of all content types, after
+ * the associations changed or a custom command was added.
+ **/
+void
+xfce_mime_chooser_clear_cache (void)
+{
+    if (chooser_apps_cache != NULL)
+        g_hash_table_remove_all (chooser_apps_cache);
+}
@@ -40,6 +40,8 @@ void       xfce_mime_chooser_set_mime_type (XfceMimeChooser *chooser,
 
 GAppInfo  *xfce_mime_chooser_get_app_info  (XfceMimeChooser *chooser);
 
+void       xfce_mime_chooser_clear_cache   (void);
+
 G_END_DECLS
 
 #endif /* !__XFCE_MIME_CHOOSER_H__ */
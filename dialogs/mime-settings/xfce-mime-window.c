@@ -645,6 +645,9 @@ xfce_mime_window_set_default_for_type (XfceMimeWindow *window,
     {
         if (g_app_info_set_as_default_for_type (app_info, mime_type, &error))
         {
+            /* the recommended applications changed */
+            xfce_mime_chooser_clear_cache ();
+
             xfce_mime_window_set_filter_model (window, filter_path,
                                                g_app_info_get_name (app_info), TRUE);
         }
@@ -846,6 +849,7 @@ xfce_mime_window_reset_response (GtkWidget       *dialog,
     {
         /* reset the user's default */
         g_app_info_reset_type_associations (data->mime_type);
+        xfce_mime_chooser_clear_cache ();
 
         /* restore the system default */
         app_default = g_app_info_get_default_for_type (data->mime_type, FALSE);
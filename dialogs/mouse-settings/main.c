@@ -47,6 +47,10 @@
 #include <libbladeutil/libbladeutil.h>
 #include <libbladeui/libbladeui.h>
 
+#include <common/pointers-properties.h>
+
+#include "mouse-device-cache.h"
+#include "mouse-theme-loader.h"
 #include "mouse-dialog_ui.h"
 
 /* settings */
@@ -57,6 +61,10 @@
 #define PREVIEW_SPACING (2)
 #endif /* !HAVE_XCURSOR */
 
+/* polling when waiting for a feedback reset */
+#define RESET_POLL_INTERVAL (50)
+#define RESET_POLL_ATTEMPTS (20)
+
 
 /* global setting channels */
 BlconfChannel *xsettings_channel;
@@ -65,14 +73,31 @@ BlconfChannel *pointers_channel;
 /* lock counter to avoid signals during updates */
 static gint locked = 0;
 
+#ifdef HAVE_XCURSOR
+/* configured cursor theme, until the loader found it */
+static gchar *active_theme = NULL;
+#endif
+
 /* device update id */
 static guint timeout_id = 0;
 
+/* device that is rendered once its state is loaded */
+static XID render_xid = None;
+
+/* state before a feedback reset and the remaining polls */
+static MouseDeviceState reset_state;
+static guint            reset_attempts = 0;
+
 #ifdef DEVICE_HOTPLUGGING
 /* event id for device add/remove */
 static gint device_presence_event_type = 0;
 #endif
 
+#ifdef DEVICE_XI2
+/* major opcode of the input extension for XI2 events */
+static gint xi_opcode = -1;
+#endif
+
 /* option entries */
 static GdkNativeWindow opt_socket_id = 0;
 static gchar *opt_device_name = NULL;
@@ -118,18 +143,6 @@ enum
     N_DEVICE_COLUMNS
 };
 
-typedef union
-{
-    gchar   c;
-    guchar  uc;
-    gint16  i16;
-    guint16 u16;
-    gint32  i32;
-    guint32 u32;
-    float   f;
-    Atom    a;
-} propdata_t;
-
 static gchar *
 mouse_settings_format_value_px (GtkScale *scale,
                                 gdouble   value)
@@ -164,101 +177,6 @@ mouse_settings_format_value_s (GtkScale *scale,
 
 
 #ifdef HAVE_XCURSOR
-static GdkPixbuf *
-mouse_settings_themes_pixbuf_from_filename (const gchar *filename,
-                                            guint        size)
-{
-    XcursorImage *image;
-    GdkPixbuf    *scaled, *pixbuf = NULL;
-    gsize         bsize;
-    guchar       *buffer, *p, tmp;
-    gdouble       wratio, hratio;
-    gint          dest_width, dest_height;
-
-    /* load the image */
-    image = XcursorFilenameLoadImage (filename, size);
-    if (G_LIKELY (image))
-    {
-        /* buffer size */
-        bsize = image->width * image->height * 4;
-
-        /* allocate buffer */
-        buffer = g_malloc (bsize);
-
-        /* copy pixel data to buffer */
-        memcpy (buffer, image->pixels, bsize);
-
-        /* swap bits */
-        for (p = buffer; p < buffer + bsize; p += 4)
-        {
-            tmp = p[0];
-            p[0] = p[2];
-            p[2] = tmp;
-        }
-
-        /* create pixbuf */
-        pixbuf = gdk_pixbuf_new_from_data (buffer, GDK_COLORSPACE_RGB, TRUE,
-                                           8, image->width, image->height,
-                                           4 * image->width,
-                                           (GdkPixbufDestroyNotify) (void (*)(void)) g_free, NULL);
-
-        /* don't leak when creating the pixbuf failed */
-        if (G_UNLIKELY (pixbuf == NULL))
-            g_free (buffer);
-
-        /* scale pixbuf if needed */
-        if (pixbuf && (image->height > size || image->width > size))
-        {
-            /* calculate the ratio */
-            wratio = (gdouble) image->width / (gdouble) size;
-            hratio = (gdouble) image->height / (gdouble) size;
-
-            /* init */
-            dest_width = dest_height = size;
-
-            /* set dest size */
-            if (hratio > wratio)
-                dest_width  = rint (image->width / hratio);
-            else
-                dest_height = rint (image->height / wratio);
-
-            /* scale pixbuf */
-            scaled = gdk_pixbuf_scale_simple (pixbuf, MAX (dest_width, 1), MAX (dest_height, 1), GDK_INTERP_BILINEAR);
-
-            /* release and set scaled pixbuf */
-            g_object_unref (G_OBJECT (pixbuf));
-            pixbuf = scaled;
-        }
-
-        /* cleanup */
-        XcursorImageDestroy (image);
-    }
-
-    return pixbuf;
-}
-
-
-
-static GdkPixbuf *
-mouse_settings_themes_preview_icon (const gchar *path)
-{
-    GdkPixbuf *pixbuf = NULL;
-    gchar     *filename;
-
-    /* we only try the normal cursor, it is (most likely) always there */
-    filename = g_build_filename (path, "left_ptr", NULL);
-
-    /* try to load the pixbuf */
-    pixbuf = mouse_settings_themes_pixbuf_from_filename (filename, PREVIEW_SIZE);
-
-    /* cleanup */
-    g_free (filename);
-
-    return pixbuf;
-}
-
-
-
 static void
 mouse_settings_themes_preview_image (const gchar *path,
                                      GtkImage    *image)
@@ -283,7 +201,7 @@ mouse_settings_themes_preview_image (const gchar *path,
         {
             /* create cursor filename and try to load the pixbuf */
             filename = g_build_filename (path, preview_names[i], NULL);
-            pixbuf = mouse_settings_themes_pixbuf_from_filename (filename, PREVIEW_SIZE);
+            pixbuf = mouse_theme_loader_load_cursor (filename, PREVIEW_SIZE);
             g_free (filename);
 
             if (G_LIKELY (pixbuf))
@@ -347,8 +265,14 @@ mouse_settings_themes_selection_changed (GtkTreeSelection *selection,
 
         /* write configuration (not during a lock) */
         if (locked == 0)
+        {
             blconf_channel_set_string (xsettings_channel, "/Gtk/CursorThemeName", name);
 
+            /* the user picked a theme, stop selecting the configured one */
+            g_free (active_theme);
+            active_theme = NULL;
+        }
+
         /* cleanup */
         g_free (path);
         g_free (name);
@@ -393,166 +317,75 @@ mouse_settings_themes_sort_func (GtkTreeModel *model,
 
 
 
+static void
+mouse_settings_themes_loaded (const MouseTheme *theme,
+                              gpointer          user_data)
+{
+    GtkBuilder   *builder = GTK_BUILDER (user_data);
+    GObject      *treeview;
+    GtkTreeModel *model;
+    GtkTreeIter   iter;
+    GtkTreePath  *path;
+
+    treeview = gtk_builder_get_object (builder, "theme-treeview");
+    model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
+
+    /* insert in the store, the sort function puts it in place */
+    gtk_list_store_insert_with_values (GTK_LIST_STORE (model), &iter, -1,
+                                       COLUMN_THEME_PIXBUF, theme->pixbuf,
+                                       COLUMN_THEME_NAME, theme->name,
+                                       COLUMN_THEME_DISPLAY_NAME, theme->display_name,
+                                       COLUMN_THEME_COMMENT, theme->comment,
+                                       COLUMN_THEME_PATH, theme->path, -1);
+
+    /* select the active theme once it shows up */
+    if (active_theme != NULL && strcmp (active_theme, theme->name) == 0)
+    {
+        g_free (active_theme);
+        active_theme = NULL;
+
+        path = gtk_tree_model_get_path (model, &iter);
+
+        locked++;
+        gtk_tree_view_set_cursor (GTK_TREE_VIEW (treeview), path, NULL, FALSE);
+        gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (treeview), path, NULL, TRUE, 0.5, 0.0);
+        locked--;
+
+        gtk_tree_path_free (path);
+    }
+}
+
+
+
 static void
 mouse_settings_themes_populate_store (GtkBuilder *builder)
 {
-    const gchar        *path;
-    gchar             **basedirs;
-    gint                i;
-    gchar              *homedir;
-    GDir               *dir;
-    const gchar        *theme;
-    gchar              *filename;
-    gchar              *index_file;
-    XfceRc             *rc;
-    const gchar        *name;
-    const gchar        *comment;
     GtkTreeIter         iter;
-    gint                position = 0;
-    GdkPixbuf          *pixbuf;
-    gchar              *active_theme;
-    GtkTreePath        *active_path = NULL;
+    GtkTreePath        *default_path;
     GtkListStore       *store;
     GtkCellRenderer    *renderer;
     GtkTreeViewColumn  *column;
     GObject            *treeview;
     GtkTreeSelection   *selection;
-    gchar              *comment_escaped;
 
-    /* get the cursor paths */
-#if XCURSOR_LIB_MAJOR == 1 && XCURSOR_LIB_MINOR < 1
-    path = "~/.icons:/usr/share/icons:/usr/share/pixmaps:/usr/X11R6/lib/X11/icons";
-#else
-    path = XcursorLibraryPath ();
-#endif
-
-    /* split the paths */
-    basedirs = g_strsplit (path, ":", -1);
-
-    /* get the active theme */
+    /* get the active theme, selected when the loader finds it */
     active_theme = blconf_channel_get_string (xsettings_channel, "/Gtk/CursorThemeName", "default");
 
     /* create the store */
     store = gtk_list_store_new (N_THEME_COLUMNS, GDK_TYPE_PIXBUF, G_TYPE_STRING,
                                 G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
 
+    /* sort the store, themes arrive in no particular order */
+    gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (store), COLUMN_THEME_DISPLAY_NAME, mouse_settings_themes_sort_func, NULL, NULL);
+    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store), COLUMN_THEME_DISPLAY_NAME, GTK_SORT_ASCENDING);
+
     /* insert default */
-    gtk_list_store_insert_with_values (store, &iter, position++,
+    gtk_list_store_insert_with_values (store, &iter, 0,
                                        COLUMN_THEME_NAME, "default",
                                        COLUMN_THEME_DISPLAY_NAME, _("Default"), -1);
 
     /* store the default path, so we always select a theme */
-    active_path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
-
-    if (G_LIKELY (basedirs))
-    {
-        /* walk the base directories */
-        for (i = 0; basedirs[i] != NULL; i++)
-        {
-            /* init */
-            homedir = NULL;
-
-            /* parse the homedir if needed */
-            if (strstr (basedirs[i], "~/") != NULL)
-                path = homedir = g_strconcat (g_get_home_dir (), basedirs[i] + 1, NULL);
-            else
-                path = basedirs[i];
-
-            /* open directory */
-            dir = g_dir_open (path, 0, NULL);
-            if (G_LIKELY (dir))
-            {
-                for (;;)
-                {
-                    /* get the directory name */
-                    theme = g_dir_read_name (dir);
-                    if (G_UNLIKELY (theme == NULL))
-                        break;
-
-                    /* build the full cursor path */
-                    filename = g_build_filename (path, theme, "cursors", NULL);
-
-                    /* check if it looks like a cursor theme */
-                    if (g_file_test (filename, G_FILE_TEST_IS_DIR))
-                    {
-                        /* try to load a pixbuf */
-                        pixbuf = mouse_settings_themes_preview_icon (filename);
-
-                        /* insert in the store */
-                        gtk_list_store_insert_with_values (store, &iter, position++,
-                                                           COLUMN_THEME_PIXBUF, pixbuf,
-                                                           COLUMN_THEME_NAME, theme,
-                                                           COLUMN_THEME_DISPLAY_NAME, theme,
-                                                           COLUMN_THEME_PATH, filename, -1);
-
-                        /* check if this is the active theme, set the path */
-                        if (strcmp (active_theme, theme) == 0)
-                        {
-                            gtk_tree_path_free (active_path);
-                            active_path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
-                        }
-
-                        /* release pixbuf */
-                        if (G_LIKELY (pixbuf))
-                            g_object_unref (G_OBJECT (pixbuf));
-
-                        /* check for a index.theme file for additional information */
-                        index_file = g_build_filename (path, theme, "index.theme", NULL);
-                        if (g_file_test (index_file, G_FILE_TEST_IS_REGULAR))
-                        {
-                            /* open theme desktop file */
-                            rc = xfce_rc_simple_open (index_file, TRUE);
-                            if (G_LIKELY (rc))
-                            {
-                                /* check for the theme group */
-                                if (xfce_rc_has_group (rc, "Icon Theme"))
-                                {
-                                    /* set group */
-                                    xfce_rc_set_group (rc, "Icon Theme");
-
-                                    /* read values */
-                                    name = xfce_rc_read_entry (rc, "Name", theme);
-                                    comment = xfce_rc_read_entry (rc, "Comment", NULL);
-
-                                    /* escape the comment */
-                                    comment_escaped = comment ? g_markup_escape_text (comment, -1) : NULL;
-
-                                    /* update store */
-                                    gtk_list_store_set (store, &iter,
-                                                        COLUMN_THEME_DISPLAY_NAME, name,
-                                                        COLUMN_THEME_COMMENT, comment_escaped, -1);
-
-                                    /* cleanup */
-                                    g_free (comment_escaped);
-                                }
-
-                                /* close rc file */
-                                xfce_rc_close (rc);
-                            }
-                        }
-
-                        /* cleanup */
-                        g_free (index_file);
-                    }
-
-                    /* cleanup */
-                    g_free (filename);
-                }
-
-                /* close directory */
-                g_dir_close (dir);
-            }
-
-            /* cleanup */
-            g_free (homedir);
-        }
-
-        /* cleanup */
-        g_strfreev (basedirs);
-    }
-
-    /* cleanup */
-    g_free (active_theme);
+    default_path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
 
     /* set the treeview store */
     treeview = gtk_builder_get_object (builder, "theme-treeview");
@@ -574,200 +407,24 @@ mouse_settings_themes_populate_store (GtkBuilder *builder)
     gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
     g_signal_connect (G_OBJECT (selection), "changed", G_CALLBACK (mouse_settings_themes_selection_changed), builder);
 
-    /* select the active theme in the treeview */
-    gtk_tree_view_set_cursor (GTK_TREE_VIEW (treeview), active_path, NULL, FALSE);
-    gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (treeview), active_path, NULL, TRUE, 0.5, 0.0);
-    gtk_tree_path_free (active_path);
-
-    /* sort the store */
-    gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (store), COLUMN_THEME_DISPLAY_NAME, mouse_settings_themes_sort_func, NULL, NULL);
-    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store), COLUMN_THEME_DISPLAY_NAME, GTK_SORT_ASCENDING);
+    /* select the default theme until the active one is loaded */
+    gtk_tree_view_set_cursor (GTK_TREE_VIEW (treeview), default_path, NULL, FALSE);
+    gtk_tree_path_free (default_path);
 
     /* release the store */
     g_object_unref (G_OBJECT (store));
-}
-#endif /* !HAVE_XCURSOR */
-
-
-
-#ifdef HAVE_LIBINPUT
-/* FIXME: Completely overkill here and better suited in some common file */
-static gboolean
-mouse_settings_get_device_prop (Display     *xdisplay,
-                                XDevice     *device,
-                                const gchar *prop_name,
-                                Atom         type,
-                                guint        n_items,
-                                propdata_t  *retval)
-{
-    Atom     prop, float_type, type_ret;
-    gulong   n_items_ret, bytes_after;
-    gint     rc, format, size;
-    guint    i;
-    guchar  *data, *ptr;
-    gboolean success;
-
-    prop = XInternAtom (xdisplay, prop_name, False);
-    float_type = XInternAtom (xdisplay, "FLOAT", False);
-
-    gdk_error_trap_push ();
-    rc = XGetDeviceProperty (xdisplay, device, prop, 0, 1, False,
-                             type, &type_ret, &format, &n_items_ret,
-                             &bytes_after, &data);
-    gdk_error_trap_pop ();
-    if (rc == Success && type_ret == type && n_items_ret >= n_items)
-    {
-        success = TRUE;
-        switch(format)
-        {
-            case 8:
-                size = sizeof (gchar);
-                break;
-            case 16:
-                size = sizeof (gint16);
-                break;
-            case 32:
-            default:
-                size = sizeof (gint32);
-                break;
-        }
-        ptr = data;
-
-        for (i = 0; i < n_items; i++)
-        {
-            switch (type_ret)
-            {
-                case XA_INTEGER:
-                    switch (format)
-                    {
-                        case 8:
-                            retval[i].c = *((gchar*) ptr);
-                            break;
-                        case 16:
-                            retval[i].i16 = *((gint16 *) ptr);
-                            break;
-                        case 32:
-                            retval[i].i32 = *((gint32 *) ptr);
-                            break;
-                    }
-                    break;
-                case XA_CARDINAL:
-                    switch (format)
-                    {
-                        case 8:
-                            retval[i].uc = *((guchar*) ptr);
-                            break;
-                        case 16:
-                            retval[i].u16 = *((guint16 *) ptr);
-                            break;
-                        case 32:
-                            retval[i].u32 = *((guint32 *) ptr);
-                            break;
-                    }
-                    break;
-                case XA_ATOM:
-                    retval[i].a = *((Atom *) ptr);
-                    break;
-                default:
-                    if (type_ret == float_type)
-                    {
-                        retval[i].f = *((float*) ptr);
-                    }
-                    else
-                    {
-                        success = FALSE;
-                        g_warning ("Unhandled type, please implement it");
-                    }
-                    break;
-            }
-            ptr += size;
-        }
-        XFree (data);
 
-        return success;
-    }
-
-    return FALSE;
-}
-
-static gboolean
-mouse_settings_get_libinput_accel (Display *xdisplay,
-                                   XDevice *device,
-                                   gdouble *val)
-{
-    propdata_t pdata[1];
-    Atom float_type;
-
-    float_type = XInternAtom (xdisplay, "FLOAT", False);
-    if (mouse_settings_get_device_prop (xdisplay, device, LIBINPUT_PROP_ACCEL, float_type, 1, &pdata[0]))
+    /* nothing to wait for if the default theme is active */
+    if (strcmp (active_theme, "default") == 0)
     {
-        /* We use double internally, for whatever reason */
-        *val = (gdouble) (pdata[0].f + 1.0) * 5.0;
-
-        return TRUE;
+        g_free (active_theme);
+        active_theme = NULL;
     }
 
-    return FALSE;
+    /* scan the cursor paths in the background */
+    mouse_theme_loader_start (PREVIEW_SIZE, mouse_settings_themes_loaded, builder);
 }
-
-
-
-static gboolean
-mouse_settings_get_libinput_boolean (Display     *xdisplay,
-                                     XDevice     *device,
-                                     const gchar *prop_name,
-                                     gboolean    *val)
-{
-    propdata_t pdata[1];
-
-    if (mouse_settings_get_device_prop (xdisplay, device, prop_name, XA_INTEGER, 1, &pdata[0]))
-    {
-        *val = (gboolean) (pdata[0].c);
-
-        return TRUE;
-    }
-
-    return FALSE;
-}
-#endif /* HAVE_LIBINPUT */
-
-
-
-#ifdef DEVICE_PROPERTIES
-static gint
-mouse_settings_device_get_int_property (XDevice *device,
-                                        Atom     prop,
-                                        guint    offset,
-                                        gint    *horiz)
-{
-    Atom     type;
-    gint     format;
-    gulong   n_items, bytes_after;
-    guchar  *data;
-    gint     val = -1;
-    gint     res;
-
-    gdk_error_trap_push ();
-    res = XGetDeviceProperty (GDK_DISPLAY (), device, prop, 0, 1000, False,
-                              AnyPropertyType, &type, &format,
-                              &n_items, &bytes_after, &data);
-    if (gdk_error_trap_pop () == 0 && res == Success)
-    {
-        if (type == XA_INTEGER)
-        {
-            if (n_items > offset)
-                val = data[offset];
-
-            if (n_items > 1 + offset && horiz != NULL)
-                *horiz = data[offset + 1];
-        }
-
-        XFree (data);
-    }
-
-    return val;
-}
-#endif
+#endif /* !HAVE_XCURSOR */
 
 
 
@@ -892,20 +549,16 @@ mouse_settings_wacom_set_mode (GtkComboBox *combobox,
 static void
 mouse_settings_synaptics_set_tap_to_click (GtkBuilder *builder)
 {
-    Display   *xdisplay = GDK_DISPLAY ();
-    XDevice   *device;
-    gchar     *name = NULL;
-    Atom       tap_ation_prop;
-    Atom       type;
-    gint       format;
-    gulong     n, n_items, bytes_after;
-    guchar    *data;
-    gboolean   tap_to_click;
-    GPtrArray *array;
-    gint       res;
-    GObject   *object;
-    gchar     *prop;
-    GValue    *val;
+    Display          *xdisplay = GDK_DISPLAY ();
+    XDevice          *device;
+    gchar            *name = NULL;
+    XfcePointersRead  read;
+    gulong            n;
+    gboolean          tap_to_click;
+    GPtrArray        *array;
+    GObject          *object;
+    gchar            *prop;
+    GValue           *val;
 
     if (mouse_settings_device_get_selected (builder, &device, &name))
     {
@@ -913,29 +566,27 @@ mouse_settings_synaptics_set_tap_to_click (GtkBuilder *builder)
         tap_to_click = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (object));
 
         gdk_error_trap_push ();
-        tap_ation_prop = XInternAtom (xdisplay, "Synaptics Tap Action", True);
-        res = XGetDeviceProperty (xdisplay, device, tap_ation_prop, 0, 1000, False,
-                                  AnyPropertyType, &type, &format,
-                                  &n_items, &bytes_after, &data);
+        read.property = xfce_pointers_atom (xdisplay, XFCE_POINTERS_ATOM_SYNAPTICS_TAP_ACTION);
+        xfce_pointers_properties_read (xdisplay, device, &read, 1);
         if (gdk_error_trap_pop () == 0
-            && res == Success)
+            && read.data != NULL)
         {
-            if (type == XA_INTEGER
-                && format == 8
-                && n_items >= 7)
+            if (read.type == XA_INTEGER
+                && read.format == 8
+                && read.n_items >= 7)
             {
 
                 /* format: RT, RB, LT, LB, F1, F2, F3 */
-                data[4] = tap_to_click ? 1 : 0;
-                data[5] = tap_to_click ? 3 : 0;
-                data[6] = tap_to_click ? 2 : 0;
+                read.data[4] = tap_to_click ? 1 : 0;
+                read.data[5] = tap_to_click ? 3 : 0;
+                read.data[6] = tap_to_click ? 2 : 0;
 
-                array = g_ptr_array_sized_new (n_items);
-                for (n = 0; n < n_items; n++)
+                array = g_ptr_array_sized_new (read.n_items);
+                for (n = 0; n < read.n_items; n++)
                 {
                     val = g_new0 (GValue, 1);
                     g_value_init (val, G_TYPE_INT);
-                    g_value_set_int (val, data[n]);
+                    g_value_set_int (val, read.data[n]);
                     g_ptr_array_add (array, val);
                 }
 
@@ -946,7 +597,7 @@ mouse_settings_synaptics_set_tap_to_click (GtkBuilder *builder)
                 blconf_array_free (array);
             }
 
-            XFree (data);
+            xfce_pointers_properties_free (&read, 1);
         }
 
 #ifdef HAVE_LIBINPUT
@@ -1149,291 +800,92 @@ mouse_settings_device_set_enabled (GtkToggleButton *button,
 
 
 
-static void
-mouse_settings_device_selection_changed (GtkBuilder *builder)
+static gboolean
+mouse_settings_device_get_selected_xid (GtkBuilder *builder,
+                                        XID        *xid)
 {
-    gint               nbuttons = 0;
-    Display           *xdisplay = GDK_DISPLAY ();
-    XDevice           *device;
-    XDeviceInfo       *device_info;
-    XFeedbackState    *states, *pt;
-    XAnyClassPtr       any;
-    gint               nstates;
-    XPtrFeedbackState *state;
-    gint               i, n;
-    guchar            *buttonmap;
-    gint               id_1 = 0, id_3 = 0;
-    gint               id_4 = 0, id_5 = 0;
-    gdouble            acceleration = -1.00;
-    gint               threshold = -1;
-    GObject           *object;
-    gint               ndevices;
-    gboolean           is_synaptics = FALSE;
-    gboolean           is_wacom = FALSE;
-    gboolean           left_handed = FALSE;
-    gboolean           reverse_scrolling = FALSE;
-#ifdef HAVE_LIBINPUT
-    gboolean           is_libinput = FALSE;
-#endif /* HAVE_LIBINPUT */
-#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
-#ifdef HAVE_LIBINPUT
-    Atom               libinput_tap_prop;
-    Atom               libinput_scroll_methods_prop;
-#endif /* HAVE_LIBINPUT */
-    Atom               synaptics_prop;
-    Atom               wacom_prop;
-    Atom               synaptics_tap_prop;
-    Atom               synaptics_edge_scroll_prop;
-    Atom               synaptics_two_scroll_prop;
-    Atom               synaptics_circ_scroll_prop;
-    Atom               device_enabled_prop;
-    Atom               wacom_rotation_prop;
-    gint               is_enabled = -1;
-    gint               synaptics_tap_to_click = -1;
-    gint               synaptics_edge_scroll = -1;
-    gint               synaptics_edge_hscroll = -1;
-    gint               synaptics_two_scroll = -1;
-    gint               synaptics_two_hscroll = -1;
-    gint               synaptics_circ_scroll = -1;
-    gint               synaptics_scroll_mode = 0;
-    GtkTreeIter        iter;
-    gint               wacom_rotation = -1;
-    Atom              *props;
-    gint               nprops;
-    gint               wacom_mode = -1;
-#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
-
-    /* lock the dialog */
-    locked++;
+    GObject      *combobox;
+    GtkTreeIter   iter;
+    GtkTreeModel *model;
+    gulong        id;
 
-    /* get the selected item */
-    if (mouse_settings_device_get_selected (builder, &device, NULL))
+    combobox = gtk_builder_get_object (builder, "device-combobox");
+    if (gtk_combo_box_get_active_iter (GTK_COMBO_BOX (combobox), &iter))
     {
-        gdk_error_trap_push ();
-        device_info = XListInputDevices (xdisplay, &ndevices);
-        if (gdk_error_trap_pop () == 0 && device_info != NULL)
-        {
-            /* find mode and number of buttons */
-            for (i = 0; i < ndevices; i++)
-            {
-                if (device_info[i].id != device->device_id)
-                    continue;
+        model = gtk_combo_box_get_model (GTK_COMBO_BOX (combobox));
+        gtk_tree_model_get (model, &iter, COLUMN_DEVICE_XID, &id, -1);
+        *xid = id;
 
-                any = device_info[i].inputclassinfo;
-                for (n = 0; n < device_info[i].num_classes; n++)
-                {
-                    if (any->class == ButtonClass)
-                        nbuttons = ((XButtonInfoPtr) any)->num_buttons;
-#ifdef DEVICE_PROPERTIES
-                    else if (any->class == ValuatorClass)
-                        wacom_mode = ((XValuatorInfoPtr) any)->mode == Absolute ? 0 : 1;
-#endif
+        return TRUE;
+    }
 
-                    any = (XAnyClassPtr) ((gchar *) any + any->length);
-                }
+    return FALSE;
+}
 
-                break;
-            }
 
-            XFreeDeviceList (device_info);
-        }
-#ifdef HAVE_LIBINPUT
-        is_libinput = mouse_settings_get_libinput_boolean (xdisplay, device, LIBINPUT_PROP_LEFT_HANDED, &left_handed);
-        mouse_settings_get_libinput_boolean (xdisplay, device, LIBINPUT_PROP_NATURAL_SCROLL, &reverse_scrolling);
-        if (!is_libinput)
-#endif /* HAVE_LIBINPUT */
-        {
-            /* get the button mapping */
-            if (nbuttons > 0)
-            {
-                buttonmap = g_new0 (guchar, nbuttons);
-                gdk_error_trap_push ();
-                XGetDeviceButtonMapping (xdisplay, device, buttonmap, nbuttons);
-                if (gdk_error_trap_pop () != 0)
-                    g_critical ("Failed to get button map");
-
-                /* figure out the position of the first and second/third button in the map */
-                for (i = 0; i < nbuttons; i++)
-                {
-                    if (buttonmap[i] == 1)
-                        id_1 = i;
-                    else if (buttonmap[i] == (nbuttons < 3 ? 2 : 3))
-                        id_3 = i;
-                    else if (buttonmap[i] == 4)
-                        id_4 = i;
-                    else if (buttonmap[i] == 5)
-                        id_5 = i;
-                }
-                g_free (buttonmap);
-                left_handed = (id_1 > id_3);
-                reverse_scrolling = !!(id_5 < id_4);
-            }
-            else
-            {
-                g_critical ("Device has no buttons");
-            }
-        }
-#ifdef HAVE_LIBINPUT
-        if (!mouse_settings_get_libinput_accel (xdisplay, device, &acceleration))
-#endif /* HAVE_LIBINPUT */
-        {
-            /* get the feedback states for this device */
-            gdk_error_trap_push ();
-            states = XGetFeedbackControl (xdisplay, device, &nstates);
-            if (gdk_error_trap_pop () != 0 || states == NULL)
-            {
-                 g_critical ("Failed to get feedback states");
-            }
-            else
-            {
-                /* get the pointer feedback class */
-                for (pt = states, i = 0; i < nstates; i++)
-                {
-                    if (pt->class == PtrFeedbackClass)
-                    {
-                        /* get the state */
-                        state = (XPtrFeedbackState *) pt;
-                        acceleration = (gdouble) state->accelNum / (gdouble) state->accelDenom;
-                        threshold = state->threshold;
-                    }
-
-                    /* advance the offset */
-                    pt = (XFeedbackState *) ((gchar *) pt + pt->length);
-                }
 
-                XFreeFeedbackList (states);
-            }
-        }
+static void
+mouse_settings_device_render (GtkBuilder             *builder,
+                              const MouseDeviceState *state)
+{
+    GObject           *object;
 #if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
-#ifdef HAVE_LIBINPUT
-        /* lininput properties */
-        libinput_tap_prop = XInternAtom (xdisplay, LIBINPUT_PROP_TAP, True);
-        libinput_scroll_methods_prop = XInternAtom (xdisplay, LIBINPUT_PROP_SCROLL_METHOD_ENABLED, True);
-#endif /* HAVE_LIBINPUT */
-        /* wacom and synaptics specific properties */
-        device_enabled_prop = XInternAtom (xdisplay, "Device Enabled", True);
-        synaptics_prop = XInternAtom (xdisplay, "Synaptics Off", True);
-        wacom_prop = XInternAtom (xdisplay, "Wacom Tool Type", True);
-        synaptics_tap_prop = XInternAtom (xdisplay, "Synaptics Tap Action", True);
-        synaptics_edge_scroll_prop = XInternAtom (xdisplay, "Synaptics Edge Scrolling", True);
-        synaptics_two_scroll_prop = XInternAtom (xdisplay, "Synaptics Two-Finger Scrolling", True);
-        synaptics_circ_scroll_prop = XInternAtom (xdisplay, "Synaptics Circular Scrolling", True);
-        wacom_rotation_prop = XInternAtom (xdisplay, "Wacom Rotation", True);
-
-        /* check if this is a synaptics or wacom device */
-        gdk_error_trap_push ();
-        props = XListDeviceProperties (xdisplay, device, &nprops);
-        if (gdk_error_trap_pop () == 0 && props != NULL)
-        {
-            for (i = 0; i < nprops; i++)
-            {
-                if (props[i] == device_enabled_prop)
-                    is_enabled = mouse_settings_device_get_int_property (device, props[i], 0, NULL);
-                else if (props[i] == synaptics_prop)
-                    is_synaptics = TRUE;
-                else if (props[i] == wacom_prop)
-                    is_wacom = TRUE;
-                else if (props[i] == synaptics_tap_prop)
-                    synaptics_tap_to_click = mouse_settings_device_get_int_property (device, props[i], 4, NULL);
-                else if (props[i] == synaptics_edge_scroll_prop)
-                    synaptics_edge_scroll = mouse_settings_device_get_int_property (device, props[i], 0, &synaptics_edge_hscroll);
-                else if (props[i] == synaptics_two_scroll_prop)
-                    synaptics_two_scroll = mouse_settings_device_get_int_property (device, props[i], 0, &synaptics_two_hscroll);
-                else if (props[i] == synaptics_circ_scroll_prop)
-                    synaptics_circ_scroll = mouse_settings_device_get_int_property (device, props[i], 0, NULL);
-                else if (props[i] == wacom_rotation_prop)
-                    wacom_rotation = mouse_settings_device_get_int_property (device, props[i], 0, NULL);
-#ifdef HAVE_LIBINPUT
-                else if (props[i] == libinput_tap_prop)
-                {
-                    is_synaptics = TRUE;
-                    mouse_settings_get_libinput_boolean (xdisplay, device, LIBINPUT_PROP_TAP, &synaptics_tap_to_click);
-                }
-                else if (props[i] == libinput_scroll_methods_prop)
-                {
-                    propdata_t pdata[3];
-                    gboolean success;
-
-                    success = mouse_settings_get_device_prop (xdisplay,
-                                                              device,
-                                                              LIBINPUT_PROP_SCROLL_METHOD_ENABLED,
-                                                              XA_INTEGER, 3, &pdata[0]);
-                    if (success)
-                    {
-                        synaptics_two_scroll = (gint) pdata[0].c;
-                        synaptics_edge_scroll = (gint) pdata[1].c;
-                        synaptics_circ_scroll = -1; /* libinput does not expose this method */
-                    }
-
-                    success = mouse_settings_get_device_prop (xdisplay,
-                                                              device,
-                                                              LIBINPUT_PROP_SCROLL_METHODS_AVAILABLE,
-                                                              XA_INTEGER, 3, &pdata[0]);
-                    if (success)
-                    {
-                        if (!pdata[0].c)
-                            synaptics_two_scroll = -1;
-                        if (!pdata[1].c)
-                            synaptics_edge_scroll = -1;
-                    }
-                }
-#endif /* HAVE_LIBINPUT */
-            }
-
-            XFree (props);
-        }
+    gint               synaptics_scroll_mode = 0;
+    GtkTreeIter        iter;
 #endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+#ifdef DEVICE_PROPERTIES
+    gint               wacom_rotation = state->wacom_rotation;
+#endif
 
-        /* close the device */
-        XCloseDevice (xdisplay, device);
-    }
+    /* lock the dialog */
+    locked++;
 
     /* update button order */
-    object = gtk_builder_get_object (builder, left_handed ? "device-left-handed" : "device-right-handed");
+    object = gtk_builder_get_object (builder, state->left_handed ? "device-left-handed" : "device-right-handed");
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), TRUE);
 
     object = gtk_builder_get_object (builder, "device-reverse-scrolling");
-    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), reverse_scrolling);
-    gtk_widget_set_sensitive (GTK_WIDGET (object), nbuttons >= 5);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), state->reverse_scrolling);
+    gtk_widget_set_sensitive (GTK_WIDGET (object), state->nbuttons >= 5);
 
     /* update acceleration scale */
     object = gtk_builder_get_object (builder, "device-acceleration-scale");
-    gtk_range_set_value (GTK_RANGE (object), acceleration);
-    gtk_widget_set_sensitive (GTK_WIDGET (object), acceleration != -1);
+    gtk_range_set_value (GTK_RANGE (object), state->acceleration);
+    gtk_widget_set_sensitive (GTK_WIDGET (object), state->acceleration != -1);
 
     /* update threshold scale */
     object = gtk_builder_get_object (builder, "device-threshold-scale");
-    gtk_range_set_value (GTK_RANGE (object), threshold);
-    gtk_widget_set_visible (GTK_WIDGET (object), threshold != -1);
+    gtk_range_set_value (GTK_RANGE (object), state->threshold);
+    gtk_widget_set_visible (GTK_WIDGET (object), state->threshold != -1);
     object = gtk_builder_get_object (builder, "device-threshold-label");
-    gtk_widget_set_visible (GTK_WIDGET (object), threshold != -1);
+    gtk_widget_set_visible (GTK_WIDGET (object), state->threshold != -1);
 
     object = gtk_builder_get_object (builder, "device-enabled");
 #ifdef DEVICE_PROPERTIES
-    gtk_widget_set_sensitive (GTK_WIDGET (object), is_enabled != -1);
-    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), is_enabled > 0);
+    gtk_widget_set_sensitive (GTK_WIDGET (object), state->is_enabled != -1);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), state->is_enabled > 0);
 
     object = gtk_builder_get_object (builder, "device-notebook");
-    gtk_widget_set_sensitive (GTK_WIDGET (object), is_enabled == 1);
+    gtk_widget_set_sensitive (GTK_WIDGET (object), state->is_enabled == 1);
 #else
     gtk_widget_set_visible (GTK_WIDGET (object), FALSE);
 #endif
 
 #ifdef HAVE_LIBINPUT
     object = gtk_builder_get_object (builder, "device-reset-feedback");
-    gtk_widget_set_visible (GTK_WIDGET (object), !is_libinput);
+    gtk_widget_set_visible (GTK_WIDGET (object), !state->is_libinput);
 #endif /* HAVE_LIBINPUT */
 
     /* synaptics options */
     object = gtk_builder_get_object (builder, "synaptics-tab");
-    gtk_widget_set_visible (GTK_WIDGET (object), is_synaptics);
+    gtk_widget_set_visible (GTK_WIDGET (object), state->is_synaptics);
 
 #if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
-    if (is_synaptics)
+    if (state->is_synaptics)
     {
         object = gtk_builder_get_object (builder, "synaptics-tap-to-click");
-        gtk_widget_set_sensitive (GTK_WIDGET (object), synaptics_tap_to_click != -1);
-        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), synaptics_tap_to_click > 0);
+        gtk_widget_set_sensitive (GTK_WIDGET (object), state->synaptics_tap_to_click != -1);
+        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object), state->synaptics_tap_to_click > 0);
 
         /* Values for synaptics_scroll_mode:
          * -1 no selection
@@ -1442,24 +894,24 @@ mouse_settings_device_selection_changed (GtkBuilder *builder)
          *  2 two-finger scrolling
          *  3 circular scrolling
          */
-        if (synaptics_edge_scroll > 0)
+        if (state->synaptics_edge_scroll > 0)
             synaptics_scroll_mode = 1;
 
-        if (synaptics_two_scroll > 0)
+        if (state->synaptics_two_scroll > 0)
             synaptics_scroll_mode = 2;
 
-        if (synaptics_circ_scroll > 0)
+        if (state->synaptics_circ_scroll > 0)
             synaptics_scroll_mode = 3;
 
         object = gtk_builder_get_object (builder, "synaptics-scroll-store");
         if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (object), &iter, NULL, 1))
-            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, synaptics_edge_scroll != -1, -1);
+            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, state->synaptics_edge_scroll != -1, -1);
 
         if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (object), &iter, NULL, 2))
-            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, synaptics_two_scroll != -1, -1);
+            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, state->synaptics_two_scroll != -1, -1);
 
         if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (object), &iter, NULL, 3))
-            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, synaptics_circ_scroll != -1, -1);
+            gtk_list_store_set (GTK_LIST_STORE (object), &iter, 1, state->synaptics_circ_scroll != -1, -1);
 
         object = gtk_builder_get_object (builder, "synaptics-scroll");
         gtk_combo_box_set_active (GTK_COMBO_BOX (object), synaptics_scroll_mode);
@@ -1467,29 +919,29 @@ mouse_settings_device_selection_changed (GtkBuilder *builder)
         object = gtk_builder_get_object (builder, "synaptics-scroll-horiz");
         mouse_settings_synaptics_hscroll_sensitive (builder);
         gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (object),
-                                      synaptics_edge_hscroll == 1 || synaptics_two_hscroll == 1);
+                                      state->synaptics_edge_hscroll == 1 || state->synaptics_two_hscroll == 1);
 #ifdef HAVE_LIBINPUT
-        gtk_widget_set_visible (GTK_WIDGET (object), !is_libinput);
+        gtk_widget_set_visible (GTK_WIDGET (object), !state->is_libinput);
 
         object = gtk_builder_get_object (builder, "synaptics-disable-while-type");
-        gtk_widget_set_visible (GTK_WIDGET (object), !is_libinput);
+        gtk_widget_set_visible (GTK_WIDGET (object), !state->is_libinput);
 
         object = gtk_builder_get_object (builder, "synaptics-disable-duration-box");
-        gtk_widget_set_visible (GTK_WIDGET (object), !is_libinput);
+        gtk_widget_set_visible (GTK_WIDGET (object), !state->is_libinput);
 #endif /* HAVE_LIBINPUT */
     }
 #endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
 
     /* wacom options */
     object = gtk_builder_get_object (builder, "wacom-tab");
-    gtk_widget_set_visible (GTK_WIDGET (object), is_wacom);
+    gtk_widget_set_visible (GTK_WIDGET (object), state->is_wacom);
 
 #ifdef DEVICE_PROPERTIES
-    if (is_wacom)
+    if (state->is_wacom)
     {
         object = gtk_builder_get_object (builder, "wacom-mode");
-        gtk_widget_set_sensitive (GTK_WIDGET (object), wacom_mode != -1);
-        gtk_combo_box_set_active (GTK_COMBO_BOX (object), wacom_mode == -1 ? 1 : wacom_mode);
+        gtk_widget_set_sensitive (GTK_WIDGET (object), state->wacom_mode != -1);
+        gtk_combo_box_set_active (GTK_COMBO_BOX (object), state->wacom_mode == -1 ? 1 : state->wacom_mode);
 
         object = gtk_builder_get_object (builder, "wacom-rotation");
         gtk_widget_set_sensitive (GTK_WIDGET (object), wacom_rotation != -1);
@@ -1510,6 +962,132 @@ mouse_settings_device_selection_changed (GtkBuilder *builder)
 
 
 
+static gboolean
+mouse_settings_device_reset_poll (gpointer user_data)
+{
+    GDK_THREADS_ENTER ();
+
+    /* reload the state of the device we're waiting for */
+    if (render_xid != None)
+        mouse_device_cache_refresh (render_xid);
+
+    GDK_THREADS_LEAVE ();
+
+    return FALSE;
+}
+
+
+
+static void
+mouse_settings_device_list_changed_timeout_destroyed (gpointer user_data)
+{
+    /* reset the timeout id */
+    timeout_id = 0;
+}
+
+
+
+static gboolean
+mouse_settings_device_reset_applied (const MouseDeviceState *state)
+{
+    /* the feedback control has no change events, so we poll until the
+     * daemon applied the new values or we gave up waiting */
+    if (reset_attempts == 0)
+        return TRUE;
+
+    if (state->valid
+        && state->acceleration == reset_state.acceleration
+        && state->threshold == reset_state.threshold
+        && --reset_attempts > 0)
+    {
+        if (timeout_id == 0)
+            timeout_id = g_timeout_add_full (G_PRIORITY_LOW, RESET_POLL_INTERVAL,
+                                             mouse_settings_device_reset_poll, NULL,
+                                             mouse_settings_device_list_changed_timeout_destroyed);
+        return FALSE;
+    }
+
+    reset_attempts = 0;
+
+    return TRUE;
+}
+
+
+
+static void
+mouse_settings_device_selection_changed (GtkBuilder *builder)
+{
+    const MouseDeviceState *state;
+    MouseDeviceState        empty;
+    XID                     xid;
+    GObject                *button;
+
+    /* stop waiting for a reset of the previous device */
+    if (reset_attempts > 0)
+    {
+        reset_attempts = 0;
+        button = gtk_builder_get_object (builder, "device-reset-feedback");
+        gtk_widget_set_sensitive (GTK_WIDGET (button), TRUE);
+    }
+
+    if (mouse_settings_device_get_selected_xid (builder, &xid))
+    {
+        /* render straight from the cache */
+        state = mouse_device_cache_lookup (xid);
+        if (G_LIKELY (state != NULL))
+            mouse_settings_device_render (builder, state);
+
+        if (state == NULL || state->stale)
+        {
+            /* not loaded yet or outdated, render again once the worker is done */
+            render_xid = xid;
+            mouse_device_cache_refresh (xid);
+        }
+        else
+        {
+            render_xid = None;
+        }
+    }
+    else
+    {
+        /* nothing selected, reset the widgets */
+        render_xid = None;
+        mouse_device_state_init (&empty, None);
+        mouse_settings_device_render (builder, &empty);
+    }
+}
+
+
+
+static void
+mouse_settings_device_state_loaded (const MouseDeviceState *state,
+                                    gpointer                user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER (user_data);
+    GObject    *button;
+    XID         xid;
+
+    /* only update the dialog if we're waiting for this device */
+    if (state->xid != render_xid
+        || !mouse_settings_device_reset_applied (state))
+        return;
+
+    render_xid = None;
+
+    if (mouse_settings_device_get_selected_xid (builder, &xid)
+        && xid == state->xid)
+    {
+        if (state->valid)
+            mouse_settings_device_render (builder, state);
+
+        /* in case we were waiting for a reset */
+        button = gtk_builder_get_object (builder, "device-reset-feedback");
+        gtk_widget_set_sensitive (GTK_WIDGET (button), TRUE);
+    }
+}
+
+
+
 static void
 mouse_settings_device_save (GtkBuilder *builder)
 {
@@ -1574,36 +1152,6 @@ mouse_settings_device_save (GtkBuilder *builder)
 
 
 
-static gchar *
-mouse_settings_device_blconf_name (const gchar *name)
-{
-    GString     *string;
-    const gchar *p;
-
-    /* NOTE: this function exists in both the dialog and
-     *       helper code and they have to identical! */
-
-    /* allocate a string */
-    string = g_string_sized_new (strlen (name));
-
-    /* create a name with only valid chars */
-    for (p = name; *p != '\0'; p++)
-    {
-        if ((*p >= 'A' && *p <= 'Z')
-            || (*p >= 'a' && *p <= 'z')
-            || (*p >= '0' && *p <= '9')
-            || *p == '_' || *p == '-')
-          string = g_string_append_c (string, *p);
-        else if (*p == ' ')
-            string = g_string_append_c (string, '_');
-    }
-
-    /* return the new string */
-    return g_string_free (string, FALSE);
-}
-
-
-
 static void
 mouse_settings_device_populate_store (GtkBuilder *builder,
                                       gboolean    create_store)
@@ -1647,6 +1195,9 @@ mouse_settings_device_populate_store (GtkBuilder *builder,
         gtk_list_store_clear (store);
     }
 
+    /* device ids can be reused, start with an empty cache */
+    mouse_device_cache_clear ();
+
     /* get all the registered devices */
     gdk_error_trap_push ();
     device_list = XListInputDevices (GDK_DISPLAY (), &ndevices);
@@ -1671,7 +1222,7 @@ mouse_settings_device_populate_store (GtkBuilder *builder,
             continue;
 
         /* create a valid blconf device name */
-        blconf_name = mouse_settings_device_blconf_name (device_info->name);
+        blconf_name = xfce_pointers_device_blconf_name (device_info->name);
 
         /* insert in the store */
         gtk_list_store_insert_with_values (store, &iter, i,
@@ -1680,6 +1231,9 @@ mouse_settings_device_populate_store (GtkBuilder *builder,
                                            COLUMN_DEVICE_XID, device_info->id,
                                            -1);
 
+        /* load the device state in the background */
+        mouse_device_cache_refresh (device_info->id);
+
         /* check if we should select this device */
         if (opt_device_name != NULL
             && strcmp (opt_device_name, device_info->name) == 0)
@@ -1707,45 +1261,16 @@ mouse_settings_device_populate_store (GtkBuilder *builder,
 
 
 
-static gboolean
-mouse_settings_device_update_sliders (gpointer user_data)
-{
-    GtkBuilder *builder = GTK_BUILDER (user_data);
-    GObject    *button;
-
-    GDK_THREADS_ENTER ();
-
-    /* update */
-    mouse_settings_device_selection_changed (builder);
-
-    /* make the button sensitive again */
-    button = gtk_builder_get_object (builder, "device-reset-feedback");
-    gtk_widget_set_sensitive (GTK_WIDGET (button), TRUE);
-
-    GDK_THREADS_LEAVE ();
-
-    return FALSE;
-}
-
-
-
-static void
-mouse_settings_device_list_changed_timeout_destroyed (gpointer user_data)
-{
-    /* reset the timeout id */
-    timeout_id = 0;
-}
-
-
-
 static void
 mouse_settings_device_reset (GtkWidget  *button,
                              GtkBuilder *builder)
 {
-    gchar        *name, *property_name;
-    GtkTreeModel *model;
-    GtkTreeIter   iter;
-    GObject      *combobox;
+    gchar                  *name, *property_name;
+    GtkTreeModel           *model;
+    GtkTreeIter             iter;
+    GObject                *combobox;
+    gulong                  xid;
+    const MouseDeviceState *state;
 
     /* leave when locked */
     if (locked > 0)
@@ -1757,13 +1282,25 @@ mouse_settings_device_reset (GtkWidget  *button,
     {
         /* get device id and number of buttons */
         model = gtk_combo_box_get_model (GTK_COMBO_BOX (combobox));
-        gtk_tree_model_get (model, &iter, COLUMN_DEVICE_BLCONF_NAME, &name, -1);
+        gtk_tree_model_get (model, &iter, COLUMN_DEVICE_BLCONF_NAME, &name,
+                            COLUMN_DEVICE_XID, &xid, -1);
 
-        if (G_LIKELY (name != NULL && timeout_id == 0))
+        if (G_LIKELY (name != NULL && reset_attempts == 0))
         {
             /* make the button insensitive */
             gtk_widget_set_sensitive (button, FALSE);
 
+            /* remember the current values, so we know when they changed */
+            state = mouse_device_cache_lookup (xid);
+            if (state != NULL)
+                reset_state = *state;
+            else
+                mouse_device_state_init (&reset_state, xid);
+
+            /* render the device once the new values are loaded */
+            render_xid = xid;
+            reset_attempts = RESET_POLL_ATTEMPTS;
+
             /* set the threshold to -1 */
             property_name = g_strdup_printf ("/%s/Threshold", name);
             blconf_channel_set_int (pointers_channel, property_name, -1);
@@ -1774,9 +1311,12 @@ mouse_settings_device_reset (GtkWidget  *button,
             blconf_channel_set_double (pointers_channel, property_name, -1.00);
             g_free (property_name);
 
-            /* update the sliders in 500ms */
-            timeout_id = g_timeout_add_full (G_PRIORITY_LOW, 500, mouse_settings_device_update_sliders,
-                                             builder, mouse_settings_device_list_changed_timeout_destroyed);
+            /* property backed devices are reloaded on the XI property event,
+             * for the others start polling */
+            if (timeout_id == 0)
+                timeout_id = g_timeout_add_full (G_PRIORITY_LOW, RESET_POLL_INTERVAL,
+                                                 mouse_settings_device_reset_poll, NULL,
+                                                 mouse_settings_device_list_changed_timeout_destroyed);
         }
 
         /* cleanup */
@@ -1786,6 +1326,121 @@ mouse_settings_device_reset (GtkWidget  *button,
 
 
 
+#ifdef DEVICE_XI2
+static GdkFilterReturn
+mouse_settings_property_event_filter (GdkXEvent *xevent,
+                                      GdkEvent  *gdk_event,
+                                      gpointer   user_data)
+{
+    XEvent              *event = xevent;
+    XGenericEventCookie *cookie = &event->xcookie;
+    XIPropertyEvent     *property_event;
+    gboolean             fetched = FALSE;
+
+    if (event->type != GenericEvent
+        || cookie->extension != xi_opcode
+        || cookie->evtype != XI_PropertyEvent)
+        return GDK_FILTER_CONTINUE;
+
+    /* gdk does not fetch the cookie data for us */
+    if (cookie->data == NULL)
+        fetched = XGetEventData (cookie->display, cookie);
+
+    if (cookie->data != NULL)
+    {
+        /* reload devices we know about or are waiting for */
+        property_event = cookie->data;
+        if (mouse_device_cache_lookup (property_event->deviceid) != NULL
+            || (XID) property_event->deviceid == render_xid)
+            mouse_device_cache_refresh (property_event->deviceid);
+    }
+
+    if (fetched)
+        XFreeEventData (cookie->display, cookie);
+
+    return GDK_FILTER_CONTINUE;
+}
+
+
+
+static void
+mouse_settings_create_property_event_filter (GtkBuilder *builder)
+{
+    Display       *xdisplay = GDK_DISPLAY ();
+    XIEventMask    event_mask;
+    guchar         mask[XIMaskLen (XI_LASTEVENT)] = { 0, };
+    gint           event, error;
+    gint           major = 2, minor = 0;
+
+    if (!XQueryExtension (xdisplay, INAME, &xi_opcode, &event, &error))
+        return;
+
+    /* property events require XI2 */
+    gdk_error_trap_push ();
+    if (XIQueryVersion (xdisplay, &major, &minor) != Success)
+    {
+        gdk_error_trap_pop ();
+        xi_opcode = -1;
+        return;
+    }
+
+    XISetMask (mask, XI_PropertyEvent);
+    event_mask.deviceid = XIAllDevices;
+    event_mask.mask_len = sizeof (mask);
+    event_mask.mask = mask;
+    XISelectEvents (xdisplay, RootWindow (xdisplay, DefaultScreen (xdisplay)), &event_mask, 1);
+    if (gdk_error_trap_pop () != 0)
+    {
+        g_critical ("Failed to setup the property event filter");
+        xi_opcode = -1;
+        return;
+    }
+
+    gdk_window_add_filter (NULL, mouse_settings_property_event_filter, builder);
+}
+#endif
+
+
+
+static void
+mouse_settings_device_blconf_changed (BlconfChannel *channel,
+                                      const gchar   *property,
+                                      const GValue  *value,
+                                      GtkBuilder    *builder)
+{
+    GObject      *combobox;
+    GtkTreeModel *model;
+    GtkTreeIter   iter;
+    gchar        *blconf_name;
+    gulong        xid;
+    gsize         len;
+
+    /* the dialog or someone else changed a device setting; the cached
+     * state is outdated as soon as the daemon applied it */
+    combobox = gtk_builder_get_object (builder, "device-combobox");
+    model = gtk_combo_box_get_model (GTK_COMBO_BOX (combobox));
+    if (model == NULL || !gtk_tree_model_get_iter_first (model, &iter))
+        return;
+
+    do
+    {
+        gtk_tree_model_get (model, &iter, COLUMN_DEVICE_BLCONF_NAME, &blconf_name,
+                            COLUMN_DEVICE_XID, &xid, -1);
+
+        len = blconf_name != NULL ? strlen (blconf_name) : 0;
+        if (len > 0
+            && property[0] == '/'
+            && strncmp (property + 1, blconf_name, len) == 0
+            && property[len + 1] == '/')
+            mouse_device_cache_invalidate (xid);
+
+        g_free (blconf_name);
+    }
+    while (gtk_tree_model_iter_next (model, &iter));
+}
+
+
+
 #ifdef DEVICE_HOTPLUGGING
 static GdkFilterReturn
 mouse_settings_event_filter (GdkXEvent *xevent,
@@ -1861,6 +1516,13 @@ main (gint argc, gchar **argv)
     /* setup translation domain */
     xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
 
+    /* the device cache queries the server from a worker thread */
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+    if (!g_thread_supported ())
+        g_thread_init (NULL);
+#endif
+    XInitThreads ();
+
     /* initialize Gtk+ */
     if (!gtk_init_with_args (&argc, &argv, "", option_entries, GETTEXT_PACKAGE, &error))
     {
@@ -1940,9 +1602,20 @@ main (gint argc, gchar **argv)
             /* lock */
             locked++;
 
+            /* start loading device states in the background */
+            if (!mouse_device_cache_init (GDK_DISPLAY (), mouse_settings_device_state_loaded, builder))
+            {
+                g_critical ("Failed to start the device cache");
+                return EXIT_FAILURE;
+            }
+
             /* populate the devices combobox */
             mouse_settings_device_populate_store (builder, TRUE);
 
+            /* outdate cached states when device settings change */
+            g_signal_connect (G_OBJECT (pointers_channel), "property-changed",
+                              G_CALLBACK (mouse_settings_device_blconf_changed), builder);
+
             /* connect signals */
 #ifdef DEVICE_PROPERTIES
             object = gtk_builder_get_object (builder, "device-enabled");
@@ -2063,6 +1736,11 @@ main (gint argc, gchar **argv)
             mouse_settings_create_event_filter (builder);
 #endif
 
+#ifdef DEVICE_XI2
+            /* reload cached device states on property changes */
+            mouse_settings_create_property_event_filter (builder);
+#endif
+
             if (G_UNLIKELY (opt_socket_id == 0))
             {
                 /* get the dialog */
@@ -2113,6 +1791,13 @@ main (gint argc, gchar **argv)
             g_error_free (error);
         }
 
+        /* stop the workers before the builder goes away */
+        mouse_device_cache_shutdown ();
+#ifdef HAVE_XCURSOR
+        mouse_theme_loader_shutdown ();
+        g_free (active_theme);
+#endif
+
         /* release the Gtk+ user-interface file */
         g_object_unref (G_OBJECT (builder));
 
@@ -0,0 +1,549 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gdk/gdk.h>
+
+#include <common/pointers-properties.h>
+
+#include "mouse-device-cache.h"
+
+/* The device cache keeps the state of every pointer device around, so
+ * the dialog can switch between devices without talking to the X server.
+ * States are (re)loaded by a single worker thread that owns its own X
+ * connection; the results are handed back to the main loop in an idle
+ * and only the main loop touches the hash tables below. */
+
+
+
+#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
+/* properties fetched in one batch for every device */
+enum
+{
+    READ_DEVICE_ENABLED,
+    READ_SYNAPTICS_OFF,
+    READ_SYNAPTICS_TAP_ACTION,
+    READ_SYNAPTICS_EDGE_SCROLLING,
+    READ_SYNAPTICS_TWO_FINGER_SCROLLING,
+    READ_SYNAPTICS_CIRCULAR_SCROLLING,
+    READ_WACOM_TOOL_TYPE,
+    READ_WACOM_ROTATION,
+#ifdef HAVE_LIBINPUT
+    READ_LIBINPUT_TAP,
+    READ_LIBINPUT_ACCEL,
+    READ_LIBINPUT_LEFT_HANDED,
+    READ_LIBINPUT_NATURAL_SCROLL,
+    READ_LIBINPUT_SCROLL_METHOD_ENABLED,
+    READ_LIBINPUT_SCROLL_METHODS_AVAILABLE,
+#endif /* HAVE_LIBINPUT */
+    N_READS
+};
+
+static const XfcePointersAtom read_atoms[] =
+{
+    XFCE_POINTERS_ATOM_DEVICE_ENABLED,
+    XFCE_POINTERS_ATOM_SYNAPTICS_OFF,
+    XFCE_POINTERS_ATOM_SYNAPTICS_TAP_ACTION,
+    XFCE_POINTERS_ATOM_SYNAPTICS_EDGE_SCROLLING,
+    XFCE_POINTERS_ATOM_SYNAPTICS_TWO_FINGER_SCROLLING,
+    XFCE_POINTERS_ATOM_SYNAPTICS_CIRCULAR_SCROLLING,
+    XFCE_POINTERS_ATOM_WACOM_TOOL_TYPE,
+    XFCE_POINTERS_ATOM_WACOM_ROTATION,
+#ifdef HAVE_LIBINPUT
+    XFCE_POINTERS_ATOM_LIBINPUT_TAP,
+    XFCE_POINTERS_ATOM_LIBINPUT_ACCEL,
+    XFCE_POINTERS_ATOM_LIBINPUT_LEFT_HANDED,
+    XFCE_POINTERS_ATOM_LIBINPUT_NATURAL_SCROLL,
+    XFCE_POINTERS_ATOM_LIBINPUT_SCROLL_METHOD_ENABLED,
+    XFCE_POINTERS_ATOM_LIBINPUT_SCROLL_METHODS_AVAILABLE,
+#endif /* HAVE_LIBINPUT */
+};
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+
+
+
+/* worker side, only used from the pool thread */
+static Display     *cache_xdisplay = NULL;
+
+/* shared */
+static GThreadPool *cache_pool = NULL;
+static gint         cache_xerror = 0;
+static XErrorHandler cache_xerror_parent = NULL;
+
+/* main loop side */
+static GHashTable          *cache_states = NULL;
+static GHashTable          *cache_pending = NULL;
+static MouseDeviceCacheFunc cache_func = NULL;
+static gpointer             cache_func_data = NULL;
+
+/* values for the pending table */
+#define PENDING_QUEUED (GINT_TO_POINTER (1))
+#define PENDING_AGAIN  (GINT_TO_POINTER (2))
+
+
+
+static gint
+mouse_device_cache_x_error (Display     *xdisplay,
+                            XErrorEvent *event)
+{
+    /* errors on our private connection are expected when a device
+     * disappears while it is queried, just remember them */
+    if (xdisplay == cache_xdisplay)
+    {
+        g_atomic_int_set (&cache_xerror, event->error_code);
+        return 0;
+    }
+
+    if (cache_xerror_parent != NULL)
+        return cache_xerror_parent (xdisplay, event);
+
+    return 0;
+}
+
+
+
+#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
+static gint
+mouse_device_cache_get_int (const XfcePointersRead *read,
+                            guint                   index)
+{
+    gint val;
+
+    if (xfce_pointers_property_get_int (read, index, &val))
+        return val;
+
+    return -1;
+}
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+
+
+
+static void
+mouse_device_cache_query (Display          *xdisplay,
+                          MouseDeviceState *state)
+{
+    XDevice           *device;
+    XDeviceInfo       *device_info;
+    XFeedbackState    *states, *pt;
+    XPtrFeedbackState *ptr_state;
+    XAnyClassPtr       any;
+    gint               nstates, ndevices;
+    gint               i, n;
+    guchar            *buttonmap;
+    gint               id_1 = 0, id_3 = 0;
+    gint               id_4 = 0, id_5 = 0;
+#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
+    XfcePointersRead   reads[N_READS];
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+#ifdef HAVE_LIBINPUT
+    gint               val;
+    gfloat             accel;
+#endif /* HAVE_LIBINPUT */
+
+    device = XOpenDevice (xdisplay, state->xid);
+    if (device == NULL)
+        return;
+
+    state->valid = TRUE;
+
+    /* find mode and number of buttons */
+    device_info = XListInputDevices (xdisplay, &ndevices);
+    if (device_info != NULL)
+    {
+        for (i = 0; i < ndevices; i++)
+        {
+            if (device_info[i].id != device->device_id)
+                continue;
+
+            any = device_info[i].inputclassinfo;
+            for (n = 0; n < device_info[i].num_classes; n++)
+            {
+                if (any->class == ButtonClass)
+                    state->nbuttons = ((XButtonInfoPtr) any)->num_buttons;
+#ifdef DEVICE_PROPERTIES
+                else if (any->class == ValuatorClass)
+                    state->wacom_mode = ((XValuatorInfoPtr) any)->mode == Absolute ? 0 : 1;
+#endif
+
+                any = (XAnyClassPtr) ((gchar *) any + any->length);
+            }
+
+            break;
+        }
+
+        XFreeDeviceList (device_info);
+    }
+
+#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
+    /* fetch all the properties the device has in one go */
+    for (i = 0; i < N_READS; i++)
+        reads[i].property = xfce_pointers_atom (xdisplay, read_atoms[i]);
+    xfce_pointers_properties_read (xdisplay, device, reads, N_READS);
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+
+#ifdef HAVE_LIBINPUT
+    if (xfce_pointers_property_get_int (&reads[READ_LIBINPUT_LEFT_HANDED], 0, &val))
+    {
+        state->is_libinput = TRUE;
+        state->left_handed = (gboolean) val;
+    }
+
+    if (xfce_pointers_property_get_int (&reads[READ_LIBINPUT_NATURAL_SCROLL], 0, &val))
+        state->reverse_scrolling = (gboolean) val;
+
+    if (!state->is_libinput)
+#endif /* HAVE_LIBINPUT */
+    {
+        /* get the button mapping */
+        if (state->nbuttons > 0)
+        {
+            buttonmap = g_new0 (guchar, state->nbuttons);
+            XGetDeviceButtonMapping (xdisplay, device, buttonmap, state->nbuttons);
+
+            /* figure out the position of the first and second/third button in the map */
+            for (i = 0; i < state->nbuttons; i++)
+            {
+                if (buttonmap[i] == 1)
+                    id_1 = i;
+                else if (buttonmap[i] == (state->nbuttons < 3 ? 2 : 3))
+                    id_3 = i;
+                else if (buttonmap[i] == 4)
+                    id_4 = i;
+                else if (buttonmap[i] == 5)
+                    id_5 = i;
+            }
+            g_free (buttonmap);
+
+            state->left_handed = (id_1 > id_3);
+            state->reverse_scrolling = !!(id_5 < id_4);
+        }
+    }
+
+#ifdef HAVE_LIBINPUT
+    if (xfce_pointers_property_get_float (xdisplay, &reads[READ_LIBINPUT_ACCEL], 0, &accel))
+    {
+        /* We use double internally, for whatever reason */
+        state->acceleration = (gdouble) (accel + 1.0) * 5.0;
+    }
+    else
+#endif /* HAVE_LIBINPUT */
+    {
+        /* get the feedback states for this device */
+        states = XGetFeedbackControl (xdisplay, device, &nstates);
+        if (states != NULL)
+        {
+            /* get the pointer feedback class */
+            for (pt = states, i = 0; i < nstates; i++)
+            {
+                if (pt->class == PtrFeedbackClass)
+                {
+                    ptr_state = (XPtrFeedbackState *) pt;
+                    state->acceleration = (gdouble) ptr_state->accelNum / (gdouble) ptr_state->accelDenom;
+                    state->threshold = ptr_state->threshold;
+                }
+
+                /* advance the offset */
+                pt = (XFeedbackState *) ((gchar *) pt + pt->length);
+            }
+
+            XFreeFeedbackList (states);
+        }
+    }
+
+#if defined(DEVICE_PROPERTIES) || defined (HAVE_LIBINPUT)
+    /* check if this is a synaptics or wacom device */
+    state->is_synaptics = reads[READ_SYNAPTICS_OFF].data != NULL;
+    state->is_wacom = reads[READ_WACOM_TOOL_TYPE].data != NULL;
+
+    if (reads[READ_DEVICE_ENABLED].data != NULL)
+        state->is_enabled = mouse_device_cache_get_int (&reads[READ_DEVICE_ENABLED], 0);
+    if (reads[READ_SYNAPTICS_TAP_ACTION].data != NULL)
+        state->synaptics_tap_to_click = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_TAP_ACTION], 4);
+    if (reads[READ_SYNAPTICS_EDGE_SCROLLING].data != NULL)
+    {
+        state->synaptics_edge_scroll = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_EDGE_SCROLLING], 0);
+        state->synaptics_edge_hscroll = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_EDGE_SCROLLING], 1);
+    }
+    if (reads[READ_SYNAPTICS_TWO_FINGER_SCROLLING].data != NULL)
+    {
+        state->synaptics_two_scroll = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_TWO_FINGER_SCROLLING], 0);
+        state->synaptics_two_hscroll = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_TWO_FINGER_SCROLLING], 1);
+    }
+    if (reads[READ_SYNAPTICS_CIRCULAR_SCROLLING].data != NULL)
+        state->synaptics_circ_scroll = mouse_device_cache_get_int (&reads[READ_SYNAPTICS_CIRCULAR_SCROLLING], 0);
+    if (reads[READ_WACOM_ROTATION].data != NULL)
+        state->wacom_rotation = mouse_device_cache_get_int (&reads[READ_WACOM_ROTATION], 0);
+
+#ifdef HAVE_LIBINPUT
+    if (reads[READ_LIBINPUT_TAP].data != NULL)
+    {
+        state->is_synaptics = TRUE;
+        if (xfce_pointers_property_get_int (&reads[READ_LIBINPUT_TAP], 0, &val))
+            state->synaptics_tap_to_click = val;
+    }
+
+    if (reads[READ_LIBINPUT_SCROLL_METHOD_ENABLED].n_items >= 3)
+    {
+        state->synaptics_two_scroll = mouse_device_cache_get_int (&reads[READ_LIBINPUT_SCROLL_METHOD_ENABLED], 0);
+        state->synaptics_edge_scroll = mouse_device_cache_get_int (&reads[READ_LIBINPUT_SCROLL_METHOD_ENABLED], 1);
+        state->synaptics_circ_scroll = -1; /* libinput does not expose this method */
+
+        if (reads[READ_LIBINPUT_SCROLL_METHODS_AVAILABLE].n_items >= 3)
+        {
+            if (mouse_device_cache_get_int (&reads[READ_LIBINPUT_SCROLL_METHODS_AVAILABLE], 0) == 0)
+                state->synaptics_two_scroll = -1;
+            if (mouse_device_cache_get_int (&reads[READ_LIBINPUT_SCROLL_METHODS_AVAILABLE], 1) == 0)
+                state->synaptics_edge_scroll = -1;
+        }
+    }
+#endif /* HAVE_LIBINPUT */
+
+    xfce_pointers_properties_free (reads, N_READS);
+#endif /* DEVICE_PROPERTIES || HAVE_LIBINPUT */
+
+    XCloseDevice (xdisplay, device);
+}
+
+
+
+static gboolean
+mouse_device_cache_loaded (gpointer data)
+{
+    MouseDeviceState *state = data;
+    gpointer          pending;
+
+    GDK_THREADS_ENTER ();
+
+    if (cache_states != NULL)
+    {
+        if (state->valid)
+            g_hash_table_replace (cache_states, GUINT_TO_POINTER (state->xid), state);
+        else
+            g_hash_table_remove (cache_states, GUINT_TO_POINTER (state->xid));
+
+        /* tell the dialog about the new state */
+        if (cache_func != NULL)
+            cache_func (state, cache_func_data);
+
+        /* query again if the device changed while we were loading it */
+        pending = g_hash_table_lookup (cache_pending, GUINT_TO_POINTER (state->xid));
+        g_hash_table_remove (cache_pending, GUINT_TO_POINTER (state->xid));
+        if (pending == PENDING_AGAIN)
+            mouse_device_cache_refresh (state->xid);
+
+        if (!state->valid)
+            g_slice_free (MouseDeviceState, state);
+    }
+    else
+    {
+        /* the cache was shut down in the meantime */
+        g_slice_free (MouseDeviceState, state);
+    }
+
+    GDK_THREADS_LEAVE ();
+
+    return FALSE;
+}
+
+
+
+static void
+mouse_device_cache_worker (gpointer data,
+                           gpointer user_data)
+{
+    MouseDeviceState *state = data;
+
+    g_atomic_int_set (&cache_xerror, 0);
+    mouse_device_cache_query (cache_xdisplay, state);
+    if (g_atomic_int_get (&cache_xerror) != 0)
+    {
+        /* most likely the device was removed while we queried it */
+        mouse_device_state_init (state, state->xid);
+    }
+
+    g_idle_add (mouse_device_cache_loaded, state);
+}
+
+
+
+static void
+mouse_device_cache_state_free (gpointer data)
+{
+    g_slice_free (MouseDeviceState, data);
+}
+
+
+
+void
+mouse_device_state_init (MouseDeviceState *state,
+                         XID               xid)
+{
+    memset (state, 0, sizeof (MouseDeviceState));
+
+    state->xid = xid;
+    state->acceleration = -1.00;
+    state->threshold = -1;
+    state->is_enabled = -1;
+    state->synaptics_tap_to_click = -1;
+    state->synaptics_edge_scroll = -1;
+    state->synaptics_edge_hscroll = -1;
+    state->synaptics_two_scroll = -1;
+    state->synaptics_two_hscroll = -1;
+    state->synaptics_circ_scroll = -1;
+    state->wacom_rotation = -1;
+    state->wacom_mode = -1;
+}
+
+
+
+gboolean
+mouse_device_cache_init (Display              *xdisplay,
+                         MouseDeviceCacheFunc  func,
+                         gpointer              user_data)
+{
+    GError *error = NULL;
+
+    g_return_val_if_fail (cache_pool == NULL, FALSE);
+
+    /* private connection, so the worker never blocks the dialog */
+    cache_xdisplay = XOpenDisplay (DisplayString (xdisplay));
+    if (cache_xdisplay == NULL)
+    {
+        g_critical ("Failed to open a connection for the device cache");
+        return FALSE;
+    }
+
+    /* a single thread is enough, it keeps the queries ordered */
+    cache_pool = g_thread_pool_new (mouse_device_cache_worker, NULL,
+                                    1, FALSE, &error);
+    if (G_UNLIKELY (cache_pool == NULL))
+    {
+        g_critical ("Failed to start the device cache worker: %s", error->message);
+        g_error_free (error);
+
+        XCloseDisplay (cache_xdisplay);
+        cache_xdisplay = NULL;
+
+        return FALSE;
+    }
+
+    cache_xerror_parent = XSetErrorHandler (mouse_device_cache_x_error);
+
+    cache_states = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, mouse_device_cache_state_free);
+    cache_pending = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    cache_func = func;
+    cache_func_data = user_data;
+
+    return TRUE;
+}
+
+
+
+void
+mouse_device_cache_shutdown (void)
+{
+    if (cache_pool == NULL)
+        return;
+
+    /* wait for the running query, drop the queued ones */
+    g_thread_pool_free (cache_pool, TRUE, TRUE);
+    cache_pool = NULL;
+
+    XSetErrorHandler (cache_xerror_parent);
+    XCloseDisplay (cache_xdisplay);
+    cache_xdisplay = NULL;
+
+    g_hash_table_destroy (cache_states);
+    cache_states = NULL;
+    g_hash_table_destroy (cache_pending);
+    cache_pending = NULL;
+
+    cache_func = NULL;
+    cache_func_data = NULL;
+}
+
+
+
+const MouseDeviceState *
+mouse_device_cache_lookup (XID xid)
+{
+    if (cache_states == NULL)
+        return NULL;
+
+    return g_hash_table_lookup (cache_states, GUINT_TO_POINTER (xid));
+}
+
+
+
+void
+mouse_device_cache_refresh (XID xid)
+{
+    MouseDeviceState *state;
+
+    if (cache_pool == NULL)
+        return;
+
+    /* a query for this device is already on its way, only make sure
+     * it runs again once more so we don't miss the latest change */
+    if (g_hash_table_lookup (cache_pending, GUINT_TO_POINTER (xid)) != NULL)
+    {
+        g_hash_table_insert (cache_pending, GUINT_TO_POINTER (xid), PENDING_AGAIN);
+        return;
+    }
+
+    g_hash_table_insert (cache_pending, GUINT_TO_POINTER (xid), PENDING_QUEUED);
+
+    state = g_slice_new (MouseDeviceState);
+    mouse_device_state_init (state, xid);
+    g_thread_pool_push (cache_pool, state, NULL);
+}
+
+
+
+void
+mouse_device_cache_invalidate (XID xid)
+{
+    MouseDeviceState *state;
+
+    if (cache_states == NULL)
+        return;
+
+    /* keep the values around, they are still the best we have */
+    state = g_hash_table_lookup (cache_states, GUINT_TO_POINTER (xid));
+    if (state != NULL)
+        state->stale = TRUE;
+}
+
+
+
+void
+mouse_device_cache_clear (void)
+{
+    if (cache_states != NULL)
+        g_hash_table_remove_all (cache_states);
+}
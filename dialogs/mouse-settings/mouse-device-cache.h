@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <blsettingsd/pointers-defines.h>
+
+#ifndef __MOUSE_DEVICE_CACHE_H__
+#define __MOUSE_DEVICE_CACHE_H__
+
+typedef struct _MouseDeviceState MouseDeviceState;
+
+/* everything the device tab shows, queried in one go */
+struct _MouseDeviceState
+{
+    XID      xid;
+
+    /* FALSE when the device could not be opened */
+    gboolean valid;
+
+    /* TRUE when the settings changed after the state was loaded */
+    gboolean stale;
+
+    gint     nbuttons;
+    gboolean left_handed;
+    gboolean reverse_scrolling;
+    gdouble  acceleration;
+    gint     threshold;
+
+    gboolean is_libinput;
+    gboolean is_synaptics;
+    gboolean is_wacom;
+
+    /* -1 when the property is not supported */
+    gint     is_enabled;
+    gint     synaptics_tap_to_click;
+    gint     synaptics_edge_scroll;
+    gint     synaptics_edge_hscroll;
+    gint     synaptics_two_scroll;
+    gint     synaptics_two_hscroll;
+    gint     synaptics_circ_scroll;
+    gint     wacom_rotation;
+    gint     wacom_mode;
+};
+
+/* called in the main loop when a device state has been (re)loaded */
+typedef void (*MouseDeviceCacheFunc) (const MouseDeviceState *state,
+                                      gpointer                user_data);
+
+gboolean                mouse_device_cache_init       (Display              *xdisplay,
+                                                       MouseDeviceCacheFunc  func,
+                                                       gpointer              user_data);
+
+void                    mouse_device_cache_shutdown   (void);
+
+const MouseDeviceState *mouse_device_cache_lookup     (XID                   xid);
+
+void                    mouse_device_cache_refresh    (XID                   xid);
+
+void                    mouse_device_cache_invalidate (XID                   xid);
+
+void                    mouse_device_cache_clear      (void);
+
+void                    mouse_device_state_init       (MouseDeviceState     *state,
+                                                       XID                   xid);
+
+#endif /* !__MOUSE_DEVICE_CACHE_H__ */
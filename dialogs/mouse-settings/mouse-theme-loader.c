@@ -0,0 +1,530 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_XCURSOR
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_MATH_H
+#include <math.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xcursor/Xcursor.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk/gdk.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <libbladeutil/libbladeutil.h>
+
+#include "mouse-theme-loader.h"
+
+#if defined (__SSE2__) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#include <emmintrin.h>
+#define HAVE_SSE2_SWIZZLE 1
+#endif
+
+/* Themes are discovered and their preview icons decoded by a small
+ * pool of worker threads: one job scans a library path and queues a
+ * job for every theme directory it finds. Every loaded theme is handed
+ * to the main loop on its own, so the store fills in while the rest is
+ * still loading. Decoded cursors are cached as small png files. */
+
+
+
+#define LOADER_MAX_THREADS (4)
+
+#define CACHE_OPTION_PATH  "tEXt::Cursor::Path"
+#define CACHE_OPTION_MTIME "tEXt::Cursor::MTime"
+
+
+
+typedef enum
+{
+    LOADER_JOB_SCAN,
+    LOADER_JOB_THEME
+}
+LoaderJobType;
+
+typedef struct
+{
+    LoaderJobType  type;
+
+    /* library path, and the theme directory name for theme jobs */
+    gchar         *basedir;
+    gchar         *theme;
+}
+LoaderJob;
+
+
+
+static GThreadPool          *loader_pool = NULL;
+static gboolean              loader_cancelled = FALSE;
+static guint                 loader_preview_size = 0;
+static gchar                *loader_cache_dir = NULL;
+static MouseThemeLoaderFunc  loader_func = NULL;
+static gpointer              loader_func_data = NULL;
+
+/* protects pushing jobs from the workers against the shutdown */
+G_LOCK_DEFINE_STATIC (loader_pool);
+
+
+
+static void
+mouse_theme_loader_job_free (LoaderJob *job)
+{
+    g_free (job->basedir);
+    g_free (job->theme);
+    g_slice_free (LoaderJob, job);
+}
+
+
+
+static void
+mouse_theme_loader_push (LoaderJobType  type,
+                         const gchar   *basedir,
+                         const gchar   *theme)
+{
+    LoaderJob *job;
+
+    job = g_slice_new (LoaderJob);
+    job->type = type;
+    job->basedir = g_strdup (basedir);
+    job->theme = g_strdup (theme);
+
+    G_LOCK (loader_pool);
+    if (!loader_cancelled && loader_pool != NULL)
+        g_thread_pool_push (loader_pool, job, NULL);
+    else
+        mouse_theme_loader_job_free (job);
+    G_UNLOCK (loader_pool);
+}
+
+
+
+static void
+mouse_theme_loader_theme_free (MouseTheme *theme)
+{
+    g_free (theme->name);
+    g_free (theme->display_name);
+    g_free (theme->comment);
+    g_free (theme->path);
+
+    if (theme->pixbuf != NULL)
+        g_object_unref (G_OBJECT (theme->pixbuf));
+
+    g_slice_free (MouseTheme, theme);
+}
+
+
+
+/* convert native endian ARGB32 pixels to the RGBA byte order of a pixbuf,
+ * without undoing the premultiplication (the previews never did) */
+static void
+mouse_theme_loader_swizzle (guint32       *dest,
+                            const guint32 *src,
+                            gsize          n_pixels)
+{
+    gsize   i = 0;
+    guint32 p;
+
+#ifdef HAVE_SSE2_SWIZZLE
+    const __m128i mask_ag = _mm_set1_epi32 ((gint) 0xff00ff00);
+    const __m128i mask_b = _mm_set1_epi32 (0x000000ff);
+    __m128i       v;
+
+    /* four pixels at a time: keep alpha and green, swap red and blue */
+    for (; i + 4 <= n_pixels; i += 4)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (src + i));
+        v = _mm_or_si128 (_mm_and_si128 (v, mask_ag),
+                          _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (v, 16), mask_b),
+                                        _mm_slli_epi32 (_mm_and_si128 (v, mask_b), 16)));
+        _mm_storeu_si128 ((__m128i *) (dest + i), v);
+    }
+#endif
+
+    for (; i < n_pixels; i++)
+    {
+        p = src[i];
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+        dest[i] = (p << 8) | (p >> 24);
+#else
+        dest[i] = (p & 0xff00ff00) | ((p >> 16) & 0x000000ff) | ((p & 0x000000ff) << 16);
+#endif
+    }
+}
+
+
+
+static GdkPixbuf *
+mouse_theme_loader_decode (const gchar *filename,
+                           guint        size)
+{
+    XcursorImage *image;
+    GdkPixbuf    *scaled, *pixbuf = NULL;
+    guint32      *buffer;
+    gdouble       wratio, hratio;
+    gint          dest_width, dest_height;
+
+    /* load the image */
+    image = XcursorFilenameLoadImage (filename, size);
+    if (G_LIKELY (image))
+    {
+        /* copy and convert the pixel data in one pass */
+        buffer = g_new (guint32, image->width * image->height);
+        mouse_theme_loader_swizzle (buffer, (const guint32 *) image->pixels,
+                                    image->width * image->height);
+
+        /* create pixbuf */
+        pixbuf = gdk_pixbuf_new_from_data ((guchar *) buffer, GDK_COLORSPACE_RGB, TRUE,
+                                           8, image->width, image->height,
+                                           4 * image->width,
+                                           (GdkPixbufDestroyNotify) (void (*)(void)) g_free, NULL);
+
+        /* don't leak when creating the pixbuf failed */
+        if (G_UNLIKELY (pixbuf == NULL))
+            g_free (buffer);
+
+        /* scale pixbuf if needed */
+        if (pixbuf && (image->height > size || image->width > size))
+        {
+            /* calculate the ratio */
+            wratio = (gdouble) image->width / (gdouble) size;
+            hratio = (gdouble) image->height / (gdouble) size;
+
+            /* init */
+            dest_width = dest_height = size;
+
+            /* set dest size */
+            if (hratio > wratio)
+                dest_width  = rint (image->width / hratio);
+            else
+                dest_height = rint (image->height / wratio);
+
+            /* scale pixbuf */
+            scaled = gdk_pixbuf_scale_simple (pixbuf, MAX (dest_width, 1), MAX (dest_height, 1), GDK_INTERP_BILINEAR);
+
+            /* release and set scaled pixbuf */
+            g_object_unref (G_OBJECT (pixbuf));
+            pixbuf = scaled;
+        }
+
+        /* cleanup */
+        XcursorImageDestroy (image);
+    }
+
+    return pixbuf;
+}
+
+
+
+GdkPixbuf *
+mouse_theme_loader_load_cursor (const gchar *filename,
+                                guint        size)
+{
+    struct stat  st;
+    GdkPixbuf   *pixbuf = NULL;
+    gchar       *key;
+    gchar       *checksum;
+    gchar       *cache_file = NULL;
+    gchar       *tmp_file;
+    gchar       *mtime;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    /* most themes lack some of the preview cursors */
+    if (g_stat (filename, &st) != 0)
+        return NULL;
+
+    mtime = g_strdup_printf ("%ld", (glong) st.st_mtime);
+
+    if (loader_cache_dir != NULL)
+    {
+        key = g_strdup_printf ("%s:%u", filename, size);
+        checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+        cache_file = g_strconcat (loader_cache_dir, G_DIR_SEPARATOR_S, checksum, ".png", NULL);
+        g_free (checksum);
+        g_free (key);
+
+        /* use the cached image if it belongs to this version of the cursor */
+        pixbuf = gdk_pixbuf_new_from_file (cache_file, NULL);
+        if (pixbuf != NULL
+            && (g_strcmp0 (gdk_pixbuf_get_option (pixbuf, CACHE_OPTION_PATH), filename) != 0
+                || g_strcmp0 (gdk_pixbuf_get_option (pixbuf, CACHE_OPTION_MTIME), mtime) != 0))
+        {
+            g_object_unref (G_OBJECT (pixbuf));
+            pixbuf = NULL;
+        }
+    }
+
+    if (pixbuf == NULL)
+    {
+        pixbuf = mouse_theme_loader_decode (filename, size);
+
+        /* write a temporary file first, the dialog and the workers can
+         * store the same cursor at the same time; failing to save only
+         * costs a decode next time */
+        if (pixbuf != NULL && cache_file != NULL)
+        {
+            tmp_file = g_strdup_printf ("%s.%p", cache_file, (gpointer) g_thread_self ());
+            if (gdk_pixbuf_save (pixbuf, tmp_file, "png", NULL,
+                                 CACHE_OPTION_PATH, filename,
+                                 CACHE_OPTION_MTIME, mtime, NULL))
+                g_rename (tmp_file, cache_file);
+            else
+                g_unlink (tmp_file);
+            g_free (tmp_file);
+        }
+    }
+
+    g_free (cache_file);
+    g_free (mtime);
+
+    return pixbuf;
+}
+
+
+
+static gboolean
+mouse_theme_loader_loaded (gpointer data)
+{
+    MouseTheme *theme = data;
+
+    GDK_THREADS_ENTER ();
+
+    /* the loader might have been shut down in the meantime */
+    if (loader_func != NULL)
+        loader_func (theme, loader_func_data);
+
+    mouse_theme_loader_theme_free (theme);
+
+    GDK_THREADS_LEAVE ();
+
+    return FALSE;
+}
+
+
+
+static void
+mouse_theme_loader_load_theme (const gchar *basedir,
+                               const gchar *name)
+{
+    MouseTheme  *theme;
+    gchar       *filename;
+    gchar       *index_file;
+    XfceRc      *rc;
+    const gchar *comment;
+
+    theme = g_slice_new0 (MouseTheme);
+    theme->name = g_strdup (name);
+    theme->path = g_build_filename (basedir, name, "cursors", NULL);
+
+    /* we only try the normal cursor, it is (most likely) always there */
+    filename = g_build_filename (theme->path, "left_ptr", NULL);
+    theme->pixbuf = mouse_theme_loader_load_cursor (filename, loader_preview_size);
+    g_free (filename);
+
+    /* check for a index.theme file for additional information */
+    index_file = g_build_filename (basedir, name, "index.theme", NULL);
+    if (g_file_test (index_file, G_FILE_TEST_IS_REGULAR))
+    {
+        /* open theme desktop file */
+        rc = xfce_rc_simple_open (index_file, TRUE);
+        if (G_LIKELY (rc))
+        {
+            /* check for the theme group */
+            if (xfce_rc_has_group (rc, "Icon Theme"))
+            {
+                /* set group */
+                xfce_rc_set_group (rc, "Icon Theme");
+
+                /* read values */
+                theme->display_name = g_strdup (xfce_rc_read_entry (rc, "Name", name));
+                comment = xfce_rc_read_entry (rc, "Comment", NULL);
+
+                /* escape the comment */
+                theme->comment = comment ? g_markup_escape_text (comment, -1) : NULL;
+            }
+
+            /* close rc file */
+            xfce_rc_close (rc);
+        }
+    }
+    g_free (index_file);
+
+    if (theme->display_name == NULL)
+        theme->display_name = g_strdup (name);
+
+    g_idle_add (mouse_theme_loader_loaded, theme);
+}
+
+
+
+static void
+mouse_theme_loader_scan (const gchar *basedir)
+{
+    GDir        *dir;
+    const gchar *theme;
+    gchar       *filename;
+
+    /* open directory */
+    dir = g_dir_open (basedir, 0, NULL);
+    if (G_UNLIKELY (dir == NULL))
+        return;
+
+    while (!g_atomic_int_get (&loader_cancelled)
+           && (theme = g_dir_read_name (dir)) != NULL)
+    {
+        /* check if it looks like a cursor theme */
+        filename = g_build_filename (basedir, theme, "cursors", NULL);
+        if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+            mouse_theme_loader_push (LOADER_JOB_THEME, basedir, theme);
+        g_free (filename);
+    }
+
+    /* close directory */
+    g_dir_close (dir);
+}
+
+
+
+static void
+mouse_theme_loader_worker (gpointer data,
+                           gpointer user_data)
+{
+    LoaderJob *job = data;
+
+    if (!g_atomic_int_get (&loader_cancelled))
+    {
+        if (job->type == LOADER_JOB_SCAN)
+            mouse_theme_loader_scan (job->basedir);
+        else
+            mouse_theme_loader_load_theme (job->basedir, job->theme);
+    }
+
+    mouse_theme_loader_job_free (job);
+}
+
+
+
+gboolean
+mouse_theme_loader_start (guint                 preview_size,
+                          MouseThemeLoaderFunc  func,
+                          gpointer              user_data)
+{
+    const gchar  *path;
+    gchar       **basedirs;
+    gchar        *homedir;
+    gint          i;
+    GError       *error = NULL;
+
+    g_return_val_if_fail (loader_pool == NULL, FALSE);
+
+    /* create the pool before the jobs are queued */
+    loader_pool = g_thread_pool_new (mouse_theme_loader_worker, NULL,
+                                     LOADER_MAX_THREADS, FALSE, &error);
+    if (G_UNLIKELY (loader_pool == NULL))
+    {
+        g_critical ("Failed to start the cursor theme loader: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    loader_cancelled = FALSE;
+    loader_preview_size = preview_size;
+    loader_func = func;
+    loader_func_data = user_data;
+
+    /* resolved here, the resource functions are not thread safe */
+    loader_cache_dir = xfce_resource_save_location (XFCE_RESOURCE_CACHE,
+                                                    "xfce4/mouse-settings/cursors/", TRUE);
+
+    /* get the cursor paths */
+#if XCURSOR_LIB_MAJOR == 1 && XCURSOR_LIB_MINOR < 1
+    path = "~/.icons:/usr/share/icons:/usr/share/pixmaps:/usr/X11R6/lib/X11/icons";
+#else
+    path = XcursorLibraryPath ();
+#endif
+
+    /* split the paths */
+    basedirs = g_strsplit (path, ":", -1);
+    if (G_LIKELY (basedirs))
+    {
+        /* queue a scan for every base directory */
+        for (i = 0; basedirs[i] != NULL; i++)
+        {
+            /* parse the homedir if needed */
+            if (strstr (basedirs[i], "~/") != NULL)
+            {
+                homedir = g_strconcat (g_get_home_dir (), basedirs[i] + 1, NULL);
+                mouse_theme_loader_push (LOADER_JOB_SCAN, homedir, NULL);
+                g_free (homedir);
+            }
+            else
+            {
+                mouse_theme_loader_push (LOADER_JOB_SCAN, basedirs[i], NULL);
+            }
+        }
+
+        /* cleanup */
+        g_strfreev (basedirs);
+    }
+
+    return TRUE;
+}
+
+
+
+void
+mouse_theme_loader_shutdown (void)
+{
+    GThreadPool *pool;
+
+    if (loader_pool == NULL)
+        return;
+
+    /* no new jobs from here on */
+    G_LOCK (loader_pool);
+    g_atomic_int_set (&loader_cancelled, TRUE);
+    pool = loader_pool;
+    loader_pool = NULL;
+    G_UNLOCK (loader_pool);
+
+    /* drop the queued jobs and wait for the running ones */
+    g_thread_pool_free (pool, TRUE, TRUE);
+
+    /* themes still waiting in an idle are dropped */
+    loader_func = NULL;
+    loader_func_data = NULL;
+
+    g_free (loader_cache_dir);
+    loader_cache_dir = NULL;
+}
+
+#endif /* !HAVE_XCURSOR */
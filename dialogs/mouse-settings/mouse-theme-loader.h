@@ -0,0 +1,56 @@
+/*
+ *  Copyright (c) 2008-2011 Nick Schermer <nick@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#ifndef __MOUSE_THEME_LOADER_H__
+#define __MOUSE_THEME_LOADER_H__
+
+typedef struct _MouseTheme MouseTheme;
+
+/* a cursor theme found in one of the xcursor library paths */
+struct _MouseTheme
+{
+    gchar     *name;
+    gchar     *display_name;
+
+    /* escaped for the tooltip, NULL if there is none */
+    gchar     *comment;
+
+    /* the cursors directory of the theme */
+    gchar     *path;
+
+    /* small preview of the left_ptr cursor, or NULL */
+    GdkPixbuf *pixbuf;
+};
+
+/* called in the main loop for every theme that has been loaded */
+typedef void (*MouseThemeLoaderFunc) (const MouseTheme *theme,
+                                      gpointer          user_data);
+
+gboolean   mouse_theme_loader_start       (guint                 preview_size,
+                                           MouseThemeLoaderFunc  func,
+                                           gpointer              user_data);
+
+void       mouse_theme_loader_shutdown    (void);
+
+GdkPixbuf *mouse_theme_loader_load_cursor (const gchar          *filename,
+                                           guint                 size);
+
+#endif /* !__MOUSE_THEME_LOADER_H__ */